@@ -0,0 +1,76 @@
+% Reactive obstacle avoidance for all robots of a swarm (see
+% model_platform2d_swarm and sensor_rangefinder2d_swarm). Every robot
+% drives forward, slows down in front of obstacles and turns towards the
+% side with more free space.
+% For correct operation, this block has to use the same wheelRadius and
+% wheelDistance parameters as the platform and the same fieldOfView as the
+% sensor.
+%
+% Output format:
+% - 2xN matrix, one column per robot:
+%   'ddrive': [omega_r; omega_l] wheel rotational rates
+%   'vomega': [v; omega]
+function ctrl = controller_swarm2d_avoid()
+    ctrl = block_base('sensor', {'sensor'}, @control);
+
+    ctrl.log.uniform = true;
+
+    ctrl.default_model = 'ddrive';          % 'ddrive' or 'vomega'
+    ctrl.default_velocity = 0.3;            % translational speed in m/s
+    ctrl.default_omega = 90 * pi / 180;     % maximum rotational speed in rad/s
+    ctrl.default_safeDistance = 0.5;        % free distance in m below which the robot slows down
+    ctrl.default_frontAngle = 30 * pi / 180;% half width of the sector considered to be in front in rad
+    ctrl.default_fieldOfView = [-90, 90] * pi / 180; % of the sensor, relative to robot orientation
+    ctrl.default_maxRange = 4.5;            % replaces ranges without a hit
+    ctrl.default_wheelRadius = 0.03;
+    ctrl.default_wheelDistance = 0.2;
+
+    function [state, out, debugOut] = control(block, t, state, scans)
+        debugOut = [];
+        ranges = scans(end).data;
+        if isempty(ranges)
+            out = [];
+            return;
+        end
+        ranges(isinf(ranges)) = block.maxRange;
+        bearings = linspace(block.fieldOfView(1), block.fieldOfView(2), size(ranges, 1))';
+        right = ranges(bearings < 0, :);
+        left = ranges(bearings > 0, :);
+        [~, iMin] = min(abs(bearings));
+        front = ranges(abs(bearings) <= max(block.frontAngle, abs(bearings(iMin))), :);
+
+        % proportional to the clearance in front (stop and turn on the spot
+        % when closer than half the safe distance) ...
+        clearance = min(front, [], 1);
+        v = block.velocity * min(1, max(0, 2 * clearance / block.safeDistance - 1));
+        % ... and turn away from the closer side, the sharper the closer
+        balance = (freeSpace(left, block.safeDistance) - freeSpace(right, block.safeDistance)) / (2 * block.safeDistance);
+        blocked = clearance < block.safeDistance;
+        balance(blocked & balance >= 0) = 1;
+        balance(blocked & balance < 0) = -1;
+        omega = block.omega * max(-1, min(1, balance));
+
+        if strcmp(block.model, 'ddrive')
+            if numel(block.wheelRadius) > 1
+                R_right = block.wheelRadius(1);
+                R_left = block.wheelRadius(2);
+            else
+                R_right = block.wheelRadius(1);
+                R_left = block.wheelRadius(1);
+            end
+            out = [(v + 0.5 * block.wheelDistance * omega) / R_right; (v - 0.5 * block.wheelDistance * omega) / R_left];
+        else
+            out = [v; omega];
+        end
+    end
+
+    % mean free distance of a sector (clipped, so far away walls do not
+    % dominate), safeDistance if the sector is empty
+    function d = freeSpace(ranges, safeDistance)
+        if isempty(ranges)
+            d = safeDistance;
+        else
+            d = mean(min(ranges, 2 * safeDistance), 1);
+        end
+    end
+end
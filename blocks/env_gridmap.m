@@ -5,15 +5,26 @@
 % - .obstacles: boolean matrix where true means the cell is covered by an obstacle
 % - .scale: scale of the map in meter per cell
 % - .offset: coordinates of the map origin (in meters)
+% - .id: unique name of this map, gridmap_raycaster(map) returns the map
+%        kept resident (bit-packed) in mex_isect_gridmap_rays, use it for
+%        ray casting instead of .obstacles
+% - .distanceField: true if the resident map skips free space using a
+%                   distance transform
+% - .distance: single matrix of the same size as .obstacles, distance in
+%              meters from each cell to the nearest obstacle cell of the
+%              map before inflation (inf if there are no obstacles)
 
 function env = env_gridmap(map)
     env = block_base(inf, [], @createMap);
     env.graphicElements(end + 1).draw = @draw;
+    env.mexFiles{end + 1} = struct('file', fullfile(fileparts(mfilename('fullpath')), 'mex_distance_transform.cpp'), ...
+                                  'dependencies', {{fullfile(fileparts(mfilename('fullpath')), '../tools/raycast/include/raycast/grid_maps.hpp')}});
     env.default_scale = 0.01; % m/pixel
     env.default_offset = [0 0];
     env.default_color = [0 0 0];
     env.default_alpha = 1;
     env.default_inflateRadius = 0;
+    env.default_distanceField = true; % precompute obstacle clearance to speed up ray casting
     
     function handles = draw(block, ax, handles, out, debug, state)        
         if isempty(handles); 
@@ -32,12 +43,16 @@ function env = env_gridmap(map)
             error('env_gridmap:format', 'Invalid argument format: expected matrix of numeric (or logical) values');
         end
         out = struct();
-        out.obstacles = logical(map);
-        if block.inflateRadius > 0
-            % inflate map data to accommodate robot radius (+ safety distance)                    
-            out.obstacles = imdilate(out.obstacles, strel('disk', round(block.inflateRadius / block.scale), 0));
-        end
+        % inflate map data to accommodate robot radius (+ safety distance):
+        % all cells within the radius of an obstacle, same as imdilate with
+        % strel('disk', radius, 0)
+        [distance, out.obstacles] = mex_distance_transform(logical(map), max(0, round(block.inflateRadius / block.scale)));
         out.scale = block.scale;
         out.offset = block.offset;
+        % the output is logged and saved, so it only names the map; the
+        % native map object is created on demand by gridmap_raycaster
+        [~, out.id] = fileparts(tempname);
+        out.distanceField = logical(block.distanceField);
+        out.distance = distance * block.scale;
     end
 end
\ No newline at end of file
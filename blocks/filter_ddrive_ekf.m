@@ -4,6 +4,7 @@
 function filter = filter_ddrive_ekf()
     filter = filter_localization2d(@filterStep); % reuse drawing function from generic localization2d block     
     filter.depends = {'sensors/odometer', 'sensors/landmark_detector', 'environment/landmarks'};
+    filter.mexFiles{end + 1} = fullfile(fileparts(mfilename('fullpath')), '../sim-core/blocks/mex_integrate_kinematics.cpp');
     
     filter.default_initialPose = [0 0 0]';
     filter.default_initialPoseCov = zeros(3, 3);
@@ -20,7 +21,7 @@ function filter = filter_ddrive_ekf()
     filter.default_useRange = true;                 % enable update from range measurements 
     
     
-    filter.default_useNumericPrediction = false;    % do mean prediction using ode45
+    filter.default_useNumericPrediction = false;    % do mean prediction by numeric integration
     filter.default_useExactDiscretization = false;  % if true: do exact discretization, followed by linearization for covariance propagation
                                                     % if false (the default), linearize first and then discretize using the matrix exponential 
 
@@ -118,11 +119,10 @@ function [state, out, debugOut] = filterStep(block, t, state, odometer, sensor,
 
         % do state prediction
         if block.useNumericPrediction
-            % Use numeric integration
-            % This is applicable to any nonlinear system            
-            options = odeset('RelTol', 10^-13, 'AbsTol', eps);        
-            [~, X] = ode45(@(t, x)vomega_model(x, v, omega), [0, T], x, options);
-            x = (X(end, :)).';                
+            % Use numeric integration (fixed-step Dormand-Prince, the
+            % method of ode45, see mex_integrate_kinematics.cpp)
+            x = mex_integrate_kinematics(x.', [0, T], [v, omega], ...
+                                         struct('model', 'vomega', 'method', 'dopri5', 'maxStep', 1e-3)).';
         else
             % exact solution
             if abs(omega) < 1e-12
@@ -256,10 +256,3 @@ function [state, out, debugOut] = filterStep(block, t, state, odometer, sensor,
         P = (eye(3) - K * C) * P;                          
     end
 end
-
-function dx = vomega_model(x, v, omega)
-    phi = x(3);
-    dx = [v * cos(phi); ...
-          v * sin(phi); ...
-          omega];
-end
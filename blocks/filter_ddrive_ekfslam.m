@@ -4,6 +4,8 @@
 function filter = filter_ddrive_ekfslam()
     filter = filter_slam2d(@filterStep); % reuse drawing function from generic localization2d block     
     filter.depends = {'sensors/odometer', 'sensors/landmark_detector', 'environment/landmarks', 'platform'};
+    filter.mexFiles{end + 1} = fullfile(fileparts(mfilename('fullpath')), 'mex_ekfslam.cpp');
+    filter.mexFiles{end + 1} = fullfile(fileparts(mfilename('fullpath')), '../sim-core/blocks/mex_integrate_kinematics.cpp');
     
     filter.default_initialPose = [0 0 0]';
     filter.default_initialPoseCov = zeros(3, 3);
@@ -17,10 +19,19 @@ function filter = filter_ddrive_ekfslam()
     filter.default_useBearing = true;               % enable update from bearing measurements
     filter.default_useRange = true;                 % enable update from range measurements 
 
-    filter.default_useNumericPrediction = false;    % do mean prediction using ode45
+    filter.default_useNumericPrediction = false;    % do mean prediction by numeric integration
     filter.default_useExactDiscretization = false;  % if true: do exact discretization, followed by linearization for covariance propagation
                                                     % if false (the default), linearize first and then discretize using the matrix exponential 
     
+    filter.default_useMex = true;                   % keep state and covariance in the native EKF-SLAM core (mex_ekfslam.cpp).
+                                                    % The block state then holds only the pose and landmark blocks of the covariance.
+    filter.default_featureCapacity = 64;            % number of features to preallocate memory for in the native core
+    
+    % the full covariance of the native core is not part of the block
+    % state: the simulator restarts the filter from a checkpoint (with a
+    % copy of the core) instead of continuing from a logged state
+    filter.log.restoresState = false;
+    
 	
     filter.figures(end + 1).name = 'Covariance Plot';
     filter.figures(end).icon = fullfile(fileparts(mfilename('fullpath')), 'covariance_icon.png');
@@ -41,7 +52,27 @@ function filter = filter_ddrive_ekfslam()
         diag.hCovImg = image('Parent', diag.ax, 'CData', [], 'CDataMapping', 'scaled');
     end
     function diag = updateCovFigure(block, f, diag, out, debug, state, varargin)
-        set(diag.hCovImg, 'CData', state.cov);
+        if isfield(state, 'core') && ~isempty(state.core) && state.core.isValid() && ...
+           state.core.invoke('revision') == state.revision
+            % the full covariance is only kept by the native core (every
+            % k-th row/column of it for large maps)
+            covariance = state.core.invoke('covariance', 'maxSize', 512);
+        else
+            if isfield(state, 'core')
+                % an earlier state (replay): only the pose and landmark
+                % blocks of the covariance are known
+                covariance = zeros(3 + 2 * numel(state.features));
+                covariance(1:3, 1:3) = state.cov;
+                for i = 1:numel(state.features)
+                    c = state.featureCovariances(i, :);
+                    covariance(2 * i + (2:3), 2 * i + (2:3)) = [c(1), c(2); c(2), c(3)];
+                end
+            else covariance = state.cov;
+            end
+            step = ceil(size(covariance, 1) / 512);
+            covariance = covariance(1:step:end, 1:step:end);
+        end
+        set(diag.hCovImg, 'CData', covariance);
     end	
 
     function [f, diag] = createErrorFigure(block, blockName)       
@@ -97,11 +128,19 @@ function [state, out, debugOut] = filterStep(block, t, state, odometer, sensor,
         state.t = 0;
 
         state.features = [];
+        if block.useMex
+            state.featureCovariances = zeros(0, 3);
+            state.core = [];
+            state.revision = -1;
+        end
     end
 
     % use shorter symbols 
     x = state.x;
     P = state.cov;
+    if block.useMex
+        core = nativeCore(block, state);
+    end
     u = state.lastInput;
     tNow = state.t;
 
@@ -140,6 +179,15 @@ function [state, out, debugOut] = filterStep(block, t, state, odometer, sensor,
     end
 
     % put short-named intermediate variables back into the filter state
+    if block.useMex
+        coreState = core.invoke('get');
+        x = coreState.x;
+        P = coreState.poseCov;
+        state.features = coreState.features;
+        state.featureCovariances = coreState.featureCovariances;
+        state.core = core;
+        state.revision = coreState.revision;
+    end
     state.x = x;
     state.pose = x(1:3);
     state.cov = P;
@@ -153,12 +201,32 @@ function [state, out, debugOut] = filterStep(block, t, state, odometer, sensor,
     out.cov = state.cov(1:3, 1:3);
     out.featurePositions = reshape(state.x(4:end), 2, [])';
     out.landmarkIds = state.features;
-    autoCorrs = diag(state.cov(4:end, 4:end));
-    crossCorrs = diag(state.cov(4:end, 4:end), 1);
-    out.featureCovariances = [autoCorrs(1:2:end), crossCorrs(1:2:end), autoCorrs(2:2:end)]; 
+    if block.useMex
+        out.featureCovariances = state.featureCovariances;
+    else
+        autoCorrs = diag(state.cov(4:end, 4:end));
+        crossCorrs = diag(state.cov(4:end, 4:end), 1);
+        out.featureCovariances = [autoCorrs(1:2:end), crossCorrs(1:2:end), autoCorrs(2:2:end)]; 
+    end
 
     function [x, P] = doPrediction(x, P, u, T)        
-        % Implementation of the prediction step
+        % Implementation of the prediction step. Only the pose is affected,
+        % i. e. with the pose Jacobian F and the pose noise Q, the
+        % covariance becomes [F * P_rr * F' + Q, F * P_rl; P_lr * F', P_ll]
+        % (r: pose, l: landmarks)
+        [pose, F, Q] = predictPose(x(1:3), u, T);
+        if block.useMex
+            x(1:3) = core.invoke('predict', 'pose', pose, 'F', F, 'Q', Q);
+        else
+            x(1:3) = pose;
+            P(1:3, :) = F * P(1:3, :);
+            P(:, 1:3) = P(:, 1:3) * F.';
+            P(1:3, 1:3) = P(1:3, 1:3) + Q;
+        end
+    end
+
+    function [x, F, Q] = predictPose(x, u, T)
+        % pose prediction, its Jacobian F and the noise Q added by the inputs
 
         R_R = block.wheelRadius(1);
         R_L = block.wheelRadius(end);
@@ -184,11 +252,10 @@ function [state, out, debugOut] = filterStep(block, t, state, odometer, sensor,
         
         % do state prediction
         if block.useNumericPrediction
-            % Use numeric integration
-            % This is applicable to any nonlinear system            
-            options = odeset('RelTol', 10^-13, 'AbsTol', eps);        
-            [~, X] = ode45(@(t, x)vomega_model(x, v, omega), [0, T], x, options);
-            x(1:3) = (X(end, :)).';                
+            % Use numeric integration (fixed-step Dormand-Prince, the
+            % method of ode45, see mex_integrate_kinematics.cpp)
+            x(1:3) = mex_integrate_kinematics(x(1:3).', [0, T], [v, omega], ...
+                                              struct('model', 'vomega', 'method', 'dopri5', 'maxStep', 1e-3)).';
         else
             % exact solution
             if abs(omega) < 1e-12
@@ -233,9 +300,7 @@ function [state, out, debugOut] = filterStep(block, t, state, odometer, sensor,
             end
             H = S * B;
             
-            F = blkdiag(F, eye(size(P, 1) - 3));
-            P = F * P * F.';
-            P(1:3, 1:3) = P(1:3, 1:3) + H * N * H.';
+            Q = H * N * H.';
         else
             % discretize first (only applicable, if ODEs can be solved
             % analytically), then linearize the discrete model
@@ -258,9 +323,8 @@ function [state, out, debugOut] = filterStep(block, t, state, odometer, sensor,
                          R_R * T / (2 * a), -R_L * T / (2 * a)];
             end
             
-            A_dis = blkdiag(A_dis, eye(size(P, 1) - 3));
-            P = A_dis * P * A_dis.';            
-            P(1:3, 1:3) = P(1:3, 1:3) + B_dis * N * B_dis.';
+            F = A_dis;
+            Q = B_dis * N * B_dis.';
         end
     end
 
@@ -268,6 +332,15 @@ function [state, out, debugOut] = filterStep(block, t, state, odometer, sensor,
         % Implementation of the update step
         visIdx = meas.lmIds; % assume we can associate each measurement with a known landmark
         if isempty(visIdx); return; end
+        
+        if block.useMex
+            % all measurements of the sample in one call, the core keeps
+            % track of the features
+            x(1:3) = core.invoke('update', 'ids', visIdx(:), 'bearing', meas.bearing(:), 'range', meas.range(:), ...
+                                 'bearingError', block.bearingError, 'rangeError', block.rangeError, ...
+                                 'useBearing', block.useBearing, 'useRange', block.useRange);
+            return;
+        end
 
         % determine, which measurements belong to features already part
         % of the state vector and which we see for the first time (map
@@ -388,10 +461,22 @@ function [state, out, debugOut] = filterStep(block, t, state, odometer, sensor,
     end
 end
 
-function dx = vomega_model(x, v, omega)
-    phi = x(3);
-    dx = [v * cos(phi); ...
-          v * sin(phi); ...
-          omega];
+% The native core of a filter state. The core continues from the state if
+% its revision matches, i. e. the state is the most recent one. Otherwise
+% (should not happen, as the simulator restarts the filter from checkpoints,
+% see log.restoresState) a new core is created from the state, which only
+% holds the pose and landmark blocks of the covariance.
+function core = nativeCore(block, state)
+    core = state.core;
+    if ~isempty(core)
+        try
+            if core.invoke('revision') == state.revision; return; end
+        catch
+        end
+        warning('Sim:EKFSLAM:CoreRestored', 'EKF-SLAM core restored from the block state, correlations between pose and landmarks are lost');
+    end
+    core = mex_object_handle(@mex_ekfslam, 'pose', state.x(1:3), 'poseCov', state.cov(1:3, 1:3), ...
+                             'features', state.features(:), 'featurePositions', reshape(state.x(4:end), 2, []).', ...
+                             'featureCovariances', state.featureCovariances, ...
+                             'capacity', max(block.featureCapacity, 2 * numel(state.features)));
 end
-
@@ -0,0 +1,176 @@
+% Localization algorithm for a Differential Drive Mobile Robot based on
+% Monte Carlo Localization (particle filter) with a range finder. The
+% particles are kept, predicted, weighted and resampled by the native core
+% mex_mcl.cpp, which uses a likelihood field computed from the obstacle
+% distances of the map (see env_gridmap) and adapts the number of
+% particles by KLD sampling.
+%
+% Inputs: odometer (wheel speeds), rangefinder (sensor_rangefinder2d) and
+% the obstacle map (env_gridmap). The filter runs on each range scan.
+
+function filter = filter_ddrive_mcl()
+    filter = filter_localization2d(@filterStep); % reuse drawing function from generic localization2d block
+    filter.timing.triggers = {'sensors/rangefinder'};
+    filter.depends = {'sensors/odometer', 'sensors/rangefinder', 'environment/obstacles'};
+    filter.mexFiles{end + 1} = struct('file', fullfile(fileparts(mfilename('fullpath')), 'mex_mcl.cpp'), ...
+                                     'dependencies', {fullfile(fileparts(mfilename('fullpath')), '../tools/raycast/include/raycast', ...
+                                                               {'grid_maps.hpp', 'ray_caster.hpp', 'worker_pool.hpp'})});
+
+    filter.default_initialPose = [];                % empty: global localization, particles spread over the free space of the map
+    filter.default_initialPoseError = [0.1, 0.1, 10 * pi / 180]; % sigma of the initial pose (if given)
+
+    filter.default_odometryError = 5 * pi / 180;    % sigma of assumed odometer uncertainty in rad/s
+    filter.default_motionError = [0.05, 0.05];      % sigma of the pose change between two scans, relative to the distance and rotation (see mex_mcl.cpp)
+    filter.default_maxRange = 4.5;                  % maximum range of the rangefinder in m
+    filter.default_sigmaHit = 0.05;                 % sigma of assumed beam end point error in m
+    filter.default_zHit = 0.9;                      % weight of the gaussian part of the measurement model
+    filter.default_zRand = 0.1;                     % weight of random measurements
+    filter.default_maxBeams = 60;                   % number of beams evaluated per scan
+
+    filter.default_minParticles = 500;
+    filter.default_maxParticles = 20000;
+    filter.default_kldError = 0.05;                 % bound of the KL divergence for the adaptive particle count
+    filter.default_binSize = [0.1, 0.1, 10 * pi / 180];
+    filter.default_resampleThreshold = 0.5;         % resample when the effective sample size falls below this fraction
+    filter.default_maxDrawnParticles = 2000;
+
+    % the particles are only kept by the native core: the simulator restarts
+    % the filter from a checkpoint (with a copy of the core) instead of
+    % continuing from a logged state
+    filter.log.restoresState = false;
+
+    filter.graphicElements(end + 1).draw = @drawParticles;
+    filter.graphicElements(end).name = 'Particles';
+
+    function handles = drawParticles(block, ax, handles, out, debugOut, state, varargin)
+        if isempty(handles)
+            handles = line('Parent', ax, 'XData', [], 'YData', [], 'Color', block.color, 'LineStyle', 'none', 'Marker', '.', 'MarkerSize', 4);
+        end
+        % the particles are only kept by the native core, which is drawn
+        % only while it belongs to the displayed state
+        particles = zeros(3, 0);
+        if isfield(state, 'core') && ~isempty(state.core) && state.core.isValid()
+            try
+                if state.core.invoke('revision') == state.revision
+                    particles = state.core.invoke('particles', 'maxCount', block.maxDrawnParticles);
+                end
+            catch
+            end
+        end
+        set(handles, 'XData', particles(1, :), 'YData', particles(2, :));
+    end
+end
+
+function [state, out, debugOut] = filterStep(block, t, state, odometer, sensor, obstacles)
+    debugOut = [];
+
+    if isempty(state)
+        % Initialization
+        state.pose = block.initialPose(:);
+        state.cov = diag(block.initialPoseError .^ 2);
+        state.lastInput = [0; 0]; % initial speed is zero
+        state.t = 0;
+        state.count = 0;
+        state.core = [];
+        state.revision = -1;
+    end
+
+    core = nativeCore(block, state, obstacles(end).data);
+    u = state.lastInput;
+    tNow = state.t;
+
+    % odometer samples are collected and passed to the core with the next
+    % scan, [wheel speeds; duration] in columns
+    U = zeros(2, 0);
+    dT = zeros(1, 0);
+
+    iPredict = 1;
+    iUpdate = 1;
+
+    while tNow < t
+        % determine, which measurement to proceed next
+        if iUpdate <= length(sensor)
+            tNextUpdate = sensor(iUpdate).t;
+        else tNextUpdate = t;
+        end
+        while tNow < tNextUpdate
+            if iPredict <= length(odometer)
+                tNext = odometer(iPredict).t;
+                if tNext <= tNextUpdate
+                    U(:, end + 1) = u;
+                    dT(end + 1) = tNext - tNow;
+                    tNow = tNext;
+                    u = odometer(iPredict).data(:);
+                    iPredict = iPredict + 1;
+                else break;
+                end
+            else break;
+            end
+        end
+
+        if tNow < tNextUpdate
+            U(:, end + 1) = u;
+            dT(end + 1) = tNextUpdate - tNow;
+            tNow = tNextUpdate;
+        end
+
+        if iUpdate <= length(sensor)
+            if ~isempty(dT)
+                core.invoke('predict', 'u', U, 'dt', dT);
+                U = zeros(2, 0);
+                dT = zeros(1, 0);
+            end
+            scan = sensor(iUpdate).data;
+            core.invoke('update', 'range', scan.range(:), 'bearing', scan.bearing(:));
+            iUpdate = iUpdate + 1;
+        end
+    end
+    if ~isempty(dT)
+        core.invoke('predict', 'u', U, 'dt', dT);
+    end
+
+    estimate = core.invoke('estimate');
+    state.pose = estimate.pose;
+    state.cov = estimate.cov;
+    state.count = estimate.count;
+    state.core = core;
+    state.revision = estimate.revision;
+    state.lastInput = u;
+    state.t = tNow;
+
+    % the output of the localization filter is the estimated pose and its covariance
+    out.pose = estimate.pose;
+    out.cov = estimate.cov;
+end
+
+% The native core of a filter state. The core continues from the state if
+% its revision matches, i. e. the state is the most recent one. Otherwise
+% (should not happen, as the simulator restarts the filter from checkpoints,
+% see log.restoresState) a new core is created, with particles drawn from
+% the pose and covariance of the state.
+function core = nativeCore(block, state, map)
+    core = state.core;
+    if ~isempty(core)
+        try
+            if core.invoke('revision') == state.revision; return; end
+        catch
+        end
+        warning('Sim:MCL:CoreRestored', 'MCL core restored from the block state, the particles are redrawn from the estimated pose');
+    end
+    opts = struct('distance', map.distance, 'scale', map.scale, 'offset', map.offset, ...
+                  'wheelRadius', block.wheelRadius, 'wheelDistance', block.wheelDistance, ...
+                  'odometryError', block.odometryError, 'motionError', block.motionError, ...
+                  'maxRange', block.maxRange, 'sigmaHit', block.sigmaHit, 'zHit', block.zHit, 'zRand', block.zRand, ...
+                  'maxBeams', block.maxBeams, 'minParticles', block.minParticles, 'maxParticles', block.maxParticles, ...
+                  'kldError', block.kldError, 'binSize', block.binSize, 'resampleThreshold', block.resampleThreshold, ...
+                  'seed', randi(2^31 - 1));
+    if ~isempty(state.pose)
+        opts.pose = state.pose;
+        if isempty(state.core)
+            opts.poseError = block.initialPoseError;
+        else
+            opts.poseError = sqrt(max(0, diag(state.cov)'));
+        end
+    end
+    core = mex_object_handle(@mex_mcl, opts);
+end
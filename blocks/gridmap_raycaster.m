@@ -0,0 +1,29 @@
+% Native ray caster for a map from env_gridmap: a map object of
+% mex_isect_gridmap_rays (see there for the methods). Native objects only
+% live in the current Matlab session, so they are not part of the map
+% itself but kept here, looked up by the map's .id and rebuilt from
+% .obstacles when the id is unknown (e.g. after loading an experiment).
+% Returns [] for maps without .id.
+function caster = gridmap_raycaster(map)
+    persistent cache;
+    maxMaps = 4;
+    
+    caster = [];
+    if ~isfield(map, 'id') || isempty(map.id)
+        return;
+    end
+    if isempty(cache)
+        cache = repmat(struct('id', '', 'caster', []), 0, 1);
+    end
+    
+    iCache = find(strcmp(map.id, {cache.id}), 1);
+    if isempty(iCache)
+        caster = mex_object_handle(@mex_isect_gridmap_rays, 'obstacles', map.obstacles, ...
+                                   'scale', map.scale, 'offset', map.offset, ...
+                                   'distanceField', map.distanceField);
+        cache = [struct('id', map.id, 'caster', caster); cache(1:min(end, maxMaps - 1))];
+    else
+        caster = cache(iCache).caster;
+        cache = [cache(iCache); cache([1:(iCache - 1), (iCache + 1):end])];
+    end
+end
@@ -1,4 +1,13 @@
-function [envGroup, obstacleMap] = grp_obstacles_and_landmarks_from_image(path, varargin)
+% Creates an obstacle map (env_gridmap) and landmarks (const_points) from
+% an image with indexed colors. Each 8-connected region of the landmark
+% color becomes one landmark at its centroid.
+% Additional outputs:
+% - obstacleMap: boolean matrix, true where the image has the obstacle color
+% - landmarkRegions: struct with fields
+%   .centroid - Kx2 landmark positions (same as envGroup.landmarks)
+%   .area - Kx1 region areas in m^2
+%   .boundingBox - Kx4 region extents [xMin, yMin, xMax, yMax] in m
+function [envGroup, obstacleMap, landmarkRegions] = grp_obstacles_and_landmarks_from_image(path, varargin)
     args = struct(varargin{:});
     if ~isfield(args, 'obstacleColor')
         args.obstacleColor = [0 0 0];
@@ -26,37 +35,19 @@ function [envGroup, obstacleMap] = grp_obstacles_and_landmarks_from_image(path,
         lm_idx = -1;
     end
     
-    obstacleMap = (mapImg == obst_idx);
+    if isempty(args.landmarkColor)
+        lm_idx = -1;
+    end
+    
+    % obstacle mask and landmark regions in a single pass over the image
+    mex_make(fullfile(fileparts(mfilename('fullpath')), 'mex_image_components.cpp'));
+    [obstacleMap, centroids, areas, boxes] = mex_image_components(mapImg, obst_idx, lm_idx);
     envGroup.obstacles = env_gridmap(obstacleMap);
     envGroup.obstacles.scale = args.scale;
     
-    landmarks = zeros(0, 2);
-    if ~isempty(args.landmarkColor)
-        temp = which('bwlabel');
-        if ~isempty(temp)
-            [labelMap, numLm] = bwlabel(mapImg == lm_idx);
-
-            if numLm > 0
-                sumX = zeros(numLm, 1);
-                sumY = zeros(numLm, 1);
-                N = zeros(numLm, 1);
-
-                for x = 1:size(labelMap, 2)
-                    for y = 1:size(labelMap, 1)
-                        label = labelMap(y, x);
-                        if label > 0
-                            sumX(label) = sumX(label) + x;
-                            sumY(label) = sumY(label) + y;
-                            N(label) = N(label) + 1;
-                        end
-                    end
-                end				
-                landmarks = args.scale * ([sumX ./ N, sumY ./ N] + 0.5);
-            end
-        else
-            warning('grp_obstacles_and_landmarks_from_image:toolbox', 'Image processing toolbox not installed. Could not extract landmarks.');
-        end
-    end    
+    landmarks = args.scale * (centroids + 0.5);
+    landmarkRegions = struct('centroid', landmarks, 'area', args.scale^2 * areas, ...
+                             'boundingBox', args.scale * [boxes(:, 1:2), boxes(:, 3:4) + 1]);
     envGroup.landmarks = const_points(landmarks);
     envGroup.landmarks.format = {'Marker', 'd', 'MarkerFaceColor', 0.7 * [1 1 1], 'MarkerSize', 8, 'MarkerEdgeColor', 0.2 * [1 1 1]};
 
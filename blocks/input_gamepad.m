@@ -7,9 +7,14 @@
 % - axis: index of gamepad axis (zero-based)
 % - range: [max], [min, max] or [min, neutral, max] of the output value
 %
+% The joystick is opened once (mex_joystick) and polled by a background
+% thread, the block state holds its handle. It is reopened if the handle did
+% not survive (e.g. the experiment was loaded from a file).
+%
 function input = input_gamepad(varargin)    
     input = block_base(1/10, [], @read);
-    input.mexFiles{end + 1} = fullfile(fileparts(mfilename('fullpath')), '../tools/input/joyread.c');
+    input.mexFiles{end + 1} = struct('file', fullfile(fileparts(mfilename('fullpath')), '../tools/input/mex_joystick.cpp'), ...
+                                     'dependencies', {{'input_device.hpp'}});
     if nargin > 1; error('input_gamepad:args', 'Too many input arguments'); end
     if nargin == 1
         input.mapping = varargin{1};
@@ -23,10 +28,15 @@ function input = input_gamepad(varargin)
         input.mapping(1).range = [];
     end
         
-    function [state, out, debugOut] = read(block, varargin)
+    input.default_joystickIndex = 0;     % zero-based index of the joystick
+    
+    function [state, out, debugOut] = read(block, t, state, varargin)
         debugOut = [];
-        state = [];
-        axisData = joyread();
+        if isempty(state) || ~state.isValid()
+            state = mex_object_handle(@mex_joystick, 'index', block.joystickIndex);
+        end
+        joystick = state.invoke('state');
+        axisData = joystick.axes;
         out = zeros(size(block.mapping));
         if ~isempty(axisData)
             for i = 1:numel(out)
@@ -0,0 +1,104 @@
+% This block builds an occupancy grid map from range scans.
+% The log-odds grid is kept in mex_occupancy_grid and updated in place by
+% each scan (endpoint hits, free space along the rays), so the grid has a
+% fixed size and a scan costs O(rays * range).
+% The grid only exists in the native object of the current state and in
+% the checkpoints of the simulator (log.restoresState = false), the logged
+% states only hold the revision. While replaying, the grid of the most
+% recent checkpoint at or before the displayed time is drawn (nothing for
+% loaded experiments, which have no checkpoints yet). Output format: struct
+% with fields
+% - .scale: scale of the grid in meter per cell
+% - .offset: coordinates of the grid origin (in meters)
+% - .revision: number of scans integrated so far
+function mapper = map_occupancy2d()
+    mapper = block_base('sensors/rangefinder', {'platform', 'sensors/rangefinder'}, @addScan);
+
+    mapper.mexFiles{end + 1} = fullfile(fileparts(mfilename('fullpath')), 'mex_occupancy_grid.cpp');
+
+    mapper.graphicElements(end + 1).draw = @drawMap;
+
+    % the grid is not logged (see unloadRecord), the simulator restarts the
+    % block from a checkpoint (with a copy of the grid) instead
+    mapper.log.unload = @unloadRecord;
+    mapper.log.load = @loadRecord;
+    mapper.log.restoresState = false;
+    mapper.log.maxCached = 1; % loaded records refer to a checkpointed grid
+
+    mapper.default_scale = 0.05;            % m/cell
+    mapper.default_offset = [0 0];          % coordinates of the grid origin in m
+    mapper.default_extent = [10 10];        % [width, height] of the grid in m
+    mapper.default_maxRange = 4.5;          % free space cleared by rays without return, should match the rangefinder
+    mapper.default_logOddsHit = 0.85;
+    mapper.default_logOddsMiss = -0.4;
+    mapper.default_logOddsLimits = [-2 3.5];
+    mapper.default_color = [1 0 0];
+
+    % only cells that are more likely occupied than free are drawn. Once
+    % the image shows a grid, only the tiles changed since the last redraw
+    % are fetched from it.
+    function handles = drawMap(block, ax, handles, out, debugOut, state, varargin)
+        if isempty(handles)
+            handles = image('Parent', ax, 'CData', zeros(1, 1, 3), 'AlphaData', 0, 'UserData', struct('grid', [], 'revision', -1));
+        end
+        if ~isfield(state, 'grid') || isempty(state.grid) || ~state.grid.isValid()
+            set(handles, 'Visible', 'off', 'UserData', struct('grid', [], 'revision', -1));
+            return;
+        end
+        % the drawn grid is kept in UserData, so its key is not reused by
+        % another grid
+        drawn = get(handles, 'UserData');
+        revision = state.grid.invoke('revision');
+        if isempty(drawn.grid) || drawn.grid ~= state.grid || drawn.revision > revision
+            occupancy = state.grid.invoke('image');
+            set(handles, 'CData', repmat(reshape(block.color, 1, 1, 3), size(occupancy)), ...
+                         'AlphaData', max(2 * occupancy - 1, 0), ...
+                         'XData', out.offset(1) + out.scale * ((1:size(occupancy, 2)) - 0.5), ...
+                         'YData', out.offset(2) + out.scale * ((1:size(occupancy, 1)) - 0.5));
+        elseif drawn.revision < revision
+            [occupancy, rows, cols] = state.grid.invoke('image', 'since', drawn.revision);
+            if ~isempty(occupancy)
+                alpha = get(handles, 'AlphaData');
+                alpha(rows(1):rows(2), cols(1):cols(2)) = max(2 * occupancy - 1, 0);
+                set(handles, 'AlphaData', alpha);
+            end
+        end
+        set(handles, 'Visible', 'on', 'UserData', struct('grid', state.grid, 'revision', revision));
+    end
+
+    function [state, out, debugOut] = addScan(block, t, state, poseProvider, rangefinder)
+        debugOut = [];
+
+        if isempty(state)
+            state = struct('grid', createGrid(block), 'revision', 0);
+        elseif ~state.grid.isValid() || state.grid.invoke('revision') ~= state.revision
+            % the simulator never continues from a logged state (see
+            % log.restoresState), so this is an internal error
+            error('Sim:OccupancyGrid:StateLost', 'Occupancy grid does not match the block state');
+        end
+
+        pose = poseProvider(end).data;
+        for i = 1:numel(rangefinder)
+            state.revision = state.grid.invoke('addScan', 'pose', pose, 'range', rangefinder(i).data.range, ...
+                                               'bearing', rangefinder(i).data.bearing, 'maxRange', block.maxRange);
+        end
+        out = struct('scale', block.scale, 'offset', block.offset, 'revision', state.revision);
+    end
+end
+
+function grid = createGrid(block)
+    grid = mex_object_handle(@mex_occupancy_grid, 'scale', block.scale, 'offset', block.offset, 'extent', block.extent, ...
+                             'logOddsHit', block.logOddsHit, 'logOddsMiss', block.logOddsMiss, 'logOddsLimits', block.logOddsLimits);
+end
+
+% log records hold the revision of the grid, but not the grid. Loading them
+% while replaying attaches the grid of the checkpoint.
+function [out, debugOut, state] = unloadRecord(block, iteration, out, debugOut, state)
+    state = rmfield(state, 'grid');
+end
+function [out, debugOut, state] = loadRecord(block, iteration, out, debugOut, state, checkpointState)
+    state.grid = [];
+    if nargin >= 6 && ~isempty(checkpointState)
+        state.grid = checkpointState.grid;
+    end
+end
@@ -3,7 +3,9 @@
 % output data. 
 % Visualization of the scan map is done by storing a Mx2 array of absolute
 % ray endpoint coordinates for every scan in the state.
-% The drawing function accesses the whole log to display all scans
+% The drawing function accesses the whole log to display all scans, so
+% memory and redraw time grow with the length of the experiment. See
+% map_occupancy2d for a map of fixed size.
 function mapper = map_scans2d()
     mapper = block_base('sensors/rangefinder', {'platform', 'sensors/rangefinder'}, @addScan);    
     
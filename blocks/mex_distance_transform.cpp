@@ -0,0 +1,74 @@
+//$ mex mex_distance_transform.cpp -I../tools/raycast/include # Maltab command for generating the MEX file
+/*******************************************************
+ * Euclidean distance transform of an obstacle grid map in linear time
+ * (Felzenszwalb & Huttenlocher, see raycast/grid_maps.hpp) and obstacle
+ * inflation by thresholding the distances.
+ *
+ * [distance, inflated] = mex_distance_transform(obstacles[, radius])
+ * Outputs:
+ * - distance: single matrix of the same size as obstacles, distance in cells
+ *             from each cell center to the nearest obstacle cell center (0
+ *             for obstacles, inf if the map does not contain any obstacle).
+ *             Cells outside the map are not considered obstacles.
+ * - inflated: logical matrix, true for all cells within radius of an
+ *             obstacle. Equal to imdilate(obstacles, strel('disk', radius, 0))
+ *             for integer radii.
+ * Inputs:
+ * - obstacles: logical matrix, true means the cell is covered by an obstacle
+ * - radius: (optional) inflation radius in cells, 0 by default
+ */
+
+#include "mex.h"
+#include "matrix.h"
+#include <raycast/grid_maps.hpp>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#define INDEX_IN_OBSTACLES  0
+#define INDEX_IN_RADIUS     1
+#define IN_MIN_COUNT        1
+#define IN_MAX_COUNT        2
+
+#define INDEX_OUT_DISTANCE  0
+#define INDEX_OUT_INFLATED  1
+#define OUT_MAX_COUNT       2
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    if (nrhs < IN_MIN_COUNT) mexErrMsgTxt("Too few input arguments");
+    if (nrhs > IN_MAX_COUNT) mexErrMsgTxt("Too many input arguments");
+    if (nlhs > OUT_MAX_COUNT) mexErrMsgTxt("Too many output arguments");
+
+    const mxArray *mxObstacles = prhs[INDEX_IN_OBSTACLES];
+    if (!mxIsLogical(mxObstacles) || mxGetNumberOfDimensions(mxObstacles) != 2)
+        mexErrMsgTxt("Input argument 'obstacles' must be a logical matrix");
+    double radius = 0.0;
+    if (nrhs > INDEX_IN_RADIUS) {
+        const mxArray *mxRadius = prhs[INDEX_IN_RADIUS];
+        if (!mxIsDouble(mxRadius) || mxIsComplex(mxRadius) || mxGetNumberOfElements(mxRadius) != 1 || !(mxGetScalar(mxRadius) >= 0))
+            mexErrMsgTxt("Input argument 'radius' must be a non-negative scalar");
+        radius = mxGetScalar(mxRadius);
+    }
+
+    size_t height = mxGetM(mxObstacles), width = mxGetN(mxObstacles), count = width * height;
+    if (width > (size_t)std::numeric_limits<int>::max() || height > (size_t)std::numeric_limits<int>::max())
+        mexErrMsgTxt("Input argument 'obstacles' is too large");
+    const mxLogical *pObstacles = mxGetLogicals(mxObstacles);
+    std::vector<int64_t> dist(count);
+    for (size_t i = 0; i < count; i++) dist[i] = pObstacles[i] ? 0 : raycast::DISTANCE_INF;
+    if (count > 0) raycast::squaredDistanceTransform(&dist[0], (int)width, (int)height);
+
+    plhs[INDEX_OUT_DISTANCE] = mxCreateNumericMatrix(height, width, mxSINGLE_CLASS, mxREAL);
+    float *pDistance = (float *)mxGetData(plhs[INDEX_OUT_DISTANCE]);
+    for (size_t i = 0; i < count; i++) {
+        pDistance[i] = dist[i] >= raycast::DISTANCE_INF ? std::numeric_limits<float>::infinity() : (float)std::sqrt((double)dist[i]);
+    }
+
+    if (nlhs > INDEX_OUT_INFLATED) {
+        // compare squared distances, which are exact integers
+        double radius2 = radius * radius;
+        plhs[INDEX_OUT_INFLATED] = mxCreateLogicalMatrix(height, width);
+        mxLogical *pInflated = mxGetLogicals(plhs[INDEX_OUT_INFLATED]);
+        for (size_t i = 0; i < count; i++) pInflated[i] = dist[i] < raycast::DISTANCE_INF && (double)dist[i] <= radius2;
+    }
+}
@@ -0,0 +1,287 @@
+//$ mex mex_dwa_candidates.cpp # Maltab command for generating the MEX file
+/*******************************************************
+ * Evaluate the v/omega candidates of the Dynamic Window Approach (see
+ * dwaStep in guidance_dwa2d_native.m).
+ *
+ * candidates = mex_dwa_candidates(obstacleLines, window, resolution, params)
+ * Inputs:
+ * - obstacleLines: Nx4 matrix of obstacle lines [px py qx qy] in robot
+ *                  coordinates (robot at the origin, heading along x)
+ * - window: [minV, maxV, minOmega, maxOmega], limits of the dynamic window
+ * - resolution: [nV, nOmega], number of candidates per window dimension
+ * - params: struct with fields
+ *   .T - time step [s]
+ *   .accV, .accOmega - translational/angular deceleration [m / s^2], [rad / s^2]
+ *   .vMax - velocity of utility 1 in the velocity utility [m / s]
+ *   .maxDistanceCare - upper limit for the obstacle distance utility [m]
+ *   .weights - weight factors [heading, obstacle distance, velocity, approach]
+ *   .goal - [x, y] goal position in robot coordinates
+ * Output: struct with the nV x nOmega candidate matrices stored by dwaStep
+ * in debugOut (meshgrid layout, velocities along the rows, omegas along the
+ * columns):
+ *   .velocities, .omegas - the candidates, omegas below 1e-4 rad/s are set to 0
+ *   .minDists - collision distance along the trajectory (inf if none)
+ *   .admissibleCandidates - logical, minDists > distance to stop the robot
+ *                           after one time step
+ *   .utility_heading, .utility_dist, .utility_velocity, .utility_approach
+ *   .utility_sum - weighted sum of the utilities, 0 for non-admissible candidates
+ *
+ * Collision distances are computed in closed form: straight trajectories
+ * (omega = 0) by a line/segment intersection, arcs of radius R = v / omega
+ * (center [0, R]) by a circle/segment intersection, from which the angle
+ * travelled up to the hit point follows. The lines are sorted by their
+ * distance from the robot, so each candidate stops testing lines as soon as
+ * no remaining line can be closer than the nearest hit (the path length to
+ * a point is never shorter than its distance).
+ */
+
+#include "mex.h"
+#include "matrix.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#define IN_REQ_COUNT 4
+#define IN_MAX_COUNT 4
+#define OUT_MAX_COUNT 1
+
+#define INDEX_IN_LINES 0
+#define INDEX_IN_WINDOW 1
+#define INDEX_IN_RESOLUTION 2
+#define INDEX_IN_PARAMS 3
+
+// obstacle line p + u * d, u in [0, 1], with precomputed products
+struct ObstacleLine {
+    double px, py, dx, dy;
+    double dd, dp, pp; // d.d, d.p, p.p
+    double minDist;    // distance of the closest point to the origin
+};
+
+struct CandidateParameters {
+    double T;
+    double accV, accOmega;
+    double vMax;
+    double maxDistanceCare;
+    double weights[4];
+    double goal[2];
+};
+
+static double getScalarField(const mxArray *mxStruct, const char *name) {
+    const mxArray *mxField = mxGetField(mxStruct, 0, name);
+    if (!mxField) mexErrMsgIdAndTxt("mex_dwa_candidates:params", "Parameter '%s' missing", name);
+    if (!(mxIsNumeric(mxField) || mxIsLogical(mxField)) || mxIsComplex(mxField) || mxGetNumberOfElements(mxField) != 1)
+        mexErrMsgIdAndTxt("mex_dwa_candidates:params", "Parameter '%s' must be a real numeric scalar", name);
+    return mxGetScalar(mxField);
+}
+
+static void getVectorField(const mxArray *mxStruct, const char *name, double *pDest, size_t count) {
+    const mxArray *mxField = mxGetField(mxStruct, 0, name);
+    if (!mxField) mexErrMsgIdAndTxt("mex_dwa_candidates:params", "Parameter '%s' missing", name);
+    if (!mxIsDouble(mxField) || mxIsComplex(mxField) || mxGetNumberOfElements(mxField) != count)
+        mexErrMsgIdAndTxt("mex_dwa_candidates:params", "Parameter '%s' must be a real double vector with %d elements", name, (int)count);
+    std::copy(mxGetPr(mxField), mxGetPr(mxField) + count, pDest);
+}
+
+static CandidateParameters getParameters(const mxArray *mxParams) {
+    if (!mxIsStruct(mxParams) || mxGetNumberOfElements(mxParams) != 1)
+        mexErrMsgTxt("Input argument 'params' must be a scalar struct");
+    CandidateParameters params;
+    params.T = getScalarField(mxParams, "T");
+    params.accV = getScalarField(mxParams, "accV");
+    params.accOmega = getScalarField(mxParams, "accOmega");
+    params.vMax = getScalarField(mxParams, "vMax");
+    params.maxDistanceCare = getScalarField(mxParams, "maxDistanceCare");
+    getVectorField(mxParams, "weights", params.weights, 4);
+    getVectorField(mxParams, "goal", params.goal, 2);
+    if (!(params.accV > 0.0) || !(params.accOmega > 0.0))
+        mexErrMsgTxt("Parameters 'accV' and 'accOmega' must be positive");
+    if (!(params.maxDistanceCare > 0.0)) mexErrMsgTxt("Parameter 'maxDistanceCare' must be positive");
+    return params;
+}
+
+static std::vector<ObstacleLine> getObstacleLines(const mxArray *mxLines) {
+    if (mxGetNumberOfDimensions(mxLines) != 2 || !mxIsDouble(mxLines) || mxIsComplex(mxLines) ||
+        (mxGetN(mxLines) != 4 && !mxIsEmpty(mxLines)))
+        mexErrMsgTxt("Input argument 'obstacleLines' must be a Nx4 double matrix");
+
+    size_t count = mxIsEmpty(mxLines) ? 0 : mxGetM(mxLines);
+    const double *pLines = mxGetPr(mxLines);
+    std::vector<ObstacleLine> lines;
+    lines.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        ObstacleLine line;
+        line.px = pLines[i];
+        line.py = pLines[i + count];
+        line.dx = pLines[i + 2 * count] - line.px;
+        line.dy = pLines[i + 3 * count] - line.py;
+        line.dd = line.dx * line.dx + line.dy * line.dy;
+        line.dp = line.dx * line.px + line.dy * line.py;
+        line.pp = line.px * line.px + line.py * line.py;
+        if (!(line.dd > 0.0) || !std::isfinite(line.dd) || !std::isfinite(line.pp)) continue; // degenerate lines are never hit
+        double u = std::min(1.0, std::max(0.0, -line.dp / line.dd));
+        line.minDist = std::hypot(line.px + u * line.dx, line.py + u * line.dy);
+        lines.push_back(line);
+    }
+    std::sort(lines.begin(), lines.end(), [](const ObstacleLine &a, const ObstacleLine &b) { return a.minDist < b.minDist; });
+    return lines;
+}
+
+// path length travelled on a straight line in direction sign(v) until
+// hitting the line, inf if it is not hit
+static inline double straightDistance(const ObstacleLine &line, double direction) {
+    // solve direction * [d, 0] = p + u * D for d >= 0 and u in [0, 1]
+    double denom = direction * line.dy;
+    if (denom == 0.0) return HUGE_VAL; // parallel
+    double d = (line.px * line.dy - line.py * line.dx) / denom;
+    double u = -line.py * direction / denom;
+    return (d >= 0.0 && u >= 0.0 && u <= 1.0) ? d : HUGE_VAL;
+}
+
+// path length travelled on the arc of radius R = v / omega (center [0, R])
+// in direction sign(v) until hitting the line, inf if it is not hit
+static inline double arcDistance(const ObstacleLine &line, double R, double direction) {
+    // |p + u * D - [0, R]|^2 = R^2  <=>  a * u^2 + b * u + c = 0
+    double a = line.dd;
+    double b = 2.0 * (line.dp - R * line.dy);
+    double c = line.pp - 2.0 * R * line.py;
+    double disc = b * b - 4.0 * a * c;
+    if (disc < 0.0) return HUGE_VAL;
+    double sqrtDisc = std::sqrt(disc);
+    double absR = std::fabs(R);
+    double signR = R > 0.0 ? 1.0 : -1.0;
+    double best = HUGE_VAL;
+    for (int i = 0; i < 2; i++) {
+        double u = (-b + (i == 0 ? -sqrtDisc : sqrtDisc)) / (2.0 * a);
+        if (u < 0.0 || u > 1.0) continue;
+        double qx = line.px + u * line.dx;
+        double qy = line.py + u * line.dy;
+        // hit point = [sign(v) * |R| * sin(alpha), R * (1 - cos(alpha))]
+        double alpha = std::atan2(direction * qx, absR - signR * qy);
+        if (alpha < 0.0) alpha += 2.0 * M_PI;
+        best = std::min(best, alpha * absR);
+    }
+    return best;
+}
+
+static double collisionDistance(const std::vector<ObstacleLine> &lines, double v, double omega) {
+    double best = HUGE_VAL;
+    if (v == 0.0) return best; // collision impossible, if the robot is not moving
+    double direction = v > 0.0 ? 1.0 : -1.0;
+    double R = omega != 0.0 ? v / omega : 0.0;
+    for (size_t i = 0; i < lines.size() && lines[i].minDist < best; i++) {
+        double d = omega == 0.0 ? straightDistance(lines[i], direction) : arcDistance(lines[i], R, direction);
+        if (d < best) best = d;
+    }
+    return best;
+}
+
+static double clamp01(double x) {
+    return std::min(1.0, std::max(0.0, x));
+}
+
+static void setField(mxArray *mxResult, const char *name, mxArray *mxValue) {
+    mxSetFieldByNumber(mxResult, 0, mxAddField(mxResult, name), mxValue);
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    if (nrhs < IN_REQ_COUNT) mexErrMsgTxt("Too few input arguments");
+    if (nrhs > IN_MAX_COUNT) mexErrMsgTxt("Too many input arguments");
+    if (nlhs > OUT_MAX_COUNT) mexErrMsgTxt("Too many output arguments");
+
+    const mxArray *mxWindow = prhs[INDEX_IN_WINDOW];
+    const mxArray *mxResolution = prhs[INDEX_IN_RESOLUTION];
+    if (!mxIsDouble(mxWindow) || mxIsComplex(mxWindow) || mxGetNumberOfElements(mxWindow) != 4)
+        mexErrMsgTxt("Input argument 'window' must be a real double vector [minV, maxV, minOmega, maxOmega]");
+    if (!mxIsDouble(mxResolution) || mxIsComplex(mxResolution) || mxGetNumberOfElements(mxResolution) != 2 ||
+        !(mxGetPr(mxResolution)[0] >= 1.0) || !(mxGetPr(mxResolution)[1] >= 1.0))
+        mexErrMsgTxt("Input argument 'resolution' must be a real double vector [nV, nOmega] of positive values");
+
+    const double *window = mxGetPr(mxWindow);
+    size_t nV = (size_t)mxGetPr(mxResolution)[0];
+    size_t nOmega = (size_t)mxGetPr(mxResolution)[1];
+    std::vector<ObstacleLine> lines = getObstacleLines(prhs[INDEX_IN_LINES]);
+    CandidateParameters params = getParameters(prhs[INDEX_IN_PARAMS]);
+
+    mxArray *mxVelocities = mxCreateDoubleMatrix(nV, nOmega, mxREAL);
+    mxArray *mxOmegas = mxCreateDoubleMatrix(nV, nOmega, mxREAL);
+    mxArray *mxMinDists = mxCreateDoubleMatrix(nV, nOmega, mxREAL);
+    mxArray *mxAdmissible = mxCreateLogicalMatrix(nV, nOmega);
+    mxArray *mxHeading = mxCreateDoubleMatrix(nV, nOmega, mxREAL);
+    mxArray *mxDist = mxCreateDoubleMatrix(nV, nOmega, mxREAL);
+    mxArray *mxVelocity = mxCreateDoubleMatrix(nV, nOmega, mxREAL);
+    mxArray *mxApproach = mxCreateDoubleMatrix(nV, nOmega, mxREAL);
+    mxArray *mxSum = mxCreateDoubleMatrix(nV, nOmega, mxREAL);
+    double *velocities = mxGetPr(mxVelocities), *omegas = mxGetPr(mxOmegas), *minDists = mxGetPr(mxMinDists);
+    mxLogical *admissible = mxGetLogicals(mxAdmissible);
+    double *heading = mxGetPr(mxHeading), *dist = mxGetPr(mxDist), *velocity = mxGetPr(mxVelocity);
+    double *approach = mxGetPr(mxApproach), *sum = mxGetPr(mxSum);
+
+    const double goalDistance = std::hypot(params.goal[0], params.goal[1]);
+    double minApproach = HUGE_VAL, maxApproach = -HUGE_VAL;
+    for (size_t iOmega = 0; iOmega < nOmega; iOmega++) {
+        // same values as linspace(minOmega, maxOmega, nOmega)
+        double omega = nOmega > 1 ? window[2] + iOmega * (window[3] - window[2]) / (nOmega - 1) : window[3];
+        if (iOmega == nOmega - 1) omega = window[3];
+        // prevent insanely large arcs by snapping tiny angular rates to zero
+        if (std::fabs(omega) < 1e-4) omega = 0.0;
+
+        for (size_t iV = 0; iV < nV; iV++) {
+            double v = nV > 1 ? window[0] + iV * (window[1] - window[0]) / (nV - 1) : window[1];
+            if (iV == nV - 1) v = window[1];
+            size_t i = iV + iOmega * nV;
+            velocities[i] = v;
+            omegas[i] = omega;
+
+            double dColl = collisionDistance(lines, v, omega);
+            minDists[i] = dColl;
+
+            // distance of one time step and of stopping afterwards (constant
+            // arc radius, i.e. v and omega reach zero simultaneously)
+            double tDeceleration = std::max(std::fabs(v) / params.accV, std::fabs(omega) / params.accOmega);
+            double dNextStep = std::fabs(v) * params.T;
+            double dDeceleration = 0.5 * std::fabs(v) * tDeceleration;
+            double dPred = dNextStep + dDeceleration;
+            admissible[i] = dColl > dPred;
+
+            // predicted pose after the time step and the deceleration phase
+            double phi = omega * (params.T + 0.5 * tDeceleration);
+            double x, y;
+            if (omega != 0.0) {
+                double R = v / omega;
+                x = R * std::sin(phi);
+                y = R * (1.0 - std::cos(phi));
+            } else {
+                x = v * (params.T + 0.5 * tDeceleration);
+                y = 0.0;
+            }
+
+            double theta = std::remainder(std::atan2(params.goal[1] - y, params.goal[0] - x) - phi, 2.0 * M_PI);
+            heading[i] = 1.0 - std::fabs(theta) / M_PI;
+            dist[i] = clamp01((dColl - dPred) / params.maxDistanceCare);
+            velocity[i] = params.vMax > 0.0 ? std::fabs(v) / params.vMax : 0.0;
+            approach[i] = goalDistance - std::hypot(x - params.goal[0], y - params.goal[1]);
+            minApproach = std::min(minApproach, approach[i]);
+            maxApproach = std::max(maxApproach, approach[i]);
+        }
+    }
+
+    size_t count = nV * nOmega;
+    double approachScale = std::max(std::fabs(minApproach), std::fabs(maxApproach));
+    for (size_t i = 0; i < count; i++) {
+        approach[i] = minApproach < maxApproach ? 0.5 + 0.5 * approach[i] / approachScale : 0.0;
+        sum[i] = admissible[i] ? params.weights[0] * heading[i] + params.weights[1] * dist[i] +
+                                 params.weights[2] * velocity[i] + params.weights[3] * approach[i]
+                               : 0.0;
+    }
+
+    plhs[0] = mxCreateStructMatrix(1, 1, 0, NULL);
+    setField(plhs[0], "velocities", mxVelocities);
+    setField(plhs[0], "omegas", mxOmegas);
+    setField(plhs[0], "minDists", mxMinDists);
+    setField(plhs[0], "admissibleCandidates", mxAdmissible);
+    setField(plhs[0], "utility_heading", mxHeading);
+    setField(plhs[0], "utility_dist", mxDist);
+    setField(plhs[0], "utility_velocity", mxVelocity);
+    setField(plhs[0], "utility_approach", mxApproach);
+    setField(plhs[0], "utility_sum", mxSum);
+}
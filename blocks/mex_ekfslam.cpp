@@ -0,0 +1,515 @@
+//$ mex mex_ekfslam.cpp -I../tools/mex/include # Maltab command for generating the MEX file
+/*******************************************************
+ * EKF-SLAM core for filter_ddrive_ekfslam: keeps the state vector
+ * [x, y, phi, lx1, ly1, lx2, ly2, ...] and its covariance between calls and
+ * updates only the parts touched by the motion and measurement models.
+ *
+ * Construction: core = mex_object_handle(@mex_ekfslam, opts)
+ * opts: struct with fields
+ *   .pose - initial pose [x; y; phi]
+ *   .poseCov - 3x3 covariance of the initial pose
+ *   .features - (optional) Mx1 landmark ids of initial features
+ *   .featurePositions - (optional) Mx2 feature positions
+ *   .featureCovariances - (optional) Mx3 feature covariances [xx, xy, yy].
+ *                         Initial features are uncorrelated.
+ *   .capacity - (optional) number of features to allocate memory for
+ *               (default: 64). The capacity is doubled as needed.
+ *
+ * Methods (all return the revision, which is incremented by every change):
+ *   [pose, revision] = core.invoke('predict', 'pose', pose, 'F', F, 'Q', Q)
+ *       Replace the pose by the predicted pose. The covariance is propagated
+ *       with the pose Jacobian F (3x3) and the pose noise Q (3x3):
+ *       P_rr = F * P_rr * F' + Q, P_rl = F * P_rl (r: pose, l: features).
+ *   [pose, revision] = core.invoke('update', 'ids', ids, 'bearing', bearing, 'range', range,
+ *                                  'bearingError', sigma, 'rangeError', sigma,
+ *                                  'useBearing', b, 'useRange', b)
+ *       Process all range/bearing measurements of one sensor sample.
+ *       Landmarks seen for the first time are added to the state (from
+ *       both range and bearing), the measurements of all other landmarks
+ *       are processed in a single EKF update. rangeError is relative to
+ *       the measured range.
+ *   s = core.invoke('get')
+ *       struct with fields .x (state vector), .poseCov (3x3), .features
+ *       (landmark ids), .featureCovariances (Mx3, see above), .revision
+ *   revision = core.invoke('revision')
+ *   P = core.invoke('covariance'[, 'maxSize', n])
+ *       The full covariance matrix, or every k-th row/column of it such
+ *       that P has at most n rows.
+ *   copy = core.clone()
+ *       Independent copy of the filter (e.g. for the checkpoints of the simulator)
+ *
+ * Costs with N state variables and m measurements of known landmarks:
+ * prediction O(N), adding a landmark O(N), update O(N * m) for the sparse
+ * products with the measurement Jacobian (each row touches 5 state
+ * variables) and O(N^2 * m) for the covariance update, which is dense in
+ * an EKF. Only the upper triangle is computed and then mirrored.
+ */
+
+#include "mex.h"
+#include "matrix.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <mex/object_manager.hpp>
+
+#define POSE_SIZE 3
+#define ROW_SIZE 5 // state variables touched by one measurement: pose and landmark
+
+class EkfSlam {
+public:
+    EkfSlam(const double *pose, const double *poseCov, size_t capacity):
+        size_(0), ld_(0), revision_(0) {
+        reserve(POSE_SIZE + 2 * std::max<size_t>(capacity, 1));
+        size_ = POSE_SIZE;
+        for (int i = 0; i < POSE_SIZE; i++) {
+            x_[i] = pose[i];
+            for (int j = 0; j < POSE_SIZE; j++) P(i, j) = poseCov[i + POSE_SIZE * j];
+        }
+    }
+
+    size_t size() const { return size_; }
+    size_t featureCount() const { return ids_.size(); }
+    uint64_t revision() const { return revision_; }
+    const double *x() const { return &x_[0]; }
+    double cov(size_t i, size_t j) const { return P_[i + j * ld_]; }
+    double featureId(size_t i) const { return ids_[i]; }
+
+    void addUncorrelatedFeature(double id, double px, double py, double cxx, double cxy, double cyy) {
+        if (index_.count(id)) throw std::runtime_error("Duplicate feature id");
+        size_t i = appendFeature(id);
+        x_[i] = px;
+        x_[i + 1] = py;
+        P(i, i) = cxx;
+        P(i, i + 1) = P(i + 1, i) = cxy;
+        P(i + 1, i + 1) = cyy;
+        revision_++;
+    }
+
+    void predict(const double *pose, const double *F, const double *Q) {
+        for (int i = 0; i < POSE_SIZE; i++) x_[i] = pose[i];
+
+        // P_rl = F * P_rl, P_lr = P_rl'
+        for (size_t j = POSE_SIZE; j < size_; j++) {
+            double col[POSE_SIZE];
+            for (int i = 0; i < POSE_SIZE; i++) {
+                col[i] = 0.0;
+                for (int k = 0; k < POSE_SIZE; k++) col[i] += F[i + POSE_SIZE * k] * P(k, j);
+            }
+            for (int i = 0; i < POSE_SIZE; i++) P(i, j) = P(j, i) = col[i];
+        }
+        // P_rr = F * P_rr * F' + Q
+        double FP[POSE_SIZE][POSE_SIZE];
+        for (int i = 0; i < POSE_SIZE; i++) {
+            for (int j = 0; j < POSE_SIZE; j++) {
+                FP[i][j] = 0.0;
+                for (int k = 0; k < POSE_SIZE; k++) FP[i][j] += F[i + POSE_SIZE * k] * P(k, j);
+            }
+        }
+        for (int i = 0; i < POSE_SIZE; i++) {
+            for (int j = 0; j < POSE_SIZE; j++) {
+                double value = Q[i + POSE_SIZE * j];
+                for (int k = 0; k < POSE_SIZE; k++) value += FP[i][k] * F[j + POSE_SIZE * k];
+                P(i, j) = value;
+            }
+        }
+        revision_++;
+    }
+
+    struct Measurement {
+        double id, bearing, range;
+    };
+
+    void update(const std::vector<Measurement> &measurements, double bearingError, double rangeError, bool useBearing, bool useRange) {
+        // landmarks seen for the first time are added first, the update uses
+        // the measurements of the landmarks known before
+        std::vector<const Measurement *> known;
+        for (size_t i = 0; i < measurements.size(); i++) {
+            if (index_.count(measurements[i].id)) known.push_back(&measurements[i]);
+        }
+        for (size_t i = 0; i < measurements.size(); i++) {
+            if (!index_.count(measurements[i].id)) addFeature(measurements[i], bearingError, rangeError);
+        }
+        if (!known.empty() && (useBearing || useRange)) updateKnown(known, bearingError, rangeError, useBearing, useRange);
+        revision_++;
+    }
+
+    // every step-th row/column of the covariance
+    void copyCovariance(size_t step, double *dest) const {
+        size_t n = (size_ + step - 1) / step;
+        for (size_t j = 0; j < n; j++) {
+            for (size_t i = 0; i < n; i++) dest[i + j * n] = cov(i * step, j * step);
+        }
+    }
+
+private:
+    double &P(size_t i, size_t j) { return P_[i + j * ld_]; }
+
+    void reserve(size_t capacity) {
+        if (capacity <= ld_) return;
+        std::vector<double> resized(capacity * capacity, 0.0);
+        for (size_t j = 0; j < size_; j++) std::copy(&P_[j * ld_], &P_[j * ld_] + size_, &resized[j * capacity]);
+        P_.swap(resized);
+        x_.resize(capacity, 0.0);
+        ld_ = capacity;
+    }
+
+    // appends a feature with zero mean and covariance, returns its index in x
+    size_t appendFeature(double id) {
+        if (size_ + 2 > ld_) reserve(std::max(2 * ld_, size_ + 2));
+        size_t i = size_;
+        size_ += 2;
+        index_[id] = i;
+        ids_.push_back(id);
+        for (size_t j = 0; j < size_; j++) P(i, j) = P(i + 1, j) = P(j, i) = P(j, i + 1) = 0.0;
+        return i;
+    }
+
+    void addFeature(const Measurement &m, double bearingError, double rangeError) {
+        double phi = x_[2] + m.bearing;
+        double c = std::cos(phi), s = std::sin(phi);
+        // Jacobians w.r.t. the pose (Jr) and the measurement [bearing, range] (Jz)
+        double Jr[2][POSE_SIZE] = {{1.0, 0.0, -m.range * s}, {0.0, 1.0, m.range * c}};
+        double Jz[2][2] = {{-m.range * s, c}, {m.range * c, s}};
+        double sigmaB2 = bearingError * bearingError;
+        double sigmaR2 = (rangeError * m.range) * (rangeError * m.range);
+
+        double px = x_[0] + m.range * c, py = x_[1] + m.range * s;
+        size_t l = appendFeature(m.id);
+        x_[l] = px;
+        x_[l + 1] = py;
+
+        // cross covariances with all previous state variables: Jr * P_r*
+        for (size_t j = 0; j < l; j++) {
+            for (int a = 0; a < 2; a++) {
+                double value = 0.0;
+                for (int k = 0; k < POSE_SIZE; k++) value += Jr[a][k] * P(k, j);
+                P(l + a, j) = P(j, l + a) = value;
+            }
+        }
+        // Jr * P_rr * Jr' + Jz * W * Jz'
+        for (int a = 0; a < 2; a++) {
+            for (int b = 0; b < 2; b++) {
+                double value = Jz[a][0] * sigmaB2 * Jz[b][0] + Jz[a][1] * sigmaR2 * Jz[b][1];
+                for (int k = 0; k < POSE_SIZE; k++) value += P(l + a, k) * Jr[b][k];
+                P(l + a, l + b) = value;
+            }
+        }
+    }
+
+    void updateKnown(const std::vector<const Measurement *> &known, double bearingError, double rangeError, bool useBearing, bool useRange) {
+        // sparse measurement Jacobian: each row touches the pose and one landmark
+        size_t m = known.size() * ((useBearing ? 1 : 0) + (useRange ? 1 : 0));
+        std::vector<size_t> rowIndex(m * ROW_SIZE);
+        std::vector<double> rowValue(m * ROW_SIZE), innovation(m), noise(m);
+        size_t row = 0;
+        for (int type = 0; type < 2; type++) {
+            if ((type == 0 && !useBearing) || (type == 1 && !useRange)) continue;
+            for (size_t i = 0; i < known.size(); i++, row++) {
+                size_t l = index_[known[i]->id];
+                double dx = x_[l] - x_[0], dy = x_[l + 1] - x_[1];
+                size_t *index = &rowIndex[row * ROW_SIZE];
+                double *value = &rowValue[row * ROW_SIZE];
+                index[0] = 0; index[1] = 1; index[2] = 2; index[3] = l; index[4] = l + 1;
+                if (type == 0) {
+                    double d2 = dx * dx + dy * dy;
+                    double z = std::atan2(dy, dx) - x_[2];
+                    innovation[row] = std::remainder(known[i]->bearing - z, 2.0 * M_PI);
+                    value[0] = dy / d2; value[1] = -dx / d2; value[2] = -1.0;
+                    value[3] = -dy / d2; value[4] = dx / d2;
+                    noise[row] = bearingError * bearingError;
+                } else {
+                    double d = std::sqrt(dx * dx + dy * dy);
+                    innovation[row] = known[i]->range - d;
+                    value[0] = -dx / d; value[1] = -dy / d; value[2] = 0.0;
+                    value[3] = dx / d; value[4] = dy / d;
+                    noise[row] = (rangeError * known[i]->range) * (rangeError * known[i]->range);
+                }
+            }
+        }
+
+        // PC = P * C' (N x m)
+        size_t n = size_;
+        std::vector<double> PC(n * m, 0.0);
+        for (size_t k = 0; k < m; k++) {
+            double *pc = &PC[k * n];
+            for (int e = 0; e < ROW_SIZE; e++) {
+                const double *column = &P_[rowIndex[k * ROW_SIZE + e] * ld_];
+                double c = rowValue[k * ROW_SIZE + e];
+                for (size_t i = 0; i < n; i++) pc[i] += c * column[i];
+            }
+        }
+        // S = C * P * C' + W (m x m), Cholesky factorization S = L * L'
+        std::vector<double> L(m * m, 0.0);
+        for (size_t k = 0; k < m; k++) {
+            for (size_t a = k; a < m; a++) {
+                double value = a == k ? noise[k] : 0.0;
+                for (int e = 0; e < ROW_SIZE; e++) value += rowValue[a * ROW_SIZE + e] * PC[k * n + rowIndex[a * ROW_SIZE + e]];
+                L[a + k * m] = value;
+            }
+        }
+        for (size_t k = 0; k < m; k++) {
+            for (size_t j = 0; j < k; j++) {
+                for (size_t a = k; a < m; a++) L[a + k * m] -= L[a + j * m] * L[k + j * m];
+            }
+            if (!(L[k + k * m] > 0.0)) throw std::runtime_error("Innovation covariance is not positive definite");
+            double d = std::sqrt(L[k + k * m]);
+            for (size_t a = k; a < m; a++) L[a + k * m] /= d;
+        }
+        // K = PC * S^-1: solve L * L' * K' = PC' for each row of PC
+        std::vector<double> K(PC);
+        for (size_t k = 0; k < m; k++) {
+            double *kk = &K[k * n];
+            for (size_t j = 0; j < k; j++) {
+                double l = L[k + j * m];
+                const double *kj = &K[j * n];
+                for (size_t i = 0; i < n; i++) kk[i] -= l * kj[i];
+            }
+            double d = 1.0 / L[k + k * m];
+            for (size_t i = 0; i < n; i++) kk[i] *= d;
+        }
+        for (size_t k = m; k-- > 0; ) {
+            double *kk = &K[k * n];
+            for (size_t j = k + 1; j < m; j++) {
+                double l = L[j + k * m];
+                const double *kj = &K[j * n];
+                for (size_t i = 0; i < n; i++) kk[i] -= l * kj[i];
+            }
+            double d = 1.0 / L[k + k * m];
+            for (size_t i = 0; i < n; i++) kk[i] *= d;
+        }
+
+        // x = x + K * innovation
+        for (size_t k = 0; k < m; k++) {
+            const double *kk = &K[k * n];
+            for (size_t i = 0; i < n; i++) x_[i] += kk[i] * innovation[k];
+        }
+        // P = P - K * PC' (upper triangle, then mirrored). With K and PC
+        // transposed, each entry is a dot product of two contiguous rows;
+        // four columns are processed at once to share the rows of K.
+        std::vector<double> Kt(n * m), PCt(n * m);
+        for (size_t k = 0; k < m; k++) {
+            for (size_t i = 0; i < n; i++) {
+                Kt[i * m + k] = K[k * n + i];
+                PCt[i * m + k] = PC[k * n + i];
+            }
+        }
+        size_t j = 0;
+        for (; j + 4 <= n; j += 4) {
+            const double *b0 = &PCt[j * m], *b1 = b0 + m, *b2 = b1 + m, *b3 = b2 + m;
+            double *c0 = &P_[j * ld_], *c1 = c0 + ld_, *c2 = c1 + ld_, *c3 = c2 + ld_;
+            // entries below the diagonal are overwritten by mirrorUpper()
+            for (size_t i = 0; i < j + 4; i++) {
+                const double *a = &Kt[i * m];
+                double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+                for (size_t k = 0; k < m; k++) {
+                    s0 += a[k] * b0[k];
+                    s1 += a[k] * b1[k];
+                    s2 += a[k] * b2[k];
+                    s3 += a[k] * b3[k];
+                }
+                c0[i] -= s0;
+                c1[i] -= s1;
+                c2[i] -= s2;
+                c3[i] -= s3;
+            }
+        }
+        for (; j < n; j++) {
+            const double *b = &PCt[j * m];
+            double *column = &P_[j * ld_];
+            for (size_t i = 0; i <= j; i++) {
+                const double *a = &Kt[i * m];
+                double sum = 0.0;
+                for (size_t k = 0; k < m; k++) sum += a[k] * b[k];
+                column[i] -= sum;
+            }
+        }
+        mirrorUpper();
+    }
+
+    // copy the upper triangle of the covariance to the lower one (in tiles
+    // to keep the transposed accesses in the cache)
+    void mirrorUpper() {
+        const size_t tile = 32;
+        for (size_t jt = 0; jt < size_; jt += tile) {
+            for (size_t it = 0; it <= jt; it += tile) {
+                size_t jEnd = std::min(jt + tile, size_), iEnd = std::min(it + tile, size_);
+                for (size_t j = jt; j < jEnd; j++) {
+                    for (size_t i = it; i < iEnd && i < j; i++) P(j, i) = P(i, j);
+                }
+            }
+        }
+    }
+
+    std::vector<double> x_, P_; // P_ is column-major with leading dimension ld_
+    size_t size_, ld_;
+    std::vector<double> ids_;
+    std::map<double, size_t> index_; // landmark id -> index of the feature in x_
+    uint64_t revision_;
+};
+
+enum EkfSlamMethod {
+    METHOD_PREDICT,
+    METHOD_UPDATE,
+    METHOD_GET,
+    METHOD_REVISION,
+    METHOD_COVARIANCE
+};
+
+static const mxArray *getField(const mxArray *mxStruct, const char *name) {
+    const mxArray *mxField = mxStruct ? mxGetField(mxStruct, 0, name) : NULL;
+    if (!mxField) throw std::runtime_error(std::string("Parameter '") + name + "' missing");
+    return mxField;
+}
+
+static const double *getMatrixField(const mxArray *mxStruct, const char *name, size_t count) {
+    const mxArray *mxField = getField(mxStruct, name);
+    if (!mxIsDouble(mxField) || mxIsComplex(mxField) || mxGetNumberOfElements(mxField) != count)
+        throw std::runtime_error(std::string("Parameter '") + name + "' must be a real double array with " + std::to_string(count) + " elements");
+    return mxGetPr(mxField);
+}
+
+static double getScalar(const mxArray *mxStruct, const char *name, double defaultValue) {
+    const mxArray *mxField = mxStruct ? mxGetField(mxStruct, 0, name) : NULL;
+    if (!mxField) return defaultValue;
+    if (!(mxIsNumeric(mxField) || mxIsLogical(mxField)) || mxIsComplex(mxField) || mxGetNumberOfElements(mxField) != 1)
+        throw std::runtime_error(std::string("Parameter '") + name + "' must be a real scalar");
+    return mxGetScalar(mxField);
+}
+
+static size_t getOptionalCount(const mxArray *mxStruct, const char *name) {
+    const mxArray *mxField = mxGetField(mxStruct, 0, name);
+    return mxField ? mxGetNumberOfElements(mxField) : 0;
+}
+
+static mxArray *createPose(const EkfSlam &slam) {
+    mxArray *mxPose = mxCreateDoubleMatrix(POSE_SIZE, 1, mxREAL);
+    std::copy(slam.x(), slam.x() + POSE_SIZE, mxGetPr(mxPose));
+    return mxPose;
+}
+
+class EkfSlamManager: public mex::object_manager<EkfSlam> {
+public:
+    EkfSlamManager() {
+        setConstructionRequiresArgument(true);
+        addMethod("predict", METHOD_PREDICT);
+        addMethod("update", METHOD_UPDATE);
+        addMethod("get", METHOD_GET);
+        addMethod("revision", METHOD_REVISION);
+        addMethod("covariance", METHOD_COVARIANCE);
+    }
+
+    virtual EkfSlam *create(const mxArray *mxOpts) {
+        const double *pose = getMatrixField(mxOpts, "pose", POSE_SIZE);
+        const double *poseCov = getMatrixField(mxOpts, "poseCov", POSE_SIZE * POSE_SIZE);
+        size_t count = getOptionalCount(mxOpts, "features");
+        double capacity = getScalar(mxOpts, "capacity", 64);
+        if (!(capacity >= 0)) throw std::runtime_error("Parameter 'capacity' must be nonnegative");
+
+        std::unique_ptr<EkfSlam> slam(new EkfSlam(pose, poseCov, std::max((size_t)capacity, count)));
+        if (count > 0) {
+            const double *ids = getMatrixField(mxOpts, "features", count);
+            const double *positions = getMatrixField(mxOpts, "featurePositions", 2 * count);
+            const double *covariances = getMatrixField(mxOpts, "featureCovariances", 3 * count);
+            for (size_t i = 0; i < count; i++) {
+                slam->addUncorrelatedFeature(ids[i], positions[i], positions[i + count],
+                                             covariances[i], covariances[i + count], covariances[i + 2 * count]);
+            }
+        }
+        return slam.release();
+    }
+
+    virtual EkfSlam *clone(const EkfSlam &slam) {
+        return new EkfSlam(slam);
+    }
+
+    virtual void invoke(EkfSlam &slam, int methodId, const mxArray *mxOpts, int nlhs, mxArray *plhs[]) {
+        switch (methodId) {
+        case METHOD_PREDICT:
+            if (nlhs > 2) throw std::runtime_error("Too many output arguments");
+            slam.predict(getMatrixField(mxOpts, "pose", POSE_SIZE), getMatrixField(mxOpts, "F", POSE_SIZE * POSE_SIZE),
+                         getMatrixField(mxOpts, "Q", POSE_SIZE * POSE_SIZE));
+            returnPose(slam, nlhs, plhs);
+            break;
+        case METHOD_UPDATE: {
+            if (nlhs > 2) throw std::runtime_error("Too many output arguments");
+            size_t count = mxGetNumberOfElements(getField(mxOpts, "ids"));
+            const double *ids = getMatrixField(mxOpts, "ids", count);
+            const double *bearings = getMatrixField(mxOpts, "bearing", count);
+            const double *ranges = getMatrixField(mxOpts, "range", count);
+            std::vector<EkfSlam::Measurement> measurements(count);
+            for (size_t i = 0; i < count; i++) {
+                measurements[i].id = ids[i];
+                measurements[i].bearing = bearings[i];
+                measurements[i].range = ranges[i];
+            }
+            slam.update(measurements, getScalar(mxOpts, "bearingError", 0.0), getScalar(mxOpts, "rangeError", 0.0),
+                        getScalar(mxOpts, "useBearing", 1.0) != 0.0, getScalar(mxOpts, "useRange", 1.0) != 0.0);
+            returnPose(slam, nlhs, plhs);
+            break;
+        }
+        case METHOD_GET: {
+            if (nlhs > 1) throw std::runtime_error("Too many output arguments");
+            size_t count = slam.featureCount();
+            mxArray *mxX = mxCreateDoubleMatrix(slam.size(), 1, mxREAL);
+            std::copy(slam.x(), slam.x() + slam.size(), mxGetPr(mxX));
+            mxArray *mxPoseCov = mxCreateDoubleMatrix(POSE_SIZE, POSE_SIZE, mxREAL);
+            for (int j = 0; j < POSE_SIZE; j++) {
+                for (int i = 0; i < POSE_SIZE; i++) mxGetPr(mxPoseCov)[i + POSE_SIZE * j] = slam.cov(i, j);
+            }
+            mxArray *mxFeatures = mxCreateDoubleMatrix(count, 1, mxREAL);
+            mxArray *mxFeatureCov = mxCreateDoubleMatrix(count, 3, mxREAL);
+            double *pFeatureCov = mxGetPr(mxFeatureCov);
+            for (size_t i = 0; i < count; i++) {
+                size_t l = POSE_SIZE + 2 * i;
+                mxGetPr(mxFeatures)[i] = slam.featureId(i);
+                pFeatureCov[i] = slam.cov(l, l);
+                pFeatureCov[i + count] = slam.cov(l, l + 1);
+                pFeatureCov[i + 2 * count] = slam.cov(l + 1, l + 1);
+            }
+            const char *fields[] = {"x", "poseCov", "features", "featureCovariances", "revision"};
+            plhs[0] = mxCreateStructMatrix(1, 1, 5, fields);
+            mxSetField(plhs[0], 0, "x", mxX);
+            mxSetField(plhs[0], 0, "poseCov", mxPoseCov);
+            mxSetField(plhs[0], 0, "features", mxFeatures);
+            mxSetField(plhs[0], 0, "featureCovariances", mxFeatureCov);
+            mxSetField(plhs[0], 0, "revision", mxCreateDoubleScalar((double)slam.revision()));
+            break;
+        }
+        case METHOD_REVISION:
+            if (nlhs > 1) throw std::runtime_error("Too many output arguments");
+            plhs[0] = mxCreateDoubleScalar((double)slam.revision());
+            break;
+        case METHOD_COVARIANCE: {
+            if (nlhs > 1) throw std::runtime_error("Too many output arguments");
+            double maxSize = getScalar(mxOpts, "maxSize", (double)slam.size());
+            if (!(maxSize >= 1)) throw std::runtime_error("Parameter 'maxSize' must be positive");
+            size_t step = (slam.size() + (size_t)maxSize - 1) / (size_t)maxSize;
+            size_t n = (slam.size() + step - 1) / step;
+            plhs[0] = mxCreateDoubleMatrix(n, n, mxREAL);
+            slam.copyCovariance(step, mxGetPr(plhs[0]));
+            break;
+        }
+        }
+    }
+
+private:
+    static void returnPose(const EkfSlam &slam, int nlhs, mxArray *plhs[]) {
+        plhs[0] = createPose(slam);
+        if (nlhs > 1) plhs[1] = mxCreateDoubleScalar((double)slam.revision());
+    }
+};
+
+static EkfSlamManager ekfSlamManager;
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    try {
+        ekfSlamManager.mexFunction(nlhs, plhs, nrhs, prhs);
+    } catch (const std::exception &e) {
+        mexErrMsgIdAndTxt("mex_ekfslam:error", "%s", e.what());
+    }
+}
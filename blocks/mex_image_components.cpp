@@ -0,0 +1,185 @@
+//$ mex mex_image_components.cpp # Maltab command for generating the MEX file
+/*******************************************************
+ * Obstacle mask and landmark extraction from an indexed map image in a
+ * single pass. Landmarks are the 8-connected components of the landmark
+ * color (as labeled by bwlabel), found by union-find while the image is
+ * scanned column by column.
+ *
+ * [obstacles, centroids, areas, boxes] = mex_image_components(image, obstacleIndex, landmarkIndex)
+ * Outputs:
+ * - obstacles: logical matrix, true where image == obstacleIndex
+ * - centroids: Kx2 matrix of component centroids [x, y] in (one-based)
+ *              pixel coordinates, x is the column and y the row
+ * - areas: Kx1 vector of the number of pixels per component
+ * - boxes: Kx4 matrix of bounding boxes [xMin, yMin, xMax, yMax] (one-based,
+ *          inclusive)
+ * Components are ordered by their first pixel in column-major order, which
+ * is the label order of bwlabel.
+ * Inputs:
+ * - image: uint8 or logical matrix of color indices (as returned by imread)
+ * - obstacleIndex, landmarkIndex: color indices of obstacles and landmarks,
+ *                                 -1 if the color is not used
+ */
+
+#include "mex.h"
+#include "matrix.h"
+#include <algorithm>
+#include <stdint.h>
+#include <vector>
+
+#define INDEX_IN_IMAGE      0
+#define INDEX_IN_OBSTACLE   1
+#define INDEX_IN_LANDMARK   2
+#define IN_COUNT            3
+
+#define INDEX_OUT_OBSTACLES 0
+#define INDEX_OUT_CENTROIDS 1
+#define INDEX_OUT_AREAS     2
+#define INDEX_OUT_BOXES     3
+#define OUT_MAX_COUNT       4
+
+static const uint32_t NONE = 0xFFFFFFFF; // no label (background)
+
+// statistics of a provisional label, merged into the root on union
+struct Component {
+    uint32_t parent;
+    double sumX, sumY, area;
+    uint32_t xMin, yMin, xMax, yMax;
+};
+
+class ComponentLabeler {
+public:
+    explicit ComponentLabeler(size_t height): previous_(height, NONE), current_(height, NONE) { }
+
+    // add pixel (x, y), visited in column-major order
+    void add(uint32_t x, uint32_t y) {
+        // already visited 8-neighbors: above, and left-above, left, left-below
+        uint32_t label = NONE;
+        if (y > 0) label = join(label, current_[y - 1]);
+        if (y > 0) label = join(label, previous_[y - 1]);
+        label = join(label, previous_[y]);
+        if (y + 1 < previous_.size()) label = join(label, previous_[y + 1]);
+        if (label == NONE) {
+            label = (uint32_t)components_.size();
+            Component c = { label, 0.0, 0.0, 0.0, x, y, x, y };
+            components_.push_back(c);
+        }
+        Component &c = components_[label];
+        c.sumX += x;
+        c.sumY += y;
+        c.area++;
+        c.xMin = std::min(c.xMin, x);
+        c.yMin = std::min(c.yMin, y);
+        c.xMax = std::max(c.xMax, x);
+        c.yMax = std::max(c.yMax, y);
+        current_[y] = label;
+    }
+
+    void skip(uint32_t y) { current_[y] = NONE; }
+
+    void nextColumn() { previous_.swap(current_); }
+
+    // final components (roots), ordered by their first pixel
+    std::vector<Component> components() {
+        std::vector<Component> result;
+        for (uint32_t i = 0; i < components_.size(); i++) {
+            if (components_[i].parent == i) result.push_back(components_[i]);
+        }
+        return result;
+    }
+
+private:
+    uint32_t find(uint32_t label) {
+        while (components_[label].parent != label) {
+            components_[label].parent = components_[components_[label].parent].parent; // path halving
+            label = components_[label].parent;
+        }
+        return label;
+    }
+
+    // union of two (possibly NONE) labels, the smaller label becomes the
+    // root, so roots are the first labels of their components
+    uint32_t join(uint32_t a, uint32_t b) {
+        if (b == NONE) return a;
+        b = find(b);
+        if (a == NONE || a == b) return b;
+        a = find(a);
+        if (a == b) return a;
+        if (b < a) std::swap(a, b);
+        Component &root = components_[a], &merged = components_[b];
+        merged.parent = a;
+        root.sumX += merged.sumX;
+        root.sumY += merged.sumY;
+        root.area += merged.area;
+        root.xMin = std::min(root.xMin, merged.xMin);
+        root.yMin = std::min(root.yMin, merged.yMin);
+        root.xMax = std::max(root.xMax, merged.xMax);
+        root.yMax = std::max(root.yMax, merged.yMax);
+        return a;
+    }
+
+    std::vector<uint32_t> previous_, current_; // labels of the last and the current column
+    std::vector<Component> components_;
+};
+
+template <typename PixelType>
+static std::vector<Component> scan(const PixelType *pImage, size_t height, size_t width, double obstacleIndex, double landmarkIndex,
+                                   mxLogical *pObstacles) {
+    ComponentLabeler labeler(height);
+    for (size_t x = 0; x < width; x++) {
+        const PixelType *pColumn = pImage + x * height;
+        for (size_t y = 0; y < height; y++) {
+            double value = (double)pColumn[y];
+            pObstacles[x * height + y] = value == obstacleIndex;
+            if (value == landmarkIndex) labeler.add((uint32_t)x, (uint32_t)y);
+            else labeler.skip((uint32_t)y);
+        }
+        labeler.nextColumn();
+    }
+    return labeler.components();
+}
+
+static double getIndex(const mxArray *mxIndex, const char *name) {
+    if (!mxIsNumeric(mxIndex) || mxIsComplex(mxIndex) || mxGetNumberOfElements(mxIndex) != 1)
+        mexErrMsgIdAndTxt("mex_image_components:input", "Input argument '%s' must be a real scalar", name);
+    return mxGetScalar(mxIndex);
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    if (nrhs != IN_COUNT) mexErrMsgTxt("Three input arguments required");
+    if (nlhs > OUT_MAX_COUNT) mexErrMsgTxt("Too many output arguments");
+
+    const mxArray *mxImage = prhs[INDEX_IN_IMAGE];
+    if ((!mxIsUint8(mxImage) && !mxIsLogical(mxImage)) || mxGetNumberOfDimensions(mxImage) != 2)
+        mexErrMsgTxt("Input argument 'image' must be a uint8 or logical matrix of color indices");
+    double obstacleIndex = getIndex(prhs[INDEX_IN_OBSTACLE], "obstacleIndex");
+    double landmarkIndex = getIndex(prhs[INDEX_IN_LANDMARK], "landmarkIndex");
+
+    size_t height = mxGetM(mxImage), width = mxGetN(mxImage);
+    if (width >= 0xFFFFFFFF || height >= 0xFFFFFFFF || width * height >= 0xFFFFFFFF)
+        mexErrMsgTxt("Input argument 'image' is too large");
+    plhs[INDEX_OUT_OBSTACLES] = mxCreateLogicalMatrix(height, width);
+    mxLogical *pObstacles = mxGetLogicals(plhs[INDEX_OUT_OBSTACLES]);
+    std::vector<Component> components = mxIsUint8(mxImage) ?
+        scan((const uint8_t *)mxGetData(mxImage), height, width, obstacleIndex, landmarkIndex, pObstacles) :
+        scan(mxGetLogicals(mxImage), height, width, obstacleIndex, landmarkIndex, pObstacles);
+
+    size_t count = components.size();
+    mxArray *mxCentroids = mxCreateDoubleMatrix(count, 2, mxREAL);
+    mxArray *mxAreas = mxCreateDoubleMatrix(count, 1, mxREAL);
+    mxArray *mxBoxes = mxCreateDoubleMatrix(count, 4, mxREAL);
+    double *pCentroids = mxGetPr(mxCentroids), *pAreas = mxGetPr(mxAreas), *pBoxes = mxGetPr(mxBoxes);
+    for (size_t i = 0; i < count; i++) {
+        const Component &c = components[i];
+        pCentroids[i] = c.sumX / c.area + 1;
+        pCentroids[i + count] = c.sumY / c.area + 1;
+        pAreas[i] = c.area;
+        pBoxes[i] = c.xMin + 1;
+        pBoxes[i + count] = c.yMin + 1;
+        pBoxes[i + 2 * count] = c.xMax + 1;
+        pBoxes[i + 3 * count] = c.yMax + 1;
+    }
+    if (nlhs > INDEX_OUT_CENTROIDS) plhs[INDEX_OUT_CENTROIDS] = mxCentroids; else mxDestroyArray(mxCentroids);
+    if (nlhs > INDEX_OUT_AREAS) plhs[INDEX_OUT_AREAS] = mxAreas; else mxDestroyArray(mxAreas);
+    if (nlhs > INDEX_OUT_BOXES) plhs[INDEX_OUT_BOXES] = mxBoxes; else mxDestroyArray(mxBoxes);
+}
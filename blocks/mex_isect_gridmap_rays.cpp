@@ -1,15 +1,73 @@
-//$ mex mex_isect_gridmap_rays.cpp # Maltab command for generating the MEX file
+//$ mex mex_isect_gridmap_rays.cpp -I../tools/mex/include -I../tools/raycast/include # Maltab command for generating the MEX file
 /*******************************************************
  * test rays for intersection with an obstacle grid map and optionally 
  * return the distance from the start point to the first obstacle.
+ *
+ * Ray mode: [intersection, range] = mex_isect_gridmap_rays(obstacles, rayStart, rayEnd[, obstacleValue])
  * Outputs: 
  * - intersection = true for each ray that intersects an obstacle
  * - range = distance from start to first obstacle or NaN when no intersection was found
+ * Ray mode uses the Bresenham traversal for compatibility (see Traversal below).
  *Inputs:
  * - obstacles: matrix (uint8 or mxLogical), map of obstacles
  * - rayStart: Mx2 matrix of ray start coordinates (relative to map)
  * - rayEnd: Mx2 matrix of ray end coordinates (relative to map)
  * - obstacleValue (optional) which value in the map should be treated as obstacle, 0/false by default
+ *
+ * Scan mode: [range, bearing] = mex_isect_gridmap_rays(obstacles, poses, scan[, obstacleValue])
+ * Generates a fan of rays for each pose without any per-ray input from Matlab.
+ * Outputs:
+ * - range = KxN matrix of metric ranges (one row per pose, one column per ray),
+ *           inf when no intersection was found within scan.maxRange
+ * - bearing = Nx1 vector of ray bearings relative to the pose orientation
+ * Inputs:
+ * - obstacles, obstacleValue: see above
+ * - poses: Kx3 matrix of [x, y, theta] poses in metric world coordinates
+ * - scan: struct with fields
+ *   .scale - map scale in m/cell
+ *   .offset - 1x2 vector, coordinates of the map origin in m
+ *   .fieldOfView - 1x2 vector, [first, last] bearing in rad
+ *   .increment - angular difference between adjacent rays in rad
+ *   .maxRange - maximum detection distance in m
+ *   .error - (optional) stddev of the range error relative to the range, 0 by default
+ *   .seed - (optional) seed for the range error. Equal seeds generate equal noise.
+ *   .traversal - (optional) 'dda' (default) or 'bresenham', see below
+ *   .discs - (optional) Dx3 matrix of [x, y, radius] discs in metric world
+ *            coordinates, dynamic obstacles (e.g. other robots) on top of
+ *            the map. Each ray only tests the discs within maxRange of its
+ *            pose.
+ *   .ownDiscs - (optional) if true, disc k is the body of pose k (D = K) and
+ *               not seen by the rays of pose k, false by default
+ *
+ * Map object mode: use with mex_object_handle to keep a map resident between calls
+ *   h = mex_object_handle(@mex_isect_gridmap_rays, 'obstacles', obstacles, 'scale', scale, 'offset', offset
+ *                         [, 'obstacleValue', value][, 'distanceField', true])
+ * The map is stored with one bit per cell in 8x8 cell tiles. obstacleValue
+ * is 1/true by default. With distanceField set, a Euclidean distance 
+ * transform of the map is precomputed and rays skip free space in steps of
+ * the obstacle clearance instead of visiting every cell. The results are 
+ * identical, the cost of a ray then depends on the obstacles near the ray 
+ * rather than on its length in cells. Methods:
+ *   [intersection, range] = h.invoke('castRays', 'rayStart', rayStart, 'rayEnd', rayEnd[, 'traversal', traversal])
+ *       same as ray mode, but with the DDA traversal by default
+ *   [range, bearing] = h.invoke('castScan', 'poses', poses, <scan parameters>)
+ *       same as scan mode, scale and offset are taken from the map object
+ *
+ * Traversal:
+ * - 'dda': floating point grid traversal (Amanatides & Woo) that visits every
+ *   cell touched by the ray. Cell (i, j) (zero-based) covers [i, i + 1) x [j, j + 1).
+ *   range is the exact distance from the start point to the boundary of the 
+ *   first obstacle cell or of the map.
+ * - 'bresenham': start and end points are truncated to integer cells, range
+ *   is the distance from the start cell to the last free cell (or the last
+ *   cell inside the map). Diagonal walls that are only one cell thick may be
+ *   missed.
+ *
+ * Configuration: [threads] = mex_isect_gridmap_rays('threads'[, n])
+ * Query or set the number of threads used for casting rays (including the
+ * calling thread). n = 0 selects the number of hardware threads (default),
+ * n = 1 disables multi-threading. Batches of less than 1024 rays
+ * are always processed serially. Results are identical for any thread count.
  */
 
 
@@ -17,9 +75,12 @@
 #include "matrix.h"
 #include <cmath>
 #include <memory>
-#include <algorithm>
-#include <functional>
-#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string.h>
+#include <stdint.h>
+#include <mex/object_manager.hpp>
+#include <raycast.hpp>
 
 #define printf mexPrintf
 
@@ -33,186 +94,68 @@
 #define INDEX_IN_OBSTVALUE  3
 #define IN_MAX_COUNT		4
 
+#define INDEX_IN_POSES      1
+#define INDEX_IN_SCAN       2
+
 #define INDEX_OUT_ISECT     0
 #define OUT_REQ_COUNT       1
 #define INDEX_OUT_RANGE     1
 #define OUT_MAX_COUNT       2
 
+#define INDEX_OUT_SCAN_RANGE    0
+#define INDEX_OUT_SCAN_BEARING  1
+
+using namespace raycast;
+
 struct MxArrayDeleter {
     void operator()(mxArray *mx) { mxDestroyArray(mx); }
 };
 
 typedef std::unique_ptr<mxArray, MxArrayDeleter> UniqueMxArrayPointer;
 
+static WorkerPool workerPool;
+
+static void shutdownWorkerPool() {
+    workerPool.shutdown();
+}
+
+// Access to a column-major Matlab matrix as passed to the mex function
+template <typename CellType>
+static DenseMap<CellType> denseMap(const mxArray *mxMap, CellType obstacleValue) {
+    return DenseMap<CellType>((const CellType *)mxGetData(mxMap), (int)mxGetN(mxMap), (int)mxGetM(mxMap), obstacleValue);
+}
+
+// Creates the Matlab outputs and fills them using the Matlab independent 
+// ray caster (tools/raycast) on the shared worker pool
 class IntersectionDetector {
 public:
-    IntersectionDetector(const mxArray *mxMap, const mxArray *mxRayStart, const mxArray *mxRayEnd) {
-        width = mxGetN(mxMap);
-        height = mxGetM(mxMap);
-        pitch = height;
-        count = mxGetM(mxRayStart);
-        rayStart.pX = mxGetPr(mxRayStart);
-        rayStart.pY = rayStart.pX + count;
-        rayEnd.pX = mxGetPr(mxRayEnd);
-        rayEnd.pY = rayEnd.pX + count;        
-    }    
-
-    template <typename CellType>
-    void operator()(const CellType *pMap, const CellType &obstacleValue = CellType(), bool generateRange = true) {
+    IntersectionDetector(Traversal traversal = TRAVERSAL_BRESENHAM): caster_(traversal, &workerPool) { }
+
+    // ray mode: test Mx2 start/end coordinates (given in cells)
+    template <typename Map>
+    void operator()(const Map &map, const mxArray *mxRayStart, const mxArray *mxRayEnd, bool generateRange = true) {
+        size_t count = mxGetM(mxRayStart);
+        const double *pStart = mxGetPr(mxRayStart), *pEnd = mxGetPr(mxRayEnd);
+
         mxISect_ = UniqueMxArrayPointer(mxCreateLogicalMatrix(count, 1));
-        mxLogical *pISect = (mxLogical *)mxGetData(mxISect_.get());
         double *pRange = NULL;
         if (generateRange) {
             mxRange_ = UniqueMxArrayPointer(mxCreateDoubleMatrix(count, 1, mxREAL));
             pRange = mxGetPr(mxRange_.get());
         }        
+        caster_.castRays(map, count, pStart, pStart + count, pEnd, pEnd + count, 
+                         (mxLogical *)mxGetData(mxISect_.get()), pRange);
+    }
+
+    // scan mode: generate a fan of rays for each row [x, y, theta] of mxPoses
+    template <typename Map>
+    void operator()(const Map &map, const mxArray *mxPoses, const ScanParameters &scan) {
+        size_t poseCount = mxGetM(mxPoses);
+        size_t rayCount = scan.rayCount();
 
-        for (size_t i = 0; i < count; i++) {
-            int xs = (int)(*rayStart.pX++); /* add rounding constant of 0.5 and subtract Matlab array-start-with-1-offset */
-			int ys = (int)(*rayStart.pY++);
-            if (xs >= 0 && ys >= 0 && xs < width && ys < height) {
-                if (pMap[xs * pitch + ys] != obstacleValue) {
-                    int xe = (int)(*rayEnd.pX++);
-                    int ye = (int)(*rayEnd.pY++);
-                    
-					int dx = xe - xs;
-					int dy = ye - ys;
-                    int x, y, prevX, prevY;
-                    bool isect;
-                    
-#define CHECK_CELL \
-    if (pMap[x * pitch + y] != obstacleValue) { \
-        prevX = x; \
-        prevY = y; \
-    } else break;
-
-                    if (dx >= 0) { /* octants 1, 2, 7, 8 */
-						if (dy >= 0) { /* octants 1, 2 */
-							if (dx >= dy) { /* octant 1 */
-                                int error = dx >> 1;				
-								int xe_ = xe < width ? xe : (width - 1);
-								for(prevX = x = xs, prevY = y = ys; x <= xe_; x++) { 
-                                    CHECK_CELL						  
-									error -= dy;
-									if (error < 0) {
-										if (++y >= height) break;
-										error += dx;
-									}
-								}
-                                isect = (x <= xe);
-							} else { /* octant 2 */
-								int error = dy >> 1;
-								int ye_ = ye < height ? ye : (height - 1);
-								for(prevX = x = xs, prevY = y = ys; y <= ye_; y++) {
-									CHECK_CELL
-									error -= dx;
-									if (error < 0) {
-										if (++x >= width) break;
-										error += dy;
-									}
-								}
-                                isect = (y <= ye);
-							}				 
-						} else { /* octants 7, 8 */
-							dy = -dy;
-							if ( dx >= dy) { /* octant 8 */
-								int error = dx >> 1;
-								int xe_ = xe < width ? xe : (width - 1);
-								for(prevX = x = xs, prevY = y = ys; x <= xe_; x++) {
-									CHECK_CELL
-									error -= dy;
-									if (error < 0) {
-										if (--y < 0) break;
-										error += dx;
-									}
-								}				
-                                isect = (x <= xe);
-							} else { /* octant 7 */
-								int error = dy >> 1;
-								int ye_ = ye < 0 ? 0 : ye;
-								for(prevX = x = xs, prevY = y = ys; y >= ye_; y--) {
-									CHECK_CELL
-									error -= dx;
-									if (error < 0) {
-										if (++x >= width) break;
-										error += dy;
-									}
-								} 
-                                isect = (y >= ye);
-                            }
-						}
-					} else { /* octants 3-6 */
-						dx = -dx;
-						if (dy >= 0) { /* octants 3, 4 */
-							if (dx >= dy) { /* octant 4 */
-								int error = dx >> 1;
-								int xe_ = xe < 0 ? 0 : xe;
-								for(prevX = x = xs, prevY = y = ys; x >= xe_; x--) {
-									CHECK_CELL
-									error -= dy;
-									if (error < 0) {
-										if (++y >= height) break;
-										error += dx;
-									}
-								}
-                                isect = (x >= xe);
-							} else { /* octant 3 */
-								int error = dy >> 1;
-								int ye_ = ye < height ? ye : (height - 1);
-								for(prevX = x = xs, prevY = y = ys; y <= ye_; y++) {
-									CHECK_CELL
-									error -= dx;
-									if (error < 0) {
-										if (--x < 0) break;
-										error += dy;
-									}
-								} 
-                                isect = (y <= ye);
-							}
-						} else { /* octants 5, 6 */
-							dy = -dy;
-							if (dx >= dy) { /* octant 5 */
-								int error = dx >> 1;
-								int xe_ = xe < 0 ? 0 : xe;
-								for(prevX = x = xs, prevY = y = ys; x >= xe_; x--) {
-									CHECK_CELL
-									error -= dy;
-									if (error < 0) {
-										if (--y < 0) break;
-										error += dx;
-									}
-								}
-                                isect = (x >= xe);
-							} else { /* octant 6 */
-								int error = dy >> 1;
-								int ye_ = ye < 0 ? 0 : ye;
-								for(prevX = x = xs, prevY = y = ys; y >= ye_; y--) {
-									CHECK_CELL
-									error -= dx;
-									if (error < 0) {
-										if (--x < 0) break;
-										error += dy;
-									}
-								} 				
-                                isect = (y >= ye);
-							}
-						}
-					} 
-#undef CHECK_CELL
-
-                    *pISect++ = isect;
-                    if (pRange) {
-                        *pRange++ = isect ? sqrt((double)((prevX - xs) * (prevX - xs) + (prevY - ys) * (prevY - ys))) : 
-                                            std::numeric_limits<double>::signaling_NaN();
-                    }
-                    continue;
-                }
-            }
-                
-            // ray starts off the map or the start position is an obstacle
-            *pISect++ = true;
-            if (pRange) *pRange++ = 0.0;            
-        }                     
+        mxBearing_ = UniqueMxArrayPointer(mxCreateDoubleMatrix(rayCount, 1, mxREAL));
+        mxRange_ = UniqueMxArrayPointer(mxCreateDoubleMatrix(poseCount, rayCount, mxREAL));
+        caster_.castScan(map, mxGetPr(mxPoses), poseCount, scan, mxGetPr(mxRange_.get()), mxGetPr(mxBearing_.get()));
     }
     
     UniqueMxArrayPointer mxISect() {
@@ -221,34 +164,110 @@ public:
     UniqueMxArrayPointer mxRange() {
         return std::move(mxRange_);
     }
+    UniqueMxArrayPointer mxBearing() {
+        return std::move(mxBearing_);
+    }
     
 private:
-    int width, height;
-    unsigned pitch, count;
-    struct {
-        const double *pX;
-        const double *pY;
-    } rayStart, rayEnd;
-    
-    UniqueMxArrayPointer mxISect_, mxRange_;
+    RayCaster caster_;
+    UniqueMxArrayPointer mxISect_, mxRange_, mxBearing_;
 };
 
-void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {    
-    if (nrhs < IN_REQ_COUNT) mexErrMsgTxt("Too few input arguments");
-	if (nrhs > IN_MAX_COUNT) mexErrMsgTxt("Too many input arguments");
-	if (nlhs < OUT_REQ_COUNT) mexErrMsgTxt("Too few output arguments");
-    if (nlhs > OUT_MAX_COUNT) mexErrMsgTxt("Too many output arguments");
+static double getScalarField(const mxArray *mxStruct, const char *name, bool required = true, double defaultValue = 0.0) {
+    const mxArray *mxField = mxGetField(mxStruct, 0, name);
+    if (!mxField) {
+        if (required) mexErrMsgIdAndTxt("mex_isect_gridmap_rays:scan", "Scan parameter '%s' missing", name);
+        return defaultValue;
+    }
+    if (!(mxIsNumeric(mxField) || mxIsLogical(mxField)) || mxIsComplex(mxField) || mxGetNumberOfElements(mxField) != 1)
+        mexErrMsgIdAndTxt("mex_isect_gridmap_rays:scan", "Scan parameter '%s' must be a real numeric scalar", name);
+    return mxGetScalar(mxField);
+}
 
-    const mxArray *mxMap = prhs[INDEX_IN_MAP];
-    const mxArray *mxRayStart = prhs[INDEX_IN_START];
-    const mxArray *mxRayEnd = prhs[INDEX_IN_END];
-    const mxArray *mxObstacleValue = (nrhs > INDEX_IN_OBSTVALUE) ? prhs[INDEX_IN_OBSTVALUE] : NULL;
+static void getVectorField(const mxArray *mxStruct, const char *name, double *pDest) {
+    const mxArray *mxField = mxGetField(mxStruct, 0, name);
+    if (!mxField) mexErrMsgIdAndTxt("mex_isect_gridmap_rays:scan", "Scan parameter '%s' missing", name);
+    if (!mxIsDouble(mxField) || mxIsComplex(mxField) || mxGetNumberOfElements(mxField) != 2)
+        mexErrMsgIdAndTxt("mex_isect_gridmap_rays:scan", "Scan parameter '%s' must be a real two-element double vector", name);
+    pDest[0] = mxGetPr(mxField)[0];
+    pDest[1] = mxGetPr(mxField)[1];
+}
+
+// read the fan of rays, leaves scale and offset untouched
+static void getFanParameters(const mxArray *mxScan, ScanParameters &scan) {
+    getVectorField(mxScan, "fieldOfView", scan.fieldOfView);
+    scan.increment = getScalarField(mxScan, "increment");
+    scan.maxRange = getScalarField(mxScan, "maxRange");
+    scan.error = getScalarField(mxScan, "error", false, 0.0);
+    if (mxGetField(mxScan, 0, "seed")) scan.seed = (uint64_t)getScalarField(mxScan, "seed");
+    else scan.seed = std::random_device()();
+    
+    if (!(scan.increment > 0.0) || !(scan.fieldOfView[1] >= scan.fieldOfView[0])) 
+        mexErrMsgTxt("Scan parameters 'increment' and 'fieldOfView' do not describe a valid fan of rays");
+    if (!(scan.maxRange >= 0.0)) mexErrMsgTxt("Scan parameter 'maxRange' must be nonnegative");
+
+    const mxArray *mxDiscs = mxGetField(mxScan, 0, "discs");
+    if (mxDiscs && !mxIsEmpty(mxDiscs)) {
+        if (mxGetNumberOfDimensions(mxDiscs) != 2 || mxGetN(mxDiscs) != 3 || !mxIsDouble(mxDiscs) || mxIsComplex(mxDiscs))
+            mexErrMsgTxt("Scan parameter 'discs' must be a Dx3 double matrix");
+        scan.discs = mxGetPr(mxDiscs);
+        scan.discCount = mxGetM(mxDiscs);
+    }
+    scan.ownDiscs = getScalarField(mxScan, "ownDiscs", false, 0.0) != 0.0;
+}
+
+// with ownDiscs, there is one disc per pose
+static void checkDiscs(const ScanParameters &scan, const mxArray *mxPoses) {
+    if (scan.ownDiscs && scan.discCount != mxGetM(mxPoses))
+        mexErrMsgTxt("Scan parameter 'discs' must have one row per pose if 'ownDiscs' is set");
+}
+
+static ScanParameters getScanParameters(const mxArray *mxScan) {
+    if (!mxIsStruct(mxScan) || mxGetNumberOfElements(mxScan) != 1)
+        mexErrMsgTxt("Input argument 'scan' must be a scalar struct");
     
+    ScanParameters scan;
+    scan.scale = getScalarField(mxScan, "scale");
+    getVectorField(mxScan, "offset", scan.offset);
+    if (!(scan.scale > 0.0)) mexErrMsgTxt("Scan parameter 'scale' must be positive");
+    getFanParameters(mxScan, scan);
+    return scan;
+}
+
+// traversal algorithm selected by the optional string field 'traversal' 
+// ('dda' or 'bresenham')
+static Traversal getTraversal(const mxArray *mxStruct, Traversal defaultTraversal) {
+    const mxArray *mxField = mxGetField(mxStruct, 0, "traversal");
+    if (!mxField) return defaultTraversal;
+    char traversal[16];
+    if (!mxIsChar(mxField) || mxGetString(mxField, traversal, sizeof(traversal)) != 0)
+        mexErrMsgTxt("Parameter 'traversal' must be a string");
+    if (strcmp(traversal, "dda") == 0) return TRAVERSAL_DDA;
+    if (strcmp(traversal, "bresenham") == 0) return TRAVERSAL_BRESENHAM;
+    mexErrMsgTxt("Unknown traversal. Supported: 'dda', 'bresenham'");
+    return defaultTraversal;
+}
 
+static void checkMap(const mxArray *mxMap) {
 	if (mxGetNumberOfDimensions(mxMap) != 2 || !(mxIsUint8(mxMap) || mxIsLogical(mxMap)) ||
 		mxIsComplex(mxMap) || mxIsEmpty(mxMap)) 
         mexErrMsgTxt("Input argument 'map' must be a non-empty, real uint8 or logical matrix");
+}
+
+static unsigned getObstacleValue(const mxArray *mxObstacleValue) {
+    if (mxIsComplex(mxObstacleValue) || mxGetNumberOfElements(mxObstacleValue) != 1 ||
+        !(mxIsNumeric(mxObstacleValue) || mxIsLogical(mxObstacleValue)))
+        mexErrMsgTxt("Input argument 'obstacleValue' must be a noncomplex numeric scalar value");
+    return (unsigned)mxGetScalar(mxObstacleValue);
+}
 
+static void checkPoses(const mxArray *mxPoses) {
+    if (mxGetNumberOfDimensions(mxPoses) != 2 || mxGetN(mxPoses) != 3 ||
+        !mxIsDouble(mxPoses) || mxIsComplex(mxPoses))
+        mexErrMsgTxt("Input argument 'poses' must be a Kx3 double matrix");
+}
+
+static void checkRays(const mxArray *mxRayStart, const mxArray *mxRayEnd) {
 	if (mxGetNumberOfDimensions(mxRayStart) != 2 || mxGetN(mxRayStart) != 2 ||
 		!mxIsDouble(mxRayStart) || mxIsComplex(mxRayStart)) 
         mexErrMsgTxt("Input argument 'rayStart' must be a Mx2 double matrix");
@@ -256,23 +275,184 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
 	if (mxGetNumberOfDimensions(mxRayEnd) != 2 || mxGetN(mxRayEnd) != 2 || mxGetM(mxRayStart) != mxGetM(mxRayEnd) ||
         !mxIsDouble(mxRayEnd) || mxIsComplex(mxRayEnd))
 		mexErrMsgTxt("Input argument 'rayEnd' must be a double matrix of the same size as 'rayStart'");
+}
+
+// map object kept between calls to the mex function (see map object mode)
+class GridMap {
+public:
+    GridMap(const TiledBitmap &bitmap, double scale, const double offset[2], bool withDistanceField): 
+        bitmap_(bitmap), scale_(scale) {
+        offset_[0] = offset[0];
+        offset_[1] = offset[1];
+        if (withDistanceField) distanceField_.reset(new DistanceField(bitmap_));
+    }
+    
+    const TiledBitmap &bitmap() const { return bitmap_; }
+    const DistanceField *distanceField() const { return distanceField_.get(); }
+    double scale() const { return scale_; }
+    const double *offset() const { return offset_; }
     
-    unsigned obstacleValue = 0;
+private:
+    TiledBitmap bitmap_;
+    std::unique_ptr<DistanceField> distanceField_;
+    double scale_;
+    double offset_[2];
+};
+
+enum GridMapMethod {
+    METHOD_CAST_RAYS,
+    METHOD_CAST_SCAN
+};
+
+class GridMapManager: public mex::object_manager<GridMap> {
+public:
+    GridMapManager() {
+        setConstructionRequiresArgument(true);
+        addMethod("castRays", METHOD_CAST_RAYS);
+        addMethod("castScan", METHOD_CAST_SCAN);
+    }
     
-	if(mxObstacleValue) {
-        if (mxIsComplex(mxObstacleValue) || mxGetNumberOfElements(mxObstacleValue) != 1 ||
-            !(mxIsNumeric(mxObstacleValue) || mxIsLogical(mxObstacleValue)))
-            mexErrMsgTxt("Input argument 'obstacleValue' must be a noncomplex numeric scalar value");
+    virtual GridMap *create(const mxArray *mxOpts) {
+        const mxArray *mxMap = mxGetField(mxOpts, 0, "obstacles");
+        if (!mxMap) throw std::runtime_error("Map parameter 'obstacles' missing");
+        checkMap(mxMap);
         
-        obstacleValue = (unsigned)mxGetScalar(mxObstacleValue);
-	}   
+        const mxArray *mxObstacleValue = mxGetField(mxOpts, 0, "obstacleValue");
+        unsigned obstacleValue = mxObstacleValue ? getObstacleValue(mxObstacleValue) : 1;
+        
+        double scale = getScalarField(mxOpts, "scale");
+        if (!(scale > 0.0)) throw std::runtime_error("Map parameter 'scale' must be positive");
+        double offset[2];
+        getVectorField(mxOpts, "offset", offset);
+        bool withDistanceField = getScalarField(mxOpts, "distanceField", false, 0.0) != 0.0;
+        
+        if (mxIsUint8(mxMap)) {
+            return new GridMap(TiledBitmap(denseMap(mxMap, (unsigned char)obstacleValue)), scale, offset, withDistanceField);
+        } else {
+            return new GridMap(TiledBitmap(denseMap(mxMap, (mxLogical)obstacleValue)), scale, offset, withDistanceField);
+        }
+    }
     
-    IntersectionDetector detector(mxMap, mxRayStart, mxRayEnd);
+    virtual void invoke(GridMap &map, int methodId, const mxArray *mxOpts, int nlhs, mxArray *plhs[]) {
+        if (!mxOpts) throw std::runtime_error("Method requires an argument structure");
+        if (nlhs < OUT_REQ_COUNT) throw std::runtime_error("Too few output arguments");
+        if (nlhs > OUT_MAX_COUNT) throw std::runtime_error("Too many output arguments");
+        
+        IntersectionDetector detector(getTraversal(mxOpts, TRAVERSAL_DDA));
+        if (methodId == METHOD_CAST_RAYS) {
+            const mxArray *mxRayStart = mxGetField(mxOpts, 0, "rayStart");
+            const mxArray *mxRayEnd = mxGetField(mxOpts, 0, "rayEnd");
+            if (!mxRayStart || !mxRayEnd) throw std::runtime_error("Parameters 'rayStart' and 'rayEnd' required");
+            checkRays(mxRayStart, mxRayEnd);
+            
+            if (map.distanceField()) detector(*map.distanceField(), mxRayStart, mxRayEnd, nlhs > INDEX_OUT_RANGE);
+            else detector(map.bitmap(), mxRayStart, mxRayEnd, nlhs > INDEX_OUT_RANGE);
+            plhs[INDEX_OUT_ISECT] = detector.mxISect().release();
+            if (nlhs > INDEX_OUT_RANGE) plhs[INDEX_OUT_RANGE] = detector.mxRange().release();
+        } else {
+            const mxArray *mxPoses = mxGetField(mxOpts, 0, "poses");
+            if (!mxPoses) throw std::runtime_error("Parameter 'poses' required");
+            checkPoses(mxPoses);
+            
+            ScanParameters scan;
+            scan.scale = map.scale();
+            scan.offset[0] = map.offset()[0];
+            scan.offset[1] = map.offset()[1];
+            getFanParameters(mxOpts, scan);
+            checkDiscs(scan, mxPoses);
+            
+            if (map.distanceField()) detector(*map.distanceField(), mxPoses, scan);
+            else detector(map.bitmap(), mxPoses, scan);
+            plhs[INDEX_OUT_SCAN_RANGE] = detector.mxRange().release();
+            if (nlhs > INDEX_OUT_SCAN_BEARING) plhs[INDEX_OUT_SCAN_BEARING] = detector.mxBearing().release();
+        }
+    }
+};
+
+static GridMapManager gridMapManager;
+
+// constructor call (a single struct) or method call on a map handle
+static bool isMapObjectCall(int nrhs, const mxArray *prhs[]) {
+    if (nrhs <= 1) return nrhs == 0 || mxIsStruct(prhs[0]);
+    return mxGetClassID(prhs[0]) == mex::get_class<GridMapManager::key_type>::value && 
+           mex::is_scalar(prhs[0]) && mxIsChar(prhs[1]);
+}
+
+static void configure(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    char option[32];
+    if (mxGetString(prhs[0], option, sizeof(option)) != 0 || strcmp(option, "threads") != 0)
+        mexErrMsgTxt("Unknown configuration option. Supported: 'threads'");
+    if (nrhs > 2) mexErrMsgTxt("Too many input arguments");
+    if (nlhs > 1) mexErrMsgTxt("Too many output arguments");
+    
+    if (nrhs > 1) {
+        if (!mxIsNumeric(prhs[1]) || mxIsComplex(prhs[1]) || mxGetNumberOfElements(prhs[1]) != 1 || !(mxGetScalar(prhs[1]) >= 0))
+            mexErrMsgTxt("Thread count must be a nonnegative scalar value");
+        workerPool.setThreadCount((unsigned)mxGetScalar(prhs[1]));
+    }
+    plhs[0] = mxCreateDoubleScalar(workerPool.threadCount());
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {    
+    static bool exitHandlerRegistered = false;
+    if (!exitHandlerRegistered) {
+        mexAtExit(shutdownWorkerPool);
+        exitHandlerRegistered = true;
+    }
+    
+    if (nrhs >= 1 && mxIsChar(prhs[0])) {
+        configure(nlhs, plhs, nrhs, prhs);
+        return;
+    }
+    
+    if (isMapObjectCall(nrhs, prhs)) {
+        try {
+            gridMapManager.mexFunction(nlhs, plhs, nrhs, prhs);
+        } catch (const std::exception &e) {
+            mexErrMsgIdAndTxt("mex_isect_gridmap_rays:object", "%s", e.what());
+        }
+        return;
+    }
+    
+    if (nrhs < IN_REQ_COUNT) mexErrMsgTxt("Too few input arguments");
+	if (nrhs > IN_MAX_COUNT) mexErrMsgTxt("Too many input arguments");
+	if (nlhs < OUT_REQ_COUNT) mexErrMsgTxt("Too few output arguments");
+    if (nlhs > OUT_MAX_COUNT) mexErrMsgTxt("Too many output arguments");
+
+    const mxArray *mxMap = prhs[INDEX_IN_MAP];
+    const mxArray *mxObstacleValue = (nrhs > INDEX_IN_OBSTVALUE) ? prhs[INDEX_IN_OBSTVALUE] : NULL;
+    bool scanMode = mxIsStruct(prhs[INDEX_IN_SCAN]);
+
+    checkMap(mxMap);
+    unsigned obstacleValue = mxObstacleValue ? getObstacleValue(mxObstacleValue) : 0;
+    
+    if (scanMode) {
+        const mxArray *mxPoses = prhs[INDEX_IN_POSES];
+        checkPoses(mxPoses);
+        ScanParameters scan = getScanParameters(prhs[INDEX_IN_SCAN]);
+        checkDiscs(scan, mxPoses);
+        IntersectionDetector detector(getTraversal(prhs[INDEX_IN_SCAN], TRAVERSAL_DDA));
+
+        if (mxIsUint8(mxMap)) {
+            detector(denseMap(mxMap, (unsigned char)obstacleValue), mxPoses, scan);
+        } else if (mxIsLogical(mxMap)) {
+            detector(denseMap(mxMap, (mxLogical)obstacleValue), mxPoses, scan);
+        } else mexErrMsgTxt("Unsupported data format. This should have been detected earlier!");
+        
+        plhs[INDEX_OUT_SCAN_RANGE] = detector.mxRange().release();
+        if (nlhs > INDEX_OUT_SCAN_BEARING) plhs[INDEX_OUT_SCAN_BEARING] = detector.mxBearing().release();
+        return;
+    }
+    
+    const mxArray *mxRayStart = prhs[INDEX_IN_START];
+    const mxArray *mxRayEnd = prhs[INDEX_IN_END];
+    checkRays(mxRayStart, mxRayEnd);
+    IntersectionDetector detector(TRAVERSAL_BRESENHAM);
     
     if (mxIsUint8(mxMap)) {
-        detector((const unsigned char *)mxGetData(mxMap), (unsigned char)obstacleValue, nlhs > INDEX_OUT_RANGE);
+        detector(denseMap(mxMap, (unsigned char)obstacleValue), mxRayStart, mxRayEnd, nlhs > INDEX_OUT_RANGE);
     } else if (mxIsLogical(mxMap)) {
-        detector((const mxLogical *)mxGetData(mxMap), (mxLogical)obstacleValue, nlhs > INDEX_OUT_RANGE);
+        detector(denseMap(mxMap, (mxLogical)obstacleValue), mxRayStart, mxRayEnd, nlhs > INDEX_OUT_RANGE);
     } else mexErrMsgTxt("Unsupported data format. This should have been detected earlier!");
     
     plhs[INDEX_OUT_ISECT] = detector.mxISect().release();
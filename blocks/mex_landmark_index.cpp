@@ -0,0 +1,204 @@
+//$ mex mex_landmark_index.cpp -I../tools/mex/include -I../tools/raycast/include # Maltab command for generating the MEX file
+/*******************************************************
+ * Landmark visibility queries for sensor_landmarks2d: keeps the landmarks
+ * in a uniform grid and the obstacle map resident between calls and tests
+ * only the landmarks near the sensor for field of view, range and occlusion.
+ *
+ * Construction: index = mex_object_handle(@mex_landmark_index, opts)
+ * opts: struct with fields
+ *   .landmarks - Nx2 matrix of landmark positions in m
+ *   .cellSize - (optional) edge length of the grid cells in m, chosen from
+ *               the landmark density by default. The sensor range is a good
+ *               choice.
+ *   .obstacles - (optional) obstacle map (uint8 or logical matrix), no
+ *                occlusion test without a map
+ *   .scale, .offset - map scale in m/cell and map origin in m, required
+ *                     with .obstacles
+ *   .obstacleValue - (optional) which value in the map should be treated
+ *                    as obstacle, 1/true by default
+ *   .traversal - (optional) 'bresenham' (default) or 'dda', see
+ *                mex_isect_gridmap_rays.cpp
+ *   .distanceField - (optional) precompute the obstacle clearance to speed
+ *                    up the occlusion rays (same results)
+ *
+ * Methods:
+ *   [lmIds, range, bearing] = index.invoke('query', 'pose', pose, 'range', maxRange, 'fieldOfView', fov)
+ *       All landmarks with a range below maxRange and a bearing (relative
+ *       to pose [x, y, theta], wrapped to [-pi, pi)) within fov = [first, last]
+ *       that are not occluded by an obstacle. A landmark is occluded if the
+ *       ray from the pose to the landmark intersects the map. lmIds are the
+ *       (one-based) row indices into .landmarks in ascending order, range and
+ *       bearing are exact (no noise is added).
+ *
+ * The query visits the grid cells overlapping the bounding box of the
+ * sensor sector, so its cost depends on the landmarks within range rather
+ * than on the total number of landmarks.
+ */
+
+#include "mex.h"
+#include "matrix.h"
+#include <memory>
+#include <stdexcept>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <mex/object_manager.hpp>
+#include <raycast.hpp>
+
+using namespace raycast;
+
+// landmark grid and (optional) obstacle map kept between calls
+class LandmarkMap {
+public:
+    LandmarkMap(const double *pX, const double *pY, size_t count, double cellSize):
+        index_(pX, pY, count, cellSize), caster_(TRAVERSAL_BRESENHAM), scale_(1.0) {
+        offset_[0] = offset_[1] = 0.0;
+    }
+
+    template <typename Map>
+    void setObstacles(const Map &map, double scale, const double offset[2], Traversal traversal, bool withDistanceField) {
+        bitmap_.reset(new TiledBitmap(map));
+        if (withDistanceField) distanceField_.reset(new DistanceField(*bitmap_));
+        caster_ = RayCaster(traversal);
+        scale_ = scale;
+        offset_[0] = offset[0];
+        offset_[1] = offset[1];
+    }
+
+    // candidates from the grid, then one occlusion ray per candidate (in
+    // cells, like the rays sensor_landmarks2d used to cast itself)
+    void query(const double pose[3], double maxRange, const double fieldOfView[2], std::vector<LandmarkObservation> &result) const {
+        index_.query(pose, maxRange, fieldOfView, result);
+        if (!bitmap_) return;
+
+        double xs = (pose[0] - offset_[0]) / scale_, ys = (pose[1] - offset_[1]) / scale_;
+        size_t visible = 0;
+        for (size_t i = 0; i < result.size(); i++) {
+            size_t id = result[i].id;
+            double xe = (index_.x(id) - offset_[0]) / scale_, ye = (index_.y(id) - offset_[1]) / scale_;
+            double range;
+            bool occluded = distanceField_ ? caster_.castRay(*distanceField_, xs, ys, xe, ye, range)
+                                           : caster_.castRay(*bitmap_, xs, ys, xe, ye, range);
+            if (!occluded) result[visible++] = result[i];
+        }
+        result.resize(visible);
+    }
+
+private:
+    LandmarkIndex index_;
+    std::unique_ptr<TiledBitmap> bitmap_;
+    std::unique_ptr<DistanceField> distanceField_;
+    RayCaster caster_;
+    double scale_;
+    double offset_[2];
+};
+
+enum LandmarkMapMethod {
+    METHOD_QUERY
+};
+
+static const mxArray *getField(const mxArray *mxStruct, const char *name) {
+    const mxArray *mxField = mxStruct ? mxGetField(mxStruct, 0, name) : NULL;
+    if (!mxField) throw std::runtime_error(std::string("Parameter '") + name + "' missing");
+    return mxField;
+}
+
+static const double *getMatrixField(const mxArray *mxStruct, const char *name, size_t count) {
+    const mxArray *mxField = getField(mxStruct, name);
+    if (!mxIsDouble(mxField) || mxIsComplex(mxField) || mxGetNumberOfElements(mxField) != count)
+        throw std::runtime_error(std::string("Parameter '") + name + "' must be a real double array with " + std::to_string(count) + " elements");
+    return mxGetPr(mxField);
+}
+
+static double getScalar(const mxArray *mxStruct, const char *name, double defaultValue) {
+    const mxArray *mxField = mxStruct ? mxGetField(mxStruct, 0, name) : NULL;
+    if (!mxField) return defaultValue;
+    if (!(mxIsNumeric(mxField) || mxIsLogical(mxField)) || mxIsComplex(mxField) || mxGetNumberOfElements(mxField) != 1)
+        throw std::runtime_error(std::string("Parameter '") + name + "' must be a real scalar");
+    return mxGetScalar(mxField);
+}
+
+static Traversal getTraversal(const mxArray *mxStruct) {
+    const mxArray *mxField = mxGetField(mxStruct, 0, "traversal");
+    if (!mxField) return TRAVERSAL_BRESENHAM;
+    char traversal[16];
+    if (!mxIsChar(mxField) || mxGetString(mxField, traversal, sizeof(traversal)) != 0)
+        throw std::runtime_error("Parameter 'traversal' must be a string");
+    if (strcmp(traversal, "dda") == 0) return TRAVERSAL_DDA;
+    if (strcmp(traversal, "bresenham") == 0) return TRAVERSAL_BRESENHAM;
+    throw std::runtime_error("Unknown traversal. Supported: 'dda', 'bresenham'");
+}
+
+template <typename CellType>
+static DenseMap<CellType> denseMap(const mxArray *mxMap, CellType obstacleValue) {
+    return DenseMap<CellType>((const CellType *)mxGetData(mxMap), (int)mxGetN(mxMap), (int)mxGetM(mxMap), obstacleValue);
+}
+
+class LandmarkMapManager: public mex::object_manager<LandmarkMap> {
+public:
+    LandmarkMapManager() {
+        setConstructionRequiresArgument(true);
+        addMethod("query", METHOD_QUERY);
+    }
+
+    virtual LandmarkMap *create(const mxArray *mxOpts) {
+        const mxArray *mxLandmarks = getField(mxOpts, "landmarks");
+        if (mxGetNumberOfDimensions(mxLandmarks) != 2 || !mxIsDouble(mxLandmarks) || mxIsComplex(mxLandmarks) ||
+            (mxGetN(mxLandmarks) != 2 && !mxIsEmpty(mxLandmarks)))
+            throw std::runtime_error("Parameter 'landmarks' must be a Nx2 double matrix");
+        size_t count = mxIsEmpty(mxLandmarks) ? 0 : mxGetM(mxLandmarks);
+        const double *pLandmarks = mxGetPr(mxLandmarks);
+        std::unique_ptr<LandmarkMap> landmarkMap(new LandmarkMap(pLandmarks, pLandmarks + count, count,
+                                                                 getScalar(mxOpts, "cellSize", 0.0)));
+
+        const mxArray *mxMap = mxGetField(mxOpts, 0, "obstacles");
+        if (mxMap) {
+            if (mxGetNumberOfDimensions(mxMap) != 2 || !(mxIsUint8(mxMap) || mxIsLogical(mxMap)) ||
+                mxIsComplex(mxMap) || mxIsEmpty(mxMap))
+                throw std::runtime_error("Parameter 'obstacles' must be a non-empty, real uint8 or logical matrix");
+            double scale = getScalar(mxOpts, "scale", 0.0);
+            if (!(scale > 0.0)) throw std::runtime_error("Parameter 'scale' must be a positive scalar");
+            const double *offset = getMatrixField(mxOpts, "offset", 2);
+            unsigned obstacleValue = (unsigned)getScalar(mxOpts, "obstacleValue", 1.0);
+            Traversal traversal = getTraversal(mxOpts);
+            bool withDistanceField = getScalar(mxOpts, "distanceField", 0.0) != 0.0;
+            if (mxIsUint8(mxMap)) {
+                landmarkMap->setObstacles(denseMap(mxMap, (unsigned char)obstacleValue), scale, offset, traversal, withDistanceField);
+            } else {
+                landmarkMap->setObstacles(denseMap(mxMap, (mxLogical)obstacleValue), scale, offset, traversal, withDistanceField);
+            }
+        }
+        return landmarkMap.release();
+    }
+
+    virtual void invoke(LandmarkMap &landmarkMap, int /* methodId: only METHOD_QUERY */, const mxArray *mxOpts, int nlhs, mxArray *plhs[]) {
+        if (nlhs > 3) throw std::runtime_error("Too many output arguments");
+        const double *pose = getMatrixField(mxOpts, "pose", 3);
+        double maxRange = getScalar(mxOpts, "range", 0.0);
+        const double *fieldOfView = getMatrixField(mxOpts, "fieldOfView", 2);
+
+        landmarkMap.query(pose, maxRange, fieldOfView, observations_);
+        size_t count = observations_.size();
+        plhs[0] = mxCreateDoubleMatrix(count, 1, mxREAL);
+        if (nlhs > 1) plhs[1] = mxCreateDoubleMatrix(count, 1, mxREAL);
+        if (nlhs > 2) plhs[2] = mxCreateDoubleMatrix(count, 1, mxREAL);
+        for (size_t i = 0; i < count; i++) {
+            mxGetPr(plhs[0])[i] = (double)(observations_[i].id + 1);
+            if (nlhs > 1) mxGetPr(plhs[1])[i] = observations_[i].range;
+            if (nlhs > 2) mxGetPr(plhs[2])[i] = observations_[i].bearing;
+        }
+    }
+
+private:
+    std::vector<LandmarkObservation> observations_; // reused between queries
+};
+
+static LandmarkMapManager landmarkMapManager;
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    try {
+        landmarkMapManager.mexFunction(nlhs, plhs, nrhs, prhs);
+    } catch (const std::exception &e) {
+        mexErrMsgIdAndTxt("mex_landmark_index:error", "%s", e.what());
+    }
+}
@@ -0,0 +1,670 @@
+//$ mex mex_mcl.cpp -I../tools/mex/include -I../tools/raycast/include # Maltab command for generating the MEX file
+/*******************************************************
+ * Monte Carlo localization core for filter_ddrive_mcl: a particle filter
+ * for a differential drive robot with a range finder. Range scans are
+ * weighted with the likelihood field model (Thrun et al., Probabilistic
+ * Robotics, ch. 6.4), which is precomputed for every map cell from the
+ * obstacle distances of env_gridmap, so a beam costs a single table
+ * lookup. The number of particles is adapted by KLD sampling (Fox, 2003).
+ *
+ * Construction: core = mex_object_handle(@mex_mcl, opts)
+ * opts: struct with fields
+ *   .distance - single or double matrix, distance in m from each map cell
+ *               to the nearest obstacle (0 for obstacles, see env_gridmap)
+ *   .scale, .offset - map scale in m per cell and map origin in m
+ *   .wheelRadius - [R_right, R_left] or a single radius for both wheels
+ *   .wheelDistance - distance between the wheels
+ *   .pose - (optional) initial pose [x; y; phi]. If missing or empty, the
+ *           particles are spread uniformly over the free cells of the map
+ *           (global localization).
+ *   .poseError - (optional) [sigma_x, sigma_y, sigma_phi] of the initial
+ *                pose (default: zeros)
+ *   .odometryError - (optional) sigma of the wheel speeds in rad/s
+ *                    (default: 0.1)
+ *   .motionError - (optional) [a_d, a_phi], sigma of the pose error of a
+ *                  prediction relative to the motion: a_d * d for x and y
+ *                  and a_phi * |dphi| + a_d * d for phi, d is the distance
+ *                  driven and dphi the rotation (default: [0.05, 0.05]).
+ *                  Keeps the particles from collapsing when the odometer
+ *                  noise is small compared to the errors of the map and
+ *                  the sensor model.
+ *   .maxRange - (optional) maximum range of the sensor in m (default: 4.5)
+ *   .sigmaHit - (optional) sigma of the beam end points in m (default: 0.05)
+ *   .zHit, .zRand - (optional) weights of the gaussian and the uniform part
+ *                   of the measurement model (default: 0.9, 0.1)
+ *   .maxBeams - (optional) number of beams used per scan (default: 60)
+ *   .minParticles, .maxParticles - (optional) bounds of the particle count
+ *                                  (default: 500, 20000)
+ *   .kldError, .kldQuantile - (optional) bound and upper standard normal
+ *                             quantile of the KLD sampling (default: 0.05,
+ *                             2.33, i. e. 99%)
+ *   .binSize - (optional) [x, y, phi] histogram bin size of the KLD
+ *              sampling (default: [0.1, 0.1, 10 * pi / 180])
+ *   .resampleThreshold - (optional) resample if the effective sample size
+ *                        falls below this fraction of the particle count
+ *                        (default: 0.5)
+ *   .seed - (optional) seed for all random numbers. Equal seeds and inputs
+ *           give equal results, regardless of the number of threads.
+ *
+ * Methods (all return the revision, which is incremented by every change):
+ *   revision = core.invoke('predict', 'u', u, 'dt', dt)
+ *       Move all particles by M odometer samples: u is 2xM wheel speeds
+ *       [omega_r; omega_l] in rad/s, each applied for dt(i) seconds, with
+ *       independent gaussian noise per wheel and sample and the motion
+ *       error of all samples together.
+ *   revision = core.invoke('update', 'range', range, 'bearing', bearing)
+ *       Weight the particles with a scan (ranges in m, inf for no hit) and
+ *       resample if necessary.
+ *   e = core.invoke('estimate')
+ *       struct with fields .pose (weighted mean, 3x1), .cov (3x3), .count
+ *       (number of particles), .ess (effective sample size), .revision
+ *   [particles, weights] = core.invoke('particles'[, 'maxCount', n])
+ *       3xN particle poses and 1xN weights, every k-th particle if there
+ *       are more than n
+ *   revision = core.invoke('revision')
+ *   copy = core.clone()
+ *       Independent copy of the particle filter (e.g. for the checkpoints of
+ *       the simulator), which shares the likelihood field with core.
+ *
+ * Configuration: [threads] = mex_mcl('threads'[, n])
+ * Query or set the number of threads (see mex_isect_gridmap_rays).
+ *
+ * The particles are kept as separate arrays of x, y, phi and weights. Both
+ * the prediction and the weighting run on a worker pool in chunks of
+ * particles, with counter based random numbers, which only depend on the
+ * seed, the step and the particle index.
+ */
+
+#include "mex.h"
+#include "matrix.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <string.h>
+#include <vector>
+#include <mex/object_manager.hpp>
+#include <raycast/ray_caster.hpp>
+#include <raycast/worker_pool.hpp>
+
+#define POSE_SIZE 3
+#define PARALLEL_MIN_PARTICLES 2048 // smaller sets are not worth waking up the workers
+#define PARALLEL_CHUNK_SIZE 512     // particles per work item
+
+using raycast::splitMix64;
+using raycast::gaussianNoise;
+using raycast::wrapAngle;
+
+static raycast::WorkerPool workerPool;
+
+static void shutdownWorkerPool() {
+    workerPool.shutdown();
+}
+
+// counter based uniform noise in [0, 1), see raycast::gaussianNoise
+static inline double uniformNoise(uint64_t seed, uint64_t index) {
+    return (splitMix64(seed ^ splitMix64(index)) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// two independent samples of the same Box-Muller transform, see
+// raycast::gaussianNoise
+static inline void gaussianNoisePair(uint64_t seed, uint64_t index, double &n1, double &n2) {
+    uint64_t r1 = splitMix64(seed ^ splitMix64(index));
+    uint64_t r2 = splitMix64(r1);
+    double u1 = ((r1 >> 11) + 1) * (1.0 / 9007199254740993.0); /* (0, 1] */
+    double u2 = (r2 >> 11) * (1.0 / 9007199254740992.0);       /* [0, 1) */
+    double radius = std::sqrt(-2.0 * std::log(u1));
+    n1 = radius * std::cos(2.0 * M_PI * u2);
+    n2 = radius * std::sin(2.0 * M_PI * u2);
+}
+
+template <typename Fn>
+static void forEachChunk(size_t count, Fn fn) {
+    if (count >= PARALLEL_MIN_PARTICLES) workerPool.parallelFor(count, PARALLEL_CHUNK_SIZE, fn);
+    else fn((size_t)0, count);
+}
+
+// Log-likelihood of a beam end point for every map cell:
+// log(zHit * exp(-d^2 / (2 sigmaHit^2)) + zRand / maxRange), d is the
+// distance to the nearest obstacle. End points outside the map count as
+// far away from all obstacles.
+class LikelihoodField {
+public:
+    template <typename T>
+    LikelihoodField(const T *distance, int width, int height, double scale, const double *offset,
+                    double sigmaHit, double zHit, double zRand, double maxRange):
+        width_(width), height_(height), invScale_(1.0 / scale), offsetX_(offset[0]), offsetY_(offset[1]),
+        logLikelihood_((size_t)width * height), free_((size_t)width * height) {
+        double zRandPart = zRand / maxRange;
+        outside_ = (float)std::log(zRandPart);
+        for (size_t i = 0; i < logLikelihood_.size(); i++) {
+            double d = (double)distance[i];
+            logLikelihood_[i] = (float)std::log(zHit * std::exp(-d * d / (2.0 * sigmaHit * sigmaHit)) + zRandPart);
+            free_[i] = d > 0.0;
+        }
+    }
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    float logLikelihood(double x, double y) const {
+        size_t i;
+        return index(x, y, i) ? logLikelihood_[i] : outside_;
+    }
+    bool isFree(double x, double y) const {
+        size_t i;
+        return index(x, y, i) && free_[i];
+    }
+    // center of cell (column, row) in m
+    double cellX(int column) const { return offsetX_ + (column + 0.5) / invScale_; }
+    double cellY(int row) const { return offsetY_ + (row + 0.5) / invScale_; }
+    bool isFreeCell(size_t i) const { return free_[i]; }
+
+private:
+    // column-major like the Matlab matrix: rows are y, columns are x
+    bool index(double x, double y, size_t &i) const {
+        double cx = (x - offsetX_) * invScale_, cy = (y - offsetY_) * invScale_;
+        if (!(cx >= 0.0 && cx < width_ && cy >= 0.0 && cy < height_)) return false;
+        i = (size_t)cx * height_ + (size_t)cy;
+        return true;
+    }
+
+    int width_, height_;
+    double invScale_, offsetX_, offsetY_;
+    float outside_;
+    std::vector<float> logLikelihood_;
+    std::vector<uint8_t> free_;
+};
+
+struct MclParameters {
+    double wheelRadius[2];
+    double wheelDistance;
+    double odometryError;
+    double motionError[2];
+    size_t maxBeams;
+    size_t minParticles, maxParticles;
+    double kldError, kldQuantile;
+    double binSize[POSE_SIZE];
+    double resampleThreshold;
+    double maxRange;
+};
+
+class ParticleFilter {
+public:
+    ParticleFilter(std::shared_ptr<const LikelihoodField> field, const MclParameters &params, uint64_t seed):
+        field_(std::move(field)), params_(params), seed_(seed), step_(0), revision_(0) { }
+
+    // gaussian around pose
+    void initialize(const double *pose, const double *poseError) {
+        resize(params_.maxParticles);
+        uint64_t stepSeed = nextStepSeed();
+        for (size_t i = 0; i < x_.size(); i++) {
+            x_[i] = pose[0] + poseError[0] * gaussianNoise(stepSeed, 3 * i);
+            y_[i] = pose[1] + poseError[1] * gaussianNoise(stepSeed, 3 * i + 1);
+            phi_[i] = wrapAngle(pose[2] + poseError[2] * gaussianNoise(stepSeed, 3 * i + 2));
+        }
+        revision_++;
+    }
+
+    // uniform over all free cells
+    void initialize() {
+        std::vector<size_t> freeCells;
+        size_t cellCount = (size_t)field_->width() * field_->height();
+        for (size_t i = 0; i < cellCount; i++) {
+            if (field_->isFreeCell(i)) freeCells.push_back(i);
+        }
+        if (freeCells.empty()) throw std::runtime_error("The map does not contain any free cell");
+
+        resize(params_.maxParticles);
+        uint64_t stepSeed = nextStepSeed();
+        double cellSize = field_->cellX(1) - field_->cellX(0);
+        for (size_t i = 0; i < x_.size(); i++) {
+            size_t cell = freeCells[std::min(freeCells.size() - 1, (size_t)(uniformNoise(stepSeed, 4 * i) * freeCells.size()))];
+            int column = (int)(cell / field_->height()), row = (int)(cell % field_->height());
+            x_[i] = field_->cellX(column) + (uniformNoise(stepSeed, 4 * i + 1) - 0.5) * cellSize;
+            y_[i] = field_->cellY(row) + (uniformNoise(stepSeed, 4 * i + 2) - 0.5) * cellSize;
+            phi_[i] = (2.0 * uniformNoise(stepSeed, 4 * i + 3) - 1.0) * M_PI;
+        }
+        revision_++;
+    }
+
+    // u: 2xcount wheel speeds, dt: durations
+    void predict(const double *u, const double *dt, size_t count) {
+        std::vector<uint64_t> stepSeeds(count);
+        for (size_t k = 0; k < count; k++) stepSeeds[k] = nextStepSeed();
+        uint64_t motionSeed = nextStepSeed();
+
+        const double R_R = params_.wheelRadius[0], R_L = params_.wheelRadius[1];
+        const double a = params_.wheelDistance / 2.0, sigma = params_.odometryError;
+        double *px = &x_[0], *py = &y_[0], *pphi = &phi_[0];
+        forEachChunk(x_.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                double x = px[i], y = py[i], phi = pphi[i];
+                double c = std::cos(phi), s = std::sin(phi);
+                double distance = 0.0, rotation = 0.0;
+                for (size_t k = 0; k < count; k++) {
+                    double noiseR, noiseL;
+                    gaussianNoisePair(stepSeeds[k], i, noiseR, noiseL);
+                    double omegaR = u[2 * k] + sigma * noiseR, omegaL = u[2 * k + 1] + sigma * noiseL;
+                    double v = (R_R * omegaR + R_L * omegaL) / 2.0;
+                    double omega = (R_R * omegaR - R_L * omegaL) / (2.0 * a);
+                    double dphi = omega * dt[k];
+                    // exact integration on a circular arc, the heading is
+                    // rotated by dphi instead of evaluating sin/cos of phi
+                    double cd = std::cos(dphi), sd = std::sin(dphi);
+                    double cNext = c * cd - s * sd, sNext = s * cd + c * sd;
+                    if (std::fabs(dphi) < 1e-9) {
+                        x += v * dt[k] * 0.5 * (c + cNext);
+                        y += v * dt[k] * 0.5 * (s + sNext);
+                    } else {
+                        x += v / omega * (sNext - s);
+                        y += v / omega * (c - cNext);
+                    }
+                    c = cNext;
+                    s = sNext;
+                    phi += dphi;
+                    distance += std::fabs(v * dt[k]);
+                    rotation += dphi;
+                }
+                double sigmaXY = params_.motionError[0] * distance;
+                double sigmaPhi = params_.motionError[1] * std::fabs(rotation) + params_.motionError[0] * distance;
+                double noiseX, noiseY;
+                gaussianNoisePair(motionSeed, 2 * i, noiseX, noiseY);
+                px[i] = x + sigmaXY * noiseX;
+                py[i] = y + sigmaXY * noiseY;
+                pphi[i] = wrapAngle(phi + sigmaPhi * gaussianNoise(motionSeed, 2 * i + 1));
+            }
+        });
+        revision_++;
+    }
+
+    void update(const double *range, const double *bearing, size_t count) {
+        // evenly spaced subset of the beams that hit something
+        std::vector<size_t> valid;
+        for (size_t j = 0; j < count; j++) {
+            if (std::isfinite(range[j]) && range[j] > 0.0 && range[j] < params_.maxRange) valid.push_back(j);
+        }
+        size_t beamCount = std::min(valid.size(), params_.maxBeams);
+        revision_++;
+        if (beamCount == 0) return;
+        std::vector<double> beamRange(beamCount), beamCos(beamCount), beamSin(beamCount);
+        for (size_t b = 0; b < beamCount; b++) {
+            size_t j = valid[b * valid.size() / beamCount];
+            beamRange[b] = range[j];
+            beamCos[b] = std::cos(bearing[j]);
+            beamSin[b] = std::sin(bearing[j]);
+        }
+
+        // log weights: previous weight times the likelihood of all beams.
+        // Particles inside obstacles or outside the map are discarded.
+        const LikelihoodField &field = *field_;
+        forEachChunk(x_.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                double x = x_[i], y = y_[i], c = std::cos(phi_[i]), s = std::sin(phi_[i]);
+                if (!(w_[i] > 0.0) || !field.isFree(x, y)) {
+                    logW_[i] = -std::numeric_limits<double>::infinity();
+                    continue;
+                }
+                double logLikelihood = 0.0;
+                for (size_t b = 0; b < beamCount; b++) {
+                    double r = beamRange[b];
+                    logLikelihood += field.logLikelihood(x + r * (c * beamCos[b] - s * beamSin[b]),
+                                                         y + r * (s * beamCos[b] + c * beamSin[b]));
+                }
+                logW_[i] = std::log(w_[i]) + logLikelihood;
+            }
+        });
+
+        double maxLogW = *std::max_element(logW_.begin(), logW_.end());
+        if (!std::isfinite(maxLogW)) {
+            // no particle is consistent with the map, keep them all
+            std::fill(w_.begin(), w_.end(), 1.0 / w_.size());
+            return;
+        }
+        double sum = 0.0;
+        for (size_t i = 0; i < w_.size(); i++) sum += (w_[i] = std::exp(logW_[i] - maxLogW));
+        for (size_t i = 0; i < w_.size(); i++) w_[i] /= sum;
+
+        if (effectiveSampleSize() < params_.resampleThreshold * w_.size()) resample();
+    }
+
+    double effectiveSampleSize() const {
+        double sum2 = 0.0;
+        for (size_t i = 0; i < w_.size(); i++) sum2 += w_[i] * w_[i];
+        return 1.0 / sum2;
+    }
+
+    // weighted mean and covariance, the orientation is averaged on the circle
+    void estimate(double *pose, double *cov) const {
+        double mx = 0.0, my = 0.0, mc = 0.0, ms = 0.0;
+        for (size_t i = 0; i < x_.size(); i++) {
+            mx += w_[i] * x_[i];
+            my += w_[i] * y_[i];
+            mc += w_[i] * std::cos(phi_[i]);
+            ms += w_[i] * std::sin(phi_[i]);
+        }
+        pose[0] = mx;
+        pose[1] = my;
+        pose[2] = std::atan2(ms, mc);
+        std::fill(cov, cov + POSE_SIZE * POSE_SIZE, 0.0);
+        for (size_t i = 0; i < x_.size(); i++) {
+            double d[POSE_SIZE] = { x_[i] - pose[0], y_[i] - pose[1], wrapAngle(phi_[i] - pose[2]) };
+            for (int r = 0; r < POSE_SIZE; r++) {
+                for (int c = r; c < POSE_SIZE; c++) cov[r + POSE_SIZE * c] += w_[i] * d[r] * d[c];
+            }
+        }
+        for (int r = 0; r < POSE_SIZE; r++) {
+            for (int c = 0; c < r; c++) cov[r + POSE_SIZE * c] = cov[c + POSE_SIZE * r];
+        }
+    }
+
+    size_t count() const { return x_.size(); }
+    uint64_t revision() const { return revision_; }
+    double x(size_t i) const { return x_[i]; }
+    double y(size_t i) const { return y_[i]; }
+    double phi(size_t i) const { return phi_[i]; }
+    double weight(size_t i) const { return w_[i]; }
+
+private:
+    void resize(size_t count) {
+        x_.resize(count);
+        y_.resize(count);
+        phi_.resize(count);
+        w_.assign(count, 1.0 / count);
+        logW_.resize(count);
+    }
+
+    uint64_t nextStepSeed() {
+        return splitMix64(seed_ ^ splitMix64(step_++));
+    }
+
+    // Number of particles required to keep the KLD between the sample
+    // based and the true posterior below kldError with probability
+    // quantile, if the posterior occupies binCount histogram bins.
+    size_t kldCount(size_t binCount) const {
+        if (binCount <= 1) return params_.minParticles;
+        double k = (double)(binCount - 1), a = 2.0 / (9.0 * k);
+        double t = 1.0 - a + std::sqrt(a) * params_.kldQuantile;
+        double n = std::ceil(k / (2.0 * params_.kldError) * t * t * t);
+        return (size_t)std::max<double>(params_.minParticles, std::min<double>(params_.maxParticles, n));
+    }
+
+    // Low variance (systematic) resampling. The new particle count follows
+    // from the number of histogram bins occupied by the particles that a
+    // systematic draw of maxParticles samples would select.
+    void resample() {
+        size_t oldCount = x_.size();
+        uint64_t stepSeed = nextStepSeed();
+
+        std::vector<uint64_t> bins;
+        bins.reserve(oldCount);
+        double offset = uniformNoise(stepSeed, 0), cumulative = 0.0;
+        double previousDraws = std::floor(-offset);
+        for (size_t i = 0; i < oldCount; i++) {
+            cumulative += w_[i];
+            double draws = std::floor(cumulative * params_.maxParticles - offset);
+            if (draws > previousDraws) bins.push_back(binKey(i));
+            previousDraws = draws;
+        }
+        std::sort(bins.begin(), bins.end());
+        size_t binCount = std::unique(bins.begin(), bins.end()) - bins.begin();
+        size_t newCount = kldCount(binCount);
+
+        std::vector<double> x(newCount), y(newCount), phi(newCount);
+        double step = 1.0 / newCount, target = uniformNoise(stepSeed, 1) * step;
+        size_t j = 0;
+        cumulative = w_[0];
+        for (size_t m = 0; m < newCount; m++, target += step) {
+            while (target > cumulative && j + 1 < oldCount) cumulative += w_[++j];
+            x[m] = x_[j];
+            y[m] = y_[j];
+            phi[m] = phi_[j];
+        }
+        x_.swap(x);
+        y_.swap(y);
+        phi_.swap(phi);
+        w_.assign(newCount, 1.0 / newCount);
+        logW_.resize(newCount);
+    }
+
+    // 21 bits per dimension
+    uint64_t binKey(size_t i) const {
+        const int64_t bias = (int64_t)1 << 20, mask = ((int64_t)1 << 21) - 1;
+        int64_t bx = (int64_t)std::floor(x_[i] / params_.binSize[0]) + bias;
+        int64_t by = (int64_t)std::floor(y_[i] / params_.binSize[1]) + bias;
+        int64_t bphi = (int64_t)std::floor((phi_[i] + M_PI) / params_.binSize[2]);
+        return ((uint64_t)(bx & mask) << 42) | ((uint64_t)(by & mask) << 21) | (uint64_t)(bphi & mask);
+    }
+
+    std::shared_ptr<const LikelihoodField> field_; // read-only, shared by copies
+    MclParameters params_;
+    uint64_t seed_, step_, revision_;
+    std::vector<double> x_, y_, phi_, w_, logW_;
+};
+
+enum MclMethod {
+    METHOD_PREDICT,
+    METHOD_UPDATE,
+    METHOD_ESTIMATE,
+    METHOD_PARTICLES,
+    METHOD_REVISION
+};
+
+static const mxArray *getField(const mxArray *mxStruct, const char *name) {
+    const mxArray *mxField = mxStruct ? mxGetField(mxStruct, 0, name) : NULL;
+    if (!mxField) throw std::runtime_error(std::string("Parameter '") + name + "' missing");
+    return mxField;
+}
+
+static const double *getMatrixField(const mxArray *mxStruct, const char *name, size_t count) {
+    const mxArray *mxField = getField(mxStruct, name);
+    if (!mxIsDouble(mxField) || mxIsComplex(mxField) || mxGetNumberOfElements(mxField) != count)
+        throw std::runtime_error(std::string("Parameter '") + name + "' must be a real double array with " + std::to_string(count) + " elements");
+    return mxGetPr(mxField);
+}
+
+static double getScalar(const mxArray *mxStruct, const char *name, double defaultValue) {
+    const mxArray *mxField = mxStruct ? mxGetField(mxStruct, 0, name) : NULL;
+    if (!mxField) return defaultValue;
+    if (!(mxIsNumeric(mxField) || mxIsLogical(mxField)) || mxIsComplex(mxField) || mxGetNumberOfElements(mxField) != 1)
+        throw std::runtime_error(std::string("Parameter '") + name + "' must be a real scalar");
+    return mxGetScalar(mxField);
+}
+
+static size_t getOptionalCount(const mxArray *mxStruct, const char *name) {
+    const mxArray *mxField = mxGetField(mxStruct, 0, name);
+    return mxField ? mxGetNumberOfElements(mxField) : 0;
+}
+
+static void getOptionalVector(const mxArray *mxStruct, const char *name, double *dest, size_t count) {
+    if (getOptionalCount(mxStruct, name) == 0) return;
+    const double *values = getMatrixField(mxStruct, name, count);
+    std::copy(values, values + count, dest);
+}
+
+static std::unique_ptr<LikelihoodField> createField(const mxArray *mxOpts, double sigmaHit, double zHit, double zRand, double maxRange) {
+    const mxArray *mxDistance = getField(mxOpts, "distance");
+    if (mxIsComplex(mxDistance) || mxGetNumberOfDimensions(mxDistance) != 2 || mxIsEmpty(mxDistance))
+        throw std::runtime_error("Parameter 'distance' must be a non-empty real matrix");
+    int width = (int)mxGetN(mxDistance), height = (int)mxGetM(mxDistance);
+    double scale = getScalar(mxOpts, "scale", 0.0);
+    if (!(scale > 0.0)) throw std::runtime_error("Parameter 'scale' must be positive");
+    const double *offset = getMatrixField(mxOpts, "offset", 2);
+
+    if (mxIsSingle(mxDistance)) {
+        return std::unique_ptr<LikelihoodField>(new LikelihoodField((const float *)mxGetData(mxDistance), width, height, scale, offset,
+                                                                    sigmaHit, zHit, zRand, maxRange));
+    } else if (mxIsDouble(mxDistance)) {
+        return std::unique_ptr<LikelihoodField>(new LikelihoodField(mxGetPr(mxDistance), width, height, scale, offset,
+                                                                    sigmaHit, zHit, zRand, maxRange));
+    }
+    throw std::runtime_error("Parameter 'distance' must be a single or double matrix");
+}
+
+class MclManager: public mex::object_manager<ParticleFilter> {
+public:
+    MclManager() {
+        setConstructionRequiresArgument(true);
+        addMethod("predict", METHOD_PREDICT);
+        addMethod("update", METHOD_UPDATE);
+        addMethod("estimate", METHOD_ESTIMATE);
+        addMethod("particles", METHOD_PARTICLES);
+        addMethod("revision", METHOD_REVISION);
+    }
+
+    virtual ParticleFilter *create(const mxArray *mxOpts) {
+        MclParameters params;
+        size_t radiusCount = mxGetNumberOfElements(getField(mxOpts, "wheelRadius"));
+        if (radiusCount != 1 && radiusCount != 2) throw std::runtime_error("Parameter 'wheelRadius' must have one or two elements");
+        const double *wheelRadius = getMatrixField(mxOpts, "wheelRadius", radiusCount);
+        params.wheelRadius[0] = wheelRadius[0];
+        params.wheelRadius[1] = wheelRadius[radiusCount - 1];
+        params.wheelDistance = getScalar(mxOpts, "wheelDistance", 0.0);
+        params.odometryError = getScalar(mxOpts, "odometryError", 0.1);
+        params.motionError[0] = params.motionError[1] = 0.05;
+        getOptionalVector(mxOpts, "motionError", params.motionError, 2);
+        params.maxRange = getScalar(mxOpts, "maxRange", 4.5);
+        double maxBeams = getScalar(mxOpts, "maxBeams", 60);
+        double minParticles = getScalar(mxOpts, "minParticles", 500);
+        double maxParticles = getScalar(mxOpts, "maxParticles", 20000);
+        params.kldError = getScalar(mxOpts, "kldError", 0.05);
+        params.kldQuantile = getScalar(mxOpts, "kldQuantile", 2.33);
+        params.binSize[0] = params.binSize[1] = 0.1;
+        params.binSize[2] = 10.0 * M_PI / 180.0;
+        getOptionalVector(mxOpts, "binSize", params.binSize, POSE_SIZE);
+        params.resampleThreshold = getScalar(mxOpts, "resampleThreshold", 0.5);
+        double sigmaHit = getScalar(mxOpts, "sigmaHit", 0.05);
+        double zHit = getScalar(mxOpts, "zHit", 0.9);
+        double zRand = getScalar(mxOpts, "zRand", 0.1);
+
+        if (!(params.wheelDistance > 0.0)) throw std::runtime_error("Parameter 'wheelDistance' must be positive");
+        if (!(params.odometryError >= 0.0)) throw std::runtime_error("Parameter 'odometryError' must be nonnegative");
+        if (!(params.motionError[0] >= 0.0 && params.motionError[1] >= 0.0)) throw std::runtime_error("Parameter 'motionError' must be nonnegative");
+        if (!(params.maxRange > 0.0)) throw std::runtime_error("Parameter 'maxRange' must be positive");
+        if (!(maxBeams >= 1.0)) throw std::runtime_error("Parameter 'maxBeams' must be positive");
+        if (!(minParticles >= 1.0 && maxParticles >= minParticles && maxParticles <= 1e8))
+            throw std::runtime_error("Parameters 'minParticles' and 'maxParticles' must satisfy 1 <= minParticles <= maxParticles <= 1e8");
+        if (!(params.kldError > 0.0)) throw std::runtime_error("Parameter 'kldError' must be positive");
+        if (!(params.binSize[0] > 0.0 && params.binSize[1] > 0.0 && params.binSize[2] > 0.0))
+            throw std::runtime_error("Parameter 'binSize' must be positive");
+        if (!(sigmaHit > 0.0 && zHit >= 0.0 && zRand > 0.0)) throw std::runtime_error("Parameters 'sigmaHit' and 'zRand' must be positive, 'zHit' nonnegative");
+        params.maxBeams = (size_t)maxBeams;
+        params.minParticles = (size_t)minParticles;
+        params.maxParticles = (size_t)maxParticles;
+
+        uint64_t seed;
+        if (mxGetField(mxOpts, 0, "seed")) seed = (uint64_t)getScalar(mxOpts, "seed", 0.0);
+        else seed = std::random_device()();
+
+        std::unique_ptr<ParticleFilter> filter(new ParticleFilter(createField(mxOpts, sigmaHit, zHit, zRand, params.maxRange), params, seed));
+        if (getOptionalCount(mxOpts, "pose") > 0) {
+            double poseError[POSE_SIZE] = { 0.0, 0.0, 0.0 };
+            getOptionalVector(mxOpts, "poseError", poseError, POSE_SIZE);
+            filter->initialize(getMatrixField(mxOpts, "pose", POSE_SIZE), poseError);
+        } else {
+            filter->initialize();
+        }
+        return filter.release();
+    }
+
+    virtual ParticleFilter *clone(const ParticleFilter &filter) {
+        return new ParticleFilter(filter);
+    }
+
+    virtual void invoke(ParticleFilter &filter, int methodId, const mxArray *mxOpts, int nlhs, mxArray *plhs[]) {
+        switch (methodId) {
+        case METHOD_PREDICT: {
+            if (nlhs > 1) throw std::runtime_error("Too many output arguments");
+            size_t count = mxGetNumberOfElements(getField(mxOpts, "dt"));
+            filter.predict(getMatrixField(mxOpts, "u", 2 * count), getMatrixField(mxOpts, "dt", count), count);
+            plhs[0] = mxCreateDoubleScalar((double)filter.revision());
+            break;
+        }
+        case METHOD_UPDATE: {
+            if (nlhs > 1) throw std::runtime_error("Too many output arguments");
+            size_t count = mxGetNumberOfElements(getField(mxOpts, "range"));
+            filter.update(getMatrixField(mxOpts, "range", count), getMatrixField(mxOpts, "bearing", count), count);
+            plhs[0] = mxCreateDoubleScalar((double)filter.revision());
+            break;
+        }
+        case METHOD_ESTIMATE: {
+            if (nlhs > 1) throw std::runtime_error("Too many output arguments");
+            mxArray *mxPose = mxCreateDoubleMatrix(POSE_SIZE, 1, mxREAL);
+            mxArray *mxCov = mxCreateDoubleMatrix(POSE_SIZE, POSE_SIZE, mxREAL);
+            filter.estimate(mxGetPr(mxPose), mxGetPr(mxCov));
+            const char *fields[] = {"pose", "cov", "count", "ess", "revision"};
+            plhs[0] = mxCreateStructMatrix(1, 1, 5, fields);
+            mxSetField(plhs[0], 0, "pose", mxPose);
+            mxSetField(plhs[0], 0, "cov", mxCov);
+            mxSetField(plhs[0], 0, "count", mxCreateDoubleScalar((double)filter.count()));
+            mxSetField(plhs[0], 0, "ess", mxCreateDoubleScalar(filter.effectiveSampleSize()));
+            mxSetField(plhs[0], 0, "revision", mxCreateDoubleScalar((double)filter.revision()));
+            break;
+        }
+        case METHOD_PARTICLES: {
+            if (nlhs > 2) throw std::runtime_error("Too many output arguments");
+            double maxCount = getScalar(mxOpts, "maxCount", (double)filter.count());
+            if (!(maxCount >= 1)) throw std::runtime_error("Parameter 'maxCount' must be positive");
+            size_t step = (filter.count() + (size_t)maxCount - 1) / (size_t)maxCount;
+            size_t n = (filter.count() + step - 1) / step;
+            plhs[0] = mxCreateDoubleMatrix(POSE_SIZE, n, mxREAL);
+            double *pParticles = mxGetPr(plhs[0]), *pWeights = NULL;
+            if (nlhs > 1) {
+                plhs[1] = mxCreateDoubleMatrix(1, n, mxREAL);
+                pWeights = mxGetPr(plhs[1]);
+            }
+            for (size_t k = 0; k < n; k++) {
+                pParticles[POSE_SIZE * k] = filter.x(k * step);
+                pParticles[POSE_SIZE * k + 1] = filter.y(k * step);
+                pParticles[POSE_SIZE * k + 2] = filter.phi(k * step);
+                if (pWeights) pWeights[k] = filter.weight(k * step);
+            }
+            break;
+        }
+        case METHOD_REVISION:
+            if (nlhs > 1) throw std::runtime_error("Too many output arguments");
+            plhs[0] = mxCreateDoubleScalar((double)filter.revision());
+            break;
+        }
+    }
+};
+
+static MclManager mclManager;
+
+static void configure(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    char option[32];
+    if (mxGetString(prhs[0], option, sizeof(option)) != 0 || strcmp(option, "threads") != 0)
+        mexErrMsgTxt("Unknown configuration option. Supported: 'threads'");
+    if (nrhs > 2) mexErrMsgTxt("Too many input arguments");
+    if (nlhs > 1) mexErrMsgTxt("Too many output arguments");
+
+    if (nrhs > 1) {
+        if (!mxIsNumeric(prhs[1]) || mxIsComplex(prhs[1]) || mxGetNumberOfElements(prhs[1]) != 1 || !(mxGetScalar(prhs[1]) >= 0))
+            mexErrMsgTxt("Thread count must be a nonnegative scalar value");
+        workerPool.setThreadCount((unsigned)mxGetScalar(prhs[1]));
+    }
+    plhs[0] = mxCreateDoubleScalar(workerPool.threadCount());
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    static bool exitHandlerRegistered = false;
+    if (!exitHandlerRegistered) {
+        mexAtExit(shutdownWorkerPool);
+        exitHandlerRegistered = true;
+    }
+
+    if (nrhs >= 1 && mxIsChar(prhs[0])) {
+        configure(nlhs, plhs, nrhs, prhs);
+        return;
+    }
+
+    try {
+        mclManager.mexFunction(nlhs, plhs, nrhs, prhs);
+    } catch (const std::exception &e) {
+        mexErrMsgIdAndTxt("mex_mcl:error", "%s", e.what());
+    }
+}
@@ -0,0 +1,309 @@
+//$ mex mex_occupancy_grid.cpp -I../tools/mex/include # Maltab command for generating the MEX file
+/*******************************************************
+ * Occupancy grid mapping for map_occupancy2d: keeps a log-odds grid between
+ * calls and integrates range scans in place. Memory is fixed by the grid
+ * size, a scan costs O(rays * range in cells).
+ *
+ * Construction: grid = mex_object_handle(@mex_occupancy_grid, opts)
+ * opts: struct with fields
+ *   .scale - edge length of a cell in m
+ *   .offset - coordinates of the grid origin in m
+ *   .extent - [width, height] of the grid in m
+ *   .logOddsHit - (optional) log-odds added to a cell containing a scan endpoint (default: 0.85)
+ *   .logOddsMiss - (optional) log-odds added to a cell traversed by a ray (default: -0.4)
+ *   .logOddsLimits - (optional) [min, max] clamping of the log-odds (default: [-2, 3.5])
+ *
+ * Cell (i, j) (one-based, row i, column j as in a Matlab image) covers
+ * x in offset(1) + scale * [j - 1, j), y in offset(2) + scale * [i - 1, i).
+ *
+ * Methods:
+ *   revision = grid.invoke('addScan', 'pose', pose, 'range', range, 'bearing', bearing, 'maxRange', maxRange)
+ *       Integrate the scan (Nx1 range and bearing relative to pose [x, y, theta])
+ *       and return the revision, which is incremented by every scan. Rays
+ *       with infinite range only clear the free space up to maxRange. Each
+ *       cell is updated at most once per scan, hits take precedence.
+ *   [occupancy, rows, cols] = grid.invoke('image'[, 'since', revision])
+ *       Occupancy probabilities of the grid. With 'since', only the
+ *       bounding box of the tiles of 16x16 cells changed by scans after
+ *       the given revision is returned, rows = [first, last] and cols =
+ *       [first, last] are its (one-based) cell indices. All outputs are
+ *       empty when nothing has changed.
+ *   revision = grid.invoke('revision')
+ *   copy = grid.clone()
+ *       Independent copy of the grid (e.g. for the checkpoints of the simulator)
+ */
+
+#include "mex.h"
+#include "matrix.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <mex/object_manager.hpp>
+
+#define TILE_SHIFT 4 // tiles of 16x16 cells for change tracking
+
+class OccupancyGrid {
+public:
+    OccupancyGrid(int width, int height, double scale, const double offset[2]):
+        width_(width), height_(height), scale_(scale),
+        tilesX_(((width - 1) >> TILE_SHIFT) + 1), tilesY_(((height - 1) >> TILE_SHIFT) + 1),
+        logOdds_((size_t)width * height, 0.0f), scanStamp_((size_t)width * height, 0),
+        tileRevision_((size_t)tilesX_ * tilesY_, 0), revision_(0),
+        hit_(0.85f), miss_(-0.4f), min_(-2.0f), max_(3.5f) {
+        offset_[0] = offset[0];
+        offset_[1] = offset[1];
+    }
+
+    void setLogOdds(double hit, double miss, double min, double max) {
+        hit_ = (float)hit;
+        miss_ = (float)miss;
+        min_ = (float)min;
+        max_ = (float)max;
+    }
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    uint64_t revision() const { return revision_; }
+
+    void addScan(const double pose[3], size_t count, const double *pRange, const double *pBearing, double maxRange) {
+        revision_++;
+        // stamps tell which cells this scan has already updated
+        uint32_t stamp = (uint32_t)revision_;
+        if (stamp == 0) {
+            std::fill(scanStamp_.begin(), scanStamp_.end(), 0);
+            stamp = (uint32_t)++revision_;
+        }
+
+        double xs = (pose[0] - offset_[0]) / scale_, ys = (pose[1] - offset_[1]) / scale_;
+        if (!std::isfinite(xs) || !std::isfinite(ys)) return;
+        for (size_t i = 0; i < count; i++) {
+            double angle = pose[2] + pBearing[i];
+            if (!std::isfinite(pRange[i]) || !(pRange[i] >= 0.0) || !std::isfinite(angle)) continue;
+            double x = std::floor(xs + pRange[i] / scale_ * std::cos(angle));
+            double y = std::floor(ys + pRange[i] / scale_ * std::sin(angle));
+            if (x >= 0.0 && y >= 0.0 && x < width_ && y < height_) update((int)x, (int)y, hit_, stamp);
+        }
+        for (size_t i = 0; i < count; i++) {
+            double angle = pose[2] + pBearing[i];
+            if (!(pRange[i] >= 0.0) || !std::isfinite(angle)) continue;
+            bool hit = std::isfinite(pRange[i]);
+            double range = (hit ? pRange[i] : maxRange) / scale_;
+            if (!(range > 0.0) || !std::isfinite(range)) continue;
+            traverse(xs, ys, xs + range * std::cos(angle), ys + range * std::sin(angle), !hit, stamp);
+        }
+    }
+
+    // bounding box (zero-based, inclusive) of the cells changed after revision,
+    // false if there are none
+    bool changedRegion(uint64_t since, int &x0, int &x1, int &y0, int &y1) const {
+        int tx0 = tilesX_, tx1 = -1, ty0 = tilesY_, ty1 = -1;
+        for (int ty = 0; ty < tilesY_; ty++) {
+            for (int tx = 0; tx < tilesX_; tx++) {
+                if (tileRevision_[(size_t)ty * tilesX_ + tx] <= since) continue;
+                tx0 = std::min(tx0, tx);
+                tx1 = std::max(tx1, tx);
+                ty0 = std::min(ty0, ty);
+                ty1 = std::max(ty1, ty);
+            }
+        }
+        if (tx1 < 0) return false;
+        x0 = tx0 << TILE_SHIFT;
+        x1 = std::min(((tx1 + 1) << TILE_SHIFT) - 1, width_ - 1);
+        y0 = ty0 << TILE_SHIFT;
+        y1 = std::min(((ty1 + 1) << TILE_SHIFT) - 1, height_ - 1);
+        return true;
+    }
+
+    // occupancy probabilities of the region, column-major with y as row index
+    void copyOccupancy(int x0, int x1, int y0, int y1, double *pDest) const {
+        for (int x = x0; x <= x1; x++) {
+            const float *pColumn = &logOdds_[(size_t)x * height_];
+            for (int y = y0; y <= y1; y++) *pDest++ = 1.0 - 1.0 / (1.0 + std::exp((double)pColumn[y]));
+        }
+    }
+
+private:
+    bool contains(int x, int y) const { return x >= 0 && y >= 0 && x < width_ && y < height_; }
+
+    void update(int x, int y, float delta, uint32_t stamp) {
+        size_t i = (size_t)x * height_ + y;
+        if (scanStamp_[i] == stamp) return;
+        scanStamp_[i] = stamp;
+        logOdds_[i] = std::min(max_, std::max(min_, logOdds_[i] + delta));
+        tileRevision_[(size_t)(y >> TILE_SHIFT) * tilesX_ + (x >> TILE_SHIFT)] = revision_;
+    }
+
+    // grid traversal (Amanatides & Woo) of the segment clipped to the grid.
+    // All visited cells are free except the end cell, which is only cleared
+    // for rays without return (clearEnd).
+    void traverse(double xs, double ys, double xe, double ye, bool clearEnd, uint32_t stamp) {
+        double dx = xe - xs, dy = ye - ys;
+        // clip the parameter range [t0, t1] to the grid (Liang-Barsky)
+        double t0 = 0.0, t1 = 1.0;
+        if (!clip(-dx, xs, t0, t1) || !clip(dx, width_ - xs, t0, t1) ||
+            !clip(-dy, ys, t0, t1) || !clip(dy, height_ - ys, t0, t1)) return;
+
+        double xEnd = std::floor(xe), yEnd = std::floor(ye);
+        int x = std::min(std::max((int)std::floor(xs + t0 * dx), 0), width_ - 1);
+        int y = std::min(std::max((int)std::floor(ys + t0 * dy), 0), height_ - 1);
+        int lastX = std::min(std::max((int)std::floor(xs + t1 * dx), 0), width_ - 1);
+        int lastY = std::min(std::max((int)std::floor(ys + t1 * dy), 0), height_ - 1);
+
+        int stepX = dx > 0 ? 1 : -1, stepY = dy > 0 ? 1 : -1;
+        double deltaX = dx != 0.0 ? std::fabs(1.0 / dx) : HUGE_VAL;
+        double deltaY = dy != 0.0 ? std::fabs(1.0 / dy) : HUGE_VAL;
+        double nextX = dx != 0.0 ? ((dx > 0 ? x + 1 : x) - xs) / dx : HUGE_VAL;
+        double nextY = dy != 0.0 ? ((dy > 0 ? y + 1 : y) - ys) / dy : HUGE_VAL;
+
+        // at most one step per cell boundary between the first and the last cell
+        int steps = std::abs(lastX - x) + std::abs(lastY - y);
+        for (int k = 0; ; k++) {
+            if (clearEnd || x != xEnd || y != yEnd) update(x, y, miss_, stamp);
+            if (k >= steps) break;
+            if (nextX < nextY) {
+                x += stepX;
+                nextX += deltaX;
+            } else {
+                y += stepY;
+                nextY += deltaY;
+            }
+            if (!contains(x, y)) break;
+        }
+    }
+
+    static bool clip(double p, double q, double &t0, double &t1) {
+        if (p == 0.0) return q >= 0.0;
+        double t = q / p;
+        if (p < 0.0) {
+            if (t > t1) return false;
+            t0 = std::max(t0, t);
+        } else {
+            if (t < t0) return false;
+            t1 = std::min(t1, t);
+        }
+        return true;
+    }
+
+    int width_, height_;
+    double scale_, offset_[2];
+    int tilesX_, tilesY_;
+    std::vector<float> logOdds_;      // column-major, y is the row index
+    std::vector<uint32_t> scanStamp_; // (truncated) revision of the last update of each cell
+    std::vector<uint64_t> tileRevision_;
+    uint64_t revision_;
+    float hit_, miss_, min_, max_;
+};
+
+enum OccupancyGridMethod {
+    METHOD_ADD_SCAN,
+    METHOD_IMAGE,
+    METHOD_REVISION
+};
+
+static const mxArray *getField(const mxArray *mxStruct, const char *name) {
+    const mxArray *mxField = mxStruct ? mxGetField(mxStruct, 0, name) : NULL;
+    if (!mxField) throw std::runtime_error(std::string("Parameter '") + name + "' missing");
+    return mxField;
+}
+
+static const double *getMatrixField(const mxArray *mxStruct, const char *name, size_t count) {
+    const mxArray *mxField = getField(mxStruct, name);
+    if (!mxIsDouble(mxField) || mxIsComplex(mxField) || mxGetNumberOfElements(mxField) != count)
+        throw std::runtime_error(std::string("Parameter '") + name + "' must be a real double array with " + std::to_string(count) + " elements");
+    return mxGetPr(mxField);
+}
+
+static double getScalar(const mxArray *mxStruct, const char *name, double defaultValue) {
+    const mxArray *mxField = mxStruct ? mxGetField(mxStruct, 0, name) : NULL;
+    if (!mxField) return defaultValue;
+    if (!(mxIsNumeric(mxField) || mxIsLogical(mxField)) || mxIsComplex(mxField) || mxGetNumberOfElements(mxField) != 1)
+        throw std::runtime_error(std::string("Parameter '") + name + "' must be a real scalar");
+    return mxGetScalar(mxField);
+}
+
+static mxArray *createRange(int first, int last) {
+    mxArray *mxRange = mxCreateDoubleMatrix(1, 2, mxREAL);
+    mxGetPr(mxRange)[0] = first + 1;
+    mxGetPr(mxRange)[1] = last + 1;
+    return mxRange;
+}
+
+class OccupancyGridManager: public mex::object_manager<OccupancyGrid> {
+public:
+    OccupancyGridManager() {
+        setConstructionRequiresArgument(true);
+        addMethod("addScan", METHOD_ADD_SCAN);
+        addMethod("image", METHOD_IMAGE);
+        addMethod("revision", METHOD_REVISION);
+    }
+
+    virtual OccupancyGrid *create(const mxArray *mxOpts) {
+        double scale = getScalar(mxOpts, "scale", 0.0);
+        if (!(scale > 0.0)) throw std::runtime_error("Parameter 'scale' must be a positive scalar");
+        const double *offset = getMatrixField(mxOpts, "offset", 2);
+        const double *extent = getMatrixField(mxOpts, "extent", 2);
+        double width = std::ceil(extent[0] / scale), height = std::ceil(extent[1] / scale);
+        if (!(width >= 1 && height >= 1 && width * height <= 1e9))
+            throw std::runtime_error("Parameter 'extent' must describe a grid of 1 to 1e9 cells");
+
+        std::unique_ptr<OccupancyGrid> grid(new OccupancyGrid((int)width, (int)height, scale, offset));
+        static const double DEFAULT_LIMITS[2] = { -2.0, 3.5 };
+        const double *limits = mxGetField(mxOpts, 0, "logOddsLimits") ? getMatrixField(mxOpts, "logOddsLimits", 2) : DEFAULT_LIMITS;
+        if (!(limits[0] <= 0.0 && limits[1] >= 0.0)) throw std::runtime_error("Parameter 'logOddsLimits' must enclose 0");
+        grid->setLogOdds(getScalar(mxOpts, "logOddsHit", 0.85), getScalar(mxOpts, "logOddsMiss", -0.4), limits[0], limits[1]);
+        return grid.release();
+    }
+
+    virtual OccupancyGrid *clone(const OccupancyGrid &grid) {
+        return new OccupancyGrid(grid);
+    }
+
+    virtual void invoke(OccupancyGrid &grid, int methodId, const mxArray *mxOpts, int nlhs, mxArray *plhs[]) {
+        switch (methodId) {
+        case METHOD_ADD_SCAN: {
+            if (nlhs > 1) throw std::runtime_error("Too many output arguments");
+            const double *pose = getMatrixField(mxOpts, "pose", 3);
+            const mxArray *mxRange = getField(mxOpts, "range");
+            size_t count = mxGetNumberOfElements(mxRange);
+            const double *pRange = getMatrixField(mxOpts, "range", count);
+            const double *pBearing = getMatrixField(mxOpts, "bearing", count);
+            double maxRange = getScalar(mxOpts, "maxRange", 0.0);
+            grid.addScan(pose, count, pRange, pBearing, maxRange);
+            plhs[0] = mxCreateDoubleScalar((double)grid.revision());
+            break;
+        }
+        case METHOD_IMAGE: {
+            if (nlhs > 3) throw std::runtime_error("Too many output arguments");
+            int x0 = 0, x1 = grid.width() - 1, y0 = 0, y1 = grid.height() - 1;
+            double since = getScalar(mxOpts, "since", -1.0);
+            if (since >= 0.0 && !grid.changedRegion((uint64_t)since, x0, x1, y0, y1)) {
+                for (int i = 0; i < std::max(nlhs, 1); i++) plhs[i] = mxCreateDoubleMatrix(0, 0, mxREAL);
+                break;
+            }
+            plhs[0] = mxCreateDoubleMatrix(y1 - y0 + 1, x1 - x0 + 1, mxREAL);
+            grid.copyOccupancy(x0, x1, y0, y1, mxGetPr(plhs[0]));
+            if (nlhs > 1) plhs[1] = createRange(y0, y1);
+            if (nlhs > 2) plhs[2] = createRange(x0, x1);
+            break;
+        }
+        case METHOD_REVISION:
+            if (nlhs > 1) throw std::runtime_error("Too many output arguments");
+            plhs[0] = mxCreateDoubleScalar((double)grid.revision());
+            break;
+        }
+    }
+};
+
+static OccupancyGridManager occupancyGridManager;
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    try {
+        occupancyGridManager.mexFunction(nlhs, plhs, nrhs, prhs);
+    } catch (const std::exception &e) {
+        mexErrMsgIdAndTxt("mex_occupancy_grid:error", "%s", e.what());
+    }
+}
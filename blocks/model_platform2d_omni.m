@@ -9,11 +9,17 @@
 function model = model_platform2d_omni(varargin)   
     model = model_platform2d(@move, 'controller');    
     
+    model.mexFiles{end + 1} = fullfile(fileparts(mfilename('fullpath')), '../sim-core/blocks/mex_integrate_kinematics.cpp');
+    model.default_integration = 'exact';    % 'exact', 'rk4' or 'dopri5' (native, see mex_integrate_kinematics.cpp) or 'ode45'
+    model.default_maxStep = 0.01;           % step size of 'rk4' and 'dopri5' in s
+    
     if nargin >= 1; model.default_initialPose = varargin{1}; end
     
     function [state, out, debugOut] = move(block, t, state, in)
         debugOut = [];
-        [state, out] = continuous_integration(@model_equations, block.initialPose, t, state, in);
+        integrator = struct('method', block.integration, 'maxStep', block.maxStep, ...
+                            'model', struct('model', 'omni'));
+        [state, out] = continuous_integration(@model_equations, block.initialPose, t, state, in, integrator);
     
         function dX = model_equations(~, X, u)
             % Input format:
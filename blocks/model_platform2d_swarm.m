@@ -0,0 +1,106 @@
+% Kinematic model of a swarm of N identical ground robots in a single
+% block. The poses are kept in one 3xN array and all robots are integrated
+% together in one call to mex_integrate_kinematics, instead of one block
+% (and one integration) per robot.
+%
+% model = model_platform2d_swarm(initialPoses)
+% initialPoses: 3xN matrix, one column [x; y; phi] per robot
+%
+% Expected input format:
+% - MxN matrix, one column of inputs per robot (see block.model):
+%   'ddrive': [omega_r; omega_l] wheel rotational rates
+%   'vomega': [v; omega]
+%   'omni':   [vx; vy; omega] body-fixed velocities
+%   Empty inputs stop all robots.
+%
+% Output format:
+% - 3xN matrix of poses, one column [r_x; r_y; phi] per robot
+function model = model_platform2d_swarm(initialPoses)
+    model = block_base(0, 'controller', @move);
+
+    model.log.uniform = true;
+
+    model.mexFiles{end + 1} = fullfile(fileparts(mfilename('fullpath')), '../sim-core/blocks/mex_integrate_kinematics.cpp');
+    model.default_model = 'ddrive';         % 'ddrive', 'vomega' or 'omni'
+    model.default_integration = 'exact';    % 'exact', 'rk4' or 'dopri5' (see mex_integrate_kinematics.cpp)
+    model.default_maxStep = 0.01;           % step size of 'rk4' and 'dopri5' in s
+    model.default_wheelRadius = [0.03 0.03];
+    model.default_wheelDistance = 0.2;
+
+    if nargin >= 1; model.default_initialPoses = initialPoses;
+    else model.default_initialPoses = zeros(3, 1);
+    end
+
+    model.graphicElements(end + 1).draw = @drawBots;
+    model.graphicElements(end).name = 'Robots';
+    model.graphicElements(end + 1).draw = @drawTracks;
+    model.graphicElements(end).name = 'Tracks';
+    model.graphicElements(end).useLogs = true;
+    model.graphicElements(end).hideByDefault = true;
+
+    model.default_color = [0 0 1];
+    model.default_radius = 0.14;
+
+    function [state, out, debugOut] = move(block, t, state, in)
+        debugOut = [];
+        robotCount = size(block.initialPoses, 2);
+        % state is [t X(:)'], t is the time of the last update
+        if isempty(state)
+            state = [t block.initialPoses(:)'];
+        elseif ~isempty(in) && state(1) < t
+            % segment s spans [tBounds(s), tBounds(s + 1)] with input in(s)
+            % (same as continuous_integration)
+            tBounds = [state(1), in(2:end).t, t];
+            segmentCount = find(tBounds(2:end) >= t, 1);
+            tBounds = tBounds(1:segmentCount + 1);
+
+            params = struct('model', block.model, 'method', block.integration, 'maxStep', block.maxStep, ...
+                            'wheelRadius', block.wheelRadius, 'wheelDistance', block.wheelDistance);
+            inputSize = 2;
+            if strcmp(block.model, 'omni'); inputSize = 3; end
+            U = zeros(inputSize, robotCount, segmentCount);
+            for iIn = 1:segmentCount
+                if ~isempty(in(iIn).data); U(:, :, iIn) = in(iIn).data; end
+            end
+            X = mex_integrate_kinematics(reshape(state(2:end), 3, [])', tBounds, permute(U, [3 1 2]), params);
+            state = [tBounds(end) reshape(X', 1, [])];
+        end
+        out = reshape(state(2:end), 3, []);
+    end
+
+    % all robots in a single patch and a single line object
+    function handles = drawBots(block, ax, handles, out, varargin)
+        if isempty(handles)
+            handles.bodies = patch('Parent', ax, 'Faces', [], 'Vertices', [], 'EdgeColor', 0.5 * block.color, 'FaceColor', block.color);
+            handles.directions = line('Parent', ax, 'XData', [], 'YData', [], 'Color', bwContrastColor(block.color), 'LineWidth', 2);
+        end
+
+        robotCount = size(out, 2);
+        angles = linspace(0, 2 * pi, 17);
+        angles = angles(1:(end - 1))';
+        X = bsxfun(@plus, out(1, :), block.radius * cos(angles));
+        Y = bsxfun(@plus, out(2, :), block.radius * sin(angles));
+        set(handles.bodies, 'Vertices', [X(:), Y(:)], 'Faces', reshape(1:numel(X), numel(angles), robotCount)');
+
+        X = [out(1, :); out(1, :) + block.radius * cos(out(3, :)); NaN(1, robotCount)];
+        Y = [out(2, :); out(2, :) + block.radius * sin(out(3, :)); NaN(1, robotCount)];
+        set(handles.directions, 'XData', X(:), 'YData', Y(:));
+    end
+    function handles = drawTracks(block, ax, handles, iteration, times, out, debugOut, states)
+        if isempty(handles)
+            handles = line('Parent', ax, 'XData', [], 'YData', [], 'Color', block.color);
+        end
+        % uniform log: column i holds the poses of iteration i, [x1 y1 phi1 x2 ...]'
+        X = [out(1:3:end, 1:iteration)'; NaN(1, size(out, 1) / 3)];
+        Y = [out(2:3:end, 1:iteration)'; NaN(1, size(out, 1) / 3)];
+        set(handles, 'XData', X(:), 'YData', Y(:));
+    end
+end
+
+function [bw] = bwContrastColor(color)
+	if sum([0.4 0.45 0.15] .* color) <= 0.4,
+		bw = [1 1 1];
+	else
+		bw = [0 0 0];
+	end
+end
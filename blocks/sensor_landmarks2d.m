@@ -1,13 +1,19 @@
 function sensor = sensor_landmarks2d()
     sensor = block_base(1/15, {'environment/landmarks', 'environment/obstacles', 'platform'}, @sample);
     
-    sensor.mexFiles{end + 1} = fullfile(fileparts(mfilename('fullpath')), 'mex_isect_gridmap_rays.cpp');
+    sensor.mexFiles{end + 1} = struct('file', fullfile(fileparts(mfilename('fullpath')), 'mex_isect_gridmap_rays.cpp'), ...
+                                     'dependencies', {fullfile(fileparts(mfilename('fullpath')), '../tools/raycast/include/raycast', ...
+                                                               {'grid_maps.hpp', 'landmark_index.hpp', 'ray_caster.hpp', 'worker_pool.hpp'})});
+    sensor.mexFiles{end + 1} = struct('file', fullfile(fileparts(mfilename('fullpath')), 'mex_landmark_index.cpp'), ...
+                                     'dependencies', {fullfile(fileparts(mfilename('fullpath')), '../tools/raycast/include/raycast', ...
+                                                               {'grid_maps.hpp', 'landmark_index.hpp', 'ray_caster.hpp', 'worker_pool.hpp'})});
     
     sensor.default_range = 3;    
     sensor.default_fieldOfView = [-65, 65] * pi / 180;  % camera field-of-view in rad (relativ to robot a.k.a. camera)
     sensor.default_bearingError = 5 * pi / 180;         % bearing error (1 sigma) in rad;
     sensor.default_rangeError = 1 / 100;				% distance error (1 sigma) in percent        
     sensor.default_color = [0 0 1];
+    sensor.default_useMex = true;                       % query a resident landmark grid and obstacle map (mex_landmark_index.cpp)
     
     sensor.graphicElements(end + 1).draw = @drawFov;
     sensor.graphicElements(end).name = 'fiel-of-view';
@@ -38,33 +44,20 @@ function sensor = sensor_landmarks2d()
     end
 
     function [state, out, debugOut] = sample(block, t, state, landmarks, obstacleMap, platform)
-        state = [];
-        
         pose = platform(end).data;
-        map = obstacleMap(end).data;
-        lmPositions = landmarks(end).data;
-        
-        bearings = atan2(lmPositions(:, 2) - pose(2), lmPositions(:, 1) - pose(1)) - pose(3);
-        bearings = mod(bearings + pi, 2 * pi) - pi;
-        lmIds = [1:size(lmPositions, 1)]';
-        
-        inFovIdx = find((bearings >= block.fieldOfView(1)) & (bearings <= block.fieldOfView(2)));
-        bearings = bearings(inFovIdx);
-        lmIds = lmIds(inFovIdx);
         
-        range = sqrt(sum((lmPositions(inFovIdx, :) - repmat(pose(1:2), size(bearings, 1), 1)).^2, 2));
-        inRangeIdx = find(range < block.range);
-        range = range(inRangeIdx);
-        bearings = bearings(inRangeIdx);
-        lmIds = lmIds(inRangeIdx);
-                
-        % detect visible landmarks       
-        rayStarts = repmat((pose(1:2) - map.offset) / map.scale, size(lmIds, 1), 1);
-        rayEnds = (lmPositions(lmIds, :) - repmat(map.offset, size(lmIds, 1), 1)) / map.scale;
-        visIdx = find(~mex_isect_gridmap_rays(map.obstacles, rayStarts, rayEnds, true));
-        range = range(visIdx);
-        bearings = bearings(visIdx);
-        lmIds = lmIds(visIdx);
+        if block.useMex
+            % (re)create the index for new landmarks or maps, or if it did
+            % not survive (e.g. the experiment was loaded from a file)
+            if isempty(state) || state.landmarksTime ~= landmarks(end).t || state.mapTime ~= obstacleMap(end).t || ...
+               ~state.index.isValid()
+                state = createIndex(block, landmarks(end), obstacleMap(end));
+            end
+            [lmIds, range, bearings] = state.index.invoke('query', 'pose', pose, 'range', block.range, 'fieldOfView', block.fieldOfView);
+        else
+            state = [];
+            [lmIds, range, bearings] = visibleLandmarks(block, pose, landmarks(end).data, obstacleMap(end).data);
+        end
         
         bearings = mod(bearings + block.bearingError * randn(size(bearings)) + pi, 2 * pi) - pi;
         range = range + (block.rangeError * range) .* randn(size(range));
@@ -72,4 +65,51 @@ function sensor = sensor_landmarks2d()
         out = struct('range', range, 'bearing', bearings, 'lmIds', lmIds);
         debugOut = pose;
     end
-end
\ No newline at end of file
+end
+
+% landmark grid and obstacle map kept resident in mex_landmark_index. The
+% index is rebuilt whenever one of the inputs is updated. Occlusion rays use
+% the same traversal as the map without the index: the DDA on the map object
+% of env_gridmap, Bresenham on a plain obstacle matrix.
+function state = createIndex(block, landmarks, obstacleMap)
+    map = obstacleMap.data;
+    if isfield(map, 'id')
+        traversal = 'dda';
+    else
+        traversal = 'bresenham';
+    end
+    state = struct('landmarksTime', landmarks.t, 'mapTime', obstacleMap.t);
+    state.index = mex_object_handle(@mex_landmark_index, 'landmarks', landmarks.data, 'cellSize', block.range, ...
+                                    'obstacles', map.obstacles, 'scale', map.scale, 'offset', map.offset, ...
+                                    'traversal', traversal, 'distanceField', isfield(map, 'id') && map.distanceField);
+end
+
+% test all landmarks for field of view, range and occlusion (without index)
+function [lmIds, range, bearings] = visibleLandmarks(block, pose, lmPositions, map)
+    bearings = atan2(lmPositions(:, 2) - pose(2), lmPositions(:, 1) - pose(1)) - pose(3);
+    bearings = mod(bearings + pi, 2 * pi) - pi;
+    lmIds = [1:size(lmPositions, 1)]';
+    
+    inFovIdx = find((bearings >= block.fieldOfView(1)) & (bearings <= block.fieldOfView(2)));
+    bearings = bearings(inFovIdx);
+    lmIds = lmIds(inFovIdx);
+    
+    range = sqrt(sum((lmPositions(inFovIdx, :) - repmat(pose(1:2), size(bearings, 1), 1)).^2, 2));
+    inRangeIdx = find(range < block.range);
+    range = range(inRangeIdx);
+    bearings = bearings(inRangeIdx);
+    lmIds = lmIds(inRangeIdx);
+            
+    % detect visible landmarks       
+    rayStarts = repmat((pose(1:2) - map.offset) / map.scale, size(lmIds, 1), 1);
+    rayEnds = (lmPositions(lmIds, :) - repmat(map.offset, size(lmIds, 1), 1)) / map.scale;
+    caster = gridmap_raycaster(map);
+    if ~isempty(caster)
+        visIdx = find(~caster.invoke('castRays', 'rayStart', rayStarts, 'rayEnd', rayEnds));
+    else
+        visIdx = find(~mex_isect_gridmap_rays(map.obstacles, rayStarts, rayEnds, true));
+    end
+    range = range(visIdx);
+    bearings = bearings(visIdx);
+    lmIds = lmIds(visIdx);
+end
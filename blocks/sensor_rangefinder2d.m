@@ -1,7 +1,9 @@
 function sensor = sensor_rangefinder2d()
     sensor = block_base(1/10, {'environment/obstacles', 'platform'}, @sample);
 
-    sensor.mexFiles{end + 1} = fullfile(fileparts(mfilename('fullpath')), 'mex_isect_gridmap_rays.cpp');
+    sensor.mexFiles{end + 1} = struct('file', fullfile(fileparts(mfilename('fullpath')), 'mex_isect_gridmap_rays.cpp'), ...
+                                     'dependencies', {fullfile(fileparts(mfilename('fullpath')), '../tools/raycast/include/raycast', ...
+                                                               {'grid_maps.hpp', 'landmark_index.hpp', 'ray_caster.hpp', 'worker_pool.hpp'})});
     
     sensor.default_color = [0 0 1];
 	sensor.default_fieldOfView = [-90, 90] * pi / 180; % [rad], relative to robot orientation
@@ -41,17 +43,23 @@ function sensor = sensor_rangefinder2d()
         debugOut = [];
 
 		if ~isempty(platform) && ~isempty(obstacleMap)
-            bearing = (block.fieldOfView(1):block.increment:block.fieldOfView(2))';
-			arcs = mod(bearing + platform(end).data(3) + pi, 2 * pi) - pi;
+            pose = platform(end).data;
             map = obstacleMap(end).data;
-            rayStart = repmat((platform(end).data(1:2) - map.offset) / map.scale, length(arcs), 1);
-            rayEnd = rayStart + (block.maxRange / map.scale) * [cos(arcs), sin(arcs)];
-            [isect, range] = mex_isect_gridmap_rays(map.obstacles, rayStart, rayEnd, true);
-            range(~isect) = inf;
-            range = range * map.scale;
-        
-            % apply distance-dependent gaussian noise
-            range(isect) = range(isect) + block.error * (range(isect) .* randn(sum(isect), 1));
+            % rays are generated, cast and perturbed by distance-dependent 
+            % gaussian noise natively (the seed is taken from Matlab's
+            % random number generator to keep experiments reproducible)
+            scan = struct('fieldOfView', block.fieldOfView, 'increment', block.increment, ...
+                          'maxRange', block.maxRange, 'error', block.error, 'seed', randi(2^31 - 1));
+            caster = gridmap_raycaster(map);
+            if ~isempty(caster)
+                scan.poses = [pose(1), pose(2), pose(3)];
+                [range, bearing] = caster.invoke('castScan', scan);
+            else
+                scan.scale = map.scale;
+                scan.offset = map.offset;
+                [range, bearing] = mex_isect_gridmap_rays(map.obstacles, [pose(1), pose(2), pose(3)], scan, true);
+            end
+            range = range';
         else
             bearing = [];
             range = [];
@@ -0,0 +1,74 @@
+% Laser rangefinder mounted on every robot of a swarm (see
+% model_platform2d_swarm). All scans of one sample are cast in a single
+% native call, the robots themselves are added to the map as discs of
+% radius block.radius, so they see each other as (moving) obstacles.
+%
+% Output format:
+% - RxN matrix of ranges, one column per robot (R...number of rays, see
+%   block.fieldOfView and block.increment). The bearing of ray i is
+%   block.fieldOfView(1) + (i - 1) * block.increment.
+function sensor = sensor_rangefinder2d_swarm()
+    sensor = block_base(1/10, {'environment/obstacles', 'platform'}, @sample);
+
+    sensor.log.uniform = true;
+
+    sensor.mexFiles{end + 1} = struct('file', fullfile(fileparts(mfilename('fullpath')), 'mex_isect_gridmap_rays.cpp'), ...
+                                     'dependencies', {fullfile(fileparts(mfilename('fullpath')), '../tools/raycast/include/raycast', ...
+                                                               {'grid_maps.hpp', 'landmark_index.hpp', 'ray_caster.hpp', 'worker_pool.hpp'})});
+
+    sensor.default_color = [0 0 1];
+    sensor.default_fieldOfView = [-90, 90] * pi / 180; % [rad], relative to robot orientation
+    sensor.default_increment = 1 * pi / 180;           % angular difference between adjacent rays in rad
+    sensor.default_maxRange = 4.5;                     % maximum detection distance in m
+    sensor.default_error = 0.5 / 100;                  % stddev of range error, error scales with distance
+    sensor.default_radius = 0.14;                      % robot radius in m (obstacle size seen by the other robots)
+
+    sensor.graphicElements(end + 1).draw = @drawHits;
+    sensor.graphicElements(end).name = 'Hits';
+
+    % one dot per ray that hit something, for all robots in a single line
+    % object (drawing the rays themselves does not scale to large swarms)
+    function handles = drawHits(block, ax, handles, out, debugOut, state, obstacles, platform)
+        if isempty(handles)
+            handles = line('Parent', ax, 'XData', [], 'YData', [], 'Color', block.color, 'LineStyle', 'none', 'Marker', '.');
+        end
+
+        if ~isempty(platform) && ~isempty(out)
+            poses = platform.data;
+            bearing = (block.fieldOfView(1):block.increment:block.fieldOfView(2))';
+            angles = bsxfun(@plus, bearing, poses(3, :));
+            hit = ~isinf(out);
+            X = bsxfun(@plus, poses(1, :), out .* cos(angles));
+            Y = bsxfun(@plus, poses(2, :), out .* sin(angles));
+            set(handles, 'XData', X(hit), 'YData', Y(hit));
+        end
+    end
+
+    function [state, out, debugOut] = sample(block, t, state, obstacleMap, platform)
+        state = [];
+        debugOut = [];
+
+        if ~isempty(platform) && ~isempty(obstacleMap)
+            poses = platform(end).data;
+            map = obstacleMap(end).data;
+            % every robot is a disc, its own disc is skipped by its scan
+            % (ownDiscs); the seed is taken from Matlab's random number
+            % generator to keep experiments reproducible
+            scan = struct('fieldOfView', block.fieldOfView, 'increment', block.increment, ...
+                          'maxRange', block.maxRange, 'error', block.error, 'seed', randi(2^31 - 1), ...
+                          'discs', [poses(1:2, :)', repmat(block.radius, size(poses, 2), 1)], 'ownDiscs', true);
+            caster = gridmap_raycaster(map);
+            if ~isempty(caster)
+                scan.poses = poses';
+                range = caster.invoke('castScan', scan);
+            else
+                scan.scale = map.scale;
+                scan.offset = map.offset;
+                range = mex_isect_gridmap_rays(map.obstacles, poses', scan, true);
+            end
+            out = range';
+        else
+            out = [];
+        end
+    end
+end
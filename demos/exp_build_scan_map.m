@@ -17,7 +17,9 @@ function exp = exp_build_scan_map(varargin)
                   2.00, 1.50;...
                   2.00, 0.50];
   
-    exp.robot.scanMap = map_scans2d();
+    exp.robot.scanMap = map_occupancy2d();
+    exp.robot.scanMap.scale = 0.02;
+    exp.robot.scanMap.extent = [8 6];
     
     exp.robot.platform = model_platform2d_on_path(pathPoints);
     exp.robot.sensors.rangefinder = sensor_rangefinder2d();
@@ -0,0 +1,45 @@
+function exp = exp_dwa2d_native() 
+    exp = experiment_base('dwa2d_native');
+        
+    % office round trip of the DWA exercise
+    pathPoints = [1.00,   0.50;...
+                  1.00, 4.10;...
+                  2.60, 4.30;...
+                  2.60, 2.70;...
+                  5.50, 2.70;... 
+                  6.00, 5.10;...
+                  7.00, 5.10;...
+                  6.00, 5.10;...
+                  6.00, 3.30;...
+                  7.50, 2.70;...
+                  7.50, 0.75;...
+                  5.00, 1.50;...
+                  2.00, 1.50;...
+                  2.00, 0.50];
+    exp.robot.initialPose = [pathPoints(1, :), 90 * pi / 180];    
+    
+    exp.robot.path = const_points(pathPoints);
+    exp.robot.path.format = {'Color', [0 0 1], 'Marker', 'x'};
+
+    exp.environment = grp_obstacles_and_landmarks_from_image('../maps/office.png', 'scale', 0.01);        
+
+    exp.robot.platform = model_platform2d_vomega();
+    exp.robot.radius = 0.14;
+    exp.robot.color = [0 0 1];
+        
+    exp.robot.sensors.rangefinder = sensor_rangefinder2d();
+    exp.robot.sensors.rangefinder.maxRange = 3;                                                                   
+    exp.robot.sensors.rangefinder.fieldOfView = [-90, 90] * pi / 180;
+    exp.robot.sensors.rangefinder.color = [0.7 0 0];
+    exp.robot.sensors.rangefinder.timing.deltaT = 1 / 10;
+    
+    % native DWA; set useMex = false for the Matlab reference
+    exp.robot.controller = guidance_dwa2d_native();
+    
+    exp.robot.targetProvider = guidance_waypoints();        
+    exp.robot.targetProvider.relative = true;
+    exp.robot.controller.depends{2} = 'targetProvider';    
+    
+    exp.display.title = 'Dynamic Window Approach (DWA), native candidates';        
+    exp.display.settings = {'XGrid', 'on', 'YGrid', 'on', 'Layer', 'top', 'XLim', [0 8], 'YLim', [0 6]};
+end
@@ -0,0 +1,55 @@
+% Experiment setup for Monte Carlo localization (particle filter) of a
+% Differential Drive Mobile Robot with a laser rangefinder in the office
+% map. Without an initial pose, the filter starts with particles spread
+% over the whole map (global localization).
+function exp = exp_mcl_ddrive()
+    exp = experiment_base('ddrive_mcl');
+
+    % Some configuration options for the experiment
+    useGlobalLocalization = true;
+
+    exp.environment = grp_obstacles_and_landmarks_from_image('../maps/office.png', 'scale', 0.01);
+    pathPoints = [1.00, 0.50; ...
+                  1.00, 4.30; ...
+                  2.60, 4.30; ...
+                  2.60, 2.70; ...
+                  6.00, 2.70; ...
+                  6.00, 5.10; ...
+                  7.00, 5.10; ...
+                  6.00, 5.10; ...
+                  6.00, 3.30; ...
+                  7.50, 2.70; ...
+                  7.50, 0.75; ...
+                  5.00, 1.50; ...
+                  2.00, 1.50; ...
+                  2.00, 0.50];
+
+    % instantiate the platform (differential drive) and set its parameters
+    exp.robot.platform = model_platform2d_ddrive([pathPoints(1, :), 90 * pi / 180]);
+    exp.robot.radius = 0.14;
+    exp.robot.color = [0 0 1];
+    exp.robot.wheelRadius = [0.03 0.03];
+    exp.robot.wheelDistance = 0.25;
+
+    % the controller follows the path using the true pose
+    exp.robot.controller = controller_ddrive_follow_path(pathPoints);
+
+    % add the sensors
+    exp.robot.sensors.odometer = sensor_odometer_wheelspeed();
+    exp.robot.odometryError = 5 * pi / 180;
+
+    exp.robot.sensors.rangefinder = sensor_rangefinder2d();
+    exp.robot.maxRange = 4.5;
+
+    % ...and finally the localization filter
+    exp.robot.localization = filter_ddrive_mcl();
+    exp.robot.localization.color = [1 0 0];
+    if ~useGlobalLocalization
+        exp.robot.localization.initialPose = [pathPoints(1, :), 90 * pi / 180];
+    end
+
+    exp.depends = {'*localization'};
+
+    exp.display.title = 'Differential Drive with Monte Carlo localization based on dead reckoning and a laser rangefinder';
+    exp.display.settings = {'XGrid', 'on', 'YGrid', 'on', 'Layer', 'top', 'XLim', [0 8], 'YLim', [0 6]};
+end
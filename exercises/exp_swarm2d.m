@@ -0,0 +1,49 @@
+% Test Environment for a swarm of differential drive robots, which avoid
+% the walls and each other based on their rangefinder scans.
+% The chain of relevant blocks is
+%
+%    platform -> sensor -> controller -> platform
+%
+% All robots are simulated by a single block each, so the simulation time
+% grows with the number of robots, but not the number of blocks.
+%
+% exp = exp_swarm2d([robotCount])
+% robotCount: number of robots (default: 50)
+function exp = exp_swarm2d(robotCount)
+    if nargin < 1; robotCount = 50; end
+
+    % Instantiate an empty experiment
+    exp = experiment_base('swarm2d');
+
+    % Add an environment map
+    exp.environment = grp_obstacles_and_landmarks_from_image('../maps/emptyroom.png', 'scale', 0.01);
+
+    % Place the robots on a grid in the free part of the room with random
+    % orientations
+    columns = ceil(sqrt(robotCount * 2));
+    rows = ceil(robotCount / columns);
+    [X, Y] = meshgrid(linspace(1, 7, columns), linspace(1.5, 4.5, rows));
+    poses = [X(1:robotCount); Y(1:robotCount); 2 * pi * rand(1, robotCount)];
+
+    exp.swarm.platform = model_platform2d_swarm(poses);
+    exp.swarm.sensor = sensor_rangefinder2d_swarm();
+    exp.swarm.sensor.fieldOfView = [-90, 90] * pi / 180;
+    exp.swarm.sensor.increment = 5 * pi / 180;
+    exp.swarm.sensor.maxRange = 2;
+    exp.swarm.controller = controller_swarm2d_avoid();
+    exp.swarm.controller.fieldOfView = exp.swarm.sensor.fieldOfView;
+    exp.swarm.controller.maxRange = exp.swarm.sensor.maxRange;
+
+    % parameters shared by all swarm blocks
+    exp.swarm.radius = 0.14;
+    exp.swarm.color = [0 0 1];
+    exp.swarm.wheelRadius = 0.03;
+    exp.swarm.wheelDistance = 0.25;
+
+    % The controller (discrete) depends on the sensor, which depends on the
+    % platform, so this keeps the whole swarm from being optimized away
+    exp.depends = {'*controller', '*environment*'};
+
+    % Some parameters that influence the appereance of the display area
+    exp.display.settings = {'XGrid', 'on', 'YGrid', 'on', 'Layer', 'top', 'XLim', [0 8], 'YLim', [0 6]};
+end
@@ -0,0 +1,61 @@
+% TUD/IfA, Course "Mobile Robotic" - Practical Project
+%
+% Compare the native sensor data reader (readSensorData) with importdata
+% (importSensorData). Both results are checked for equality.
+%
+% Parameters:
+% - file (optional): sensor_data/*.dat file to read. If omitted, a
+%                    synthetic accelerometer recording with the given
+%                    number of samples is written to a temporary file
+% - samples (optional): number of synthetic samples (default: 1e6)
+% Return values:
+% - timing: struct with the times in s of
+%   .importdata - importdata of the whole file
+%   .native - readSensorData of the whole file
+%   .nativeWindow - readSensorData of the middle 10% of the time span
+%
+function timing = benchmarkSensorDataImport(file, samples)
+    if nargin < 2; samples = 1e6; end
+    removeFile = nargin < 1 || isempty(file);
+    if removeFile
+        file = [tempname() '.dat'];
+        fid = fopen(file, 'w');
+        t = (1:samples) * 1e7; % 100 Hz in ns
+        fprintf(fid, '%d\t%d\t%f\t%f\t%f\t0.0\t0.0\t0.0\n', [1:samples; t; randn(3, samples)]);
+        fclose(fid);
+    end
+    info = dir(file);
+    fprintf('Reading %s (%.1f MB)\n', file, info.bytes / 2^20);
+
+    readSensorData(file, [0 0]); % compile and warm up
+
+    tic;
+    reference = importdata(file);
+    timing.importdata = toc;
+
+    tic;
+    data = readSensorData(file);
+    timing.native = toc;
+
+    span = data.timestamp([1 end]) * 1e-9;
+    window = span(1) + diff(span) * [0.45 0.55];
+    tic;
+    windowData = readSensorData(file, window);
+    timing.nativeWindow = toc;
+
+    if removeFile
+        delete(file);
+    end
+
+    if ~isequal(reference(:, 1:5)', [data.ID; data.timestamp; data.value])
+        error('benchmarkSensorDataImport:mismatch', 'Native reader and importdata disagree');
+    end
+    inWindow = reference(:, 2) * 1e-9 >= window(1) & reference(:, 2) * 1e-9 <= window(2);
+    if ~isequal(reference(inWindow, 2)', windowData.timestamp)
+        error('benchmarkSensorDataImport:mismatch', 'Native reader returned a wrong time window');
+    end
+
+    fprintf('importdata:          %8.3f s\n', timing.importdata);
+    fprintf('native:              %8.3f s (%.1fx)\n', timing.native, timing.importdata / timing.native);
+    fprintf('native, 10%% window:  %8.3f s\n', timing.nativeWindow);
+end
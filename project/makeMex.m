@@ -0,0 +1,17 @@
+% TUD/IfA, Course "Mobile Robotic" - Practical Project
+%
+% Compile a mex file of the project directory if it is missing or out of
+% date (with mex_make of the simulator, if it is on the path).
+%
+% Parameters:
+% - source: file name of the C++ source, e.g. 'mex_read_sensor_data.cpp'
+%
+function makeMex(source)
+    source = fullfile(fileparts(mfilename('fullpath')), source);
+    [~, name] = fileparts(source);
+    if exist('mex_make', 'file')
+        mex_make(source);
+    elseif exist(name, 'file') ~= 3
+        mex('-outdir', fileparts(source), source);
+    end
+end
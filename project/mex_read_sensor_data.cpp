@@ -0,0 +1,326 @@
+//$ mex mex_read_sensor_data.cpp # Maltab command for generating the MEX file
+/*******************************************************
+ * Streaming reader for the *.dat recordings in sensor_data
+ * (accelerometer_data.dat, gyroscope_data.dat, gps_data.dat).
+ * Each line holds one record of whitespace separated numbers:
+ *   ID  timestamp[ns]  x  y  z  sigma_x  sigma_y  sigma_z
+ * (for GPS: latitude, longitude, height and the accuracy in the last
+ * column). Missing columns are returned as NaN, lines that do not start
+ * with a number (e.g. headers) are skipped.
+ *
+ * data = mex_read_sensor_data(file[, options])
+ * Outputs:
+ * - data: struct with fields
+ *   .ID - 1xN record IDs
+ *   .timestamp - 1xN timestamps in ns
+ *   .value - 3xN measurements
+ *   .sigma - 3xN standard deviations
+ * Inputs:
+ * - file: path of the .dat file
+ * - options: (optional) struct with fields
+ *   .timeWindow - [first, last] timestamp in s. Only records with
+ *                 first <= timestamp * 1e-9 <= last are returned.
+ *   .decimation - return only every k-th record (of the time window)
+ *
+ * The file is read in chunks of 4 MB, so memory only depends on the number
+ * of returned records. Timestamps are expected to be non-decreasing (as
+ * recorded): the start of the time window is then found by a binary search
+ * on the file offset and reading stops at its end, so a window costs time
+ * proportional to its own size rather than to the size of the file. If
+ * the timestamps turn out to decrease within the window, the whole file is
+ * scanned instead.
+ */
+
+#include "mex.h"
+#include "matrix.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define INDEX_IN_FILE       0
+#define IN_REQ_COUNT        1
+#define INDEX_IN_OPTIONS    1
+#define IN_MAX_COUNT        2
+
+#define COLUMN_COUNT        8
+#define CHUNK_SIZE          (4 << 20)
+#define SEARCH_MIN_RANGE    (64 << 10) // below this, the window start is searched linearly
+
+#if defined(_WIN32)
+#define fseek64 _fseeki64
+#define ftell64 _ftelli64
+#else
+#define fseek64 fseeko
+#define ftell64 ftello
+#endif
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == ',';
+}
+
+// Parse a decimal floating point number. Numbers with up to 19 significant
+// digits and a decimal exponent of at most 22 are converted exactly
+// (Clinger's fast path: both the mantissa and the power of ten are exact
+// doubles, so the single multiplication or division is correctly rounded).
+// Everything else, including inf and nan, is passed to strtod.
+static bool parseNumber(const char *&p, const char *end, double &value) {
+    static const double POW10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    while (p < end && isSpace(*p)) p++;
+    const char *start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+    // leading zeros do not count as significant digits, more than 19
+    // digits overflow the mantissa and take the slow path
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    const char *digitsStart = p;
+    while (p < end && *p == '0') p++;
+    const char *significand = p;
+    while (p < end && *p >= '0' && *p <= '9') mantissa = mantissa * 10 + (*p++ - '0');
+    digits = (int)(p - significand);
+    bool anyDigit = p != digitsStart;
+    if (p < end && *p == '.') {
+        const char *fraction = ++p;
+        if (mantissa == 0) {
+            while (p < end && *p == '0') p++;
+        }
+        const char *fractionDigits = p;
+        while (p < end && *p >= '0' && *p <= '9') mantissa = mantissa * 10 + (*p++ - '0');
+        digits += (int)(p - fractionDigits);
+        exponent -= (int)(p - fraction);
+        anyDigit = anyDigit || p != fraction;
+    }
+    bool simple = anyDigit && digits <= 19;
+    if (anyDigit && p < end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        bool negativeExponent = false;
+        if (q < end && (*q == '-' || *q == '+')) negativeExponent = *q++ == '-';
+        if (q < end && *q >= '0' && *q <= '9') {
+            int e = 0;
+            while (q < end && *q >= '0' && *q <= '9') {
+                if (e < 100000) e = e * 10 + (*q - '0');
+                q++;
+            }
+            exponent += negativeExponent ? -e : e;
+            p = q;
+        }
+    }
+    if (simple && (p == end || isSpace(*p) || *p == '\n') && mantissa < ((uint64_t)1 << 53) && exponent >= -22 && exponent <= 22) {
+        value = exponent >= 0 ? (double)mantissa * POW10[exponent] : (double)mantissa / POW10[-exponent];
+        if (negative) value = -value;
+        return true;
+    }
+
+    // slow path on a NUL-terminated copy of the token
+    p = start;
+    char token[64];
+    size_t length = 0;
+    while (p < end && !isSpace(*p) && *p != '\n' && length < sizeof(token) - 1) token[length++] = *p++;
+    token[length] = 0;
+    char *tokenEnd;
+    value = strtod(token, &tokenEnd);
+    if (length == 0 || tokenEnd != token + length || (p < end && !isSpace(*p) && *p != '\n')) {
+        p = start;
+        return false;
+    }
+    return true;
+}
+
+struct ReadOptions {
+    double first, last; // time window in ns
+    size_t decimation;
+};
+
+class SensorDataReader {
+public:
+    explicit SensorDataReader(const char *path): file_(fopen(path, "rb")), size_(0) {
+        if (!file_) mexErrMsgIdAndTxt("mex_read_sensor_data:open", "Could not open \"%s\"", path);
+        fseek64(file_, 0, SEEK_END);
+        size_ = (int64_t)ftell64(file_);
+    }
+
+    ~SensorDataReader() {
+        if (file_) fclose(file_);
+    }
+
+    // read the records of the time window, returns false if timestamps
+    // decrease (only checked if stopAtEnd is set)
+    bool read(int64_t offset, const ReadOptions &options, bool stopAtEnd) {
+        clear();
+        std::vector<char> buffer(CHUNK_SIZE);
+        size_t filled = 0, inWindow = 0;
+        double previous = -HUGE_VAL;
+        fseek64(file_, offset, SEEK_SET);
+        for (bool eof = false; !eof; ) {
+            filled += fread(&buffer[filled], 1, buffer.size() - filled, file_);
+            eof = filled < buffer.size();
+            const char *p = &buffer[0], *end = p + filled;
+            while (p < end) {
+                const char *lineEnd = (const char *)memchr(p, '\n', end - p);
+                if (!lineEnd) {
+                    if (!eof) break;
+                    lineEnd = end;
+                }
+                double id, timestamp;
+                const char *q = p;
+                if (parseNumber(q, lineEnd, id) && parseNumber(q, lineEnd, timestamp)) {
+                    if (stopAtEnd) {
+                        if (timestamp < previous) return false;
+                        if (timestamp > options.last) return true;
+                    }
+                    previous = timestamp;
+                    if (timestamp >= options.first && timestamp <= options.last && inWindow++ % options.decimation == 0) {
+                        double fields[COLUMN_COUNT - 2];
+                        for (int i = 0; i < COLUMN_COUNT - 2; i++) {
+                            if (!parseNumber(q, lineEnd, fields[i])) fields[i] = mxGetNaN();
+                        }
+                        ids_.push_back(id);
+                        timestamps_.push_back(timestamp);
+                        values_.insert(values_.end(), fields, fields + 3);
+                        sigmas_.insert(sigmas_.end(), fields + 3, fields + 6);
+                    }
+                }
+                p = lineEnd + 1;
+            }
+            // keep the incomplete last line, grow the buffer for very long lines
+            size_t rest = p < end ? end - p : 0;
+            memmove(&buffer[0], p, rest);
+            filled = rest;
+            if (filled == buffer.size()) buffer.resize(2 * buffer.size());
+        }
+        return true;
+    }
+
+    // offset of a line at or before the first record with a timestamp >=
+    // first, assuming non-decreasing timestamps
+    int64_t findWindowStart(double first) {
+        int64_t lo = 0, hi = size_;
+        while (hi - lo > SEARCH_MIN_RANGE) {
+            int64_t mid = lo + (hi - lo) / 2;
+            int64_t lineStart;
+            double timestamp;
+            if (!nextRecord(mid, hi, lineStart, timestamp)) break;
+            if (timestamp < first) lo = lineStart;
+            else hi = lineStart;
+        }
+        return lo;
+    }
+
+    void reserve(size_t count) {
+        ids_.reserve(count);
+        timestamps_.reserve(count);
+        values_.reserve(3 * count);
+        sigmas_.reserve(3 * count);
+    }
+
+    // estimated number of records in [from, to) from the length of the first lines
+    size_t estimateRecords(int64_t from, int64_t to) {
+        char sample[4096];
+        fseek64(file_, from, SEEK_SET);
+        size_t length = fread(sample, 1, sizeof(sample), file_);
+        size_t lines = std::count(sample, sample + length, '\n');
+        if (lines == 0) return 1;
+        return (size_t)((double)(to - from) * lines / length) + 1;
+    }
+
+    int64_t size() const { return size_; }
+
+    mxArray *createStruct() const {
+        static const char *FIELDS[] = { "ID", "timestamp", "value", "sigma" };
+        mxArray *mxData = mxCreateStructMatrix(1, 1, 4, FIELDS);
+        size_t count = ids_.size();
+        mxSetField(mxData, 0, "ID", createMatrix(1, count, ids_));
+        mxSetField(mxData, 0, "timestamp", createMatrix(1, count, timestamps_));
+        mxSetField(mxData, 0, "value", createMatrix(3, count, values_));
+        mxSetField(mxData, 0, "sigma", createMatrix(3, count, sigmas_));
+        return mxData;
+    }
+
+private:
+    void clear() {
+        ids_.clear();
+        timestamps_.clear();
+        values_.clear();
+        sigmas_.clear();
+    }
+
+    // first record starting after offset (and before limit)
+    bool nextRecord(int64_t offset, int64_t limit, int64_t &lineStart, double &timestamp) {
+        char line[512];
+        while (offset < limit) {
+            fseek64(file_, offset, SEEK_SET);
+            size_t length = fread(line, 1, sizeof(line), file_);
+            const char *newline = (const char *)memchr(line, '\n', length);
+            if (!newline) return false;
+            lineStart = offset + (newline - line) + 1;
+            if (lineStart >= limit) return false;
+            const char *p = newline + 1, *end = line + length;
+            const char *lineEnd = (const char *)memchr(p, '\n', end - p);
+            double id;
+            if (lineEnd && parseNumber(p, lineEnd, id) && parseNumber(p, lineEnd, timestamp)) return true;
+            offset = lineStart; // not a record, try the next line
+        }
+        return false;
+    }
+
+    static mxArray *createMatrix(size_t m, size_t n, const std::vector<double> &data) {
+        mxArray *mxMatrix = mxCreateDoubleMatrix(m, n, mxREAL);
+        if (!data.empty()) std::copy(data.begin(), data.end(), mxGetPr(mxMatrix));
+        return mxMatrix;
+    }
+
+    FILE *file_;
+    int64_t size_;
+    std::vector<double> ids_, timestamps_, values_, sigmas_;
+};
+
+static ReadOptions getOptions(const mxArray *mxOptions) {
+    ReadOptions options = { -HUGE_VAL, HUGE_VAL, 1 };
+    if (!mxOptions) return options;
+    if (!mxIsStruct(mxOptions) || mxGetNumberOfElements(mxOptions) != 1)
+        mexErrMsgTxt("Input argument 'options' must be a scalar struct");
+
+    const mxArray *mxWindow = mxGetField(mxOptions, 0, "timeWindow");
+    if (mxWindow && !mxIsEmpty(mxWindow)) {
+        if (!mxIsDouble(mxWindow) || mxIsComplex(mxWindow) || mxGetNumberOfElements(mxWindow) != 2)
+            mexErrMsgTxt("Option 'timeWindow' must be a two-element double vector");
+        options.first = mxGetPr(mxWindow)[0] * 1e9;
+        options.last = mxGetPr(mxWindow)[1] * 1e9;
+    }
+    const mxArray *mxDecimation = mxGetField(mxOptions, 0, "decimation");
+    if (mxDecimation) {
+        if (!mxIsNumeric(mxDecimation) || mxIsComplex(mxDecimation) || mxGetNumberOfElements(mxDecimation) != 1 ||
+            !(mxGetScalar(mxDecimation) >= 1))
+            mexErrMsgTxt("Option 'decimation' must be a positive integer");
+        options.decimation = (size_t)mxGetScalar(mxDecimation);
+    }
+    return options;
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    if (nrhs < IN_REQ_COUNT) mexErrMsgTxt("Too few input arguments");
+    if (nrhs > IN_MAX_COUNT) mexErrMsgTxt("Too many input arguments");
+    if (nlhs > 1) mexErrMsgTxt("Too many output arguments");
+
+    char path[4096];
+    if (!mxIsChar(prhs[INDEX_IN_FILE]) || mxGetString(prhs[INDEX_IN_FILE], path, sizeof(path)) != 0)
+        mexErrMsgTxt("Input argument 'file' must be a string");
+    ReadOptions options = getOptions(nrhs > INDEX_IN_OPTIONS ? prhs[INDEX_IN_OPTIONS] : NULL);
+
+    SensorDataReader reader(path);
+    bool windowed = options.first > -HUGE_VAL || options.last < HUGE_VAL;
+    int64_t start = options.first > -HUGE_VAL ? reader.findWindowStart(options.first) : 0;
+    reader.reserve(reader.estimateRecords(start, reader.size()) / options.decimation + 1);
+    if (!reader.read(start, options, windowed)) {
+        // timestamps out of order: the binary search and the early stop are invalid
+        reader.read(0, options, false);
+    }
+    plhs[0] = reader.createStruct();
+}
@@ -25,6 +25,8 @@ function project(varargin)
     end
     if ~isfield(options, 'disableBiasCompensation'); options.disableBiasCompensation = false; end
     if ~isfield(options, 'savePdfs'); options.savePdfs = false; end
+    if ~isfield(options, 'timeWindow'); options.timeWindow = []; end    % [first, last] sample time in s, [] = all
+    if ~isfield(options, 'decimation'); options.decimation = 1; end     % use every k-th sample only
     
     hFigures = [];        
     
@@ -36,12 +38,12 @@ function project(varargin)
     dataPath = fullfile(expPath, 'sensor_data');
     accDataFile = fullfile(dataPath, 'accelerometer_data.dat');
     if exist(accDataFile, 'file')
-        accelerometer_data = importSensorData(accDataFile);
+        accelerometer_data = readSensorData(accDataFile, options.timeWindow, options.decimation);
         
-        a.samples    = size(accelerometer_data,1);
-        a.ID         = (accelerometer_data(:,1))';
-        a.time       = (accelerometer_data(:,2))'.*10^(-9);
-        a.value      = (accelerometer_data(:,3:5))';
+        a.samples    = numel(accelerometer_data.ID);
+        a.ID         = accelerometer_data.ID;
+        a.time       = accelerometer_data.timestamp.*10^(-9);
+        a.value      = accelerometer_data.value;
         
         a.name       = 'Measured Body Acceleration';
         a.axis1      = '${}^{\rm{B}}\tilde{a}_{\rm{IB},x}$ / $\frac{\rm{m}}{\rm{s}^2}$';
@@ -53,12 +55,12 @@ function project(varargin)
     end
     gyroDataFile = fullfile(dataPath, 'gyroscope_data.dat');
     if exist(gyroDataFile, 'file')
-        gyroscope_data = importSensorData(gyroDataFile);
+        gyroscope_data = readSensorData(gyroDataFile, options.timeWindow, options.decimation);
 
-        w.samples    = size(gyroscope_data,1);
-        w.ID         = (gyroscope_data(:,1))';
-        w.time       = (gyroscope_data(:,2))'.*10^(-9);
-        w.value      = (gyroscope_data(:,3:5))';            
+        w.samples    = numel(gyroscope_data.ID);
+        w.ID         = gyroscope_data.ID;
+        w.time       = gyroscope_data.timestamp.*10^(-9);
+        w.value      = gyroscope_data.value;            
         
         w.name       = 'Measured Body Angular Rate';
         w.axis1      = '${}^{\rm{B}}\tilde{\omega}_{\rm{IB},x}$ / $\frac{\rm{rad}}{\rm{s}}$';
@@ -70,12 +72,12 @@ function project(varargin)
     end
     gpsDataFile = fullfile(dataPath, 'gps_data.dat');
     if exist(gpsDataFile, 'file')
-        gps_data = importSensorData(gpsDataFile);
+        gps_data = readSensorData(gpsDataFile, options.timeWindow, options.decimation);
         
-        r.WGS.samples    = size(gps_data,1);
-        r.WGS.ID         = (gps_data(:,1))';
-        r.WGS.time       = (gps_data(:,2))'.*10^(-9);
-        r.WGS.value      = (gps_data(:,3:5))';
+        r.WGS.samples    = numel(gps_data.ID);
+        r.WGS.ID         = gps_data.ID;
+        r.WGS.time       = gps_data.timestamp.*10^(-9);
+        r.WGS.value      = gps_data.value;
         
         r.WGS.name       = 'Measured Body Position (Geodetic)';
         r.WGS.axis1      = '$\tilde{\phi}_{\rm{B}}$ / ${}^{\circ}$';
@@ -95,9 +97,9 @@ function project(varargin)
             r.ECEF.value(:,i) = WGSpos2ECEFpos(r.WGS.value(:,i));
 
             r.N.value(:,i)    = (Quat2DCM(r.N.ECEFrot))' * (r.ECEF.value(:,i) - r.N.ECEFpos);
-            r.N.sigma(1,i)    =   gps_data(i,8);
-            r.N.sigma(2,i)    =   gps_data(i,8);
-            r.N.sigma(3,i)    = 2*gps_data(i,8);
+            r.N.sigma(1,i)    =   gps_data.sigma(3,i);
+            r.N.sigma(2,i)    =   gps_data.sigma(3,i);
+            r.N.sigma(3,i)    = 2*gps_data.sigma(3,i);
             r.N.name          = 'Measured Body Position (in Navigation Frame)';
         end        
         
@@ -166,8 +168,8 @@ function project(varargin)
             addInstanceFigures(plotErrors(applyDisplaySettings(w)));
         end
         if ~isempty(gps_data);
-            r.WGS.mean = repmat(mean(gps_data(:, 3:5))', 1, r.WGS.samples);            
-            r.WGS.sigma = repmat(std(gps_data(:, 3:5))', 1, r.WGS.samples);
+            r.WGS.mean = repmat(mean(gps_data.value, 2), 1, r.WGS.samples);            
+            r.WGS.sigma = repmat(std(gps_data.value, 0, 2), 1, r.WGS.samples);
             addInstanceFigures(plotErrors(applyDisplaySettings(r.WGS)));
         end
     end
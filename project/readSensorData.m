@@ -0,0 +1,29 @@
+% TUD/IfA, Course "Mobile Robotic" - Practical Project
+%
+% Read a sensor_data/*.dat file (accelerometer, gyroscope or GPS) with the
+% native reader mex_read_sensor_data, which is compiled on first use.
+% Replaces importSensorData (importdata) for large recordings.
+%
+% Parameters:
+% - file: path of the .dat file
+% - timeWindow (optional): [first, last] time in s, only samples within
+%                          are read (default: [] = all samples)
+% - decimation (optional): keep only every k-th sample (default: 1)
+% Return values:
+% - data: struct with fields
+%   .ID - 1xN sample IDs
+%   .timestamp - 1xN timestamps in ns
+%   .value - 3xN measurements (GPS: latitude, longitude, height)
+%   .sigma - 3xN standard deviations (GPS: accuracy in the third row)
+%   or [] if there are no samples (within the time window)
+%
+function data = readSensorData(file, timeWindow, decimation)
+    if nargin < 2; timeWindow = []; end
+    if nargin < 3; decimation = 1; end
+
+    makeMex('mex_read_sensor_data.cpp');
+    data = mex_read_sensor_data(file, struct('timeWindow', timeWindow, 'decimation', decimation));
+    if isempty(data.ID)
+        data = [];
+    end
+end
@@ -0,0 +1,531 @@
+//$ mex mex_strapdown_ekf.cpp # Maltab command for generating the MEX file
+/*******************************************************
+ * Reference implementation of the practical project (see project/project.m
+ * and processExperiment.m) for the instructors, not to be handed out:
+ * geodetic to navigation frame conversion of the GPS positions and the
+ * strapdown EKF (bias compensation, quaternion propagation, prediction and
+ * GPS update) in a single pass over the recorded data.
+ *
+ * nav = mex_strapdown_ekf('navigation', WGS)
+ * Outputs:
+ * - nav: struct with fields
+ *   .ECEF - 3xN positions in ECEF coordinates
+ *   .N - 3xN positions in the NED navigation frame {N}
+ *   .ECEFpos - origin of {N} in ECEF coordinates (the first position)
+ *   .ECEFrot - attitude quaternion of {N} w.r.t. ECEF
+ * Inputs:
+ * - WGS: 3xN positions [latitude (deg), longitude (deg), height (m)]
+ *
+ * est = mex_strapdown_ekf('filter', a, w, r, params)
+ * Outputs:
+ * - est: struct with fields
+ *   .time - 1xK filter time steps in s
+ *   .x - 10xK states [position (N), velocity (N), attitude quaternion]
+ *   .sigma - 10xK standard deviations (square root of diag(P))
+ * Inputs:
+ * - a, w: structs with fields .time (1xN, s) and .value (3xN) of the
+ *         accelerometer and the gyroscope
+ * - r: struct with fields .time (1xN, s), .value (3xN, WGS84 as above) and
+ *      .sigma (3xN, standard deviations in {N}) of the GPS
+ * - params: struct with fields
+ *   .x0 - initial state (10 elements)
+ *   .P0 - initial covariance (10x10)
+ *   .inputSigma - standard deviations of [a; w] (6 elements)
+ *   .inputBias - (optional) biases subtracted from [a; w] (default: 0)
+ *   .gravity - (optional) default: 9.81
+ *   .doCorrection - (optional) use the GPS updates (default: true)
+ *
+ * The filter steps through the merged sensor time stamps exactly like the
+ * loop in project/project.m: each step predicts with the latest accelerometer and
+ * gyroscope samples and corrects if the step ends at a GPS sample.
+ * Quaternions are [q1, q2, q3, q4] with the scalar part q4 (see
+ * Quat2DCM.m), the attitude rotates body into navigation coordinates.
+ * The discrete system matrices are computed as in discretize.m (from the
+ * exponential of the augmented matrix [A B; 0 0] * T), the state is
+ * propagated by RK4 with steps of at most 1 ms instead of ode45.
+ */
+
+#include "mex.h"
+#include "matrix.h"
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+#include <vector>
+
+#define INDEX_IN_COMMAND    0
+#define INDEX_IN_WGS        1
+#define INDEX_IN_ACC        1
+#define INDEX_IN_GYRO       2
+#define INDEX_IN_GPS        3
+#define INDEX_IN_PARAMS     4
+
+#define STATE_SIZE  10
+#define INPUT_SIZE  6
+#define AUG_SIZE    (STATE_SIZE + INPUT_SIZE)
+#define MAX_STEP    1e-3
+
+#define WGS_A       6378137.0
+#define WGS_E       0.081819
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+#define DEG         (M_PI / 180)
+
+// all matrices are column-major like in Matlab
+
+// C (m x n) = A (m x k) * B (k x n)
+static void multiply(const double *A, const double *B, double *C, int m, int k, int n) {
+    for (int j = 0; j < n; j++) {
+        for (int i = 0; i < m; i++) C[i + m * j] = 0.0;
+        for (int l = 0; l < k; l++) {
+            double b = B[l + k * j];
+            if (b == 0.0) continue;
+            for (int i = 0; i < m; i++) C[i + m * j] += A[i + m * l] * b;
+        }
+    }
+}
+
+// C (m x n) = A (m x k) * B' (B: n x k)
+static void multiplyTransposed(const double *A, const double *B, double *C, int m, int k, int n) {
+    for (int j = 0; j < n; j++) {
+        for (int i = 0; i < m; i++) {
+            double sum = 0.0;
+            for (int l = 0; l < k; l++) sum += A[i + m * l] * B[j + n * l];
+            C[i + m * j] = sum;
+        }
+    }
+}
+
+// direction cosine matrix of a quaternion (Quat2DCM.m)
+static void quatToDCM(const double *q, double *R) {
+    R[0] = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+    R[1] = 2 * (q[0] * q[1] + q[2] * q[3]);
+    R[2] = 2 * (q[0] * q[2] - q[1] * q[3]);
+    R[3] = 2 * (q[0] * q[1] - q[2] * q[3]);
+    R[4] = -q[0] * q[0] + q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+    R[5] = 2 * (q[1] * q[2] + q[0] * q[3]);
+    R[6] = 2 * (q[0] * q[2] + q[1] * q[3]);
+    R[7] = 2 * (q[1] * q[2] - q[0] * q[3]);
+    R[8] = -q[0] * q[0] - q[1] * q[1] + q[2] * q[2] + q[3] * q[3];
+}
+
+// quaternion of a direction cosine matrix (DCM2Quat.m: of the four
+// candidate solutions, the last one with a component rounding to
+// non-zero is used)
+static void dcmToQuat(const double *R, double *q) {
+    double r11 = R[0], r21 = R[1], r31 = R[2], r12 = R[3], r22 = R[4], r32 = R[5], r13 = R[6], r23 = R[7], r33 = R[8];
+    double c;
+    c = 0.5 * sqrt(1 + r11 + r22 + r33);
+    if (floor(c + 0.5) != 0) {
+        q[0] = (r32 - r23) / (4 * c); q[1] = (r13 - r31) / (4 * c); q[2] = (r21 - r12) / (4 * c); q[3] = c;
+        return;
+    }
+    c = 0.5 * sqrt(1 - r11 - r22 + r33);
+    if (floor(c + 0.5) != 0) {
+        q[0] = (r13 + r31) / (4 * c); q[1] = (r23 + r32) / (4 * c); q[2] = c; q[3] = (r21 - r12) / (4 * c);
+        return;
+    }
+    c = 0.5 * sqrt(1 - r11 + r22 - r33);
+    if (floor(c + 0.5) != 0) {
+        q[0] = (r12 + r21) / (4 * c); q[1] = c; q[2] = (r23 + r32) / (4 * c); q[3] = (r13 - r31) / (4 * c);
+        return;
+    }
+    c = 0.5 * sqrt(1 + r11 - r22 - r33);
+    q[0] = c; q[1] = (r12 + r21) / (4 * c); q[2] = (r13 + r31) / (4 * c); q[3] = (r32 - r23) / (4 * c);
+}
+
+// WGS84 [latitude, longitude (deg), height] to ECEF coordinates
+static void wgsToECEF(const double *wgs, double *ecef) {
+    double sinLat = sin(wgs[0] * DEG), cosLat = cos(wgs[0] * DEG);
+    double radius = WGS_A / sqrt(1 - WGS_E * WGS_E * sinLat * sinLat);
+    ecef[0] = (radius + wgs[2]) * cosLat * cos(wgs[1] * DEG);
+    ecef[1] = (radius + wgs[2]) * cosLat * sin(wgs[1] * DEG);
+    ecef[2] = (radius * (1 - WGS_E * WGS_E) + wgs[2]) * sinLat;
+}
+
+// rotation from a NED frame at the given WGS84 position to ECEF (the
+// columns are the north, east and down directions)
+static void nedToECEF(const double *wgs, double *R) {
+    double sinLat = sin(wgs[0] * DEG), cosLat = cos(wgs[0] * DEG);
+    double sinLon = sin(wgs[1] * DEG), cosLon = cos(wgs[1] * DEG);
+    R[0] = -sinLat * cosLon; R[1] = -sinLat * sinLon; R[2] = cosLat;
+    R[3] = -sinLon;          R[4] = cosLon;           R[5] = 0.0;
+    R[6] = -cosLat * cosLon; R[7] = -cosLat * sinLon; R[8] = -sinLat;
+}
+
+struct Parameters {
+    double x0[STATE_SIZE];
+    double P0[STATE_SIZE * STATE_SIZE];
+    double inputVariance[INPUT_SIZE];
+    double inputBias[INPUT_SIZE];
+    double gravity;
+    bool doCorrection;
+};
+
+// continuous system dx = f(x, u): position, velocity in {N} and attitude
+// quaternion, u = [specific force; angular rate] in body coordinates
+static void dynamics(const double *x, const double *u, double g, double *dx) {
+    double R[9];
+    quatToDCM(x + 6, R);
+    const double *q = x + 6, *w = u + 3;
+    for (int i = 0; i < 3; i++) {
+        dx[i] = x[3 + i];
+        dx[3 + i] = R[i] * u[0] + R[i + 3] * u[1] + R[i + 6] * u[2];
+    }
+    dx[5] += g;
+    dx[6] = 0.5 * (q[3] * w[0] + q[1] * w[2] - q[2] * w[1]);
+    dx[7] = 0.5 * (q[3] * w[1] + q[2] * w[0] - q[0] * w[2]);
+    dx[8] = 0.5 * (q[3] * w[2] + q[0] * w[1] - q[1] * w[0]);
+    dx[9] = -0.5 * (q[0] * w[0] + q[1] * w[1] + q[2] * w[2]);
+}
+
+// A = df/dx and B = df/du, both column-major with STATE_SIZE rows
+static void linearize(const double *x, const double *u, double *A, double *B) {
+    memset(A, 0, sizeof(double) * STATE_SIZE * STATE_SIZE);
+    memset(B, 0, sizeof(double) * STATE_SIZE * INPUT_SIZE);
+    const double *v = x + 6, *a = u, *w = u + 3;
+    double s = x[9];
+    double va = v[0] * a[0] + v[1] * a[1] + v[2] * a[2];
+    // cross product matrices [a]x and [w]x
+    double ax[9] = { 0, a[2], -a[1], -a[2], 0, a[0], a[1], -a[0], 0 };
+    double wx[9] = { 0, w[2], -w[1], -w[2], 0, w[0], w[1], -w[0], 0 };
+    double R[9];
+    quatToDCM(x + 6, R);
+
+    for (int i = 0; i < 3; i++) {
+        A[i + STATE_SIZE * (3 + i)] = 1.0;
+        for (int j = 0; j < 3; j++) {
+            // d(R a)/dv = -2 a v' + 2 (v'a) I + 2 v a' - 2 s [a]x
+            A[3 + i + STATE_SIZE * (6 + j)] = -2 * a[i] * v[j] + (i == j ? 2 * va : 0.0) + 2 * v[i] * a[j] - 2 * s * ax[i + 3 * j];
+            // dq/dv = [-[w]x / 2; -w' / 2]
+            A[6 + i + STATE_SIZE * (6 + j)] = -0.5 * wx[i + 3 * j];
+            // d(R a)/da = R
+            B[3 + i + STATE_SIZE * j] = R[i + 3 * j];
+        }
+        A[9 + STATE_SIZE * (6 + i)] = -0.5 * w[i];
+        A[6 + i + STATE_SIZE * 9] = 0.5 * w[i];
+        B[9 + STATE_SIZE * (3 + i)] = -0.5 * v[i];
+    }
+    // d(R a)/ds = 2 s a + 2 v x a
+    A[3 + STATE_SIZE * 9] = 2 * s * a[0] + 2 * (v[1] * a[2] - v[2] * a[1]);
+    A[4 + STATE_SIZE * 9] = 2 * s * a[1] + 2 * (v[2] * a[0] - v[0] * a[2]);
+    A[5 + STATE_SIZE * 9] = 2 * s * a[2] + 2 * (v[0] * a[1] - v[1] * a[0]);
+    // dq/dw = [(s I + [v]x) / 2; -v' / 2]
+    double vx[9] = { 0, v[2], -v[1], -v[2], 0, v[0], v[1], -v[0], 0 };
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) B[6 + i + STATE_SIZE * (3 + j)] = 0.5 * ((i == j ? s : 0.0) + vx[i + 3 * j]);
+    }
+}
+
+// matrix exponential by scaling and squaring of the Taylor series
+static void expm(const double *M, double *E, int n) {
+    double norm = 0.0;
+    for (int j = 0; j < n; j++) {
+        double column = 0.0;
+        for (int i = 0; i < n; i++) column += fabs(M[i + n * j]);
+        if (column > norm) norm = column;
+    }
+    int squarings = norm > 0.5 ? (int)ceil(log2(norm / 0.5)) : 0;
+    double scale = ldexp(1.0, -squarings);
+
+    std::vector<double> X(n * n), term(n * n), next(n * n);
+    for (int i = 0; i < n * n; i++) X[i] = M[i] * scale;
+    for (int i = 0; i < n * n; i++) E[i] = term[i] = (i % (n + 1) == 0) ? 1.0 : 0.0;
+    for (int k = 1; k <= 20; k++) {
+        multiply(&term[0], &X[0], &next[0], n, n, n);
+        double termNorm = 0.0;
+        for (int i = 0; i < n * n; i++) {
+            term[i] = next[i] / k;
+            E[i] += term[i];
+            termNorm = std::max(termNorm, fabs(term[i]));
+        }
+        if (termNorm <= 1e-17) break;
+    }
+    for (int s = 0; s < squarings; s++) {
+        multiply(E, E, &next[0], n, n, n);
+        memcpy(E, &next[0], sizeof(double) * n * n);
+    }
+}
+
+static void predict(double *x, double *P, const double *u, const Parameters &params, double dt) {
+    // discretization: expm([A B; 0 0] * dt) = [F H; 0 I]
+    double A[STATE_SIZE * STATE_SIZE], B[STATE_SIZE * INPUT_SIZE];
+    linearize(x, u, A, B);
+    double M[AUG_SIZE * AUG_SIZE] = { 0 }, E[AUG_SIZE * AUG_SIZE];
+    for (int j = 0; j < STATE_SIZE; j++) {
+        for (int i = 0; i < STATE_SIZE; i++) M[i + AUG_SIZE * j] = A[i + STATE_SIZE * j] * dt;
+    }
+    for (int j = 0; j < INPUT_SIZE; j++) {
+        for (int i = 0; i < STATE_SIZE; i++) M[i + AUG_SIZE * (STATE_SIZE + j)] = B[i + STATE_SIZE * j] * dt;
+    }
+    expm(M, E, AUG_SIZE);
+    double F[STATE_SIZE * STATE_SIZE], H[STATE_SIZE * INPUT_SIZE];
+    for (int j = 0; j < STATE_SIZE; j++) memcpy(F + STATE_SIZE * j, E + AUG_SIZE * j, sizeof(double) * STATE_SIZE);
+    for (int j = 0; j < INPUT_SIZE; j++) memcpy(H + STATE_SIZE * j, E + AUG_SIZE * (STATE_SIZE + j), sizeof(double) * STATE_SIZE);
+
+    // state propagation
+    int steps = (int)ceil(dt / MAX_STEP);
+    double h = dt / steps;
+    for (int s = 0; s < steps; s++) {
+        double k1[STATE_SIZE], k2[STATE_SIZE], k3[STATE_SIZE], k4[STATE_SIZE], xt[STATE_SIZE];
+        dynamics(x, u, params.gravity, k1);
+        for (int i = 0; i < STATE_SIZE; i++) xt[i] = x[i] + h / 2 * k1[i];
+        dynamics(xt, u, params.gravity, k2);
+        for (int i = 0; i < STATE_SIZE; i++) xt[i] = x[i] + h / 2 * k2[i];
+        dynamics(xt, u, params.gravity, k3);
+        for (int i = 0; i < STATE_SIZE; i++) xt[i] = x[i] + h * k3[i];
+        dynamics(xt, u, params.gravity, k4);
+        for (int i = 0; i < STATE_SIZE; i++) x[i] += h / 6 * (k1[i] + 2 * k2[i] + 2 * k3[i] + k4[i]);
+    }
+
+    // P = F P F' + H N H'
+    double FP[STATE_SIZE * STATE_SIZE], HN[STATE_SIZE * INPUT_SIZE], HNH[STATE_SIZE * STATE_SIZE];
+    multiply(F, P, FP, STATE_SIZE, STATE_SIZE, STATE_SIZE);
+    multiplyTransposed(FP, F, P, STATE_SIZE, STATE_SIZE, STATE_SIZE);
+    for (int j = 0; j < INPUT_SIZE; j++) {
+        for (int i = 0; i < STATE_SIZE; i++) HN[i + STATE_SIZE * j] = H[i + STATE_SIZE * j] * params.inputVariance[j];
+    }
+    multiplyTransposed(HN, H, HNH, STATE_SIZE, INPUT_SIZE, STATE_SIZE);
+    for (int i = 0; i < STATE_SIZE * STATE_SIZE; i++) P[i] += HNH[i];
+}
+
+// GPS update with the measured ECEF position y, the output is
+// y = origin + R_EN * position
+static void correct(double *x, double *P, const double *y, const double *wgs, const double *sigma,
+                    const double *origin, const double *Ren) {
+    // measurement covariance W = R_EM diag(sigma^2) R_EM' (the NED frame
+    // at the measured position)
+    double Rem[9], RemS[9], W[9];
+    nedToECEF(wgs, Rem);
+    for (int j = 0; j < 3; j++) {
+        for (int i = 0; i < 3; i++) RemS[i + 3 * j] = Rem[i + 3 * j] * sigma[j] * sigma[j];
+    }
+    multiplyTransposed(RemS, Rem, W, 3, 3, 3);
+
+    // C = [R_EN 0 0], P C' = P(:, 1:3) R_EN', C P = R_EN P(1:3, :)
+    double PCt[STATE_SIZE * 3], CP[3 * STATE_SIZE], S[9];
+    multiplyTransposed(P, Ren, PCt, STATE_SIZE, 3, 3);
+    for (int j = 0; j < STATE_SIZE; j++) {
+        for (int i = 0; i < 3; i++) CP[i + 3 * j] = Ren[i] * P[STATE_SIZE * j] + Ren[i + 3] * P[1 + STATE_SIZE * j] + Ren[i + 6] * P[2 + STATE_SIZE * j];
+    }
+    for (int j = 0; j < 3; j++) {
+        for (int i = 0; i < 3; i++) S[i + 3 * j] = Ren[i] * PCt[j * STATE_SIZE] + Ren[i + 3] * PCt[1 + j * STATE_SIZE] + Ren[i + 6] * PCt[2 + j * STATE_SIZE] + W[i + 3 * j];
+    }
+
+    double Si[9];
+    Si[0] = S[4] * S[8] - S[7] * S[5];
+    Si[1] = S[7] * S[2] - S[1] * S[8];
+    Si[2] = S[1] * S[5] - S[4] * S[2];
+    Si[3] = S[6] * S[5] - S[3] * S[8];
+    Si[4] = S[0] * S[8] - S[6] * S[2];
+    Si[5] = S[3] * S[2] - S[0] * S[5];
+    Si[6] = S[3] * S[7] - S[6] * S[4];
+    Si[7] = S[6] * S[1] - S[0] * S[7];
+    Si[8] = S[0] * S[4] - S[3] * S[1];
+    double det = S[0] * Si[0] + S[3] * Si[1] + S[6] * Si[2];
+    for (int i = 0; i < 9; i++) Si[i] /= det;
+
+    double K[STATE_SIZE * 3], innovation[3];
+    multiply(PCt, Si, K, STATE_SIZE, 3, 3);
+    for (int i = 0; i < 3; i++) innovation[i] = y[i] - origin[i] - (Ren[i] * x[0] + Ren[i + 3] * x[1] + Ren[i + 6] * x[2]);
+
+    // x = x + K (y - y_pred), P = (I - K C) P
+    double KCP[STATE_SIZE * STATE_SIZE];
+    for (int i = 0; i < STATE_SIZE; i++) x[i] += K[i] * innovation[0] + K[i + STATE_SIZE] * innovation[1] + K[i + 2 * STATE_SIZE] * innovation[2];
+    multiply(K, CP, KCP, STATE_SIZE, 3, STATE_SIZE);
+    for (int i = 0; i < STATE_SIZE * STATE_SIZE; i++) P[i] -= KCP[i];
+}
+
+struct SensorData {
+    const double *time, *value, *sigma;
+    size_t count;
+};
+
+static const mxArray *getField(const mxArray *mxStruct, const char *name, size_t rows, size_t count, const char *argument) {
+    const mxArray *mxField = mxGetField(mxStruct, 0, name);
+    if (!mxField || !mxIsDouble(mxField) || mxIsComplex(mxField) || mxGetM(mxField) != rows ||
+        (count > 0 && mxGetNumberOfElements(mxField) != rows * count))
+        mexErrMsgIdAndTxt("mex_strapdown_ekf:input", "Field '%s' of '%s' must be a real double matrix with %u rows%s",
+                          name, argument, (unsigned)rows, count > 0 ? " and one column per sample" : "");
+    return mxField;
+}
+
+static SensorData getSensorData(const mxArray *mxData, const char *argument, bool withSigma) {
+    if (!mxIsStruct(mxData) || mxGetNumberOfElements(mxData) != 1)
+        mexErrMsgIdAndTxt("mex_strapdown_ekf:input", "Input argument '%s' must be a scalar struct", argument);
+    SensorData data;
+    const mxArray *mxTime = getField(mxData, "time", 1, 0, argument);
+    data.count = mxGetN(mxTime);
+    if (data.count < 2) mexErrMsgIdAndTxt("mex_strapdown_ekf:input", "Input argument '%s' must contain at least two samples", argument);
+    data.time = mxGetPr(mxTime);
+    data.value = mxGetPr(getField(mxData, "value", 3, data.count, argument));
+    data.sigma = withSigma ? mxGetPr(getField(mxData, "sigma", 3, data.count, argument)) : NULL;
+    return data;
+}
+
+static void getVector(const mxArray *mxParams, const char *name, double *value, size_t count, bool required) {
+    const mxArray *mxField = mxGetField(mxParams, 0, name);
+    if (!mxField) {
+        if (required) mexErrMsgIdAndTxt("mex_strapdown_ekf:params", "Parameter '%s' missing", name);
+        return;
+    }
+    if (!mxIsDouble(mxField) || mxIsComplex(mxField) || mxGetNumberOfElements(mxField) != count)
+        mexErrMsgIdAndTxt("mex_strapdown_ekf:params", "Parameter '%s' must be a real double array with %u elements", name, (unsigned)count);
+    memcpy(value, mxGetPr(mxField), sizeof(double) * count);
+}
+
+static Parameters getParameters(const mxArray *mxParams) {
+    if (!mxIsStruct(mxParams) || mxGetNumberOfElements(mxParams) != 1)
+        mexErrMsgTxt("Input argument 'params' must be a scalar struct");
+    Parameters params;
+    double sigma[INPUT_SIZE], doCorrection = 1.0;
+    getVector(mxParams, "x0", params.x0, STATE_SIZE, true);
+    getVector(mxParams, "P0", params.P0, STATE_SIZE * STATE_SIZE, true);
+    getVector(mxParams, "inputSigma", sigma, INPUT_SIZE, true);
+    for (int i = 0; i < INPUT_SIZE; i++) params.inputVariance[i] = sigma[i] * sigma[i];
+    memset(params.inputBias, 0, sizeof(params.inputBias));
+    getVector(mxParams, "inputBias", params.inputBias, INPUT_SIZE, false);
+    params.gravity = 9.81;
+    getVector(mxParams, "gravity", &params.gravity, 1, false);
+    const mxArray *mxCorrection = mxGetField(mxParams, 0, "doCorrection");
+    if (mxCorrection) {
+        if ((!mxIsLogical(mxCorrection) && !mxIsNumeric(mxCorrection)) || mxGetNumberOfElements(mxCorrection) != 1)
+            mexErrMsgIdAndTxt("mex_strapdown_ekf:params", "Parameter 'doCorrection' must be a logical scalar");
+        doCorrection = mxGetScalar(mxCorrection);
+    }
+    params.doCorrection = doCorrection != 0.0;
+    return params;
+}
+
+// index i of the sample with time(i) <= t <= time(i + 1), starting the
+// search at i (the sensor loops in project/project.m)
+static void advance(const SensorData &data, size_t &i, double t, const char *sensor) {
+    while (!(data.time[i] <= t && data.time[i + 1] >= t)) {
+        if (++i + 1 >= data.count)
+            mexErrMsgIdAndTxt("mex_strapdown_ekf:time", "The %s samples do not cover the GPS time span", sensor);
+    }
+}
+
+static mxArray *navigationFrame(const mxArray *mxWGS) {
+    static const char *FIELDS[] = { "ECEF", "N", "ECEFpos", "ECEFrot" };
+    if (!mxIsDouble(mxWGS) || mxIsComplex(mxWGS) || mxGetM(mxWGS) != 3 || mxGetN(mxWGS) < 1)
+        mexErrMsgTxt("Input argument 'WGS' must be a non-empty 3xN double matrix");
+    size_t count = mxGetN(mxWGS);
+    const double *pWGS = mxGetPr(mxWGS);
+
+    mxArray *mxECEF = mxCreateDoubleMatrix(3, count, mxREAL), *mxN = mxCreateDoubleMatrix(3, count, mxREAL);
+    mxArray *mxOrigin = mxCreateDoubleMatrix(3, 1, mxREAL), *mxRot = mxCreateDoubleMatrix(4, 1, mxREAL);
+    double *pECEF = mxGetPr(mxECEF), *pN = mxGetPr(mxN), *origin = mxGetPr(mxOrigin);
+    double Ren[9];
+    wgsToECEF(pWGS, origin);
+    nedToECEF(pWGS, Ren);
+    dcmToQuat(Ren, mxGetPr(mxRot));
+    for (size_t k = 0; k < count; k++) {
+        double *ecef = pECEF + 3 * k, d[3];
+        wgsToECEF(pWGS + 3 * k, ecef);
+        for (int i = 0; i < 3; i++) d[i] = ecef[i] - origin[i];
+        for (int i = 0; i < 3; i++) pN[3 * k + i] = Ren[3 * i] * d[0] + Ren[3 * i + 1] * d[1] + Ren[3 * i + 2] * d[2];
+    }
+
+    mxArray *mxNav = mxCreateStructMatrix(1, 1, 4, FIELDS);
+    mxSetField(mxNav, 0, "ECEF", mxECEF);
+    mxSetField(mxNav, 0, "N", mxN);
+    mxSetField(mxNav, 0, "ECEFpos", mxOrigin);
+    mxSetField(mxNav, 0, "ECEFrot", mxRot);
+    return mxNav;
+}
+
+static mxArray *filter(const SensorData &acc, const SensorData &gyro, const SensorData &gps, const Parameters &params) {
+    static const char *FIELDS[] = { "time", "x", "sigma" };
+
+    // navigation frame at the first GPS position, measurements in ECEF
+    double origin[3], Ren[9];
+    wgsToECEF(gps.value, origin);
+    nedToECEF(gps.value, Ren);
+    std::vector<double> gpsECEF(3 * gps.count);
+    for (size_t k = 0; k < gps.count; k++) wgsToECEF(gps.value + 3 * k, &gpsECEF[3 * k]);
+
+    size_t maxRecords = acc.count + gyro.count + gps.count;
+    std::vector<double> time, states, sigmas;
+    time.reserve(maxRecords);
+    states.reserve(STATE_SIZE * maxRecords);
+    sigmas.reserve(STATE_SIZE * maxRecords);
+
+    double x[STATE_SIZE], P[STATE_SIZE * STATE_SIZE];
+    memcpy(x, params.x0, sizeof(x));
+    memcpy(P, params.P0, sizeof(P));
+    double t = gps.time[0];
+    size_t ia = 0, iw = 0, ir = 0;
+    for (;;) {
+        time.push_back(t);
+        states.insert(states.end(), x, x + STATE_SIZE);
+        for (int i = 0; i < STATE_SIZE; i++) sigmas.push_back(sqrt(P[i * (STATE_SIZE + 1)]));
+        if (ia + 1 == acc.count || iw + 1 == gyro.count || ir + 1 == gps.count) break;
+
+        advance(acc, ia, t, "accelerometer");
+        advance(gyro, iw, t, "gyroscope");
+        advance(gps, ir, t, "GPS");
+
+        double u[INPUT_SIZE];
+        for (int i = 0; i < 3; i++) {
+            u[i] = acc.value[3 * ia + i] - params.inputBias[i];
+            u[3 + i] = gyro.value[3 * iw + i] - params.inputBias[3 + i];
+        }
+
+        // next time step: the earliest next sample (the first sensor on ties)
+        double tNext = t;
+        int sensor = 0;
+        while (tNext == t && ia + 1 < acc.count && iw + 1 < gyro.count && ir + 1 < gps.count) {
+            tNext = acc.time[ia + 1];
+            sensor = 0;
+            if (gyro.time[iw + 1] < tNext) { tNext = gyro.time[iw + 1]; sensor = 1; }
+            if (gps.time[ir + 1] < tNext) { tNext = gps.time[ir + 1]; sensor = 2; }
+            switch (sensor) {
+            case 0: ia++; break;
+            case 1: iw++; break;
+            case 2: ir++; break;
+            }
+        }
+        if (tNext == t) break; // all samples of a sensor used up by equal time stamps
+
+        predict(x, P, u, params, tNext - t);
+        if (params.doCorrection && sensor == 2) correct(x, P, &gpsECEF[3 * ir], gps.value + 3 * ir, gps.sigma + 3 * ir, origin, Ren);
+        t = tNext;
+    }
+
+    size_t count = time.size();
+    mxArray *mxTime = mxCreateDoubleMatrix(1, count, mxREAL);
+    mxArray *mxStates = mxCreateDoubleMatrix(STATE_SIZE, count, mxREAL);
+    mxArray *mxSigmas = mxCreateDoubleMatrix(STATE_SIZE, count, mxREAL);
+    memcpy(mxGetPr(mxTime), &time[0], sizeof(double) * count);
+    memcpy(mxGetPr(mxStates), &states[0], sizeof(double) * STATE_SIZE * count);
+    memcpy(mxGetPr(mxSigmas), &sigmas[0], sizeof(double) * STATE_SIZE * count);
+    mxArray *mxEstimate = mxCreateStructMatrix(1, 1, 3, FIELDS);
+    mxSetField(mxEstimate, 0, "time", mxTime);
+    mxSetField(mxEstimate, 0, "x", mxStates);
+    mxSetField(mxEstimate, 0, "sigma", mxSigmas);
+    return mxEstimate;
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    if (nrhs < 1) mexErrMsgTxt("Too few input arguments");
+    if (nlhs > 1) mexErrMsgTxt("Too many output arguments");
+
+    char command[16];
+    if (!mxIsChar(prhs[INDEX_IN_COMMAND]) || mxGetString(prhs[INDEX_IN_COMMAND], command, sizeof(command)) != 0)
+        mexErrMsgTxt("First input argument must be 'navigation' or 'filter'");
+
+    if (strcmp(command, "navigation") == 0) {
+        if (nrhs != 2) mexErrMsgTxt("Usage: nav = mex_strapdown_ekf('navigation', WGS)");
+        plhs[0] = navigationFrame(prhs[INDEX_IN_WGS]);
+    } else if (strcmp(command, "filter") == 0) {
+        if (nrhs != 5) mexErrMsgTxt("Usage: est = mex_strapdown_ekf('filter', a, w, r, params)");
+        SensorData acc = getSensorData(prhs[INDEX_IN_ACC], "a", false);
+        SensorData gyro = getSensorData(prhs[INDEX_IN_GYRO], "w", false);
+        SensorData gps = getSensorData(prhs[INDEX_IN_GPS], "r", true);
+        Parameters params = getParameters(prhs[INDEX_IN_PARAMS]);
+        plhs[0] = filter(acc, gyro, gps, params);
+    } else {
+        mexErrMsgIdAndTxt("mex_strapdown_ekf:command", "Unknown command '%s'", command);
+    }
+}
@@ -0,0 +1,117 @@
+% TUD/IfA, Course "Mobile Robotic" - Practical Project, reference solution
+%
+% Process an experiment of the practical project with the native reference
+% implementation mex_strapdown_ekf.cpp: GPS conversion and EKF of the
+% whole experiment in a single call, e.g. to reprocess all recorded
+% experiments with different options within seconds. Requires the project
+% directory on the path (getExperimentInfo, readSensorData, DCM2Quat).
+%
+% Parameters: struct or name/value pairs with the options of project.m
+% - path: experiment directory (required)
+% - doCorrection, calibrationFile, disableBiasCompensation, timeWindow,
+%   decimation: see project.m
+%
+% Returns a struct with fields
+% - pos, vel, rot: EKF results in the format of project.m, e.g.
+%   plotErrors(result.pos, result.N)
+% - N: GPS positions in the navigation frame
+%
+function result = processExperiment(varargin)
+    if nargin == 1
+        options = varargin{1};
+    else options = struct(varargin{:});
+    end
+    expInfo = getExperimentInfo(options.path);
+    if ~isfield(options, 'doCorrection'); options.doCorrection = true; end
+    if ~isfield(options, 'calibrationFile')
+        options.calibrationFile = fullfile(fileparts(options.path), 'calibration.mat');
+    end
+    if ~isfield(options, 'disableBiasCompensation'); options.disableBiasCompensation = false; end
+    if ~isfield(options, 'timeWindow'); options.timeWindow = []; end
+    if ~isfield(options, 'decimation'); options.decimation = 1; end
+
+    source = fullfile(fileparts(mfilename('fullpath')), 'mex_strapdown_ekf.cpp');
+    if exist('mex_make', 'file')
+        mex_make(source);
+    elseif exist('mex_strapdown_ekf', 'file') ~= 3
+        mex('-outdir', fileparts(source), source);
+    end
+
+    % sensor data
+    dataPath = fullfile(options.path, 'sensor_data');
+    a = readSensor(fullfile(dataPath, 'accelerometer_data.dat'), options);
+    w = readSensor(fullfile(dataPath, 'gyroscope_data.dat'), options);
+    gps = [];
+    if exist(fullfile(dataPath, 'gps_data.dat'), 'file')
+        gps = readSensorData(fullfile(dataPath, 'gps_data.dat'), options.timeWindow, options.decimation);
+    end
+    if isempty(a) || isempty(w) || isempty(gps)
+        error('project:reference:MissingSensor', 'Experiment %s lacks accelerometer, gyroscope or GPS data', options.path);
+    end
+
+    % calibration (zero defaults as in project.m)
+    calib = struct();
+    if exist(options.calibrationFile, 'file'); calib = load(options.calibrationFile); end
+    for field = {'a_sigma', 'a_bias', 'w_sigma', 'w_bias'}
+        if ~isfield(calib, field{1}); calib.(field{1}) = [0; 0; 0]; end
+    end
+
+    % GPS positions in the navigation frame
+    r.time = gps.timestamp .* 10^(-9);
+    r.value = gps.value;
+    r.sigma = [1; 1; 2] * gps.sigma(3, :);
+    nav = mex_strapdown_ekf('navigation', r.value);
+    result.N = struct('samples', numel(r.time), 'time', r.time, 'value', nav.N, 'sigma', r.sigma, ...
+                      'ECEFpos', nav.ECEFpos, 'ECEFrot', nav.ECEFrot, ...
+                      'name', 'Measured Body Position (in Navigation Frame)');
+
+    % initialization as in project.m
+    d_D = -a.value(:, 1) / norm(a.value(:, 1));
+    d_N = [0; 0; 1];
+    d_E = -cross(d_N, d_D);
+    d_E = d_E / norm(d_E);
+    d_N = cross(d_E, d_D);
+    R = [d_N d_E d_D]';
+
+    x = [nav.N(:, 1); expInfo.initialVelocity(:)];
+    if isfield(expInfo, 'initialPose')
+        x = [x; expInfo.initialPose(:)];
+    else x = [x; DCM2Quat(R)];
+    end
+    params = struct('x0', x, 'P0', diag([r.sigma(:, end); 1; 1; 1; 0.5; 0.5; 0.5; 0.5].^2), ...
+                    'inputSigma', [calib.a_sigma(:); 20 * calib.w_sigma(:)], 'doCorrection', options.doCorrection);
+    if expInfo.biasCorrection && ~options.disableBiasCompensation
+        params.inputBias = [calib.a_bias(:); calib.w_bias(:)];
+    end
+    est = mex_strapdown_ekf('filter', a, w, r, params);
+
+    result.pos = struct('time', est.time, 'value', est.x(1:3, :), 'sigma', est.sigma(1:3, :), ...
+                        'name', 'Estimated Body Position (in Navigation Frame)', ...
+                        'axis1', '${}^{\rm{N}}\hat{r}_{\rm{NB},x}$ / $\rm{m}$', ...
+                        'axis2', '${}^{\rm{N}}\hat{r}_{\rm{NB},y}$ / $\rm{m}$', ...
+                        'axis3', '${}^{\rm{N}}\hat{r}_{\rm{NB},z}$ / $\rm{m}$', ...
+                        'base', '$t$ / $\rm{s}$');
+    result.vel = struct('time', est.time, 'value', est.x(4:6, :), 'sigma', est.sigma(4:6, :), ...
+                        'name', 'Estimated Body Velocity (in Navigation Frame)', ...
+                        'axis1', '${}^{\rm{N}}\hat{v}_{\rm{NB},x}$ / $\rm{m}$', ...
+                        'axis2', '${}^{\rm{N}}\hat{v}_{\rm{NB},y}$ / $\rm{m}$', ...
+                        'axis3', '${}^{\rm{N}}\hat{v}_{\rm{NB},z}$ / $\rm{m}$', ...
+                        'base', '$t$ / $\rm{s}$');
+    result.rot = struct('time', est.time, 'value', [est.x(7:10, :); sqrt(sum(est.x(7:10, :).^2, 1))], 'sigma', est.sigma(7:10, :), ...
+                        'name', 'Estimated Body Attitude (wrt Navigation Frame)', ...
+                        'axis1', '${}^{\rm{N}}_{\rm{B}}\hat{q}_{1}$ / $1$', ...
+                        'axis2', '${}^{\rm{N}}_{\rm{B}}\hat{q}_{2}$ / $1$', ...
+                        'axis3', '${}^{\rm{N}}_{\rm{B}}\hat{q}_{3}$ / $1$', ...
+                        'axis4', '${}^{\rm{N}}_{\rm{B}}\hat{q}_{4}$ / $1$', ...
+                        'axis5', '$|{}^{\rm{N}}_{\rm{B}}\hat{q}|$ / $1$', ...
+                        'base', '$t$ / $\rm{s}$');
+end
+
+% accelerometer or gyroscope data as struct with fields .time (s) and .value
+function s = readSensor(file, options)
+    s = [];
+    if ~exist(file, 'file'); return; end
+    data = readSensorData(file, options.timeWindow, options.decimation);
+    if isempty(data); return; end
+    s = struct('time', data.timestamp .* 10^(-9), 'value', data.value);
+end
@@ -98,8 +98,10 @@
 %       - uniform: bool; if set to true, output, debugOut and state records
 %                  are expected to be the same format for each and every
 %                  iteration. This allows storing the data in linear arrays
-%                  instead of cell arrays, which is much more space
-%                  effective, especially for small records. If a block has
+%                  (numeric, logical and char records are kept in typed
+%                  columns of the native log store) instead of cell arrays,
+%                  which is much more space effective, especially for small
+%                  records. If a block has
 %                  load/unload function handles (see below), the original
 %                  outputs may be non-uniform, but the residues returned
 %                  from unload must be uniform. If the block consistently
@@ -118,9 +120,20 @@
 %                 restore the original data on demand.
 %       - load: Counterpart to .unload, which takes the residue as input 
 %               should return the original log entry, if requested by the
-%               simulation framework. 
+%               simulation framework. For blocks with restoresState = false
+%               (see below), the framework passes the state of the most
+%               recent checkpoint at or before the record as an additional
+%               argument when the log is replayed, from which e.g. native
+%               data can be drawn.
 %       - maxCached: per-block size of the cache holding loaded log entries
 %                    (3 per default)
+%       - restoresState: bool (true per default); set to false, if the
+%                        logged states do not hold the complete state of
+%                        the block, e.g. because it keeps its data in a
+%                        native object (mex_object_handle). Such blocks are
+%                        recomputed from a checkpoint of the simulator
+%                        instead of continuing from a log record (see
+%                        'Recompute from here' and loaded experiments).
 % - mexFiles:
 %       Cell array of mexFiles used by this block and instructions on how
 %       to compile then from source(s). Each field is either a string with
@@ -192,7 +205,7 @@ function block = block_base(deltaT, depends, funcHandle)
     block.graphicElements = repmat(struct('name', [], 'hideByDefault', false, 'draw', [], 'useLogs', false), 0);
     block.figures = repmat(struct('name', [], 'icon', [], 'init', [], 'draw', [], 'drawLog', []), 0);
         
-    block.log = struct('disabled', false, 'uniform', false, 'unload', [], 'load', [], 'maxCached', 3);
+    block.log = struct('disabled', false, 'uniform', false, 'unload', [], 'load', [], 'maxCached', 3, 'restoresState', true);
     
     block.mexFiles = {};
     
@@ -1,25 +1,93 @@
-function [state, X_f] = continuous_integration(model_equations, X_0, tEnd, state, in)
-    if isempty(state)           
-        state = [tEnd X_0(:)']; 
-    elseif ~isempty(in)            
-        t = state(1);
+% Integrate the model equations over all input segments since the last
+% update. The state is [t X], where t is the time of the last update.
+% Each input record is held constant until the next one (or tEnd).
+%
+% The optional argument integrator selects the method:
+% - .method: 'ode45' (default), 'rk4' or 'dopri5' (fixed step, see
+%            mex_integrate_kinematics.cpp) or 'exact' (native models only)
+% - .maxStep: step size of the fixed-step methods in s (default: 0.01)
+% - .model: (optional) params struct of a native kinematic model for
+%           mex_integrate_kinematics ('omni', 'vomega' or 'ddrive'). The
+%           whole segment list is integrated in a single call to the mex
+%           file, model_equations is not used. Without .model, the
+%           fixed-step methods evaluate model_equations in Matlab.
+function [state, X_f] = continuous_integration(model_equations, X_0, tEnd, state, in, integrator)
+    if nargin < 6 || isempty(integrator)
+        integrator = struct('method', 'ode45');
+    end
+    if isempty(state)
+        state = [tEnd X_0(:)'];
+    elseif ~isempty(in) && state(1) < tEnd
+        % segment s spans [tBounds(s), tBounds(s + 1)], the input is
+        % updated at the start of each segment until tEnd is reached
+        tBounds = [state(1), in(2:end).t, tEnd];
+        segmentCount = find(tBounds(2:end) >= tEnd, 1);
+        tBounds = tBounds(1:segmentCount + 1);
         X = state(2:end);
-        iIn = 1;        
-        while t < tEnd
-            if iIn < length(in)
-                tPartEnd = in(iIn + 1).t; 
-            else tPartEnd = tEnd; 
+        if isfield(integrator, 'model') && ~strcmp(integrator.method, 'ode45')
+            U = reshape([in(1:segmentCount).data], [], segmentCount)';
+            params = integrator.model;
+            params.method = integrator.method;
+            if isfield(integrator, 'maxStep'); params.maxStep = integrator.maxStep; end
+            X = mex_integrate_kinematics(X, tBounds, U, params);
+        else
+            for iIn = 1:segmentCount
+                if (tBounds(iIn + 1) - tBounds(iIn)) > 1e-6
+                    X = integrateSegment(model_equations, tBounds(iIn), tBounds(iIn + 1), X, in(iIn).data, integrator);
+                end
             end
-            if (tPartEnd - t) > 1e-6
-                inPart = in(iIn).data;
-                % ode45 seems to have problems with very short time intervals                
-                [~, X] = ode45(@(t, x)model_equations(t, x, inPart), [t, tPartEnd], X);
-                X = X(end, :);
-            end
-            t = tPartEnd;
-            iIn = iIn + 1;
         end
-        state = [t X];
-    end        
+        state = [tBounds(end) X];
+    end
     X_f = state(2:end);
-end
\ No newline at end of file
+end
+
+function X = integrateSegment(model_equations, t, tPartEnd, X, inPart, integrator)
+    f = @(t, x)model_equations(t, x, inPart);
+    switch integrator.method
+        case 'ode45'
+            % ode45 seems to have problems with very short time intervals
+            [~, X] = ode45(f, [t, tPartEnd], X);
+            X = X(end, :);
+        case {'rk4', 'dopri5'}
+            if isfield(integrator, 'maxStep')
+                maxStep = integrator.maxStep;
+            else
+                maxStep = 0.01;
+            end
+            steps = ceil((tPartEnd - t) / maxStep);
+            h = (tPartEnd - t) / steps;
+            x = X(:);
+            for i = 1:steps
+                if strcmp(integrator.method, 'rk4')
+                    x = stepRK4(f, t, x, h);
+                else
+                    x = stepDopri5(f, t, x, h);
+                end
+                t = t + h;
+            end
+            X = x';
+        otherwise
+            error('continuous_integration:method', 'Method ''%s'' requires a native model', integrator.method);
+    end
+end
+
+function x = stepRK4(f, t, x, h)
+    k1 = f(t, x);
+    k2 = f(t + h / 2, x + h / 2 * k1);
+    k3 = f(t + h / 2, x + h / 2 * k2);
+    k4 = f(t + h, x + h * k3);
+    x = x + h / 6 * (k1 + 2 * k2 + 2 * k3 + k4);
+end
+
+% fifth order solution of the Dormand-Prince pair (as in ode45) without
+% step size control
+function x = stepDopri5(f, t, x, h)
+    k1 = f(t, x);
+    k2 = f(t + h / 5, x + h * (k1 / 5));
+    k3 = f(t + 3 * h / 10, x + h * (3 / 40 * k1 + 9 / 40 * k2));
+    k4 = f(t + 4 * h / 5, x + h * (44 / 45 * k1 - 56 / 15 * k2 + 32 / 9 * k3));
+    k5 = f(t + 8 * h / 9, x + h * (19372 / 6561 * k1 - 25360 / 2187 * k2 + 64448 / 6561 * k3 - 212 / 729 * k4));
+    k6 = f(t + h, x + h * (9017 / 3168 * k1 - 355 / 33 * k2 + 46732 / 5247 * k3 + 49 / 176 * k4 - 5103 / 18656 * k5));
+    x = x + h * (35 / 384 * k1 + 500 / 1113 * k3 + 125 / 192 * k4 - 2187 / 6784 * k5 + 11 / 84 * k6);
+end
@@ -0,0 +1,249 @@
+//$ mex mex_integrate_kinematics.cpp # Maltab command for generating the MEX file
+/*******************************************************
+ * Fixed-step integration of the planar kinematic platform models for
+ * continuous_integration. All input segments of one block update are
+ * integrated in a single call, optionally for many platforms at once.
+ *
+ * X = mex_integrate_kinematics(X0, tBounds, U, params)
+ * Outputs:
+ * - X: Kx3 matrix of final poses [x, y, phi]
+ * Inputs:
+ * - X0: Kx3 matrix of initial poses (one row per platform)
+ * - tBounds: (S+1)-element vector of segment boundaries, segment s spans
+ *            [tBounds(s), tBounds(s + 1)]. Segments not longer than 1e-6
+ *            are skipped (same as continuous_integration with ode45).
+ * - U: S x M x K array of inputs, U(s, :, k) is the (constant) input of
+ *      platform k during segment s
+ * - params: struct with fields
+ *   .model - 'omni' (U = [vx, vy, omega], body-fixed velocities),
+ *            'vomega' (U = [v, omega]) or
+ *            'ddrive' (U = [omega_r, omega_l], wheel rotational rates)
+ *   .method - 'exact' (default), 'rk4' or 'dopri5'
+ *   .maxStep - (optional) maximum step size of 'rk4' and 'dopri5' in s,
+ *              0.01 by default. Each segment is split into equal steps.
+ *   .wheelRadius - ('ddrive' only) [right, left] or a single radius in m
+ *   .wheelDistance - ('ddrive' only) distance between the wheels in m
+ *
+ * All models reduce to constant body-fixed velocities [vx, vy, omega]
+ * during a segment. 'exact' integrates them in closed form (the robot
+ * moves on a circular arc), 'rk4' is the classic Runge-Kutta method and
+ * 'dopri5' the fifth order solution of the Dormand-Prince pair (the
+ * tableau of ode45) without step size control.
+ */
+
+#include "mex.h"
+#include "matrix.h"
+#include <cmath>
+#include <string.h>
+
+#define INDEX_IN_POSES      0
+#define INDEX_IN_BOUNDS     1
+#define INDEX_IN_INPUTS     2
+#define INDEX_IN_PARAMS     3
+#define IN_COUNT            4
+
+#define INDEX_OUT_POSES     0
+#define OUT_COUNT           1
+
+#define POSE_SIZE 3
+#define MIN_SEGMENT 1e-6
+
+enum Model {
+    MODEL_OMNI,
+    MODEL_VOMEGA,
+    MODEL_DDRIVE
+};
+
+enum Method {
+    METHOD_EXACT,
+    METHOD_RK4,
+    METHOD_DOPRI5
+};
+
+struct Parameters {
+    Model model;
+    Method method;
+    double maxStep;
+    double wheelRadius[2];
+    double wheelDistance;
+};
+
+// body-fixed velocities [vx, vy, omega] from the model input
+static void bodyVelocities(const Parameters &params, const double *u, double v[3]) {
+    switch (params.model) {
+    case MODEL_OMNI:
+        v[0] = u[0];
+        v[1] = u[1];
+        v[2] = u[2];
+        break;
+    case MODEL_VOMEGA:
+        v[0] = u[0];
+        v[1] = 0.0;
+        v[2] = u[1];
+        break;
+    case MODEL_DDRIVE:
+        v[0] = (params.wheelRadius[0] * u[0] + params.wheelRadius[1] * u[1]) / 2.0;
+        v[1] = 0.0;
+        v[2] = (params.wheelRadius[0] * u[0] - params.wheelRadius[1] * u[1]) / params.wheelDistance;
+        break;
+    }
+}
+
+static void derivative(const double *x, const double v[3], double *dx) {
+    double c = std::cos(x[2]), s = std::sin(x[2]);
+    dx[0] = c * v[0] - s * v[1];
+    dx[1] = s * v[0] + c * v[1];
+    dx[2] = v[2];
+}
+
+// closed form: the heading changes linearly, the translation is the
+// integral of the rotated body velocity. sin(h) / h keeps it accurate for
+// small rotations.
+static void integrateExact(double *x, const double v[3], double dt) {
+    double h = 0.5 * v[2] * dt;
+    double length = h != 0.0 ? dt * std::sin(h) / h : dt;
+    double c = std::cos(x[2] + h) * length, s = std::sin(x[2] + h) * length;
+    x[0] += c * v[0] - s * v[1];
+    x[1] += s * v[0] + c * v[1];
+    x[2] += 2.0 * h;
+}
+
+static void stepRK4(double *x, const double v[3], double h) {
+    double k1[POSE_SIZE], k2[POSE_SIZE], k3[POSE_SIZE], k4[POSE_SIZE], xt[POSE_SIZE];
+    derivative(x, v, k1);
+    for (int i = 0; i < POSE_SIZE; i++) xt[i] = x[i] + 0.5 * h * k1[i];
+    derivative(xt, v, k2);
+    for (int i = 0; i < POSE_SIZE; i++) xt[i] = x[i] + 0.5 * h * k2[i];
+    derivative(xt, v, k3);
+    for (int i = 0; i < POSE_SIZE; i++) xt[i] = x[i] + h * k3[i];
+    derivative(xt, v, k4);
+    for (int i = 0; i < POSE_SIZE; i++) x[i] += h / 6.0 * (k1[i] + 2.0 * k2[i] + 2.0 * k3[i] + k4[i]);
+}
+
+// Dormand-Prince tableau (the seventh stage is only needed for the error estimate)
+static const double DP_A[6][5] = {
+    { 0, 0, 0, 0, 0 },
+    { 1.0 / 5, 0, 0, 0, 0 },
+    { 3.0 / 40, 9.0 / 40, 0, 0, 0 },
+    { 44.0 / 45, -56.0 / 15, 32.0 / 9, 0, 0 },
+    { 19372.0 / 6561, -25360.0 / 2187, 64448.0 / 6561, -212.0 / 729, 0 },
+    { 9017.0 / 3168, -355.0 / 33, 46732.0 / 5247, 49.0 / 176, -5103.0 / 18656 }
+};
+static const double DP_B[6] = { 35.0 / 384, 0, 500.0 / 1113, 125.0 / 192, -2187.0 / 6784, 11.0 / 84 };
+
+static void stepDopri5(double *x, const double v[3], double h) {
+    double k[6][POSE_SIZE], xt[POSE_SIZE];
+    for (int stage = 0; stage < 6; stage++) {
+        for (int i = 0; i < POSE_SIZE; i++) {
+            xt[i] = x[i];
+            for (int j = 0; j < stage; j++) xt[i] += h * DP_A[stage][j] * k[j][i];
+        }
+        derivative(xt, v, k[stage]);
+    }
+    for (int i = 0; i < POSE_SIZE; i++) {
+        for (int stage = 0; stage < 6; stage++) x[i] += h * DP_B[stage] * k[stage][i];
+    }
+}
+
+static void integrateSegment(const Parameters &params, double *x, const double v[3], double dt) {
+    if (params.method == METHOD_EXACT) {
+        integrateExact(x, v, dt);
+        return;
+    }
+    double steps = std::ceil(dt / params.maxStep);
+    double h = dt / steps;
+    for (double i = 0; i < steps; i++) {
+        if (params.method == METHOD_RK4) stepRK4(x, v, h);
+        else stepDopri5(x, v, h);
+    }
+}
+
+static double getScalarField(const mxArray *mxStruct, const char *name, bool required, double defaultValue) {
+    const mxArray *mxField = mxGetField(mxStruct, 0, name);
+    if (!mxField) {
+        if (required) mexErrMsgIdAndTxt("mex_integrate_kinematics:params", "Parameter '%s' missing", name);
+        return defaultValue;
+    }
+    if (!mxIsDouble(mxField) || mxIsComplex(mxField) || mxGetNumberOfElements(mxField) != 1)
+        mexErrMsgIdAndTxt("mex_integrate_kinematics:params", "Parameter '%s' must be a real double scalar", name);
+    return mxGetScalar(mxField);
+}
+
+static int getStringField(const mxArray *mxStruct, const char *name, const char *const *values, int count, int defaultValue) {
+    const mxArray *mxField = mxGetField(mxStruct, 0, name);
+    if (!mxField) {
+        if (defaultValue < 0) mexErrMsgIdAndTxt("mex_integrate_kinematics:params", "Parameter '%s' missing", name);
+        return defaultValue;
+    }
+    char value[16];
+    if (!mxIsChar(mxField) || mxGetString(mxField, value, sizeof(value)) != 0)
+        mexErrMsgIdAndTxt("mex_integrate_kinematics:params", "Parameter '%s' must be a (short) string", name);
+    for (int i = 0; i < count; i++) {
+        if (strcmp(value, values[i]) == 0) return i;
+    }
+    mexErrMsgIdAndTxt("mex_integrate_kinematics:params", "Unknown %s '%s'", name, value);
+    return defaultValue;
+}
+
+static Parameters getParameters(const mxArray *mxParams) {
+    static const char *const MODELS[] = { "omni", "vomega", "ddrive" };
+    static const char *const METHODS[] = { "exact", "rk4", "dopri5" };
+    if (!mxIsStruct(mxParams) || mxGetNumberOfElements(mxParams) != 1)
+        mexErrMsgTxt("Input argument 'params' must be a scalar struct");
+
+    Parameters params;
+    params.model = (Model)getStringField(mxParams, "model", MODELS, 3, -1);
+    params.method = (Method)getStringField(mxParams, "method", METHODS, 3, METHOD_EXACT);
+    params.maxStep = getScalarField(mxParams, "maxStep", false, 0.01);
+    if (!(params.maxStep > 0.0)) mexErrMsgTxt("Parameter 'maxStep' must be positive");
+    if (params.model == MODEL_DDRIVE) {
+        const mxArray *mxRadius = mxGetField(mxParams, 0, "wheelRadius");
+        if (!mxRadius || !mxIsDouble(mxRadius) || mxIsComplex(mxRadius) || mxIsEmpty(mxRadius) || mxGetNumberOfElements(mxRadius) > 2)
+            mexErrMsgTxt("Parameter 'wheelRadius' must be a real double scalar or two-element vector");
+        params.wheelRadius[0] = mxGetPr(mxRadius)[0];
+        params.wheelRadius[1] = mxGetPr(mxRadius)[mxGetNumberOfElements(mxRadius) - 1];
+        params.wheelDistance = getScalarField(mxParams, "wheelDistance", true, 0.0);
+    }
+    return params;
+}
+
+static size_t inputSize(Model model) {
+    return model == MODEL_OMNI ? 3 : 2;
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    if (nrhs != IN_COUNT) mexErrMsgTxt("Four input arguments required");
+    if (nlhs > OUT_COUNT) mexErrMsgTxt("Too many output arguments");
+
+    const mxArray *mxPoses = prhs[INDEX_IN_POSES], *mxBounds = prhs[INDEX_IN_BOUNDS], *mxInputs = prhs[INDEX_IN_INPUTS];
+    Parameters params = getParameters(prhs[INDEX_IN_PARAMS]);
+
+    if (mxGetNumberOfDimensions(mxPoses) != 2 || mxGetN(mxPoses) != POSE_SIZE || !mxIsDouble(mxPoses) || mxIsComplex(mxPoses))
+        mexErrMsgTxt("Input argument 'X0' must be a Kx3 double matrix");
+    if (!mxIsDouble(mxBounds) || mxIsComplex(mxBounds) || mxIsEmpty(mxBounds))
+        mexErrMsgTxt("Input argument 'tBounds' must be a non-empty double vector");
+    size_t platformCount = mxGetM(mxPoses);
+    size_t segmentCount = mxGetNumberOfElements(mxBounds) - 1;
+    size_t m = inputSize(params.model);
+    if (!mxIsDouble(mxInputs) || mxIsComplex(mxInputs) || mxGetNumberOfElements(mxInputs) != segmentCount * m * platformCount ||
+        (segmentCount > 0 && mxGetM(mxInputs) != segmentCount))
+        mexErrMsgIdAndTxt("mex_integrate_kinematics:input", "Input argument 'U' must be a %u x %u x %u double array",
+                          (unsigned)segmentCount, (unsigned)m, (unsigned)platformCount);
+
+    plhs[INDEX_OUT_POSES] = mxDuplicateArray(mxPoses);
+    double *pPoses = mxGetPr(plhs[INDEX_OUT_POSES]);
+    const double *pBounds = mxGetPr(mxBounds), *pInputs = mxGetPr(mxInputs);
+    for (size_t k = 0; k < platformCount; k++) {
+        double x[POSE_SIZE] = { pPoses[k], pPoses[k + platformCount], pPoses[k + 2 * platformCount] };
+        const double *pU = pInputs + k * segmentCount * m;
+        for (size_t s = 0; s < segmentCount; s++) {
+            double dt = pBounds[s + 1] - pBounds[s];
+            if (!(dt > MIN_SEGMENT)) continue;
+            double u[3], v[3];
+            for (size_t j = 0; j < m; j++) u[j] = pU[s + j * segmentCount];
+            bodyVelocities(params, u, v);
+            integrateSegment(params, x, v, dt);
+        }
+        for (int i = 0; i < POSE_SIZE; i++) pPoses[k + i * platformCount] = x[i];
+    }
+}
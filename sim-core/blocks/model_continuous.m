@@ -4,9 +4,12 @@ function model = model_continuous(initialState, model_equations, input)
     model = block_base(0, input, @propagate);    
     model.log.uniform = true;
     model.default_initialState = initialState;
+    model.default_integration = 'ode45';    % or 'rk4' or 'dopri5' (fixed step, see continuous_integration)
+    model.default_maxStep = 0.01;           % step size of 'rk4' and 'dopri5' in s
     
     function [state, out, debugOut] = propagate(block, t, state, in)
         debugOut = [];
-        [state, out] = continuous_integration(model_equations, block.initialtate, t, state, in);        
+        [state, out] = continuous_integration(model_equations, block.initialtate, t, state, in, ...
+                                              struct('method', block.integration, 'maxStep', block.maxStep));        
     end   
 end
@@ -39,6 +39,27 @@
 %                          per block (i.e. per folder), possibly
 %                          accompanied with more data from the outFiles and
 %                          debugFiles mechanism.
+% - profile: (optional) measure where the simulation time is spent. Set
+%            to true or to a struct with the optional fields
+%            .capacity - number of recorded spans for the trace (default:
+%                        1e6)
+%            .traceFile - file for the Chrome trace (chrome://tracing,
+%                         Perfetto) that simulate.m writes at the end
+%            The engine records the phases process, inputs, unload, log,
+%            schedule and draw per block (see mex_profiler.cpp) and
+%            returns p50/p99/max durations and the log memory per block
+%            from getProfile(). simulate_unattended stores them in the
+%            results. Without this field the overhead is a single test
+%            per phase.
+% - checkpointInterval: (optional) simulation time in s between two
+%                       snapshots of all block states (default: 10, inf:
+%                       only the initial state). After a change of block
+%                       parameters, recomputeBlocks() of the engine
+%                       restarts from the most recent checkpoint and
+%                       recomputes only the changed blocks and the blocks
+%                       depending on them. All other blocks replay their
+%                       logs. Shorter intervals need more memory for the
+%                       snapshots.
 % 'Group' paramenters:
 % Besides the fields common to each block, all blocks may have additional
 % parameters and settings that are specific to their function. The
@@ -0,0 +1,281 @@
+//$ mex mex_block_scheduler.cpp -I../tools/mex/include # Maltab command for generating the MEX file
+/*******************************************************
+ * Timing and dependency bookkeeping for simulator_engine. The scheduler
+ * decides which block is processed next, the blocks themselves are processed
+ * in Matlab (see processBlock in simulator_engine.m).
+ *
+ * Construction: scheduler = mex_object_handle(@mex_block_scheduler, opts)
+ * opts: struct with fields (N = number of blocks)
+ *   .deltaT - 1xN vector, timing.deltaT of each block (> 0: discrete, 0: continuous)
+ *   .nextTime - 1xN vector, next processing time of each block (inf for continuous blocks)
+ *   .lastTime - 1xN vector, time of the last output of each block (-inf initially)
+ *   .depends - 1xN cell array, indices of the input blocks of each block
+ *   .triggers - 1xN cell array, indices of the blocks triggered by each block
+ *
+ * [iBlock, t] = mex_block_scheduler(scheduler.key, 'next'[, result])
+ * Returns the next block to process and the simulation time to process it at.
+ * iBlock is 0 when all blocks of the current time step have been processed,
+ * the following call starts the next time step. The optional struct result
+ * reports the outcome of the block returned by the previous call:
+ *   .produced - true if the block generated output
+ *   .nextTime - next processing time of the block
+ * Calling 'next' without a result while a block is pending abandons the
+ * current time step (e.g. after an error in a process function).
+ *
+ * Scheduling rules (same as the recursive processBlock they replace):
+ * - each time step starts with the discrete block with the smallest nextTime
+ *   (the lowest index for equal times) and continues with further blocks
+ *   scheduled for the same time, e.g. by triggers
+ * - before a block is processed, its inputs are processed depth first in the
+ *   order of .depends, if they are due: discrete inputs with nextTime <= t
+ *   and continuous inputs with lastTime < t
+ * - blocks with lastTime >= t and blocks that are waiting for their own
+ *   inputs (dependency cycles) are skipped
+ * - blocks producing output trigger their .triggers blocks: discrete blocks
+ *   with lastTime < t are due at t
+ * Due blocks are kept in a binary heap keyed on nextTime, so picking the next
+ * block does not depend on the total number of blocks.
+ */
+
+#include "mex.h"
+#include "matrix.h"
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <mex/object_manager.hpp>
+
+struct BlockTiming {
+    bool discrete;
+    bool continuous;
+    double nextTime;
+    double lastTime;
+    bool locked;
+    std::vector<int> depends;  // zero-based block indices
+    std::vector<int> triggers;
+};
+
+class BlockScheduler {
+public:
+    BlockScheduler(const std::vector<BlockTiming> &blocks):
+        blocks_(blocks), stepTime_(0.0), inStep_(false), pending_(-1) {
+        for (size_t i = 0; i < blocks_.size(); i++) schedule((int)i);
+    }
+
+    bool hasPending() const { return pending_ >= 0; }
+
+    // returns the zero-based index of the next block to process at time t,
+    // -1 at the end of the time step
+    int next(double &t) {
+        if (pending_ >= 0) throw std::runtime_error("Result of the previous block missing");
+        if (!inStep_) {
+            int root;
+            stepTime_ = firstDue(root);
+            if (std::isinf(stepTime_)) throw std::runtime_error("Cannot determine next block due to an unsupported combination of block timings.");
+            inStep_ = true;
+        }
+        t = stepTime_;
+
+        while (true) {
+            while (!stack_.empty()) {
+                Frame &frame = stack_.back();
+                const BlockTiming &block = blocks_[frame.block];
+                if (frame.nextInput < block.depends.size()) {
+                    int input = block.depends[frame.nextInput++];
+                    if (isDue(input)) visit(input); // invalidates frame
+                    continue;
+                }
+                // all inputs are available
+                pending_ = frame.block;
+                stack_.pop_back();
+                return pending_;
+            }
+
+            int root;
+            double tRoot = firstDue(root);
+            if (tRoot > stepTime_) {
+                inStep_ = false;
+                return -1;
+            }
+            t = stepTime_ = tRoot;
+            if (!visit(root)) throw std::runtime_error("Block scheduling stalled: the next block has already been processed");
+        }
+    }
+
+    // outcome of the block returned by next()
+    void complete(bool produced, double nextTime) {
+        if (pending_ < 0) throw std::runtime_error("No block pending");
+        BlockTiming &block = blocks_[pending_];
+        block.locked = false;
+        if (produced) {
+            block.lastTime = stepTime_;
+            // fire triggers
+            for (size_t i = 0; i < block.triggers.size(); i++) {
+                BlockTiming &triggered = blocks_[block.triggers[i]];
+                if (triggered.discrete && triggered.lastTime < stepTime_) {
+                    triggered.nextTime = stepTime_;
+                    schedule(block.triggers[i]);
+                }
+            }
+        }
+        block.nextTime = nextTime;
+        schedule(pending_);
+        pending_ = -1;
+    }
+
+    // drop the remaining blocks of the current time step
+    void abandonStep() {
+        for (size_t i = 0; i < stack_.size(); i++) blocks_[stack_[i].block].locked = false;
+        stack_.clear();
+        if (pending_ >= 0) blocks_[pending_].locked = false;
+        pending_ = -1;
+        inStep_ = false;
+    }
+
+private:
+    struct Frame {
+        int block;
+        size_t nextInput;
+    };
+    typedef std::pair<double, int> QueueEntry;
+
+    bool isDue(int i) const {
+        const BlockTiming &block = blocks_[i];
+        return (block.discrete && block.nextTime <= stepTime_) || (block.continuous && block.lastTime < stepTime_);
+    }
+
+    // start processing block i and its inputs, if it is not already processed
+    bool visit(int i) {
+        BlockTiming &block = blocks_[i];
+        if (block.locked || block.lastTime >= stepTime_) return false;
+        block.locked = true;
+        Frame frame = {i, 0};
+        stack_.push_back(frame);
+        return true;
+    }
+
+    // entries are not removed when nextTime changes; outdated entries are
+    // dropped when they reach the top of the heap
+    void schedule(int i) {
+        const BlockTiming &block = blocks_[i];
+        if (block.discrete && !std::isinf(block.nextTime) && !std::isnan(block.nextTime))
+            queue_.push(QueueEntry(block.nextTime, i));
+    }
+
+    double firstDue(int &i) {
+        while (!queue_.empty()) {
+            const QueueEntry &top = queue_.top();
+            if (top.first == blocks_[top.second].nextTime) {
+                i = top.second;
+                return top.first;
+            }
+            queue_.pop();
+        }
+        i = -1;
+        return HUGE_VAL;
+    }
+
+    std::vector<BlockTiming> blocks_;
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry> > queue_;
+    std::vector<Frame> stack_;
+    double stepTime_;
+    bool inStep_;
+    int pending_;
+};
+
+enum SchedulerMethod {
+    METHOD_NEXT
+};
+
+static const mxArray *getField(const mxArray *mxStruct, const char *name) {
+    const mxArray *mxField = mxGetField(mxStruct, 0, name);
+    if (!mxField) throw std::runtime_error(std::string("Parameter '") + name + "' missing");
+    return mxField;
+}
+
+static const double *getVectorField(const mxArray *mxStruct, const char *name, size_t count) {
+    const mxArray *mxField = getField(mxStruct, name);
+    if (!mxIsDouble(mxField) || mxIsComplex(mxField) || mxGetNumberOfElements(mxField) != count)
+        throw std::runtime_error(std::string("Parameter '") + name + "' must be a real double vector with one element per block");
+    return mxGetPr(mxField);
+}
+
+static std::vector<int> getIndices(const mxArray *mxIndices, size_t blockCount, const char *name) {
+    std::vector<int> indices;
+    if (!mxIndices || mxIsEmpty(mxIndices)) return indices;
+    if (!mxIsDouble(mxIndices) || mxIsComplex(mxIndices))
+        throw std::runtime_error(std::string("Entries of '") + name + "' must be real double vectors");
+    const double *pIndices = mxGetPr(mxIndices);
+    for (size_t i = 0; i < mxGetNumberOfElements(mxIndices); i++) {
+        if (!(pIndices[i] >= 1 && pIndices[i] <= blockCount) || pIndices[i] != std::floor(pIndices[i]))
+            throw std::runtime_error(std::string("Invalid block index in '") + name + "'");
+        indices.push_back((int)pIndices[i] - 1);
+    }
+    return indices;
+}
+
+static double getScalar(const mxArray *mxStruct, const char *name) {
+    const mxArray *mxField = getField(mxStruct, name);
+    if (!(mxIsNumeric(mxField) || mxIsLogical(mxField)) || mxIsComplex(mxField) || mxGetNumberOfElements(mxField) != 1)
+        throw std::runtime_error(std::string("Parameter '") + name + "' must be a real scalar");
+    return mxGetScalar(mxField);
+}
+
+class BlockSchedulerManager: public mex::object_manager<BlockScheduler> {
+public:
+    BlockSchedulerManager() {
+        setConstructionRequiresArgument(true);
+        addMethod("next", METHOD_NEXT);
+    }
+
+    virtual BlockScheduler *create(const mxArray *mxOpts) {
+        const mxArray *mxDeltaT = getField(mxOpts, "deltaT");
+        size_t count = mxGetNumberOfElements(mxDeltaT);
+        const double *pDeltaT = getVectorField(mxOpts, "deltaT", count);
+        const double *pNextTime = getVectorField(mxOpts, "nextTime", count);
+        const double *pLastTime = getVectorField(mxOpts, "lastTime", count);
+        const mxArray *mxDepends = getField(mxOpts, "depends");
+        const mxArray *mxTriggers = getField(mxOpts, "triggers");
+        if (!mxIsCell(mxDepends) || mxGetNumberOfElements(mxDepends) != count ||
+            !mxIsCell(mxTriggers) || mxGetNumberOfElements(mxTriggers) != count)
+            throw std::runtime_error("Parameters 'depends' and 'triggers' must be cell arrays with one cell per block");
+
+        std::vector<BlockTiming> blocks(count);
+        for (size_t i = 0; i < count; i++) {
+            blocks[i].discrete = pDeltaT[i] > 0.0;
+            blocks[i].continuous = pDeltaT[i] == 0.0;
+            blocks[i].nextTime = pNextTime[i];
+            blocks[i].lastTime = pLastTime[i];
+            blocks[i].locked = false;
+            blocks[i].depends = getIndices(mxGetCell(mxDepends, i), count, "depends");
+            blocks[i].triggers = getIndices(mxGetCell(mxTriggers, i), count, "triggers");
+        }
+        return new BlockScheduler(blocks);
+    }
+
+    virtual void invoke(BlockScheduler &scheduler, int methodId, const mxArray *mxOpts, int nlhs, mxArray *plhs[]) {
+        if (nlhs > 2) throw std::runtime_error("Too many output arguments");
+        if (methodId == METHOD_NEXT) {
+            if (mxOpts) scheduler.complete(getScalar(mxOpts, "produced") != 0.0, getScalar(mxOpts, "nextTime"));
+            else if (scheduler.hasPending()) scheduler.abandonStep();
+
+            double t;
+            int iBlock = scheduler.next(t);
+            plhs[0] = mxCreateDoubleScalar(iBlock + 1);
+            if (nlhs > 1) plhs[1] = mxCreateDoubleScalar(t);
+        }
+    }
+};
+
+static BlockSchedulerManager schedulerManager;
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    try {
+        schedulerManager.mexFunction(nlhs, plhs, nrhs, prhs);
+    } catch (const std::exception &e) {
+        mexErrMsgIdAndTxt("mex_block_scheduler:error", "%s", e.what());
+    }
+}
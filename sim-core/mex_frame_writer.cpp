@@ -0,0 +1,459 @@
+//$ mex mex_frame_writer.cpp -I../tools/mex/include -lz # Maltab command for generating the MEX file
+/*******************************************************
+ * Video frame writer for videoRecorder.m that encodes in the background.
+ * Frames are copied into a bounded queue and a writer thread converts and
+ * writes them, so recording does not stall the simulation on encoding.
+ * Two formats are supported, both intended for muxing/transcoding with
+ * ffmpeg afterwards:
+ * - 'y4m': uncompressed YUV4MPEG2 stream (4:4:4, BT.601), e.g.
+ *          ffmpeg -i video.y4m -vcodec h264 -qp 26 video.mp4
+ * - 'png': PNG sequence <base>_000001.png, ... and the concat script
+ *          <base>.ffconcat with the display duration of each image, e.g.
+ *          ffmpeg -i video.ffconcat -vcodec h264 -qp 26 -r 10 video.mp4
+ * In both cases, <base>-timestamps.txt lists the output frame index,
+ * time and chapter of each added frame.
+ *
+ * Construction: writer = mex_object_handle(@mex_frame_writer, opts)
+ * opts: struct with fields
+ *   .file - output file name (for 'png' the extension is replaced)
+ *   .format - 'y4m' or 'png'
+ *   .frameRate - (optional) frames per second (default: 10)
+ *   .queueLength - (optional) number of queued frames (default: 32)
+ *   .dropFrames - (optional) if true, a frame added while the queue is
+ *                 full is dropped and the last queued frame is shown
+ *                 longer instead, otherwise addition blocks until there is
+ *                 space (default: false)
+ *   .compression - (optional) zlib level for 'png', 0 to 9 (default: 1)
+ *
+ * Methods:
+ *   writer.invoke('add', 'frame', frame, 'repeat', n, 'time', t, 'chapter', c)
+ *       Queues the HxWx3 uint8 image frame (e.g. getframe(...).cdata),
+ *       shown for n (default: 1) output frames. t and c (default: 0) are
+ *       recorded in the timestamp file. Without frame, the previous frame
+ *       is shown n frames longer. Fails with the error of the writer
+ *       thread, if any.
+ *   stats = writer.invoke('stats')
+ *       Struct with the number of frames .queued, .written (added frames,
+ *       without repetitions) and .dropped
+ *   stats = writer.invoke('close')
+ *       Writes all queued frames and closes the files, returns the stats.
+ *       Deleting the handle closes as well, but ignores write errors.
+ */
+
+#include "mex.h"
+#include "matrix.h"
+#include <zlib.h>
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <mex/object_manager.hpp>
+
+enum FrameFormat {
+    FORMAT_Y4M,
+    FORMAT_PNG
+};
+
+struct Frame {
+    std::vector<uint8_t> pixels; // HxWx3 in Matlab (column major) order, empty to repeat the previous frame
+    size_t width, height;
+    size_t repeat;
+    double time;
+    int chapter;
+};
+
+typedef std::unique_ptr<FILE, int (*)(FILE *)> FilePtr;
+
+static FilePtr openFile(const std::string &name, const char *mode) {
+    FilePtr file(fopen(name.c_str(), mode), fclose);
+    if (!file) throw std::runtime_error("Could not open '" + name + "' for writing");
+    return file;
+}
+
+static void writeOrThrow(FILE *file, const void *data, size_t size) {
+    if (fwrite(data, 1, size, file) != size) throw std::runtime_error("Could not write video data (disk full?)");
+}
+
+static void putUint32(std::vector<uint8_t> &buffer, uint32_t value) {
+    buffer.push_back((uint8_t)(value >> 24));
+    buffer.push_back((uint8_t)(value >> 16));
+    buffer.push_back((uint8_t)(value >> 8));
+    buffer.push_back((uint8_t)value);
+}
+
+static void putChunk(std::vector<uint8_t> &png, const char *type, const uint8_t *data, size_t size) {
+    putUint32(png, (uint32_t)size);
+    size_t start = png.size();
+    png.insert(png.end(), type, type + 4);
+    png.insert(png.end(), data, data + size);
+    putUint32(png, (uint32_t)crc32(0, &png[start], (uInt)(png.size() - start)));
+}
+
+class FrameWriter {
+public:
+    FrameWriter(const std::string &file, FrameFormat format, double frameRate, size_t queueLength, bool dropFrames, int compression):
+        format_(format), frameRate_(frameRate), queueLength_(queueLength), dropFrames_(dropFrames), compression_(compression),
+        width_(0), height_(0), closing_(false), written_(0), dropped_(0),
+        output_(NULL, fclose), timestamps_(NULL, fclose), concat_(NULL, fclose), outputFrames_(0), pendingRepeat_(0) {
+        base_ = file;
+        size_t dot = file.find_last_of('.'), slash = file.find_last_of("/\\");
+        if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) base_ = file.substr(0, dot);
+        fileName_ = format == FORMAT_PNG ? base_ + ".png" : file;
+        writer_ = std::thread(&FrameWriter::run, this);
+    }
+
+    ~FrameWriter() {
+        try {
+            close();
+        } catch (...) {
+        }
+    }
+
+    // main thread: queues a frame (pixels NULL to repeat the previous one)
+    void add(const uint8_t *pixels, size_t width, size_t height, size_t repeat, double time, int chapter) {
+        if (pixels) {
+            if (format_ == FORMAT_Y4M && width_ > 0 && (width != width_ || height != height_))
+                throw std::runtime_error("The frame size must not change within a Y4M stream");
+            width_ = width;
+            height_ = height;
+        } else if (width_ == 0) return; // nothing to repeat yet
+        std::unique_ptr<Frame> frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            throwOnError();
+            if (closing_) throw std::runtime_error("The frame writer is closed");
+            if (queue_.size() >= queueLength_) {
+                if (dropFrames_) {
+                    // show the last queued frame longer instead
+                    queue_.back()->repeat += repeat;
+                    if (pixels) dropped_++;
+                    return;
+                }
+                notFull_.wait(lock, [this] { return queue_.size() < queueLength_ || !error_.empty(); });
+                throwOnError();
+            }
+            if (!pool_.empty()) {
+                frame = std::move(pool_.back());
+                pool_.pop_back();
+            }
+        }
+        // the writer thread only takes frames from the queue, so the space
+        // is still there after copying outside of the lock
+        if (!frame) frame.reset(new Frame());
+        frame->pixels.assign(pixels, pixels ? pixels + 3 * width * height : pixels);
+        frame->width = width;
+        frame->height = height;
+        frame->repeat = repeat;
+        frame->time = time;
+        frame->chapter = chapter;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(std::move(frame));
+        }
+        notEmpty_.notify_one();
+    }
+
+    mxArray *stats() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const char *fieldNames[] = { "queued", "written", "dropped" };
+        mxArray *mxStats = mxCreateStructMatrix(1, 1, 3, fieldNames);
+        mxSetField(mxStats, 0, "queued", mxCreateDoubleScalar((double)queue_.size()));
+        mxSetField(mxStats, 0, "written", mxCreateDoubleScalar((double)written_));
+        mxSetField(mxStats, 0, "dropped", mxCreateDoubleScalar((double)dropped_));
+        return mxStats;
+    }
+
+    // writes all queued frames and closes the files
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closing_ = true;
+        }
+        notEmpty_.notify_one();
+        if (writer_.joinable()) writer_.join();
+        std::lock_guard<std::mutex> lock(mutex_);
+        throwOnError();
+    }
+
+private:
+    // mutex_ held
+    void throwOnError() {
+        if (!error_.empty()) throw std::runtime_error(error_);
+    }
+
+    // writer thread
+    void run() {
+        for (;;) {
+            std::unique_ptr<Frame> frame;
+            bool failed;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                notEmpty_.wait(lock, [this] { return !queue_.empty() || closing_; });
+                if (queue_.empty()) break;
+                frame = std::move(queue_.front());
+                queue_.pop_front();
+                failed = !error_.empty();
+            }
+            notFull_.notify_one();
+            if (!failed) {
+                try {
+                    write(*frame);
+                } catch (const std::exception &e) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    error_ = e.what();
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!failed && !frame->pixels.empty()) written_++;
+            if (pool_.size() < queueLength_) pool_.push_back(std::move(frame));
+        }
+        try {
+            finish();
+        } catch (const std::exception &e) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (error_.empty()) error_ = e.what();
+        }
+        notFull_.notify_one();
+    }
+
+    // writer thread
+    void write(const Frame &frame) {
+        if (frame.pixels.empty()) {
+            if (format_ == FORMAT_Y4M) {
+                for (size_t i = 0; i < frame.repeat; i++) writeY4mFrame();
+            } else pendingRepeat_ += frame.repeat;
+            outputFrames_ += frame.repeat;
+            return;
+        }
+        if (!timestamps_) {
+            timestamps_ = openFile(base_ + "-timestamps.txt", "w");
+            fprintf(timestamps_.get(), "# frame time chapter (frame: zero-based index of the first output frame)\n");
+        }
+        fprintf(timestamps_.get(), "%lu %.6f %d\n", (unsigned long)outputFrames_, frame.time, frame.chapter);
+        if (format_ == FORMAT_Y4M) {
+            if (!output_) {
+                output_ = openFile(fileName_, "wb");
+                // frame rate as a fraction with 1/1000 resolution
+                unsigned long num = (unsigned long)std::floor(frameRate_ * 1000.0 + 0.5), den = 1000, a = num, b = den;
+                while (b != 0) { unsigned long r = a % b; a = b; b = r; }
+                fprintf(output_.get(), "YUV4MPEG2 W%lu H%lu F%lu:%lu Ip A1:1 C444\n",
+                        (unsigned long)frame.width, (unsigned long)frame.height, num / a, den / a);
+            }
+            toYuv(frame);
+            for (size_t i = 0; i < frame.repeat; i++) writeY4mFrame();
+        } else {
+            flushConcatEntry();
+            char number[16];
+            snprintf(number, sizeof(number), "_%06lu.png", (unsigned long)(written_ + 1));
+            pendingName_ = base_ + number;
+            writePng(pendingName_, frame);
+            pendingRepeat_ = frame.repeat;
+        }
+        outputFrames_ += frame.repeat;
+    }
+
+    // BT.601 limited range
+    void toYuv(const Frame &frame) {
+        size_t n = frame.width * frame.height;
+        yuv_.resize(3 * n);
+        const uint8_t *r = &frame.pixels[0], *g = r + n, *b = g + n;
+        for (size_t x = 0; x < frame.width; x++) {
+            for (size_t y = 0; y < frame.height; y++) {
+                size_t in = x * frame.height + y, out = y * frame.width + x;
+                int R = r[in], G = g[in], B = b[in];
+                yuv_[out] = (uint8_t)(((66 * R + 129 * G + 25 * B + 128) >> 8) + 16);
+                yuv_[n + out] = (uint8_t)(((-38 * R - 74 * G + 112 * B + 128) >> 8) + 128);
+                yuv_[2 * n + out] = (uint8_t)(((112 * R - 94 * G - 18 * B + 128) >> 8) + 128);
+            }
+        }
+    }
+
+    void writeY4mFrame() {
+        if (!output_) return;
+        writeOrThrow(output_.get(), "FRAME\n", 6);
+        writeOrThrow(output_.get(), &yuv_[0], yuv_.size());
+    }
+
+    void writePng(const std::string &name, const Frame &frame) {
+        // rows of RGB triples, each preceded by filter type 0
+        size_t stride = 1 + 3 * frame.width, n = frame.width * frame.height;
+        raw_.resize(stride * frame.height);
+        for (size_t y = 0; y < frame.height; y++) {
+            uint8_t *row = &raw_[y * stride];
+            row[0] = 0;
+            for (size_t x = 0; x < frame.width; x++) {
+                size_t in = x * frame.height + y;
+                row[1 + 3 * x] = frame.pixels[in];
+                row[2 + 3 * x] = frame.pixels[n + in];
+                row[3 + 3 * x] = frame.pixels[2 * n + in];
+            }
+        }
+        uLongf compressedSize = compressBound((uLong)raw_.size());
+        compressed_.resize(compressedSize);
+        if (compress2(&compressed_[0], &compressedSize, &raw_[0], (uLong)raw_.size(), compression_) != Z_OK)
+            throw std::runtime_error("Could not compress PNG image");
+
+        static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        png_.assign(signature, signature + sizeof(signature));
+        std::vector<uint8_t> header;
+        putUint32(header, (uint32_t)frame.width);
+        putUint32(header, (uint32_t)frame.height);
+        const uint8_t format[] = { 8, 2, 0, 0, 0 }; // 8 bit RGB, deflate, no interlace
+        header.insert(header.end(), format, format + sizeof(format));
+        putChunk(png_, "IHDR", &header[0], header.size());
+        putChunk(png_, "IDAT", &compressed_[0], compressedSize);
+        putChunk(png_, "IEND", NULL, 0);
+
+        FilePtr file = openFile(name, "wb");
+        writeOrThrow(file.get(), &png_[0], png_.size());
+        if (fclose(file.release()) != 0) throw std::runtime_error("Could not write '" + name + "'");
+    }
+
+    // the duration of a PNG image is known when the next one arrives
+    void flushConcatEntry() {
+        if (pendingName_.empty()) return;
+        if (!concat_) {
+            concat_ = openFile(base_ + ".ffconcat", "w");
+            fprintf(concat_.get(), "ffconcat version 1.0\n");
+        }
+        size_t slash = pendingName_.find_last_of("/\\");
+        fprintf(concat_.get(), "file '%s'\nduration %.6f\n",
+                pendingName_.substr(slash == std::string::npos ? 0 : slash + 1).c_str(), pendingRepeat_ / frameRate_);
+        pendingName_.clear();
+    }
+
+    void finish() {
+        flushConcatEntry();
+        const char *names[] = { "video", "timestamp", "concat" };
+        FILE *files[] = { output_.release(), timestamps_.release(), concat_.release() };
+        std::string failed;
+        for (int i = 0; i < 3; i++) {
+            if (files[i] && fclose(files[i]) != 0 && failed.empty()) failed = names[i];
+        }
+        if (!failed.empty()) throw std::runtime_error("Could not write the " + failed + " file (disk full?)");
+    }
+
+    FrameFormat format_;
+    double frameRate_;
+    size_t queueLength_;
+    bool dropFrames_;
+    int compression_;
+    std::string base_, fileName_;
+    size_t width_, height_; // of the last added frame, main thread only
+
+    std::mutex mutex_;
+    std::condition_variable notEmpty_, notFull_;
+    std::deque<std::unique_ptr<Frame> > queue_;
+    std::vector<std::unique_ptr<Frame> > pool_; // written frames, their buffers are reused
+    bool closing_;
+    std::string error_;  // first error of the writer thread
+    uint64_t written_, dropped_;
+    std::thread writer_;
+
+    // writer thread only
+    FilePtr output_, timestamps_, concat_;
+    uint64_t outputFrames_;
+    std::vector<uint8_t> yuv_, raw_, compressed_, png_;
+    std::string pendingName_;
+    size_t pendingRepeat_;
+};
+
+enum FrameWriterMethod {
+    METHOD_ADD,
+    METHOD_STATS,
+    METHOD_CLOSE
+};
+
+static double getScalar(const mxArray *mxOpts, const char *name, double defaultValue) {
+    const mxArray *mxField = mxOpts ? mxGetField(mxOpts, 0, name) : NULL;
+    if (!mxField) return defaultValue;
+    if (!(mxIsNumeric(mxField) || mxIsLogical(mxField)) || mxIsComplex(mxField) || mxGetNumberOfElements(mxField) != 1)
+        throw std::runtime_error(std::string("Parameter '") + name + "' must be a real scalar");
+    return mxGetScalar(mxField);
+}
+
+static std::string getString(const mxArray *mxOpts, const char *name) {
+    const mxArray *mxField = mxOpts ? mxGetField(mxOpts, 0, name) : NULL;
+    if (!mxField || !mxIsChar(mxField) || mxIsEmpty(mxField)) throw std::runtime_error(std::string("Parameter '") + name + "' must be a non-empty string");
+    char *str = mxArrayToString(mxField);
+    std::string s(str);
+    mxFree(str);
+    return s;
+}
+
+class FrameWriterManager: public mex::object_manager<FrameWriter> {
+public:
+    FrameWriterManager() {
+        setConstructionRequiresArgument(true);
+        addMethod("add", METHOD_ADD);
+        addMethod("stats", METHOD_STATS);
+        addMethod("close", METHOD_CLOSE);
+    }
+
+    virtual FrameWriter *create(const mxArray *mxOpts) {
+        std::string file = getString(mxOpts, "file");
+        std::string formatName = getString(mxOpts, "format");
+        FrameFormat format;
+        if (formatName == "y4m") format = FORMAT_Y4M;
+        else if (formatName == "png") format = FORMAT_PNG;
+        else throw std::runtime_error("Unsupported format '" + formatName + "', use 'y4m' or 'png'");
+        double frameRate = getScalar(mxOpts, "frameRate", 10.0);
+        double queueLength = getScalar(mxOpts, "queueLength", 32.0);
+        double compression = getScalar(mxOpts, "compression", 1.0);
+        if (!(frameRate >= 0.001 && frameRate <= 1000.0)) throw std::runtime_error("Parameter 'frameRate' must be within [0.001, 1000]");
+        if (!(queueLength >= 1.0 && queueLength <= 4096.0)) throw std::runtime_error("Parameter 'queueLength' must be within [1, 4096]");
+        if (!(compression >= 0.0 && compression <= 9.0)) throw std::runtime_error("Parameter 'compression' must be within [0, 9]");
+        return new FrameWriter(file, format, frameRate, (size_t)queueLength, getScalar(mxOpts, "dropFrames", 0.0) != 0.0, (int)compression);
+    }
+
+    virtual void invoke(FrameWriter &writer, int methodId, const mxArray *mxOpts, int nlhs, mxArray *plhs[]) {
+        switch (methodId) {
+        case METHOD_ADD: {
+            if (nlhs > 0) throw std::runtime_error("Too many output arguments");
+            double repeat = getScalar(mxOpts, "repeat", 1.0);
+            if (!(repeat >= 0.0 && repeat <= 1e9) || repeat != std::floor(repeat)) throw std::runtime_error("Parameter 'repeat' must be a non-negative integer");
+            const mxArray *mxFrame = mxOpts ? mxGetField(mxOpts, 0, "frame") : NULL;
+            const uint8_t *pixels = NULL;
+            size_t width = 0, height = 0;
+            if (mxFrame && !mxIsEmpty(mxFrame)) {
+                const mwSize *dims = mxGetDimensions(mxFrame);
+                if (mxGetClassID(mxFrame) != mxUINT8_CLASS || mxIsComplex(mxFrame) || mxGetNumberOfDimensions(mxFrame) != 3 || dims[2] != 3)
+                    throw std::runtime_error("Parameter 'frame' must be a HxWx3 uint8 image");
+                pixels = static_cast<const uint8_t *>(mxGetData(mxFrame));
+                height = dims[0];
+                width = dims[1];
+            }
+            if (repeat > 0 || pixels) writer.add(pixels, width, height, (size_t)repeat, getScalar(mxOpts, "time", 0.0), (int)getScalar(mxOpts, "chapter", 0.0));
+            break;
+        }
+        case METHOD_STATS:
+            if (nlhs > 1) throw std::runtime_error("Too many output arguments");
+            plhs[0] = writer.stats();
+            break;
+        case METHOD_CLOSE:
+            if (nlhs > 1) throw std::runtime_error("Too many output arguments");
+            writer.close();
+            plhs[0] = writer.stats();
+            break;
+        }
+    }
+};
+
+static FrameWriterManager frameWriterManager;
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    try {
+        frameWriterManager.mexFunction(nlhs, plhs, nrhs, prhs);
+    } catch (const std::exception &e) {
+        mexErrMsgIdAndTxt("mex_frame_writer:error", "%s", e.what());
+    }
+}
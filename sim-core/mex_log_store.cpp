@@ -0,0 +1,1286 @@
+//$ mex mex_log_store.cpp -I../tools/mex/include # Maltab command for generating the MEX file
+/*******************************************************
+ * Log storage for simulator_engine. Records are appended to fixed-size
+ * chunks, so existing records are never copied while a log grows. For each
+ * block, the store keeps
+ * - the time stamps of all records (sorted, used for binary search seeks)
+ * - the input indices of all records, i.e. indices into the logs of the
+ *   input blocks (see processBlock in simulator_engine.m)
+ * - typed columns for the out, debugOut and state records of uniform logs,
+ *   if the first record of the column is real numeric, logical or char data
+ * All other records (non-uniform logs, structs or cells in uniform logs) are
+ * opaque to the store. simulator_engine keeps them in chunked cell arrays,
+ * which shares their data with the blocks instead of copying it.
+ *
+ * Optionally, all records are streamed to a log file while they are
+ * appended, so saving an experiment only adds an index to the file. Logs
+ * opened from a saved log file are not resident: only the time stamps and
+ * the file offsets of the records are loaded, records are decoded from the
+ * memory mapped file when they are requested. The first 'export' of such a
+ * log loads all of its records (see LogStore::load). Log file format
+ * (machine byte order):
+ *   header: char[8] FILE_MAGIC, uint64 number of blocks
+ *   record entry: uint32 block (0-based), uint32 number of inputs,
+ *     uint64 payload size, payload: double t, per input uint32 count and
+ *     count double indices, out, debugOut and state encoded by
+ *     mex/serialize.hpp
+ *   index entry: uint32 INDEX_ENTRY, uint32 0, uint64 payload size,
+ *     payload: per block uint64 count, count double time stamps and count
+ *     uint64 record entry offsets
+ *   trailer (after each index): uint64 index offset, char[8] FILE_MAGIC
+ * Records are never removed from the file, truncated logs are dropped when
+ * the file is saved to a new file.
+ *
+ * Construction: store = mex_object_handle(@mex_log_store, opts)
+ * opts: struct with fields (N = number of blocks)
+ *   .chunkSize - number of records per chunk
+ *   .inputCount - 1xN vector, number of inputs of each block
+ *   .uniform - 1xN logical vector, true for blocks with uniform logs
+ *   .file - optional, path of the log file. A new log file is created
+ *           (and removed again, unless the store is saved), if
+ *           .indexOffset is not given.
+ *   .indexOffset - optional, open the existing log file .file with the index
+ *                  at .indexOffset (returned by 'save'). Data appended after
+ *                  this index is dropped.
+ *
+ * Methods (mex_log_store(store.key, method, opts), all indices are 1-based):
+ * opaque = 'append', opts: .block, .t, .inputs[, .out, .debugOut, .state]
+ *   Appends a record to the log of a block. .inputs is a cell array with the
+ *   input indices of each input. .out, .debugOut and .state are required for
+ *   uniform logs, the first record determines class and size of the typed
+ *   columns. With a log file, they are written for all logs. opaque is a
+ *   1x3 logical vector, true for the columns (out, debugOut, state) not
+ *   stored by the log store.
+ * record = 'record', opts: .block, .iteration
+ *   Struct with fields .iteration, .t, .out, .debugOut, .state (empty for
+ *   opaque columns of resident logs) and .inputs (cell array of input
+ *   indices)
+ * times = 'times', opts: .block, .iterations
+ *   Time stamps of the given records
+ * 'truncate', opts: .block, .count
+ *   Drops all records after the first .count records
+ * [positions, tNew] = 'seek', opts: .t
+ *   positions(i) is the last record of block i with a time stamp <= t (0 if
+ *   there is none), tNew is the most recent of these time stamps (>= 0)
+ * [positions, tNew] = 'stepForward'/'stepBackward', opts: .t, .positions
+ *   Moves the log positions to the next/previous time stamp in any log. The
+ *   current time is .t, tNew is inf when stepping beyond the end of all logs
+ *   (see incLogPosition/decLogPosition in simulator_engine.m)
+ * data = 'export', opts: .block
+ *   Log data in the format of saved experiments: .times (1xn), .inputs (a
+ *   linear array (0: no input) or a cell array per input) and .out,
+ *   .debugOut, .state (typed columns only, one record per column), .opaque
+ *   (see 'append'). When a log is loaded from the log file by this call, the
+ *   opaque columns hold 1xn cell arrays with the records.
+ * opaque = 'import', opts: .block, .count, .times, .inputs[, .out, .outSize, ...]
+ *   Replaces the log of a block with the first .count records of data in the
+ *   format returned by 'export'. Uniform logs require .out, .debugOut, .state
+ *   and the original record sizes .outSize, .debugOutSize, .stateSize. Not
+ *   supported with a log file.
+ * indexOffset = 'save', opts: .file
+ *   Writes the index to the log file and moves the log file to .file
+ * stats = 'stats' (no opts)
+ *   Memory held by the store, struct with 1xN fields .records, .bytes
+ *   (allocated chunk memory) and .allocations (number of chunks allocated
+ *   since the log was created, i.e. the number of times a log had to grow)
+ */
+
+#include "mex.h"
+#include "matrix.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <mex/object_manager.hpp>
+#include <mex/serialize.hpp>
+
+static const size_t COLUMN_COUNT = 3;
+static const char *COLUMN_NAMES[COLUMN_COUNT] = {"out", "debugOut", "state"};
+static const char *SIZE_NAMES[COLUMN_COUNT] = {"outSize", "debugOutSize", "stateSize"};
+// minimum time step when stepping through the logs (accommodates rounding errors)
+static const double TIME_TOLERANCE = 1e-7;
+// log file format, see above
+static const char FILE_MAGIC[] = "SIMLOG01";
+static const size_t MAGIC_SIZE = 8;
+static const uint32_t INDEX_ENTRY = 0xffffffffu;
+static const size_t ENTRY_HEADER_SIZE = 16;
+
+// Array of records with width elements each. Records are stored in chunks of
+// chunkSize records, appending never moves existing records.
+template <typename T>
+class ChunkedArray {
+public:
+    ChunkedArray(size_t chunkSize = 1, size_t width = 1): chunkSize_(chunkSize), width_(width), size_(0), allocations_(0) { }
+
+    size_t size() const { return size_; }
+    size_t bytes() const { return chunks_.size() * chunkSize_ * width_ * sizeof(T); }
+    size_t allocations() const { return allocations_; }
+    const T *at(size_t i) const { return chunks_[i / chunkSize_].get() + (i % chunkSize_) * width_; }
+
+    // returns the storage for the new record
+    T *append() {
+        size_t iChunk = size_ / chunkSize_;
+        if (iChunk == chunks_.size()) {
+            chunks_.push_back(std::unique_ptr<T[]>(new T[chunkSize_ * width_]));
+            allocations_++;
+        }
+        return chunks_[iChunk].get() + (size_++ % chunkSize_) * width_;
+    }
+
+    void truncate(size_t count) {
+        if (count >= size_) return;
+        size_ = count;
+        chunks_.resize((count + chunkSize_ - 1) / chunkSize_);
+    }
+
+    // copy records [begin, end) to a contiguous array
+    void copyTo(T *pDest, size_t begin, size_t end) const {
+        while (begin < end) {
+            size_t count = std::min(end - begin, chunkSize_ - begin % chunkSize_);
+            std::copy(at(begin), at(begin) + count * width_, pDest);
+            pDest += count * width_;
+            begin += count;
+        }
+    }
+
+    // number of leading records, whose first element satisfies pred. pred
+    // must be true for a (possibly empty) prefix of the array only.
+    template <typename Pred>
+    size_t partitionPoint(Pred pred) const {
+        // first search the chunks, then the records of the last matching chunk
+        size_t lo = 0, hi = chunks_.size();
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (pred(chunks_[mid][0])) lo = mid + 1;
+            else hi = mid;
+        }
+        if (lo == 0) return 0;
+        size_t begin = (lo - 1) * chunkSize_;
+        const T *pChunk = chunks_[lo - 1].get();
+        hi = std::min(size_, begin + chunkSize_) - begin;
+        lo = 1;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (pred(pChunk[mid * width_])) lo = mid + 1;
+            else hi = mid;
+        }
+        return begin + lo;
+    }
+
+private:
+    size_t chunkSize_, width_, size_, allocations_;
+    std::vector<std::unique_ptr<T[]> > chunks_;
+};
+
+// real numeric, logical and char data can be stored in typed columns
+static bool isTypedData(const mxArray *mxData) {
+    return (mxIsNumeric(mxData) || mxIsLogical(mxData) || mxIsChar(mxData)) && !mxIsComplex(mxData) && !mxIsSparse(mxData);
+}
+
+static double readElement(mxClassID classId, const void *pData, size_t i) {
+    switch (classId) {
+    case mxDOUBLE_CLASS: return static_cast<const double *>(pData)[i];
+    case mxSINGLE_CLASS: return static_cast<const float *>(pData)[i];
+    case mxINT8_CLASS: return static_cast<const int8_t *>(pData)[i];
+    case mxUINT8_CLASS: return static_cast<const uint8_t *>(pData)[i];
+    case mxINT16_CLASS: return static_cast<const int16_t *>(pData)[i];
+    case mxUINT16_CLASS: return static_cast<const uint16_t *>(pData)[i];
+    case mxINT32_CLASS: return static_cast<const int32_t *>(pData)[i];
+    case mxUINT32_CLASS: return static_cast<const uint32_t *>(pData)[i];
+    case mxINT64_CLASS: return (double)static_cast<const int64_t *>(pData)[i];
+    case mxUINT64_CLASS: return (double)static_cast<const uint64_t *>(pData)[i];
+    case mxLOGICAL_CLASS: return static_cast<const mxLogical *>(pData)[i] ? 1.0 : 0.0;
+    case mxCHAR_CLASS: return static_cast<const mxChar *>(pData)[i];
+    default: throw std::runtime_error("Unsupported data class");
+    }
+}
+
+// same rules as Matlab: round to nearest and saturate, NaN is converted to 0
+template <typename T>
+static void writeInteger(void *pData, size_t i, double value) {
+    T &dest = static_cast<T *>(pData)[i];
+    if (std::isnan(value)) dest = 0;
+    else if (value <= (double)std::numeric_limits<T>::min()) dest = std::numeric_limits<T>::min();
+    else if (value >= (double)std::numeric_limits<T>::max()) dest = std::numeric_limits<T>::max();
+    else dest = (T)std::round(value);
+}
+
+static void writeElement(mxClassID classId, void *pData, size_t i, double value) {
+    switch (classId) {
+    case mxDOUBLE_CLASS: static_cast<double *>(pData)[i] = value; break;
+    case mxSINGLE_CLASS: static_cast<float *>(pData)[i] = (float)value; break;
+    case mxINT8_CLASS: writeInteger<int8_t>(pData, i, value); break;
+    case mxUINT8_CLASS: writeInteger<uint8_t>(pData, i, value); break;
+    case mxINT16_CLASS: writeInteger<int16_t>(pData, i, value); break;
+    case mxUINT16_CLASS: writeInteger<uint16_t>(pData, i, value); break;
+    case mxINT32_CLASS: writeInteger<int32_t>(pData, i, value); break;
+    case mxUINT32_CLASS: writeInteger<uint32_t>(pData, i, value); break;
+    case mxINT64_CLASS: writeInteger<int64_t>(pData, i, value); break;
+    case mxUINT64_CLASS: writeInteger<uint64_t>(pData, i, value); break;
+    case mxLOGICAL_CLASS: static_cast<mxLogical *>(pData)[i] = (value != 0.0); break;
+    case mxCHAR_CLASS: writeInteger<mxChar>(pData, i, value); break;
+    default: throw std::runtime_error("Unsupported data class");
+    }
+}
+
+static mxArray *createArray(mxClassID classId, const std::vector<mwSize> &dims) {
+    if (classId == mxCHAR_CLASS) return mxCreateCharArray(dims.size(), &dims[0]);
+    if (classId == mxLOGICAL_CLASS) return mxCreateLogicalArray(dims.size(), &dims[0]);
+    return mxCreateNumericArray(dims.size(), &dims[0], classId, mxREAL);
+}
+
+// out, debugOut or state records of a block
+class Column {
+public:
+    enum Kind {
+        UNDEFINED, // uniform log without records
+        TYPED,     // records are stored by the log store
+        OPAQUE     // records are stored by simulator_engine
+    };
+
+    Column(): kind_(UNDEFINED), classId_(mxUNKNOWN_CLASS), elementCount_(0), elementSize_(0) { }
+
+    Kind kind() const { return kind_; }
+
+    void reset(Kind kind) {
+        kind_ = kind;
+        data_ = ChunkedArray<unsigned char>();
+    }
+
+    // select the storage from the first record (or data with records as columns)
+    void define(const mxArray *mxData, const std::vector<mwSize> &dims, size_t chunkSize) {
+        if (!isTypedData(mxData)) {
+            reset(OPAQUE);
+            return;
+        }
+        kind_ = TYPED;
+        classId_ = mxGetClassID(mxData);
+        dims_ = dims;
+        elementCount_ = 1;
+        for (size_t i = 0; i < dims_.size(); i++) elementCount_ *= dims_[i];
+        elementSize_ = mxGetElementSize(mxData);
+        data_ = ChunkedArray<unsigned char>(chunkSize, elementCount_ * elementSize_);
+    }
+
+    void check(const mxArray *mxRecord, const char *name) const {
+        if (!isTypedData(mxRecord))
+            throw std::runtime_error(std::string("Records of uniform log column '") + name + "' must keep their data class (numeric, logical or char)");
+        if (mxGetNumberOfElements(mxRecord) != elementCount_)
+            throw std::runtime_error(std::string("Records of uniform log column '") + name + "' must keep their number of elements");
+    }
+
+    // record must have passed check()
+    void append(const mxArray *mxRecord) {
+        unsigned char *pDest = data_.append();
+        if (mxGetClassID(mxRecord) == classId_) {
+            if (elementCount_ > 0) memcpy(pDest, mxGetData(mxRecord), elementCount_ * elementSize_);
+        } else {
+            mxClassID sourceClass = mxGetClassID(mxRecord);
+            const void *pSource = mxGetData(mxRecord);
+            for (size_t i = 0; i < elementCount_; i++) writeElement(classId_, pDest, i, readElement(sourceClass, pSource, i));
+        }
+    }
+
+    // append count records stored in the columns of mxData
+    void appendColumns(const mxArray *mxData, size_t count) {
+        const unsigned char *pSource = static_cast<const unsigned char *>(mxGetData(mxData));
+        size_t recordSize = elementCount_ * elementSize_;
+        for (size_t i = 0; i < count; i++) {
+            unsigned char *pDest = data_.append();
+            if (recordSize > 0) memcpy(pDest, pSource + i * recordSize, recordSize);
+        }
+    }
+
+    void truncate(size_t count) { data_.truncate(count); }
+
+    const ChunkedArray<unsigned char> &data() const { return data_; }
+
+    mxArray *record(size_t i) const {
+        mxArray *mxRecord = createArray(classId_, dims_);
+        if (elementCount_ > 0) memcpy(mxGetData(mxRecord), data_.at(i), elementCount_ * elementSize_);
+        return mxRecord;
+    }
+
+    // all records, one record per column
+    mxArray *exportRecords() const {
+        std::vector<mwSize> dims(2);
+        dims[0] = elementCount_;
+        dims[1] = data_.size();
+        mxArray *mxData = createArray(classId_, dims);
+        if (elementCount_ > 0) data_.copyTo(static_cast<unsigned char *>(mxGetData(mxData)), 0, data_.size());
+        return mxData;
+    }
+
+private:
+    Kind kind_;
+    mxClassID classId_;
+    std::vector<mwSize> dims_;
+    size_t elementCount_, elementSize_;
+    ChunkedArray<unsigned char> data_;
+};
+
+// input indices of one input of a block. Each record holds any number of
+// indices (usually zero or one).
+class InputLog {
+public:
+    InputLog(size_t chunkSize): ends_(chunkSize), indices_(chunkSize) { }
+
+    size_t size() const { return ends_.size(); }
+    size_t begin(size_t i) const { return i > 0 ? *ends_.at(i - 1) : 0; }
+    size_t end(size_t i) const { return *ends_.at(i); }
+    double index(size_t k) const { return *indices_.at(k); }
+
+    void get(size_t i, std::vector<double> &indices) const {
+        indices.clear();
+        for (size_t k = begin(i); k < end(i); k++) indices.push_back(index(k));
+    }
+
+    void append(const double *pIndices, size_t count) {
+        for (size_t i = 0; i < count; i++) *indices_.append() = pIndices[i];
+        *ends_.append() = indices_.size();
+    }
+
+    void truncate(size_t count) {
+        if (count >= size()) return;
+        indices_.truncate(begin(count));
+        ends_.truncate(count);
+    }
+
+    size_t bytes() const { return ends_.bytes() + indices_.bytes(); }
+    size_t allocations() const { return ends_.allocations() + indices_.allocations(); }
+
+private:
+    ChunkedArray<uint64_t> ends_;
+    ChunkedArray<double> indices_;
+};
+
+struct BlockLog {
+    BlockLog(size_t chunkSize, size_t inputCount, bool uniform): uniform(uniform), resident(true), times(chunkSize), offsets(chunkSize) {
+        for (size_t i = 0; i < inputCount; i++) inputs.push_back(InputLog(chunkSize));
+        if (!uniform) for (size_t i = 0; i < COLUMN_COUNT; i++) columns[i].reset(Column::OPAQUE);
+    }
+
+    size_t size() const { return times.size(); }
+    double time(size_t i) const { return *times.at(i); }
+    // number of records with a time stamp <= t (< t)
+    size_t countAtOrBefore(double t) const { return times.partitionPoint([t](double time) { return time <= t; }); }
+    size_t countBefore(double t) const { return times.partitionPoint([t](double time) { return time < t; }); }
+
+    size_t bytes() const {
+        size_t total = times.bytes() + offsets.bytes();
+        for (size_t i = 0; i < inputs.size(); i++) total += inputs[i].bytes();
+        for (size_t i = 0; i < COLUMN_COUNT; i++) total += columns[i].data().bytes();
+        return total;
+    }
+    size_t allocations() const {
+        size_t total = times.allocations() + offsets.allocations();
+        for (size_t i = 0; i < inputs.size(); i++) total += inputs[i].allocations();
+        for (size_t i = 0; i < COLUMN_COUNT; i++) total += columns[i].data().allocations();
+        return total;
+    }
+
+    bool uniform;
+    bool resident; // false: inputs and columns are only stored in the log file
+    ChunkedArray<double> times;
+    ChunkedArray<uint64_t> offsets; // record entries in the log file
+    std::vector<InputLog> inputs;
+    Column columns[COLUMN_COUNT];
+};
+
+static const mxArray *getField(const mxArray *mxStruct, const char *name) {
+    const mxArray *mxField = mxGetField(mxStruct, 0, name);
+    if (!mxField) throw std::runtime_error(std::string("Parameter '") + name + "' missing");
+    return mxField;
+}
+
+static double getScalar(const mxArray *mxStruct, const char *name) {
+    const mxArray *mxField = getField(mxStruct, name);
+    if (!(mxIsNumeric(mxField) || mxIsLogical(mxField)) || mxIsComplex(mxField) || mxGetNumberOfElements(mxField) != 1)
+        throw std::runtime_error(std::string("Parameter '") + name + "' must be a real scalar");
+    return mxGetScalar(mxField);
+}
+
+// 1-based index in [1, count] to zero-based index
+static size_t toIndex(double value, size_t count, const char *name) {
+    if (!(value >= 1 && value <= count) || value != std::floor(value))
+        throw std::runtime_error(std::string("Invalid index in '") + name + "'");
+    return (size_t)value - 1;
+}
+
+// mxIndices may be NULL (empty cell)
+static const double *getIndices(const mxArray *mxIndices, const char *name) {
+    if (!mxIndices || mxIsEmpty(mxIndices)) return NULL;
+    if (!mxIsDouble(mxIndices) || mxIsComplex(mxIndices))
+        throw std::runtime_error(std::string("Indices in '") + name + "' must be real double vectors");
+    return mxGetPr(mxIndices);
+}
+
+static size_t getIndexCount(const mxArray *mxIndices) {
+    return mxIndices ? mxGetNumberOfElements(mxIndices) : 0;
+}
+
+static mxArray *createRow(const std::vector<double> &values) {
+    mxArray *mxRow = mxCreateDoubleMatrix(1, values.size(), mxREAL);
+    if (!values.empty()) std::copy(values.begin(), values.end(), mxGetPr(mxRow));
+    return mxRow;
+}
+
+static std::string getString(const mxArray *mxStruct, const char *name) {
+    const mxArray *mxField = getField(mxStruct, name);
+    if (!mxIsChar(mxField) || mxIsEmpty(mxField)) throw std::runtime_error(std::string("Parameter '") + name + "' must be a non-empty string");
+    char *str = mxArrayToString(mxField);
+    std::string value(str);
+    mxFree(str);
+    return value;
+}
+
+// Append-only file, read back through a memory mapping. Appended data is
+// buffered and written before it is mapped or when the buffer is full.
+class LogFile {
+public:
+    // create a new (empty) file or open an existing file
+    LogFile(const std::string &path, bool create):
+        path_(path), size_(0), written_(0), mapped_(NULL), mappedSize_(0) {
+#ifdef _WIN32
+        mapping_ = NULL;
+        handle_ = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                              create ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (handle_ == INVALID_HANDLE_VALUE) throw std::runtime_error("Cannot open log file '" + path + "'");
+        LARGE_INTEGER fileSize;
+        bool valid = GetFileSizeEx(handle_, &fileSize) != 0;
+        if (valid) size_ = written_ = (uint64_t)fileSize.QuadPart;
+#else
+        fd_ = open(path.c_str(), O_RDWR | (create ? O_CREAT | O_TRUNC : 0), 0666);
+        if (fd_ < 0) throw std::runtime_error("Cannot open log file '" + path + "'");
+        struct stat fileStat;
+        bool valid = fstat(fd_, &fileStat) == 0;
+        if (valid) size_ = written_ = (uint64_t)fileStat.st_size;
+#endif
+        if (!valid) {
+            close();
+            throw std::runtime_error("Cannot open log file '" + path + "'");
+        }
+    }
+
+    ~LogFile() { close(); }
+
+    const std::string &path() const { return path_; }
+    uint64_t size() const { return size_; }
+
+    // returns the file offset of the data
+    uint64_t append(const void *data, size_t size) {
+        uint64_t offset = size_;
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        buffer_.insert(buffer_.end(), p, p + size);
+        size_ += size;
+        if (buffer_.size() >= FLUSH_SIZE) flush();
+        return offset;
+    }
+
+    uint64_t append(const std::vector<unsigned char> &data) { return data.empty() ? size_ : append(&data[0], data.size()); }
+
+    // pointer to size bytes at offset, valid until the next call of data(),
+    // truncate() or close()
+    const unsigned char *data(uint64_t offset, uint64_t size) {
+        if (offset > size_ || size > size_ - offset) throw std::runtime_error("Invalid offset in log file '" + path_ + "'");
+        if (offset + size > mappedSize_) map();
+        return mapped_ + offset;
+    }
+
+    void flush() {
+        if (buffer_.empty()) return;
+#ifdef _WIN32
+        LARGE_INTEGER position;
+        position.QuadPart = (LONGLONG)written_;
+        bool success = SetFilePointerEx(handle_, position, NULL, FILE_BEGIN) != 0;
+        for (size_t done = 0; success && done < buffer_.size(); ) {
+            DWORD count = 0;
+            success = WriteFile(handle_, &buffer_[done], (DWORD)std::min(buffer_.size() - done, (size_t)FLUSH_SIZE), &count, NULL) && count > 0;
+            done += count;
+        }
+#else
+        bool success = true;
+        for (size_t done = 0; success && done < buffer_.size(); ) {
+            ssize_t count = pwrite(fd_, &buffer_[done], buffer_.size() - done, (off_t)(written_ + done));
+            success = count > 0;
+            if (success) done += (size_t)count;
+        }
+#endif
+        if (!success) throw std::runtime_error("Cannot write log file '" + path_ + "'");
+        written_ += buffer_.size();
+        buffer_.clear();
+    }
+
+    // drop all data after the first size bytes
+    void truncate(uint64_t size) {
+        if (size > size_) throw std::runtime_error("Invalid log file size");
+        unmap();
+        if (size > written_) flush();
+        buffer_.clear();
+#ifdef _WIN32
+        LARGE_INTEGER position;
+        position.QuadPart = (LONGLONG)size;
+        bool success = SetFilePointerEx(handle_, position, NULL, FILE_BEGIN) && SetEndOfFile(handle_);
+#else
+        bool success = ftruncate(fd_, (off_t)size) == 0;
+#endif
+        if (!success) throw std::runtime_error("Cannot truncate log file '" + path_ + "'");
+        size_ = written_ = size;
+    }
+
+    void close() {
+        unmap();
+#ifdef _WIN32
+        if (handle_ != INVALID_HANDLE_VALUE) {
+            if (!buffer_.empty()) try { flush(); } catch (const std::exception &) { }
+            CloseHandle(handle_);
+            handle_ = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (fd_ >= 0) {
+            if (!buffer_.empty()) try { flush(); } catch (const std::exception &) { }
+            ::close(fd_);
+            fd_ = -1;
+        }
+#endif
+        buffer_.clear();
+    }
+
+    static void remove(const std::string &path) {
+#ifdef _WIN32
+        DeleteFileA(path.c_str());
+#else
+        unlink(path.c_str());
+#endif
+    }
+
+    // replaces an existing file at path 'to'
+    static void rename(const std::string &from, const std::string &to) {
+#ifdef _WIN32
+        bool success = MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        bool success = ::rename(from.c_str(), to.c_str()) == 0;
+#endif
+        if (!success) throw std::runtime_error("Cannot rename log file '" + from + "' to '" + to + "'");
+    }
+
+private:
+    static const size_t FLUSH_SIZE = 1 << 20;
+
+    void map() {
+        flush();
+        unmap();
+        if (size_ == 0) return;
+#ifdef _WIN32
+        mapping_ = CreateFileMappingA(handle_, NULL, PAGE_READONLY, (DWORD)(size_ >> 32), (DWORD)size_, NULL);
+        void *p = mapping_ ? MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, (SIZE_T)size_) : NULL;
+#else
+        void *p = mmap(NULL, (size_t)size_, PROT_READ, MAP_SHARED, fd_, 0);
+        if (p == MAP_FAILED) p = NULL;
+#endif
+        if (!p) {
+            unmap();
+            throw std::runtime_error("Cannot map log file '" + path_ + "'");
+        }
+        mapped_ = static_cast<const unsigned char *>(p);
+        mappedSize_ = size_;
+    }
+
+    void unmap() {
+#ifdef _WIN32
+        if (mapped_) UnmapViewOfFile(mapped_);
+        if (mapping_) CloseHandle(mapping_);
+        mapping_ = NULL;
+#else
+        if (mapped_) munmap(const_cast<unsigned char *>(mapped_), (size_t)mappedSize_);
+#endif
+        mapped_ = NULL;
+        mappedSize_ = 0;
+    }
+
+    LogFile(const LogFile &);
+    LogFile &operator=(const LogFile &);
+
+    std::string path_;
+    uint64_t size_, written_; // written_: size without buffer_
+    std::vector<unsigned char> buffer_;
+    const unsigned char *mapped_;
+    uint64_t mappedSize_;
+#ifdef _WIN32
+    HANDLE handle_, mapping_;
+#else
+    int fd_;
+#endif
+};
+
+class LogStore {
+public:
+    LogStore(size_t chunkSize, const std::vector<size_t> &inputCounts, const std::vector<bool> &uniform):
+        chunkSize_(chunkSize), temporary_(false), fragmented_(false), savedSize_(0) {
+        for (size_t i = 0; i < inputCounts.size(); i++) logs_.push_back(BlockLog(chunkSize, inputCounts[i], uniform[i]));
+    }
+
+    ~LogStore() {
+        if (!file_) return;
+        if (temporary_) {
+            file_->close();
+            LogFile::remove(file_->path());
+        } else {
+            // drop records appended after the last save
+            try { file_->truncate(savedSize_); } catch (const std::exception &) { }
+        }
+    }
+
+    size_t blockCount() const { return logs_.size(); }
+    const BlockLog &log(size_t iBlock) const { return logs_[iBlock]; }
+
+    // stream all records to a new log file, which is removed unless it is saved
+    void createFile(const std::string &path) {
+        file_.reset(new LogFile(path, true));
+        temporary_ = true;
+        buffer_.assign(FILE_MAGIC, FILE_MAGIC + MAGIC_SIZE);
+        mex::value_writer writer(buffer_);
+        writer.write<uint64_t>(logs_.size());
+        file_->append(buffer_);
+    }
+
+    // open a saved log file, the logs are not resident
+    void openFile(const std::string &path, uint64_t indexOffset) {
+        file_.reset(new LogFile(path, false));
+        temporary_ = false;
+        const unsigned char *pHeader = file_->data(0, MAGIC_SIZE + sizeof(uint64_t));
+        mex::value_reader header(pHeader, MAGIC_SIZE + sizeof(uint64_t));
+        if (memcmp(header.read_bytes(MAGIC_SIZE), FILE_MAGIC, MAGIC_SIZE) != 0)
+            throw std::runtime_error("'" + path + "' is not a log file");
+        if (header.read<uint64_t>() != logs_.size()) throw std::runtime_error("Log file '" + path + "' does not match the experiment");
+
+        uint64_t indexSize = readEntryHeader(indexOffset, INDEX_ENTRY);
+        mex::value_reader index(file_->data(indexOffset + ENTRY_HEADER_SIZE, indexSize), (size_t)indexSize);
+        for (size_t iBlock = 0; iBlock < logs_.size(); iBlock++) {
+            BlockLog &log = logs_[iBlock];
+            truncate(iBlock, 0);
+            log.resident = false;
+            uint64_t count = index.read<uint64_t>();
+            if (count > indexSize / (2 * sizeof(double))) throw std::runtime_error("Invalid index in log file '" + path + "'");
+            for (uint64_t i = 0; i < count; i++) {
+                double t = index.read<double>();
+                if (i > 0 && !(t >= log.time(i - 1))) throw std::runtime_error("Invalid index in log file '" + path + "'");
+                *log.times.append() = t;
+            }
+            for (uint64_t i = 0; i < count; i++) {
+                uint64_t offset = index.read<uint64_t>();
+                if (offset >= indexOffset) throw std::runtime_error("Invalid index in log file '" + path + "'");
+                *log.offsets.append() = offset;
+            }
+        }
+        // index and trailer
+        savedSize_ = indexOffset + ENTRY_HEADER_SIZE + indexSize + sizeof(uint64_t) + MAGIC_SIZE;
+        if (savedSize_ > file_->size()) throw std::runtime_error("Log file '" + path + "' is truncated");
+        file_->truncate(savedSize_);
+    }
+
+    // mxColumns: out, debugOut and state records (required for uniform logs)
+    void append(size_t iBlock, double t, const mxArray *mxInputs, const mxArray *mxColumns[]) {
+        BlockLog &log = logs_[iBlock];
+        // validate everything before modifying the log
+        if (log.size() > 0 && !(t >= log.time(log.size() - 1)))
+            throw std::runtime_error("Log records must be appended in chronological order");
+        checkInputs(log, mxInputs);
+        for (size_t i = 0; i < log.inputs.size(); i++) getIndices(mxGetCell(mxInputs, i), "inputs");
+        for (size_t i = 0; i < COLUMN_COUNT && log.uniform; i++) {
+            if (!mxColumns[i]) throw std::runtime_error(std::string("Parameter '") + COLUMN_NAMES[i] + "' missing");
+            if (log.resident && log.columns[i].kind() == Column::TYPED) log.columns[i].check(mxColumns[i], COLUMN_NAMES[i]);
+        }
+        uint64_t offset = 0;
+        if (file_) offset = file_->append(encodeRecord(iBlock, t, mxInputs, mxColumns));
+
+        for (size_t i = 0; i < COLUMN_COUNT && log.uniform && log.resident; i++) {
+            Column &column = log.columns[i];
+            if (column.kind() == Column::UNDEFINED) {
+                const mwSize *pDims = mxGetDimensions(mxColumns[i]);
+                column.define(mxColumns[i], std::vector<mwSize>(pDims, pDims + mxGetNumberOfDimensions(mxColumns[i])), chunkSize_);
+            }
+            if (column.kind() == Column::TYPED) column.append(mxColumns[i]);
+        }
+        for (size_t i = 0; i < log.inputs.size() && log.resident; i++) {
+            const mxArray *mxIndices = mxGetCell(mxInputs, i);
+            log.inputs[i].append(getIndices(mxIndices, "inputs"), getIndexCount(mxIndices));
+        }
+        *log.times.append() = t;
+        if (file_) *log.offsets.append() = offset;
+    }
+
+    void truncate(size_t iBlock, size_t count) {
+        BlockLog &log = logs_[iBlock];
+        if (count < log.size()) fragmented_ = true;
+        log.times.truncate(count);
+        log.offsets.truncate(count);
+        for (size_t i = 0; i < log.inputs.size(); i++) log.inputs[i].truncate(count);
+        for (size_t i = 0; i < COLUMN_COUNT; i++) {
+            // uniform logs select the column storage again on the next record
+            if (count == 0 && log.uniform) log.columns[i].reset(Column::UNDEFINED);
+            else log.columns[i].truncate(count);
+        }
+        if (count == 0) log.resident = true;
+    }
+
+    // mxInputs: per input either a linear array (0: no input) or a cell
+    // array of indices. mxColumns, mxSizes: uniform logs only
+    void import(size_t iBlock, size_t count, const mxArray *mxTimes, const mxArray *mxInputs,
+                const mxArray *mxColumns[], const mxArray *mxSizes[]) {
+        BlockLog &log = logs_[iBlock];
+        if (file_) throw std::runtime_error("Logs cannot be imported into a log store with a log file");
+        if (!mxIsDouble(mxTimes) || mxIsComplex(mxTimes) || mxGetNumberOfElements(mxTimes) < count)
+            throw std::runtime_error("Parameter 'times' must be a real double vector with at least 'count' elements");
+        const double *pTimes = mxGetPr(mxTimes);
+        for (size_t i = 1; i < count; i++) {
+            if (!(pTimes[i] >= pTimes[i - 1])) throw std::runtime_error("Log records must be in chronological order");
+        }
+        checkInputs(log, mxInputs);
+        for (size_t iIn = 0; iIn < log.inputs.size(); iIn++) {
+            const mxArray *mxIndices = mxGetCell(mxInputs, iIn);
+            if (count == 0) continue;
+            if (!mxIndices || mxGetNumberOfElements(mxIndices) < count || !(mxIsCell(mxIndices) || mxIsDouble(mxIndices)))
+                throw std::runtime_error("Input indices must be linear arrays or cell arrays with at least 'count' elements");
+            for (size_t i = 0; i < count && mxIsCell(mxIndices); i++) getIndices(mxGetCell(mxIndices, i), "inputs");
+        }
+        std::vector<std::vector<mwSize> > dims(COLUMN_COUNT);
+        for (size_t i = 0; i < COLUMN_COUNT && log.uniform; i++) {
+            if (!mxColumns[i] || !mxSizes[i]) throw std::runtime_error(std::string("Parameters '") + COLUMN_NAMES[i] + "' and '" + SIZE_NAMES[i] + "' required for uniform logs");
+            if (!isTypedData(mxColumns[i])) continue;
+            if (!mxIsDouble(mxSizes[i]) || mxGetNumberOfElements(mxSizes[i]) < 2)
+                throw std::runtime_error(std::string("Parameter '") + SIZE_NAMES[i] + "' must be a size vector");
+            size_t elementCount = 1;
+            for (size_t j = 0; j < mxGetNumberOfElements(mxSizes[i]); j++) {
+                dims[i].push_back((mwSize)mxGetPr(mxSizes[i])[j]);
+                elementCount *= dims[i].back();
+            }
+            if (mxGetM(mxColumns[i]) != elementCount || mxGetN(mxColumns[i]) < count)
+                throw std::runtime_error(std::string("Parameter '") + COLUMN_NAMES[i] + "' does not match '" + SIZE_NAMES[i] + "'");
+        }
+
+        truncate(iBlock, 0);
+        for (size_t i = 0; i < count; i++) *log.times.append() = pTimes[i];
+        for (size_t iIn = 0; iIn < log.inputs.size(); iIn++) {
+            const mxArray *mxIndices = mxGetCell(mxInputs, iIn);
+            for (size_t i = 0; i < count; i++) {
+                if (mxIsCell(mxIndices)) {
+                    const mxArray *mxRecord = mxGetCell(mxIndices, i);
+                    log.inputs[iIn].append(getIndices(mxRecord, "inputs"), getIndexCount(mxRecord));
+                } else {
+                    const double *pIndex = mxGetPr(mxIndices) + i;
+                    log.inputs[iIn].append(pIndex, *pIndex != 0.0 ? 1 : 0);
+                }
+            }
+        }
+        for (size_t i = 0; i < COLUMN_COUNT && log.uniform; i++) {
+            log.columns[i].define(mxColumns[i], dims[i], chunkSize_);
+            if (log.columns[i].kind() == Column::TYPED) log.columns[i].appendColumns(mxColumns[i], count);
+        }
+    }
+
+    // positions: log position of each block (number of records up to the current time)
+    double seek(double t, std::vector<size_t> &positions) const {
+        double tNew = 0.0;
+        for (size_t i = 0; i < logs_.size(); i++) {
+            positions[i] = logs_[i].countAtOrBefore(t);
+            if (positions[i] > 0) tNew = std::max(tNew, logs_[i].time(positions[i] - 1));
+        }
+        return tNew;
+    }
+
+    double stepForward(double t, std::vector<size_t> &positions) const {
+        // smallest time stamp after t, starting at the current positions
+        double minTime = t + TIME_TOLERANCE;
+        double tNew = HUGE_VAL;
+        for (size_t i = 0; i < logs_.size(); i++) {
+            size_t next = std::max(logs_[i].countBefore(minTime), firstCandidate(positions[i]));
+            if (next < logs_[i].size()) tNew = std::min(tNew, logs_[i].time(next));
+        }
+        if (std::isinf(tNew)) return tNew;
+
+        // advance to the last records not after tNew
+        for (size_t i = 0; i < logs_.size(); i++)
+            positions[i] = std::min(logs_[i].size(), std::max(logs_[i].countAtOrBefore(tNew), firstCandidate(positions[i])));
+        return tNew;
+    }
+
+    double stepBackward(double t, std::vector<size_t> &positions) const {
+        // largest time stamp before t, not after the current positions
+        double maxTime = t - TIME_TOLERANCE;
+        double tNew = 0.0;
+        for (size_t i = 0; i < logs_.size(); i++) {
+            size_t previous = std::min(logs_[i].countAtOrBefore(maxTime), positions[i]);
+            if (previous > 0) tNew = std::max(tNew, logs_[i].time(previous - 1));
+        }
+
+        // logs without records up to tNew keep their position
+        for (size_t i = 0; i < logs_.size(); i++) {
+            size_t position = std::min(logs_[i].countAtOrBefore(tNew), positions[i]);
+            if (position > 0) positions[i] = position;
+        }
+        return tNew;
+    }
+
+    // decode record i of a log from the log file (all columns, if mxColumns
+    // is not NULL)
+    void readRecord(size_t iBlock, size_t i, std::vector<std::vector<double> > &inputs, mxArray *mxColumns[]) {
+        const BlockLog &log = logs_[iBlock];
+        uint64_t offset = *log.offsets.at(i);
+        uint64_t size = readEntryHeader(offset, (uint32_t)iBlock);
+        mex::value_reader reader(file_->data(offset + ENTRY_HEADER_SIZE, size), (size_t)size);
+        reader.read<double>(); // t, also part of the index
+        inputs.resize(log.inputs.size());
+        for (size_t iIn = 0; iIn < inputs.size(); iIn++) {
+            uint32_t count = reader.read<uint32_t>();
+            inputs[iIn].resize(count);
+            if (count > 0) memcpy(&inputs[iIn][0], reader.read_bytes(count * sizeof(double)), count * sizeof(double));
+        }
+        for (size_t iCol = 0; iCol < COLUMN_COUNT && mxColumns; iCol++) mxColumns[iCol] = reader.read_value();
+    }
+
+    // make a log resident by loading all of its records from the log file.
+    // mxRecords receives 1xn cell arrays with the records of the opaque
+    // columns (NULL for typed columns)
+    void load(size_t iBlock, mxArray *mxRecords[]) {
+        BlockLog &log = logs_[iBlock];
+        size_t count = log.size();
+        BlockLog loaded(chunkSize_, log.inputs.size(), log.uniform);
+        for (size_t iCol = 0; iCol < COLUMN_COUNT; iCol++) mxRecords[iCol] = mxCreateCellMatrix(1, count);
+        std::vector<std::vector<double> > inputs;
+        mxArray *mxColumns[COLUMN_COUNT];
+        for (size_t i = 0; i < count; i++) {
+            readRecord(iBlock, i, inputs, mxColumns);
+            for (size_t iCol = 0; iCol < COLUMN_COUNT; iCol++) {
+                Column &column = loaded.columns[iCol];
+                if (column.kind() == Column::UNDEFINED) {
+                    const mwSize *pDims = mxGetDimensions(mxColumns[iCol]);
+                    column.define(mxColumns[iCol], std::vector<mwSize>(pDims, pDims + mxGetNumberOfDimensions(mxColumns[iCol])), chunkSize_);
+                }
+                if (column.kind() == Column::TYPED) {
+                    column.check(mxColumns[iCol], COLUMN_NAMES[iCol]);
+                    column.append(mxColumns[iCol]);
+                    mxDestroyArray(mxColumns[iCol]);
+                } else mxSetCell(mxRecords[iCol], i, mxColumns[iCol]);
+            }
+            for (size_t iIn = 0; iIn < inputs.size(); iIn++)
+                loaded.inputs[iIn].append(inputs[iIn].empty() ? NULL : &inputs[iIn][0], inputs[iIn].size());
+            *loaded.times.append() = log.time(i);
+        }
+        for (size_t iCol = 0; iCol < COLUMN_COUNT; iCol++) {
+            if (loaded.columns[iCol].kind() != Column::TYPED) continue;
+            mxDestroyArray(mxRecords[iCol]);
+            mxRecords[iCol] = NULL;
+        }
+        loaded.offsets = std::move(log.offsets);
+        log = std::move(loaded);
+    }
+
+    // write the index to the log file and move it to path, returns the
+    // offset of the index. Truncated records are dropped by writing the
+    // logs to a new file. A saved file is not moved away from its path.
+    uint64_t save(const std::string &path) {
+        if (!file_) throw std::runtime_error("The log store has no log file");
+        uint64_t indexOffset;
+        if (!fragmented_ && (temporary_ || path == file_->path())) {
+            std::vector<const ChunkedArray<uint64_t> *> offsets;
+            for (size_t iBlock = 0; iBlock < logs_.size(); iBlock++) offsets.push_back(&logs_[iBlock].offsets);
+            indexOffset = writeIndex(*file_, offsets);
+            file_->flush();
+            if (path != file_->path()) {
+                file_->close();
+                LogFile::rename(file_->path(), path);
+                file_.reset(new LogFile(path, false));
+            }
+        } else {
+            std::string tempPath = path + ".part";
+            if (tempPath == file_->path()) tempPath += ".part";
+            std::vector<ChunkedArray<uint64_t> > newOffsets;
+            try {
+                LogFile copy(tempPath, true);
+                copy.append(FILE_MAGIC, MAGIC_SIZE);
+                uint64_t blockCount = logs_.size();
+                copy.append(&blockCount, sizeof(blockCount));
+                for (size_t iBlock = 0; iBlock < logs_.size(); iBlock++) {
+                    const BlockLog &log = logs_[iBlock];
+                    newOffsets.push_back(ChunkedArray<uint64_t>(chunkSize_));
+                    for (size_t i = 0; i < log.size(); i++) {
+                        uint64_t offset = *log.offsets.at(i);
+                        uint64_t size = ENTRY_HEADER_SIZE + readEntryHeader(offset, (uint32_t)iBlock);
+                        *newOffsets.back().append() = copy.append(file_->data(offset, size), (size_t)size);
+                    }
+                }
+                std::vector<const ChunkedArray<uint64_t> *> offsets;
+                for (size_t iBlock = 0; iBlock < logs_.size(); iBlock++) offsets.push_back(&newOffsets[iBlock]);
+                indexOffset = writeIndex(copy, offsets);
+                copy.close();
+            } catch (const std::exception &) {
+                LogFile::remove(tempPath);
+                throw;
+            }
+            std::string oldPath = file_->path();
+            if (!temporary_) file_->truncate(savedSize_);
+            file_->close();
+            if (temporary_) LogFile::remove(oldPath);
+            LogFile::rename(tempPath, path);
+            file_.reset(new LogFile(path, false));
+            for (size_t iBlock = 0; iBlock < logs_.size(); iBlock++) logs_[iBlock].offsets = std::move(newOffsets[iBlock]);
+        }
+        temporary_ = false;
+        fragmented_ = false;
+        savedSize_ = file_->size();
+        return indexOffset;
+    }
+
+private:
+    static size_t firstCandidate(size_t position) { return position > 0 ? position - 1 : 0; }
+
+    static void checkInputs(const BlockLog &log, const mxArray *mxInputs) {
+        if (!mxIsCell(mxInputs) || mxGetNumberOfElements(mxInputs) != log.inputs.size())
+            throw std::runtime_error("Parameter 'inputs' must be a cell array with one cell per input");
+    }
+
+    // record entry of a log file, see above
+    const std::vector<unsigned char> &encodeRecord(size_t iBlock, double t, const mxArray *mxInputs, const mxArray *mxColumns[]) {
+        buffer_.clear();
+        mex::value_writer writer(buffer_);
+        writer.write<uint32_t>((uint32_t)iBlock);
+        writer.write<uint32_t>((uint32_t)logs_[iBlock].inputs.size());
+        writer.write<uint64_t>(0); // payload size, see below
+        writer.write<double>(t);
+        for (size_t iIn = 0; iIn < logs_[iBlock].inputs.size(); iIn++) {
+            const mxArray *mxIndices = mxGetCell(mxInputs, iIn);
+            const double *pIndices = getIndices(mxIndices, "inputs");
+            uint32_t count = pIndices ? (uint32_t)getIndexCount(mxIndices) : 0;
+            writer.write<uint32_t>(count);
+            if (count > 0) writer.write_bytes(pIndices, count * sizeof(double));
+        }
+        for (size_t iCol = 0; iCol < COLUMN_COUNT; iCol++) writer.write_value(mxColumns[iCol]);
+        uint64_t size = buffer_.size() - ENTRY_HEADER_SIZE;
+        memcpy(&buffer_[2 * sizeof(uint32_t)], &size, sizeof(size));
+        return buffer_;
+    }
+
+    // checks the header of the entry at offset, returns the payload size
+    uint64_t readEntryHeader(uint64_t offset, uint32_t expectedBlock) {
+        mex::value_reader header(file_->data(offset, ENTRY_HEADER_SIZE), ENTRY_HEADER_SIZE);
+        uint32_t block = header.read<uint32_t>();
+        uint32_t inputCount = header.read<uint32_t>();
+        uint64_t size = header.read<uint64_t>();
+        bool valid = block == expectedBlock &&
+                     (block == INDEX_ENTRY ? inputCount == 0 : inputCount == logs_[block].inputs.size()) &&
+                     size <= file_->size() - offset - ENTRY_HEADER_SIZE;
+        if (!valid) throw std::runtime_error("Log file '" + file_->path() + "' is corrupt");
+        return size;
+    }
+
+    // append the index entry and the trailer to file, returns the offset of
+    // the index entry
+    uint64_t writeIndex(LogFile &file, const std::vector<const ChunkedArray<uint64_t> *> &offsets) {
+        buffer_.clear();
+        mex::value_writer writer(buffer_);
+        writer.write<uint32_t>(INDEX_ENTRY);
+        writer.write<uint32_t>(0);
+        writer.write<uint64_t>(0); // payload size, see below
+        for (size_t iBlock = 0; iBlock < logs_.size(); iBlock++) {
+            const BlockLog &log = logs_[iBlock];
+            writer.write<uint64_t>(log.size());
+            for (size_t i = 0; i < log.size(); i++) writer.write<double>(log.time(i));
+            for (size_t i = 0; i < log.size(); i++) writer.write<uint64_t>(*offsets[iBlock]->at(i));
+        }
+        uint64_t size = buffer_.size() - ENTRY_HEADER_SIZE;
+        memcpy(&buffer_[2 * sizeof(uint32_t)], &size, sizeof(size));
+        uint64_t indexOffset = file.append(buffer_);
+
+        buffer_.clear();
+        writer.write<uint64_t>(indexOffset);
+        writer.write_bytes(FILE_MAGIC, MAGIC_SIZE);
+        file.append(buffer_);
+        return indexOffset;
+    }
+
+    size_t chunkSize_;
+    std::vector<BlockLog> logs_;
+    std::unique_ptr<LogFile> file_;
+    bool temporary_;  // remove the log file, unless it is saved
+    bool fragmented_; // the log file contains truncated records
+    uint64_t savedSize_;
+    std::vector<unsigned char> buffer_;
+};
+
+enum LogStoreMethod {
+    METHOD_APPEND,
+    METHOD_RECORD,
+    METHOD_TIMES,
+    METHOD_TRUNCATE,
+    METHOD_SEEK,
+    METHOD_STEP_FORWARD,
+    METHOD_STEP_BACKWARD,
+    METHOD_EXPORT,
+    METHOD_IMPORT,
+    METHOD_SAVE,
+    METHOD_STATS
+};
+
+class LogStoreManager: public mex::object_manager<LogStore> {
+public:
+    LogStoreManager() {
+        setConstructionRequiresArgument(true);
+        addMethod("append", METHOD_APPEND);
+        addMethod("record", METHOD_RECORD);
+        addMethod("times", METHOD_TIMES);
+        addMethod("truncate", METHOD_TRUNCATE);
+        addMethod("seek", METHOD_SEEK);
+        addMethod("stepForward", METHOD_STEP_FORWARD);
+        addMethod("stepBackward", METHOD_STEP_BACKWARD);
+        addMethod("export", METHOD_EXPORT);
+        addMethod("import", METHOD_IMPORT);
+        addMethod("save", METHOD_SAVE);
+        addMethod("stats", METHOD_STATS);
+    }
+
+    virtual LogStore *create(const mxArray *mxOpts) {
+        double chunkSize = getScalar(mxOpts, "chunkSize");
+        if (!(chunkSize >= 1) || chunkSize != std::floor(chunkSize)) throw std::runtime_error("Parameter 'chunkSize' must be a positive integer");
+        const mxArray *mxInputCount = getField(mxOpts, "inputCount");
+        const mxArray *mxUniform = getField(mxOpts, "uniform");
+        size_t count = mxGetNumberOfElements(mxInputCount);
+        if (!mxIsDouble(mxInputCount) || mxIsComplex(mxInputCount))
+            throw std::runtime_error("Parameter 'inputCount' must be a real double vector");
+        if (!mxIsLogical(mxUniform) || mxGetNumberOfElements(mxUniform) != count)
+            throw std::runtime_error("Parameter 'uniform' must be a logical vector with one element per block");
+
+        std::vector<size_t> inputCounts(count);
+        std::vector<bool> uniform(count);
+        for (size_t i = 0; i < count; i++) {
+            double inputCount = mxGetPr(mxInputCount)[i];
+            if (!(inputCount >= 0) || inputCount != std::floor(inputCount)) throw std::runtime_error("Invalid number of inputs");
+            inputCounts[i] = (size_t)inputCount;
+            uniform[i] = mxGetLogicals(mxUniform)[i];
+        }
+        std::unique_ptr<LogStore> store(new LogStore((size_t)chunkSize, inputCounts, uniform));
+        if (mxGetField(mxOpts, 0, "file")) {
+            std::string path = getString(mxOpts, "file");
+            if (mxGetField(mxOpts, 0, "indexOffset")) {
+                double indexOffset = getScalar(mxOpts, "indexOffset");
+                if (!(indexOffset > 0) || indexOffset != std::floor(indexOffset)) throw std::runtime_error("Parameter 'indexOffset' must be a positive integer");
+                store->openFile(path, (uint64_t)indexOffset);
+            } else store->createFile(path);
+        }
+        return store.release();
+    }
+
+    virtual void invoke(LogStore &store, int methodId, const mxArray *mxOpts, int nlhs, mxArray *plhs[]) {
+        if (nlhs > 2) throw std::runtime_error("Too many output arguments");
+        if (!mxOpts && methodId != METHOD_STATS) throw std::runtime_error("Parameter structure required");
+
+        switch (methodId) {
+        case METHOD_APPEND: {
+            size_t iBlock = getBlock(store, mxOpts);
+            const mxArray *mxColumns[COLUMN_COUNT];
+            for (size_t i = 0; i < COLUMN_COUNT; i++) mxColumns[i] = mxGetField(mxOpts, 0, COLUMN_NAMES[i]);
+            store.append(iBlock, getScalar(mxOpts, "t"), getField(mxOpts, "inputs"), mxColumns);
+            plhs[0] = createOpaqueMask(store.log(iBlock));
+            break;
+        }
+        case METHOD_RECORD: {
+            size_t iBlock = getBlock(store, mxOpts);
+            double iteration = getScalar(mxOpts, "iteration");
+            plhs[0] = createRecord(store, iBlock, toIndex(iteration, store.log(iBlock).size(), "iteration"));
+            break;
+        }
+        case METHOD_TIMES: {
+            const BlockLog &log = store.log(getBlock(store, mxOpts));
+            const mxArray *mxIterations = getField(mxOpts, "iterations");
+            const double *pIterations = getIndices(mxIterations, "iterations");
+            size_t count = mxGetNumberOfElements(mxIterations);
+            plhs[0] = mxCreateDoubleMatrix(mxGetM(mxIterations), mxGetN(mxIterations), mxREAL);
+            for (size_t i = 0; i < count; i++) mxGetPr(plhs[0])[i] = log.time(toIndex(pIterations[i], log.size(), "iterations"));
+            break;
+        }
+        case METHOD_TRUNCATE: {
+            size_t iBlock = getBlock(store, mxOpts);
+            double count = getScalar(mxOpts, "count");
+            if (!(count >= 0) || count != std::floor(count)) throw std::runtime_error("Parameter 'count' must be a non-negative integer");
+            store.truncate(iBlock, std::min((size_t)count, store.log(iBlock).size()));
+            break;
+        }
+        case METHOD_SEEK:
+        case METHOD_STEP_FORWARD:
+        case METHOD_STEP_BACKWARD: {
+            double t = getScalar(mxOpts, "t");
+            std::vector<size_t> positions(store.blockCount(), 0);
+            double tNew;
+            if (methodId == METHOD_SEEK) tNew = store.seek(t, positions);
+            else {
+                getPositions(store, mxOpts, positions);
+                if (methodId == METHOD_STEP_FORWARD) tNew = store.stepForward(t, positions);
+                else tNew = store.stepBackward(t, positions);
+            }
+            plhs[0] = mxCreateDoubleMatrix(1, positions.size(), mxREAL);
+            for (size_t i = 0; i < positions.size(); i++) mxGetPr(plhs[0])[i] = (double)positions[i];
+            if (nlhs > 1) plhs[1] = mxCreateDoubleScalar(tNew);
+            break;
+        }
+        case METHOD_EXPORT:
+            plhs[0] = exportLog(store, getBlock(store, mxOpts));
+            break;
+        case METHOD_IMPORT: {
+            size_t iBlock = getBlock(store, mxOpts);
+            double count = getScalar(mxOpts, "count");
+            if (!(count >= 0) || count != std::floor(count)) throw std::runtime_error("Parameter 'count' must be a non-negative integer");
+            const mxArray *mxColumns[COLUMN_COUNT], *mxSizes[COLUMN_COUNT];
+            for (size_t i = 0; i < COLUMN_COUNT; i++) {
+                mxColumns[i] = mxGetField(mxOpts, 0, COLUMN_NAMES[i]);
+                mxSizes[i] = mxGetField(mxOpts, 0, SIZE_NAMES[i]);
+            }
+            store.import(iBlock, (size_t)count, getField(mxOpts, "times"), getField(mxOpts, "inputs"), mxColumns, mxSizes);
+            plhs[0] = createOpaqueMask(store.log(iBlock));
+            break;
+        }
+        case METHOD_SAVE:
+            plhs[0] = mxCreateDoubleScalar((double)store.save(getString(mxOpts, "file")));
+            break;
+        case METHOD_STATS:
+            plhs[0] = createStats(store);
+            break;
+        }
+    }
+
+private:
+    static size_t getBlock(const LogStore &store, const mxArray *mxOpts) {
+        return toIndex(getScalar(mxOpts, "block"), store.blockCount(), "block");
+    }
+
+    static void getPositions(const LogStore &store, const mxArray *mxOpts, std::vector<size_t> &positions) {
+        const mxArray *mxPositions = getField(mxOpts, "positions");
+        if (!mxIsDouble(mxPositions) || mxIsComplex(mxPositions) || mxGetNumberOfElements(mxPositions) != positions.size())
+            throw std::runtime_error("Parameter 'positions' must be a real double vector with one element per block");
+        for (size_t i = 0; i < positions.size(); i++) {
+            double position = mxGetPr(mxPositions)[i];
+            if (!(position >= 0) || position != std::floor(position)) throw std::runtime_error("Invalid log position");
+            positions[i] = std::min((size_t)position, store.log(i).size());
+        }
+    }
+
+    static mxArray *createStats(const LogStore &store) {
+        static const char *fieldNames[] = {"records", "bytes", "allocations"};
+        size_t count = store.blockCount();
+        mxArray *mxStats = mxCreateStructMatrix(1, 1, 3, fieldNames);
+        mxArray *mxRecords = mxCreateDoubleMatrix(1, count, mxREAL);
+        mxArray *mxBytes = mxCreateDoubleMatrix(1, count, mxREAL);
+        mxArray *mxAllocations = mxCreateDoubleMatrix(1, count, mxREAL);
+        for (size_t i = 0; i < count; i++) {
+            const BlockLog &log = store.log(i);
+            mxGetPr(mxRecords)[i] = (double)log.size();
+            mxGetPr(mxBytes)[i] = (double)log.bytes();
+            mxGetPr(mxAllocations)[i] = (double)log.allocations();
+        }
+        mxSetField(mxStats, 0, "records", mxRecords);
+        mxSetField(mxStats, 0, "bytes", mxBytes);
+        mxSetField(mxStats, 0, "allocations", mxAllocations);
+        return mxStats;
+    }
+
+    static mxArray *createOpaqueMask(const BlockLog &log) {
+        mxArray *mxOpaque = mxCreateLogicalMatrix(1, COLUMN_COUNT);
+        for (size_t i = 0; i < COLUMN_COUNT; i++) mxGetLogicals(mxOpaque)[i] = (log.columns[i].kind() != Column::TYPED);
+        return mxOpaque;
+    }
+
+    static mxArray *createIndices(const std::vector<double> &indices) {
+        if (indices.empty()) return mxCreateDoubleMatrix(0, 0, mxREAL);
+        return createRow(indices);
+    }
+
+    static mxArray *createIndices(const InputLog &input, size_t i) {
+        std::vector<double> indices;
+        input.get(i, indices);
+        return createIndices(indices);
+    }
+
+    static mxArray *createRecord(LogStore &store, size_t iBlock, size_t i) {
+        static const char *fieldNames[] = {"iteration", "t", "out", "debugOut", "state", "inputs"};
+        const BlockLog &log = store.log(iBlock);
+        mxArray *mxColumns[COLUMN_COUNT] = {NULL, NULL, NULL};
+        std::vector<std::vector<double> > inputs(log.inputs.size());
+        if (log.resident) {
+            for (size_t iCol = 0; iCol < COLUMN_COUNT; iCol++) {
+                if (log.columns[iCol].kind() == Column::TYPED) mxColumns[iCol] = log.columns[iCol].record(i);
+            }
+            for (size_t iIn = 0; iIn < log.inputs.size(); iIn++) log.inputs[iIn].get(i, inputs[iIn]);
+        } else store.readRecord(iBlock, i, inputs, mxColumns);
+
+        mxArray *mxRecord = mxCreateStructMatrix(1, 1, 6, fieldNames);
+        mxSetField(mxRecord, 0, "iteration", mxCreateDoubleScalar((double)(i + 1)));
+        mxSetField(mxRecord, 0, "t", mxCreateDoubleScalar(log.time(i)));
+        for (size_t iCol = 0; iCol < COLUMN_COUNT; iCol++)
+            mxSetField(mxRecord, 0, COLUMN_NAMES[iCol], mxColumns[iCol] ? mxColumns[iCol] : mxCreateDoubleMatrix(0, 0, mxREAL));
+        mxArray *mxInputs = mxCreateCellMatrix(log.inputs.size(), 1);
+        for (size_t iIn = 0; iIn < log.inputs.size(); iIn++) mxSetCell(mxInputs, iIn, createIndices(inputs[iIn]));
+        mxSetField(mxRecord, 0, "inputs", mxInputs);
+        return mxRecord;
+    }
+
+    static mxArray *exportLog(LogStore &store, size_t iBlock) {
+        static const char *fieldNames[] = {"times", "inputs", "out", "debugOut", "state", "opaque"};
+        mxArray *mxRecords[COLUMN_COUNT] = {NULL, NULL, NULL};
+        if (!store.log(iBlock).resident) store.load(iBlock, mxRecords);
+        const BlockLog &log = store.log(iBlock);
+        mxArray *mxData = mxCreateStructMatrix(1, 1, 6, fieldNames);
+        size_t count = log.size();
+        mxArray *mxTimes = mxCreateDoubleMatrix(1, count, mxREAL);
+        if (count > 0) log.times.copyTo(mxGetPr(mxTimes), 0, count);
+        mxSetField(mxData, 0, "times", mxTimes);
+
+        mxArray *mxInputs = mxCreateCellMatrix(log.inputs.size(), 1);
+        for (size_t iIn = 0; iIn < log.inputs.size(); iIn++) {
+            const InputLog &input = log.inputs[iIn];
+            // linear array as long as there is at most one index per record
+            bool linear = true;
+            for (size_t i = 0; i < count && linear; i++) linear = (input.end(i) - input.begin(i) <= 1);
+            mxArray *mxIndices;
+            if (linear) {
+                mxIndices = mxCreateDoubleMatrix(1, count, mxREAL);
+                for (size_t i = 0; i < count; i++) mxGetPr(mxIndices)[i] = input.end(i) > input.begin(i) ? input.index(input.begin(i)) : 0.0;
+            } else {
+                mxIndices = mxCreateCellMatrix(1, count);
+                for (size_t i = 0; i < count; i++) mxSetCell(mxIndices, i, createIndices(input, i));
+            }
+            mxSetCell(mxInputs, iIn, mxIndices);
+        }
+        mxSetField(mxData, 0, "inputs", mxInputs);
+
+        for (size_t iCol = 0; iCol < COLUMN_COUNT; iCol++) {
+            if (log.columns[iCol].kind() == Column::TYPED) mxSetField(mxData, 0, COLUMN_NAMES[iCol], log.columns[iCol].exportRecords());
+            else if (mxRecords[iCol]) mxSetField(mxData, 0, COLUMN_NAMES[iCol], mxRecords[iCol]);
+            else mxSetField(mxData, 0, COLUMN_NAMES[iCol], mxCreateDoubleMatrix(0, 0, mxREAL));
+        }
+        mxSetField(mxData, 0, "opaque", createOpaqueMask(log));
+        return mxData;
+    }
+};
+
+static LogStoreManager logStoreManager;
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    try {
+        logStoreManager.mexFunction(nlhs, plhs, nrhs, prhs);
+    } catch (const std::exception &e) {
+        mexErrMsgIdAndTxt("mex_log_store:error", "%s", e.what());
+    }
+}
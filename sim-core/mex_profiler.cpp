@@ -0,0 +1,303 @@
+//$ mex mex_profiler.cpp -I../tools/mex/include # Maltab command for generating the MEX file
+/*******************************************************
+ * Timing recorder for simulator_engine (see experiment_base.m, 'profile').
+ * The engine marks the begin of each phase of a block (processing, input
+ * propagation, log unload, log append, drawing, ...). The time since the
+ * previous mark is accounted to the previous phase: its duration is added
+ * to a histogram of the block and phase (logarithmic buckets, 8 per
+ * octave, i.e. percentiles are accurate within 12.5%) and, while there is
+ * space left, the span is kept for the trace export.
+ *
+ * Construction: profiler = mex_object_handle(@mex_profiler, opts)
+ * opts: struct with fields
+ *   .blocks - cell array of block names (index 0 is named 'engine')
+ *   .phases - cell array of phase names
+ *   .capacity - (optional) number of spans kept for the trace (default: 1e6,
+ *               32 bytes each)
+ *
+ * Marks (no method name, for low overhead):
+ *   mex_profiler(profiler.key, block, phase)
+ *       Ends the current span and begins a span of the given block (0 for
+ *       the engine itself) and phase (1-based). Phase 0 only ends the
+ *       current span.
+ *
+ * Methods:
+ *   report = profiler.invoke('report')
+ *       Struct array with one element per block and phase that has been
+ *       recorded, fields .block, .phase (names), .count, .total, .mean,
+ *       .p50, .p99, .max (durations in s)
+ *   [count, dropped] = profiler.invoke('trace', 'file', file)
+ *       Writes the spans in Chrome trace event format (JSON, viewable with
+ *       chrome://tracing or Perfetto). count is the number of spans written,
+ *       dropped the number of spans that did not fit into the trace buffer.
+ *   profiler.invoke('reset')
+ *       Discards all histograms and spans
+ */
+
+#include "mex.h"
+#include "matrix.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <mex/object_manager.hpp>
+
+#define SUB_BUCKET_BITS 3 // 8 buckets per octave
+#define SUB_BUCKETS     (1 << SUB_BUCKET_BITS)
+#define LINEAR_BUCKETS  (2 * SUB_BUCKETS) // durations below are counted exactly
+#define BUCKET_COUNT    (LINEAR_BUCKETS + (64 - SUB_BUCKET_BITS - 1) * SUB_BUCKETS)
+
+// histogram of durations in ns
+class Histogram {
+public:
+    Histogram(): counts_(BUCKET_COUNT, 0), count_(0), total_(0), max_(0) { }
+
+    void add(uint64_t ns) {
+        counts_[bucket(ns)]++;
+        count_++;
+        total_ += ns;
+        max_ = std::max(max_, ns);
+    }
+
+    uint64_t count() const { return count_; }
+    uint64_t total() const { return total_; }
+    uint64_t max() const { return max_; }
+
+    // upper bound of the bucket holding the quantile q, at most max()
+    uint64_t quantile(double q) const {
+        uint64_t rank = (uint64_t)std::ceil(q * (double)count_), sum = 0;
+        for (int i = 0; i < BUCKET_COUNT; i++) {
+            sum += counts_[i];
+            if (sum >= rank && sum > 0) return std::min(upperBound(i), max_);
+        }
+        return max_;
+    }
+
+private:
+    static int bucket(uint64_t ns) {
+        if (ns < LINEAR_BUCKETS) return (int)ns;
+        int octave = SUB_BUCKET_BITS + 1;
+        while (octave < 63 && (ns >> (octave + 1)) != 0) octave++;
+        // the SUB_BUCKET_BITS bits below the leading one select the bucket
+        return LINEAR_BUCKETS + (octave - SUB_BUCKET_BITS - 1) * SUB_BUCKETS + (int)((ns >> (octave - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+    }
+
+    static uint64_t upperBound(int i) {
+        if (i < LINEAR_BUCKETS) return (uint64_t)i;
+        int octave = (i - LINEAR_BUCKETS) / SUB_BUCKETS + SUB_BUCKET_BITS + 1;
+        uint64_t sub = (uint64_t)((i - LINEAR_BUCKETS) % SUB_BUCKETS);
+        uint64_t lower = (SUB_BUCKETS + sub) << (octave - SUB_BUCKET_BITS);
+        return lower + ((uint64_t)1 << (octave - SUB_BUCKET_BITS)) - 1;
+    }
+
+    std::vector<uint64_t> counts_;
+    uint64_t count_, total_, max_;
+};
+
+struct Span {
+    int64_t begin;     // ns since the profiler was created
+    int64_t duration;  // ns
+    uint32_t block;
+    uint32_t phase;    // 1-based
+};
+
+class Profiler {
+public:
+    Profiler(const std::vector<std::string> &blocks, const std::vector<std::string> &phases, size_t capacity):
+        blocks_(blocks), phases_(phases), capacity_(capacity), origin_(std::chrono::steady_clock::now()),
+        histograms_(blocks.size() * phases.size()), currentBlock_(0), currentPhase_(0), currentBegin_(0), dropped_(0) {
+        spans_.reserve(std::min(capacity, (size_t)1 << 16));
+    }
+
+    void mark(size_t block, size_t phase) {
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin_).count();
+        if (currentPhase_ > 0) {
+            int64_t duration = now - currentBegin_;
+            std::unique_ptr<Histogram> &histogram = histograms_[currentBlock_ * phases_.size() + currentPhase_ - 1];
+            if (!histogram) histogram.reset(new Histogram());
+            histogram->add((uint64_t)duration);
+            if (spans_.size() < capacity_) {
+                Span span = { currentBegin_, duration, (uint32_t)currentBlock_, (uint32_t)currentPhase_ };
+                spans_.push_back(span);
+            } else dropped_++;
+        }
+        currentBlock_ = block;
+        currentPhase_ = phase;
+        currentBegin_ = now;
+    }
+
+    size_t blockCount() const { return blocks_.size(); }
+    size_t phaseCount() const { return phases_.size(); }
+
+    mxArray *report() const {
+        static const char *fieldNames[] = {"block", "phase", "count", "total", "mean", "p50", "p99", "max"};
+        size_t count = 0;
+        for (size_t i = 0; i < histograms_.size(); i++) if (histograms_[i]) count++;
+        mxArray *mxReport = mxCreateStructMatrix(count, 1, 8, fieldNames);
+        size_t iEntry = 0;
+        for (size_t i = 0; i < histograms_.size(); i++) {
+            const Histogram *histogram = histograms_[i].get();
+            if (!histogram) continue;
+            mxSetField(mxReport, iEntry, "block", mxCreateString(blocks_[i / phases_.size()].c_str()));
+            mxSetField(mxReport, iEntry, "phase", mxCreateString(phases_[i % phases_.size()].c_str()));
+            mxSetField(mxReport, iEntry, "count", mxCreateDoubleScalar((double)histogram->count()));
+            mxSetField(mxReport, iEntry, "total", mxCreateDoubleScalar(1e-9 * histogram->total()));
+            mxSetField(mxReport, iEntry, "mean", mxCreateDoubleScalar(1e-9 * histogram->total() / histogram->count()));
+            mxSetField(mxReport, iEntry, "p50", mxCreateDoubleScalar(1e-9 * histogram->quantile(0.5)));
+            mxSetField(mxReport, iEntry, "p99", mxCreateDoubleScalar(1e-9 * histogram->quantile(0.99)));
+            mxSetField(mxReport, iEntry, "max", mxCreateDoubleScalar(1e-9 * histogram->max()));
+            iEntry++;
+        }
+        return mxReport;
+    }
+
+    // Chrome trace event format: complete events ('X') with time stamps in us
+    size_t writeTrace(const std::string &path) const {
+        std::unique_ptr<FILE, int (*)(FILE *)> file(fopen(path.c_str(), "w"), fclose);
+        if (!file) throw std::runtime_error("Could not open trace file '" + path + "'");
+        std::vector<std::string> blockNames(blocks_.size()), phaseNames(phases_.size());
+        for (size_t i = 0; i < blocks_.size(); i++) blockNames[i] = escape(blocks_[i]);
+        for (size_t i = 0; i < phases_.size(); i++) phaseNames[i] = escape(phases_[i]);
+        fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+              "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"simulator\"}}", file.get());
+        for (size_t i = 0; i < spans_.size(); i++) {
+            const Span &span = spans_[i];
+            fprintf(file.get(), ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1,\"args\":{\"phase\":\"%s\"}}",
+                    blockNames[span.block].c_str(), phaseNames[span.phase - 1].c_str(), 1e-3 * span.begin, 1e-3 * span.duration,
+                    phaseNames[span.phase - 1].c_str());
+        }
+        fputs("\n]}\n", file.get());
+        if (ferror(file.get())) throw std::runtime_error("Could not write trace file '" + path + "'");
+        return spans_.size();
+    }
+
+    uint64_t dropped() const { return dropped_; }
+
+    void reset() {
+        for (size_t i = 0; i < histograms_.size(); i++) histograms_[i].reset();
+        spans_.clear();
+        currentPhase_ = 0;
+        dropped_ = 0;
+    }
+
+private:
+    static std::string escape(const std::string &s) {
+        std::string escaped;
+        for (size_t i = 0; i < s.size(); i++) {
+            char c = s[i];
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+                escaped += c;
+            } else if ((unsigned char)c < 0x20) {
+                char code[8];
+                snprintf(code, sizeof(code), "\\u%04x", (unsigned)c);
+                escaped += code;
+            } else escaped += c;
+        }
+        return escaped;
+    }
+
+    std::vector<std::string> blocks_, phases_;
+    size_t capacity_;
+    std::chrono::steady_clock::time_point origin_;
+    std::vector<std::unique_ptr<Histogram> > histograms_; // block * phaseCount + phase - 1, allocated on first use
+    std::vector<Span> spans_;
+    size_t currentBlock_, currentPhase_;
+    int64_t currentBegin_;
+    uint64_t dropped_;
+};
+
+enum ProfilerMethod {
+    METHOD_REPORT,
+    METHOD_TRACE,
+    METHOD_RESET
+};
+
+static std::vector<std::string> getStrings(const mxArray *mxOpts, const char *name) {
+    const mxArray *mxCell = mxOpts ? mxGetField(mxOpts, 0, name) : NULL;
+    if (!mxCell || !mxIsCell(mxCell)) throw std::runtime_error(std::string("Parameter '") + name + "' must be a cell array of strings");
+    std::vector<std::string> strings(mxGetNumberOfElements(mxCell));
+    for (size_t i = 0; i < strings.size(); i++) {
+        const mxArray *mxString = mxGetCell(mxCell, i);
+        if (!mxString || mxIsEmpty(mxString)) continue;
+        if (!mxIsChar(mxString)) throw std::runtime_error(std::string("Parameter '") + name + "' must be a cell array of strings");
+        char *str = mxArrayToString(mxString);
+        strings[i] = str;
+        mxFree(str);
+    }
+    return strings;
+}
+
+static size_t getIndex(const mxArray *mxIndex, size_t count, const char *name) {
+    double value = mxIsDouble(mxIndex) && mxGetNumberOfElements(mxIndex) == 1 ? mxGetScalar(mxIndex) : -1.0;
+    if (!(value >= 0 && value <= count) || value != std::floor(value)) throw std::runtime_error(std::string("Invalid ") + name + " index");
+    return (size_t)value;
+}
+
+class ProfilerManager: public mex::object_manager<Profiler> {
+public:
+    ProfilerManager() {
+        setConstructionRequiresArgument(true);
+        addMethod("report", METHOD_REPORT);
+        addMethod("trace", METHOD_TRACE);
+        addMethod("reset", METHOD_RESET);
+    }
+
+    virtual Profiler *create(const mxArray *mxOpts) {
+        std::vector<std::string> blocks = getStrings(mxOpts, "blocks");
+        blocks.insert(blocks.begin(), "engine");
+        std::vector<std::string> phases = getStrings(mxOpts, "phases");
+        if (phases.empty()) throw std::runtime_error("Parameter 'phases' must not be empty");
+        double capacity = 1e6;
+        const mxArray *mxCapacity = mxGetField(mxOpts, 0, "capacity");
+        if (mxCapacity) {
+            capacity = mxIsNumeric(mxCapacity) && mxGetNumberOfElements(mxCapacity) == 1 ? mxGetScalar(mxCapacity) : -1.0;
+            if (!(capacity >= 0.0 && capacity <= 1e9)) throw std::runtime_error("Parameter 'capacity' must be within [0, 1e9]");
+        }
+        return new Profiler(blocks, phases, (size_t)capacity);
+    }
+
+    virtual void invoke(Profiler &profiler, int methodId, const mxArray *mxOpts, int nlhs, mxArray *plhs[]) {
+        switch (methodId) {
+        case METHOD_REPORT:
+            if (nlhs > 1) throw std::runtime_error("Too many output arguments");
+            plhs[0] = profiler.report();
+            break;
+        case METHOD_TRACE: {
+            if (nlhs > 2) throw std::runtime_error("Too many output arguments");
+            const mxArray *mxFile = mxOpts ? mxGetField(mxOpts, 0, "file") : NULL;
+            if (!mxFile || !mxIsChar(mxFile) || mxIsEmpty(mxFile)) throw std::runtime_error("Parameter 'file' must be a non-empty string");
+            char *file = mxArrayToString(mxFile);
+            std::string path(file);
+            mxFree(file);
+            plhs[0] = mxCreateDoubleScalar((double)profiler.writeTrace(path));
+            if (nlhs > 1) plhs[1] = mxCreateDoubleScalar((double)profiler.dropped());
+            break;
+        }
+        case METHOD_RESET:
+            if (nlhs > 0) throw std::runtime_error("Too many output arguments");
+            profiler.reset();
+            break;
+        }
+    }
+};
+
+static ProfilerManager profilerManager;
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    try {
+        if (nrhs == 3 && !mxIsChar(prhs[1])) {
+            // mark: (key, block, phase)
+            if (nlhs > 0) throw std::runtime_error("Too many output arguments");
+            Profiler &profiler = profilerManager.instance(prhs[0]);
+            profiler.mark(getIndex(prhs[1], profiler.blockCount() - 1, "block"), getIndex(prhs[2], profiler.phaseCount(), "phase"));
+        } else profilerManager.mexFunction(nlhs, plhs, nrhs, prhs);
+    } catch (const std::exception &e) {
+        mexErrMsgIdAndTxt("mex_profiler:error", "%s", e.what());
+    }
+}
@@ -100,6 +100,8 @@ function simulate(param)
 	stepping.fixedMenuHandle = uimenu(steppingSelectionMenu, 'Label', sprintf('Fixed interval (%0.3f s)...', settings.stepping.interval), 'Callback', @(varargin)selectStepping(NaN));	
 	
 	recomputeAction.menuHandle = uimenu(simMenu, 'Label', 'Recompute from here', 'enable', 'off', 'separator', 'on', 'Callback', @prepareRecompute);	
+	parameterAction.menuHandle = uimenu(simMenu, 'Label', 'Change block parameter...', 'Callback', @prepareParameterChange);
+	parameterAction.defaults = {'', '', ''}; % last input of the dialog
 		
 	videoAction.menuHandle = uimenu(simMenu, 'Label', 'Record Video...', 'separator', 'on', 'Callback', @toggleVideo);
     viewControl.toggleAction.menuHandle = uimenu(simMenu, 'Label', 'Show/Hide', 'Callback', @showHideViewControlWindow, 'Accelerator', '8');
@@ -560,6 +562,40 @@ function simulate(param)
         end        
  	end
 
+    % Change a parameter of one or more blocks and recompute these blocks and
+    % the blocks depending on them from the most recent checkpoint (see
+    % recomputeBlocks() in simulator_engine.m)
+    % Callback for parameterAction's controls
+    function prepareParameterChange(varargin)
+        doPause();
+        answer = inputdlg({'Block(s) (name or pattern, e.g. */localization)', 'Parameter', 'Value (Matlab expression)'}, ...
+                          'Change Block Parameter', 1, parameterAction.defaults);
+        if isempty(answer); return; end
+        parameterAction.defaults = answer;
+        try
+            indices = simCtrl.setBlockParameters(answer{1}, answer{2}, eval(answer{3}));
+        catch ME
+            uiwait(errordlg(ME.message, 'Change Block Parameter'));
+            return;
+        end
+
+        % recompute from the displayed point in time
+        tFrom = t;
+        if replay; tFrom = tLog; end
+        t = simCtrl.recomputeBlocks(indices, tFrom);
+        tLog = t;
+        experimentFinished = false;
+        dirty = true;
+        if t == 0; set(timelineSlider, 'Enable', 'off', 'Value', 0, 'Max', eps); end
+        setTime(t);
+        setReplay(false);
+        setActionEnabled(stepBackAction, t > 0);
+        setActionEnabled(pauseAction, true);
+        setActionEnabled(runAction, true);
+        setActionEnabled(stepAction, true);
+        update(1:length(blocks));
+    end
+
     % Some small helper functions for the above
 	function setReplay(newReplay)
 		if newReplay == replay; return; end
@@ -656,10 +692,13 @@ function simulate(param)
     % appropriate method for each mode
     function update(changed, iElems, iFigs)
 		simBlocks = simCtrl.getBlocks();
-        [simLogs, logPositions] = simCtrl.getLogs();
+        logPositions = simCtrl.getLogPositions();
+        profiler = simCtrl.getProfiler();
 		for iIdx = 1:length(changed)
 			iBlock = changed(iIdx);
+            if ~isempty(profiler.key); mex_profiler(profiler.key, iBlock, profiler.phase.draw); end
             loaded = false;
+            blockLog = []; % full log for useLogs/drawLog, fetched on first use
             if ~replay
                 logPos = simBlocks(iBlock).iteration;
                 [out, debugOut, state, inputs] = deal(simBlocks(iBlock).out, simBlocks(iBlock).debugOut, simBlocks(iBlock).state, simBlocks(iBlock).lastInputs);
@@ -679,10 +718,11 @@ function simulate(param)
                     blocks(iBlock).graphicElements(iElem).needsUpdate = false;
 
                     if blocks(iBlock).graphicElements(iElem).useLogs
+                        if isempty(blockLog); blockLog = simCtrl.getLogs(iBlock); end
                         blocks(iBlock).graphicElements(iElem).handles = ...
                             blocks(iBlock).graphicElements(iElem).draw(...
                                 simBlocks(iBlock).spec, mw.ax, blocks(iBlock).graphicElements(iElem).handles, ...
-                                logPos, simLogs(iBlock).times, simLogs(iBlock).out, simLogs(iBlock).debugOut, simLogs(iBlock).state);
+                                logPos, blockLog.times, blockLog.out, blockLog.debugOut, blockLog.state);
                     else
                         if replay && ~loaded; loadLogRecord(changed(iIdx)); end
                         if isempty(out); continue; end % no break, since maybe we have some entries with useLogs left over
@@ -701,9 +741,10 @@ function simulate(param)
                     blocks(iBlock).figures(iFig).needsUpdate = false;
                                         
                     if ~isempty(blocks(iBlock).figures(iFig).drawLog)
+                        if isempty(blockLog); blockLog = simCtrl.getLogs(iBlock); end
                         blocks(iBlock).figures(iFig).userData = blocks(iBlock).figures(iFig).drawLog(...
                             simBlocks(iBlock).spec, blocks(iBlock).figures(iFig).handle, blocks(iBlock).figures(iFig).userData, ...
-                            logPos, simLogs(iBlock).times, simLogs(iBlock).out, simLogs(iBlock).debugOut, simLogs(iBlock).state);
+                            logPos, blockLog.times, blockLog.out, blockLog.debugOut, blockLog.state);
                     end
                     if ~isempty(blocks(iBlock).figures(iFig).draw)
                         if replay && ~loaded; loadLogRecord(changed(iIdx)); end
@@ -719,8 +760,10 @@ function simulate(param)
             end            
 		end
 		
+		if ~isempty(profiler.key); mex_profiler(profiler.key, 0, profiler.phase.draw); end
 		if replay; setTime(tLog); else setTime(t); end
         drawnow; % cancellation point
+        if ~isempty(profiler.key); mex_profiler(profiler.key, 0, 0); end
         
         function loadLogRecord(iBlock)
             logRecord = simCtrl.getLogRecords(iBlock);
@@ -794,6 +837,10 @@ function simulate(param)
                 warning('Sim:Save:InvalidPath', 'Could not save experiment. '',path'' has wrong type');
             end
         end
+        % timing trace, if requested (see experiment_base.m)
+        if isfield(experiment, 'profile') && isstruct(experiment.profile) && isfield(experiment.profile, 'traceFile')
+            simCtrl.exportProfileTrace(experiment.profile.traceFile);
+        end
         save 'workspace.mat' settings;
         % finally delete the main window
         delete(mw.handle);
@@ -1,3 +1,348 @@
-function simulate_unattended(experiment)
+% Runs experiments without graphical user interface, e.g. parameter sweeps
+% and Monte Carlo runs on machines without display.
+%
+% results = simulate_unattended(experiment)
+% results = simulate_unattended(experiment, sweep)
+% results = simulate_unattended(experiment, sweep, options)
+%
+% experiment: experiment specification (see experiment_base.m)
+% sweep: cell array of parameter/values pairs, e.g.
+%        {'robot.controller.weights', {[2 0.2 0.2], [1 0.4 0.2]}, ...
+%         'robot.sensors.rangefinder.error', [0.005 0.01 0.02]}
+%        Parameters are paths of fields in the experiment specification,
+%        values are given as cell array or vector (one value per element).
+%        One run is made for every combination of values (default: {},
+%        i.e. the experiment as specified).
+% options: struct with the optional fields
+%   .repetitions - number of runs per combination of values (Monte Carlo
+%                  runs, default: 1)
+%   .seed - seed of the random number streams (default: 0). Run k uses
+%           substream k of an 'mrg32k3a' stream, i.e. the results neither
+%           depend on the number of workers nor on the order of the runs.
+%   .stopTime - maximum simulation time of each run (default: inf, i.e.
+%               until the experiment finishes by itself)
+%   .stop - stop block for each run (replaces experiment.stop, see
+%           experiment_base.m)
+%   .outputPath - folder for the results (default: experiment.path or a
+%                 new folder in tempdir)
+%   .saveLogs - save each run as experiment run<k>.mat (with log file
+%               run<k>.simlog) in outputPath (default: true). The log
+%               records are streamed to disk while the run proceeds.
+%   .workers - number of worker processes (default: number of cores).
+%              Workers are separate Matlab processes started without
+%              display (Unix only, otherwise the runs are made one after
+%              another in this process).
+%
+% results: struct array with one element per run and the fields
+%   .run - index of the run
+%   .parameters - values of the sweep parameters (cell array)
+%   .repetition - index of the run among the runs with these values
+%   .finished - true if the experiment finished by itself (maxT, stop block)
+%   .simTime - simulation time reached
+%   .wallTime - wall time of the run in seconds (incl. initialization)
+%   .steps - number of simulation steps
+%   .error - error message (empty if the run succeeded)
+%   .file - saved experiment (empty if .saveLogs is false)
+%   .blockNames, .out - names and final outputs of all blocks
+%   .profile - timing statistics and log memory of the run (see getProfile
+%              in simulator_engine.m), empty unless experiment.profile is
+%              set. The timing trace is written to run<k>-trace.json in
+%              outputPath.
+% Each result is written to run<k>-result.mat as soon as the run is
+% complete, all results to summary.mat at the end.
+function results = simulate_unattended(experiment, sweep, options)
+    if ischar(experiment) && strcmp(experiment, '--worker')
+        % simulate_unattended('--worker', jobFile, iWorker), see startWorkers
+        runWorker(sweep, options);
+        results = [];
+        return;
+    end
 
-end
\ No newline at end of file
+    if nargin < 2 || isempty(sweep); sweep = {}; end
+    if nargin < 3 || isempty(options); options = struct(); end
+    options = batchOptions(experiment, options);
+
+    runs = batchRuns(experiment, sweep, options.repetitions);
+    if ~exist(options.outputPath, 'dir')
+        mkdir(options.outputPath);
+    end
+
+    nWorkers = min(options.workers, numel(runs));
+    if nWorkers > 1 && ~isunix()
+        warning('Sim:Batch:NoWorkers', 'Worker processes are only supported on Unix, runs are made in this process');
+        nWorkers = 1;
+    end
+    fprintf('simulate_unattended: %d run(s), %d worker(s), results in ''%s''\n', numel(runs), nWorkers, options.outputPath);
+
+    startTime = tic();
+    if nWorkers <= 1
+        for k = 1:numel(runs)
+            result = runExperiment(experiment, runs(k), options);
+            printRunResult(result, numel(runs));
+        end
+    else
+        % the first run is made in this process, which also builds the mex
+        % files required by the experiment: the workers would otherwise
+        % compile them concurrently
+        result = runExperiment(experiment, runs(1), options);
+        printRunResult(result, numel(runs));
+        startWorkers(experiment, runs, options, nWorkers - 1);
+    end
+    totalTime = toc(startTime);
+
+    results = collectResults(runs, options);
+    save(fullfile(options.outputPath, 'summary.mat'), 'results', 'sweep', 'options', 'totalTime');
+    printSummary(results, totalTime, nWorkers);
+end
+
+function options = batchOptions(experiment, options)
+    defaults = struct('repetitions', 1, 'seed', 0, 'stopTime', inf, 'stop', [], ...
+                      'outputPath', [], 'saveLogs', true, 'workers', feature('numcores'));
+    fields = fieldnames(defaults);
+    for i = 1:numel(fields)
+        if ~isfield(options, fields{i}) || (isempty(options.(fields{i})) && ~strcmp(fields{i}, 'stop'))
+            options.(fields{i}) = defaults.(fields{i});
+        end
+    end
+    unknown = setdiff(fieldnames(options), fields);
+    if ~isempty(unknown)
+        error('Sim:Batch:InvalidOption', 'Unknown option ''%s''', unknown{1});
+    end
+
+    if isempty(options.outputPath)
+        if isfield(experiment, 'path') && ischar(experiment.path) && ~isempty(experiment.path)
+            options.outputPath = experiment.path;
+        else options.outputPath = fullfile(tempdir(), ['sim_batch_' datestr(now(), 'yyyymmdd_HHMMSS')]);
+        end
+    end
+    % workers are started in the current folder, but absolute paths keep
+    % the results in place if a block changes the folder
+    if isunix() && options.outputPath(1) ~= '/'
+        options.outputPath = fullfile(pwd(), options.outputPath);
+    end
+end
+
+% one run per combination of parameter values and repetition
+function runs = batchRuns(experiment, sweep, repetitions)
+    if ~iscell(sweep) || mod(numel(sweep), 2) ~= 0
+        error('Sim:Batch:InvalidSweep', 'Sweep must be a cell array of parameter/values pairs');
+    end
+    names = sweep(1:2:end);
+    values = sweep(2:2:end);
+    for i = 1:numel(names)
+        if ~ischar(names{i})
+            error('Sim:Batch:InvalidSweep', 'Sweep parameter %d: path string expected', i);
+        end
+        try
+            parts = regexp(names{i}, '\.', 'split');
+            getfield(experiment, parts{:});
+        catch
+            error('Sim:Batch:InvalidSweep', 'Sweep parameter ''%s'' not found in the experiment specification', names{i});
+        end
+        if ~iscell(values{i})
+            if ischar(values{i}); values{i} = values(i);
+            else values{i} = num2cell(values{i});
+            end
+        end
+        if isempty(values{i})
+            error('Sim:Batch:InvalidSweep', 'No values given for sweep parameter ''%s''', names{i});
+        end
+    end
+
+    counts = cellfun(@numel, values);
+    nCombinations = prod(counts);
+    runs = repmat(struct('index', 0, 'names', {names}, 'values', {{}}, 'repetition', 0), 1, nCombinations * repetitions);
+    for c = 1:nCombinations
+        selected = cell(1, numel(names));
+        if ~isempty(names)
+            indices = cell(1, numel(names));
+            [indices{:}] = ind2sub([counts 1], c);
+            for i = 1:numel(names)
+                selected{i} = values{i}{indices{i}};
+            end
+        end
+        for r = 1:repetitions
+            k = (c - 1) * repetitions + r;
+            runs(k).index = k;
+            runs(k).values = selected;
+            runs(k).repetition = r;
+        end
+    end
+end
+
+function result = runExperiment(experiment, run, options)
+    result = struct('run', run.index, 'parameters', {run.values}, 'repetition', run.repetition, ...
+                    'finished', false, 'simTime', 0, 'wallTime', 0, 'steps', 0, 'error', '', ...
+                    'file', '', 'blockNames', {{}}, 'out', {{}}, 'profile', []);
+
+    spec = experiment;
+    for i = 1:numel(run.names)
+        parts = regexp(run.names{i}, '\.', 'split');
+        spec = setfield(spec, parts{:}, run.values{i});
+    end
+    if ~isempty(options.stop)
+        spec.stop = options.stop;
+    end
+    % the engine streams the log records to <path>.simlog while running
+    if options.saveLogs
+        spec.path = fullfile(options.outputPath, sprintf('run%05d.mat', run.index));
+    else spec.path = [];
+    end
+
+    % independent, reproducible random numbers per run
+    previousStream = RandStream.getGlobalStream();
+    stream = RandStream('mrg32k3a', 'Seed', options.seed);
+    stream.Substream = run.index;
+    RandStream.setGlobalStream(stream);
+
+    engine = [];
+    startTime = tic();
+    try
+        engine = simulator_engine(spec);
+        [tSim, finished] = engine.getExperimentState();
+        while ~finished && tSim < options.stopTime
+            engine.doStep();
+            [tSim, finished] = engine.getExperimentState();
+            result.steps = result.steps + 1;
+        end
+        result.simTime = tSim;
+        result.finished = finished;
+    catch ME
+        result.error = ME.message;
+    end
+    if ~isempty(engine)
+        % failed runs are saved as well, for looking into the problem
+        if options.saveLogs
+            if engine.saveExperiment(spec.path)
+                result.file = spec.path;
+            elseif isempty(result.error)
+                result.error = sprintf('Could not save experiment to ''%s''', spec.path);
+            end
+        end
+        blocks = engine.getBlocks();
+        named = ~cellfun(@isempty, {blocks.name});
+        result.blockNames = {blocks(named).name};
+        result.out = {blocks(named).out};
+        result.profile = engine.getProfile();
+        if ~isempty(result.profile)
+            engine.exportProfileTrace(fullfile(options.outputPath, sprintf('run%05d-trace.json', run.index)));
+        end
+    end
+    clear engine;
+    result.wallTime = toc(startTime);
+
+    RandStream.setGlobalStream(previousStream);
+    save(resultFile(options, run.index), 'result');
+end
+
+function file = resultFile(options, k)
+    file = fullfile(options.outputPath, sprintf('run%05d-result.mat', k));
+end
+
+% runs 2..N are distributed to nWorkers Matlab processes, the function
+% returns when all workers have exited
+function startWorkers(experiment, runs, options, nWorkers)
+    jobFile = fullfile(options.outputPath, 'batch-job.mat');
+    job = struct();
+    job.searchPath = path();
+    job.experiment = experiment;
+    job.runs = runs;
+    job.options = options;
+    job.assignment = cell(1, nWorkers);
+    for i = 1:nWorkers
+        job.assignment{i} = (1 + i):nWorkers:numel(runs);
+    end
+    save(jobFile, '-struct', 'job');
+
+    quote = @(s) strrep(s, '''', '''''');
+    matlabExe = fullfile(matlabroot(), 'bin', 'matlab');
+    simCorePath = fileparts(mfilename('fullpath'));
+    exitFiles = cell(1, nWorkers);
+    logFiles = cell(1, nWorkers);
+    for i = 1:nWorkers
+        exitFiles{i} = fullfile(options.outputPath, sprintf('batch-worker%d.exit', i));
+        logFiles{i} = fullfile(options.outputPath, sprintf('batch-worker%d.log', i));
+        if exist(exitFiles{i}, 'file'); delete(exitFiles{i}); end
+        call = sprintf('addpath(''%s''); simulate_unattended(''--worker'', ''%s'', %d);', quote(simCorePath), quote(jobFile), i);
+        cmd = sprintf('("%s" -nodisplay -nosplash -singleCompThread -r "try, %s catch ME, disp(getReport(ME)); exit(1); end; exit(0);" < /dev/null > "%s" 2>&1; echo $? > "%s") &', ...
+                      matlabExe, call, logFiles{i}, exitFiles{i});
+        [status, message] = system(cmd);
+        if status ~= 0
+            error('Sim:Batch:Worker', 'Could not start worker %d: %s', i, message);
+        end
+    end
+
+    % wait for the workers, report progress as results come in
+    running = true(1, nWorkers);
+    reported = 1;
+    while any(running)
+        pause(1);
+        for i = find(running)
+            if exist(exitFiles{i}, 'file')
+                code = str2double(fileread(exitFiles{i}));
+                if isnan(code); continue; end % exit code not written yet
+                running(i) = false;
+                if code ~= 0
+                    warning('Sim:Batch:Worker', 'Worker %d failed, see ''%s''', i, logFiles{i});
+                end
+                delete(exitFiles{i});
+            end
+        end
+        completed = 1;
+        for k = 2:numel(runs)
+            completed = completed + (exist(resultFile(options, k), 'file') == 2);
+        end
+        if completed > reported
+            fprintf('%d/%d runs completed\n', completed, numel(runs));
+            reported = completed;
+        end
+    end
+    delete(jobFile);
+end
+
+function runWorker(jobFile, iWorker)
+    % the search path is required before loading function handles
+    job = load(jobFile, 'searchPath');
+    path(job.searchPath);
+    job = load(jobFile);
+    for k = job.assignment{iWorker}
+        result = runExperiment(job.experiment, job.runs(k), job.options);
+        printRunResult(result, numel(job.runs));
+    end
+end
+
+function results = collectResults(runs, options)
+    results = [];
+    for k = 1:numel(runs)
+        file = resultFile(options, k);
+        if exist(file, 'file')
+            data = load(file, 'result');
+            result = data.result;
+        else
+            result = struct('run', k, 'parameters', {runs(k).values}, 'repetition', runs(k).repetition, ...
+                            'finished', false, 'simTime', 0, 'wallTime', 0, 'steps', 0, 'error', 'Run not completed', ...
+                            'file', '', 'blockNames', {{}}, 'out', {{}}, 'profile', []);
+        end
+        if isempty(results); results = result; else results(k) = result; end
+    end
+end
+
+function printRunResult(result, nRuns)
+    if isempty(result.error)
+        fprintf('run %d/%d: t = %.2f s in %.2f s wall time (%d steps)\n', result.run, nRuns, result.simTime, result.wallTime, result.steps);
+    else fprintf('run %d/%d failed: %s\n', result.run, nRuns, result.error);
+    end
+end
+
+function printSummary(results, totalTime, nWorkers)
+    failed = ~cellfun(@isempty, {results.error});
+    succeeded = results(~failed);
+    fprintf('\n%d run(s) in %.1f s with %d worker(s), %d failed: %.1f runs/hour\n', ...
+            numel(results), totalTime, nWorkers, sum(failed), 3600 * numel(results) / max(totalTime, eps));
+    if ~isempty(succeeded)
+        simTime = [succeeded.simTime];
+        wallTime = [succeeded.wallTime];
+        fprintf('per run: %.2f s simulated in %.2f s wall time on average, sim-time/wall-time %.2f (min %.2f, max %.2f)\n', ...
+                mean(simTime), mean(wallTime), mean(simTime ./ wallTime), min(simTime ./ wallTime), max(simTime ./ wallTime));
+    end
+end
@@ -3,7 +3,7 @@
 % An instance can be created from either an experiment specification or a
 % saved experiment (for replay or further computation)
 function engine = simulator_engine(param)
-    saveFormatVersion = 1.0;
+    saveFormatVersion = 2.0;
     
     if isempty(param)
         error('Experiment specification or path to stored experiment data required');
@@ -11,6 +11,11 @@ function engine = simulator_engine(param)
     
     engine = struct();
     
+    % log file, the log records are streamed to (empty: logs are kept in
+    % memory and saved to the *.mat file, see saveExperiment())
+    logFile = '';
+    logIndexOffset = [];
+    
     if ischar(param)
         % experiment given by file path. Load data structures from the
         % appropriate *.mat file
@@ -21,7 +26,17 @@ function engine = simulator_engine(param)
             % If the save format ever changes in an incompatible way,
             % conversion code based on the 'version' variable can be placed
             % here.
+            % Version 1.0 files always contain the full logs.
         end        
+        if version >= 2.0
+            logFileInfo = load(param, 'logFile', 'logIndexOffset');
+            if ~isempty(logFileInfo.logFile)
+                % the log records are read from the log file on demand
+                logFile = fullfile(fileparts(param), logFileInfo.logFile);
+                logIndexOffset = logFileInfo.logIndexOffset;
+            end
+            clear logFileInfo;
+        end
         clear version;
 
     	% Restore simulation time and log positions
@@ -35,7 +50,7 @@ function engine = simulator_engine(param)
         blocks = [];
         stopBlockIndex = 0;
         % detect all blocks in the experiment specification
-        fields = setdiff(fieldnames(experiment), {'name', 'path', 'depends', 'display'});
+        fields = setdiff(fieldnames(experiment), {'name', 'path', 'depends', 'display', 'profile', 'checkpointInterval'});
         for i = 1:numel(fields)
             [experiment.(fields{i}), blocks] = extractRuntimeBlocks(experiment.(fields{i}), blocks, fields{i});            
         end        
@@ -171,29 +186,22 @@ function engine = simulator_engine(param)
         % Keep log data from separated from runtime blocks.
         % This allows saving them to a different file and thus throwing them
         % away without loosing the experiment specification.
-        logs = repmat(struct('nUsed', 0, 'times', [], 'allocIncrement', 0, 'out', [], 'debugOut', [], 'state', [], ...
-                            'inputs', {{}}, 'cache', [], 'cacheOrder', [], 'load', [], 'unload', []), ...
-                      size(blocks));
+        logs = repmat(savedLogTemplate(), size(blocks));
 
         % Format of the logs array - one struct per block
-        % .nUsed - number of array elements occupied by meaningful data
+        % (This is the format of saved experiments and of getLogs(). While
+        % the engine is running, the data is kept in chunks by the native
+        % log store, see importLogs() and mex_log_store.cpp. Experiments
+        % with a log file save the records to the log file instead, see
+        % saveExperiment())
+        % .nUsed - number of records
         % .times - time series (linear array)
-        % .allocIncrement - number of entries to allocate, whenever the arrays
-        %                   must grow. This number is automatically determined
-        %                   according to the expected execution rate of the
-        %                   block.
         % .out, .debugOut, .state - cell or standard standard with the appropriate
         %                        data from the block. For uniform output, the
         %                        type is determined by the first block
         %                        iteration, The first dimension (if any) is
         %                        governed by the block data, the second
         %                        dimension is the iteration.
-        %                        For non-uniform output, .debugOut and .state are 
-        %                        allocated on the first non-empty return value, 
-        %                        thus saving the overhead with empty cells (For
-        %                        uniform output, this optimization is not used,
-        %                        since holding a 0 x whatever array does not
-        %                        occupy any memory.
         % .outSize, .debugOutSize, .stateSize - In uniform logs, each record is
         %                                    stored as a column vector (beause
         %                                    the horizontal direction is time).
@@ -207,14 +215,13 @@ function engine = simulator_engine(param)
         % .inputs - cell array of size nInputs. Each cell stores the input 
         %           sequence for the particular input of the block as indices
         %           into the log of the providing block (thus not duplicating 
-        %           the data). To yield the best memory efficiency, the
-        %           framework tries to store the index data in a linear array 
-        %           as long as there is only one input per iteration (the 
-        %           <no inputs>-situation is coded by a zero). As soon as a log 
-        %           entry with more than one data record for an input arrives, 
-        %           the array beloging to this input is converted to a cell 
-        %           array to support a variable number of input records per 
-        %           call.
+        %           the data). To yield the best memory efficiency, the index
+        %           data is stored in a linear array as long as there is only
+        %           one input per iteration (the <no inputs>-situation is
+        %           coded by a zero). If any log entry has more than one data
+        %           record for an input, the input sequence is stored as a
+        %           cell array to support a variable number of input records
+        %           per call.
         % .cache - struct array, cache for holding full log records. This array
         %          is always allocated to its maximum size (see block's 
         %          log.maxCached entry). Each entry is a struct with fields
@@ -224,6 +231,7 @@ function engine = simulator_engine(param)
         %               full is evicted next.
         % .load/.unload - copy of the function handles for loading/unloading
         %                 from the block specification
+        % .enabled, .uniform - log settings from the block specification
 
         % logPositions are used in conjunction with setLogPos and inc/decLogPos
         % to keep track of which record to return from getLogRecord
@@ -257,15 +265,10 @@ function engine = simulator_engine(param)
                     end
                 end
 
-                logs(iBlock).allocIncrement = calcAllocIncrement(blocks, iBlock);
-                if logs(iBlock).uniform
-                    logs(iBlock).out = [];   % dimension associated on first log entry
-                    logs(iBlock).debugOut = []; % dimension associated on first log entry
-                    logs(iBlock).state = []; % dimension associated on first log entry
-                else
-                    logs(iBlock).out = cell(1, logs(iBlock).allocIncrement);
-                    logs(iBlock).debugOut = cell(1, logs(iBlock).allocIncrement);
-                    logs(iBlock).state = cell(1, logs(iBlock).allocIncrement);
+                if ~logs(iBlock).uniform
+                    logs(iBlock).out = {};
+                    logs(iBlock).debugOut = {};
+                    logs(iBlock).state = {};
                     logs(iBlock).cache = repmat(struct('iteration', 0, 'out', [], 'debugOut', [], 'state', []), max(1, blocks(iBlock).spec.log.maxCached), 1);
                     logs(iBlock).cacheOrder = 1:length(logs(iBlock).cache);                                
                 end
@@ -288,22 +291,101 @@ function engine = simulator_engine(param)
     	% calculate the initial timesteps
         experimentFinished = false;
         t = 0;     
+        
+        if isfield(experiment, 'path') && ischar(experiment.path) && ~isempty(experiment.path)
+            logFile = experimentLogFile(experiment.path);
+        end
     end
         
-    % initialized variables for doStep
-    [tNext, nextBlock] = min([blocks(:).nextTime]);
+    % the log data is kept by the native log store, which appends records
+    % in chunks without copying the existing data
+    mex_make(fullfile(fileparts(mfilename('fullpath')), 'mex_log_store.cpp'));
+    logStore = [];
+    logStoreKey = [];
+    if ~isempty(logFile) && isempty(logIndexOffset)
+        % new experiments stream their records to a temporary file, which
+        % becomes the log file when the experiment is saved
+        try
+            importLogs(logs, [logFile '.tmp'], []);
+        catch ME
+            warning('Sim:Log:NoLogFile', 'Could not create log file ''%s'', logs are kept in memory: %s', logFile, ME.message);
+            logFile = '';
+            importLogs(logs, '', []);
+        end
+    else importLogs(logs, logFile, logIndexOffset);
+    end
+
+    % the native scheduler decides which block to process next
+    % (initialized from the blocks' timing, see mex_block_scheduler.cpp)
+    mex_make(fullfile(fileparts(mfilename('fullpath')), 'mex_block_scheduler.cpp'));
+    scheduler = [];
+    schedulerKey = [];
+    resetScheduler();
+
+    % Periodic snapshots of the runtime blocks (every checkpointInterval
+    % seconds of simulation time, see experiment_base.m), from which
+    % recomputeBlocks() restarts. The first checkpoint is the initial state
+    % of all blocks, also for loaded experiments (checkpoints are not saved).
+    % Native objects (mex_object_handle) in the block states are cloned
+    % when taking and when restoring a checkpoint, see checkpointBlocks().
+    % Struct array with fields
+    % .t - simulation time of the checkpoint
+    % .blocks - struct array with the fields checkpointFields() and .timing
+    %           (spec.timing) of all blocks
+    checkpointInterval = 10;
+    if isfield(experiment, 'checkpointInterval') && ~isempty(experiment.checkpointInterval)
+        checkpointInterval = experiment.checkpointInterval;
+    end
+    currentBlocks = blocks;
+    for iBlock = 1:length(blocks); resetBlock(iBlock); end
+    checkpoints = struct('t', 0, 'blocks', checkpointBlocks(blocks));
+    blocks = currentBlocks;
+    clear currentBlocks;
+
+    % true for blocks, which doStep() replays from their logs instead of
+    % processing them (see recomputeBlocks())
+    replayBlocks = false(size(blocks));
+    
+    % Blocks, whose logged states do not hold their complete state (see
+    % log.restoresState in block_base.m), cannot continue from a log record
+    % and are recomputed from a checkpoint instead. For loaded experiments,
+    % this applies to all of them, which were already processed (their
+    % native objects only exist in the session that saved the experiment).
+    restorable = arrayfun(@(b)~isfield(b.spec.log, 'restoresState') || b.spec.log.restoresState, blocks);
+    pendingRestart = ~restorable & [blocks.iteration] > 0;
+
+    % optional timing instrumentation (experiment.profile, see
+    % experiment_base.m and mex_profiler.cpp). When it is off, profiler.key
+    % is empty and each instrumentation point costs a single test.
+    profiler = struct('key', [], 'phase', profilerPhases());
+    profilerHandle = [];
+    if isfield(experiment, 'profile') && ~isempty(experiment.profile) && ~isequal(experiment.profile, false)
+        mex_make(fullfile(fileparts(mfilename('fullpath')), 'mex_profiler.cpp'));
+        opts = struct('blocks', {{blocks.name}}, 'phases', {fieldnames(profiler.phase)'});
+        if isstruct(experiment.profile) && isfield(experiment.profile, 'capacity')
+            opts.capacity = experiment.profile.capacity;
+        end
+        profilerHandle = mex_object_handle(@mex_profiler, opts);
+        profiler.key = profilerHandle.key;
+    end
         
     engine.getExperimentSpecification = @getExperimentSpecification;
     engine.getBlocks = @getBlocks;
     engine.getLogs = @getLogs;
+    engine.getLogPositions = @getLogPositions;
     engine.doStep = @doStep;
     engine.setLogPosition = @setLogPosition;
     engine.incLogPosition = @incLogPosition;
     engine.decLogPosition = @decLogPosition;
     engine.getLogRecords = @getLogRecords;
     engine.recomputeFromHere = @recomputeFromHere;
+    engine.setBlockParameters = @setBlockParameters;
+    engine.recomputeBlocks = @recomputeBlocks;
     engine.getExperimentState = @getExperimentState;
     engine.saveExperiment = @saveExperiment;
+    engine.getProfiler = @getProfiler;
+    engine.getProfile = @getProfile;
+    engine.exportProfileTrace = @exportProfileTrace;
     
     % some getters
     function ret = getBlocks()
@@ -312,14 +394,24 @@ function engine = simulator_engine(param)
     function ret = getExperimentSpecification()
         ret = experiment;
     end
-    function [retLogs, retLogPositions] = getLogs()
-        retLogs = logs;
+    % log data of the blocks indices (default: all blocks) in the format of
+    % saved experiments
+    function [retLogs, retLogPositions] = getLogs(indices)
+        if nargin < 1; indices = 1:length(logs); end
+        retLogs = exportLogs(indices);
         retLogPositions = logPositions;
     end    
+    function ret = getLogPositions()
+        ret = logPositions;
+    end
     function [tSim, finished] = getExperimentState()
         tSim = t;
         finished = experimentFinished;
     end        
+    % key and phase numbers for marks outside the engine, e.g. drawing
+    function ret = getProfiler()
+        ret = profiler;
+    end
     
     % Propagate simulation to a tNew > t
     function [tNew, changed] = doStep()        
@@ -328,18 +420,22 @@ function engine = simulator_engine(param)
             tNew = t;
             return;
         end
+        if any(pendingRestart); restartBlocks(find(pendingRestart)); end
         
-        % propagate simulation until t has incremented at least a bit
-        while(true)
-            if isinf(tNext)
-                error('Cannot determine next block due to an unsupported combination of block timings.');
-            end
-            [blocks, logs, newChanged] = processBlock(blocks, logs, nextBlock, tNext);
-            changed = [changed newChanged];
-            t = tNext;
-            [tNext, nextBlock] = min([blocks(:).nextTime]);
-            if tNext > t; break; end
+        % propagate simulation until t has incremented at least a bit:
+        % the scheduler returns the blocks of the next time step one by one
+        % (inputs first) and iBlock == 0 at the end of the step. Each call
+        % reports the outcome of the previous block.
+        if ~isempty(profiler.key); mex_profiler(profiler.key, 0, profiler.phase.schedule); end
+        [iBlock, tBlock] = mex_block_scheduler(schedulerKey, 'next');
+        while iBlock > 0
+            [blocks, logs, produced, replayBlocks(iBlock)] = processBlock(blocks, logs, logStoreKey, profiler, iBlock, tBlock, replayBlocks(iBlock));
+            if produced; changed = [changed iBlock]; end
+            t = tBlock;
+            if ~isempty(profiler.key); mex_profiler(profiler.key, 0, profiler.phase.schedule); end
+            [iBlock, tBlock] = mex_block_scheduler(schedulerKey, 'next', struct('produced', produced, 'nextTime', blocks(iBlock).nextTime));
         end
+        if ~isempty(profiler.key); mex_profiler(profiler.key, 0, 0); end
         tNew = t;
         
         % check if experiment finished
@@ -358,23 +454,22 @@ function engine = simulator_engine(param)
                 end
             end
         end
+
+        if experimentFinished
+            dropReplayedRecords();
+        elseif t >= checkpoints(end).t + checkpointInterval
+            checkpoints(end + 1) = struct('t', t, 'blocks', checkpointBlocks(blocks));
+        end
     end
 
     % init / move all log pointers to the most recent record, whose time is
-    % smaller than or equal to t
-    function [tNew, changed] = setLogPosition(t)
-		fprintf('setLogPosition(%f)\n', t);
+    % smaller than or equal to tDesired (records beyond the simulation time,
+    % which are still to be replayed, are not visited)
+    function [tNew, changed] = setLogPosition(tDesired)
+		fprintf('setLogPosition(%f)\n', tDesired);
 		oldLogPositions = logPositions;
-        tNew = 0;
-        for iBlock = 1:length(logs)
-            pos = find(logs(iBlock).times(1:(logs(iBlock).nUsed)) <= t, 1, 'last');
-            if isempty(pos) || pos > logs(iBlock).nUsed
-                logPositions(iBlock) = 0;
-            else
-                logPositions(iBlock) = pos;
-                if logs(iBlock).times(pos) > tNew; tNew = logs(iBlock).times(pos); end
-            end
-        end
+        [positions, tNew] = mex_log_store(logStoreKey, 'seek', struct('t', min(tDesired, t)));
+        logPositions(:) = positions;
         logTCurrent = tNew;
 		changed = find(logPositions ~= oldLogPositions);
     end
@@ -382,29 +477,12 @@ function engine = simulator_engine(param)
     % least one element in logPositions as long as the log's end is not
     % reached
     function [tNew, changed] = incLogPosition()        
-        minTime = logTCurrent + 1e-7; % add some minimum increment to accomodate rounding errors
-        tNew = inf;
-        % first determine the smallest time larger than the new logPosition
-        for iBlock = 1:length(logs)
-            iFirst = max(1, logPositions(iBlock));
-			iRec = find(logs(iBlock).times(iFirst:logs(iBlock).nUsed) >= minTime, 1);
-            if isempty(iRec); continue; end
-            iRec = iRec + iFirst - 1;
-			if logs(iBlock).times(iRec) < tNew; tNew = logs(iBlock).times(iRec); end
-		end		
-        if ~isinf(tNew)            
+        [positions, tNew] = mex_log_store(logStoreKey, 'stepForward', struct('t', logTCurrent, 'positions', logPositions));
+        if ~isinf(tNew) && tNew <= t
             logTCurrent = tNew;
-            % now advance logPositions as far as neccessary to fulfil the
-            % condition that all log timestampts are nearest but not above
-            % logTCurrent
+            % all log timestamps are nearest but not above logTCurrent
             oldLogPositions = logPositions;
-            for iBlock = 1:length(logs)
-                iFirst = max(1, logPositions(iBlock));
-				iRec = find(logs(iBlock).times(iFirst:logs(iBlock).nUsed) > tNew, 1);
-				if isempty(iRec); logPositions(iBlock) = logs(iBlock).nUsed;
-				else logPositions(iBlock) = iRec + iFirst - 2; 
-				end
-            end
+            logPositions(:) = positions;
             changed = find(logPositions ~= oldLogPositions);
         else
             % at end of log
@@ -416,20 +494,11 @@ function engine = simulator_engine(param)
     % similar to incLogPos: will move all logPointers so that at least one
     % time
     function [tNew, changed] = decLogPosition()
-        maxTime = logTCurrent - 1e-7;
-        tNew = 0;
-        for iBlock = 1:length(logs)
-			iRec = find(logs(iBlock).times(1:logPositions(iBlock)) <= maxTime, 1, 'last');
-            if isempty(iRec); continue; end
-            if logs(iBlock).times(iRec) > tNew; tNew = logs(iBlock).times(iRec); end
-        end
+        [positions, tNew] = mex_log_store(logStoreKey, 'stepBackward', struct('t', logTCurrent, 'positions', logPositions));
         logTCurrent = tNew;
 		
         oldLogPositions = logPositions;
-        for iBlock = 1:length(blocks)
-            iRec = find(logs(iBlock).times(1:logPositions(iBlock)) <= tNew, 1, 'last');
-            if ~isempty(iRec); logPositions(iBlock) = iRec; end
-		end
+        logPositions(:) = positions;
         changed = find(logPositions ~= oldLogPositions);
     end
     
@@ -444,7 +513,15 @@ function engine = simulator_engine(param)
         records = repmat(struct('iteration', [], 't', [], 'out', [], 'debugOut', [], 'state', [], 'inputs', []), size(indices));
         for i = 1:numel(indices)
             iBlock = indices(i);
-			[logs, records(i)] = loadLogRecord(blocks, logs, iBlock, logPositions(iBlock));
+            % the load function of blocks, whose logged states are
+            % incomplete, also gets the checkpointed state (see log.load in
+            % block_base.m)
+            checkpointed = {};
+            if ~restorable(iBlock) && ~isempty(logs(iBlock).load) && logPositions(iBlock) > 0 && logPositions(iBlock) <= logs(iBlock).nUsed
+                tRecord = mex_log_store(logStoreKey, 'times', struct('block', iBlock, 'iterations', logPositions(iBlock)));
+                checkpointed = {checkpoints(find([checkpoints.t] <= tRecord, 1, 'last')).blocks(iBlock).state};
+            end
+			[logs, records(i)] = loadLogRecord(blocks, logs, logStoreKey, iBlock, logPositions(iBlock), checkpointed{:});
 			% convert from inputIndices in .inputs to the full input data
             records(i).inputs = expandInputs(iBlock, records(i).inputs);            
         end
@@ -466,14 +543,9 @@ function engine = simulator_engine(param)
                 % prepare .inputBuffers, .inputIndicesBuffers and .nextTime
                 if logPos < logs(iBlock).nUsed
                     blocks(iBlock) = determineNextBlockTimeStep(blocks(iBlock), blocks(iBlock).lastTime);
+                    nextRecord = mex_log_store(logStoreKey, 'record', struct('block', iBlock, 'iteration', logPos + 1));
                     for iIn = 1:numel(blocks(iBlock).depends)
-                        if ~iscell(logs(iBlock).inputs{iIn})
-                            inIdx = logs(iBlock).inputs{iIn}(logPos + 1);
-                            if inIdx == 0; blocks(iBlock).inputIndicesBuffers{iIn} = [];
-                            else blocks(iBlock).inputIndicesBuffers{iIn} = inIdx;
-                            end                            
-                        else blocks(iBlock).inputIndicesBuffers{iIn} = logs(iBlock).inputs{iIn}{logPos + 1};
-                        end
+                        blocks(iBlock).inputIndicesBuffers{iIn} = nextRecord.inputs{iIn};
                     end
                 % else: data is already valid
                 end
@@ -481,7 +553,8 @@ function engine = simulator_engine(param)
                 % remove data from inputBuffers, that has not yet been
                 % computed
                 for iIn = 1:numel(blocks(iBlock).depends)
-                    firstInvalid = find(logs(blocks(iBlock).depends(iIn)).times(blocks(iBlock).inputIndicesBuffers{iIn}) > logTCurrent, 1);
+                    inTimes = mex_log_store(logStoreKey, 'times', struct('block', blocks(iBlock).depends(iIn), 'iterations', blocks(iBlock).inputIndicesBuffers{iIn}));
+                    firstInvalid = find(inTimes > logTCurrent, 1);
                     if ~isempty(firstInvalid); blocks(iBlock).inputIndicesBuffers{iIn}(firstInvalid:end) = []; end
                 end
                 blocks(iBlock).inputBuffers = expandInputs(iBlock, blocks(iBlock).inputIndicesBuffers);
@@ -489,26 +562,159 @@ function engine = simulator_engine(param)
             end
         end
         % Clear data from end of log (do not clear it in the above loop, as
-        % restoring the inputBuffers array accesses logs.times beyond the
+        % restoring the inputBuffers array accesses the log times beyond the
         % current log position, to determine, which inputs are already
         % available at logTCurrent.
         for iBlock = 1:length(blocks)            
-            logPos = logPositions(iBlock);
-            logs(iBlock).nUsed = logPos;
-            logs(iBlock).times((logPos + 1):end) = [];
-            logs(iBlock).out(:, (logPos + 1):end) = [];
-            logs(iBlock).debugOut(:, (logPos + 1):end) = [];
-            logs(iBlock).state(:, (logPos + 1):end) = [];
-            for iIn = 1:length(logs(iBlock).inputs)
-                logs(iBlock).inputs{iIn}((logPos + 1):end) = []; % works for uniform arrays and cell arrays
-            end                
+            mex_log_store(logStoreKey, 'truncate', struct('block', iBlock, 'count', logPositions(iBlock)));
+            logs(iBlock) = truncateOpaqueRecords(logs(iBlock), logPositions(iBlock));
         end
         
+        replayBlocks(:) = false;
+        checkpoints([checkpoints.t] > logTCurrent) = [];
+        
         % finally restore the simulation time
         experimentFinished = false;
         t = logTCurrent;
-        [tNext, nextBlock] = min([blocks(:).nextTime]);        
+        resetScheduler();
+        
+        if t > 0 && any(~restorable); restartBlocks(find(~restorable)); end
     end    
+
+    % Set parameters of the blocks matching pattern (see 'depends' in
+    % block_base.m), given as name/value pairs or as a struct. The new
+    % values are used when the blocks are processed the next time, call
+    % recomputeBlocks() to apply them to the results computed so far.
+    % Returns the indices of the changed blocks.
+    function indices = setBlockParameters(pattern, varargin)
+        if numel(varargin) == 1 && isstruct(varargin{1})
+            names = fieldnames(varargin{1})';
+            values = struct2cell(varargin{1})';
+        else
+            names = varargin(1:2:end);
+            values = varargin(2:2:end);
+        end
+        structural = intersect(names, {'timing', 'depends', 'process', 'log'});
+        if ~isempty(structural)
+            error('Sim:Parameters:Structural', 'Parameter ''%s'' defines the structure of the experiment and cannot be changed', structural{1});
+        end
+        indices = getBlocksFromPattern(blocks, '', pattern);
+        if isempty(indices)
+            error('Sim:Parameters:BlocksNotFound', 'Block ''%s'' not found', pattern);
+        end
+        for iBlock = indices
+            for i = 1:numel(names)
+                if ~isfield(blocks(iBlock).spec, names{i})
+                    warning('Sim:Parameters:Unknown', 'Block ''%s'' has no parameter ''%s''', blocks(iBlock).name, names{i});
+                end
+                blocks(iBlock).spec.(names{i}) = values{i};
+            end
+        end
+        % keep the experiment specification (saved with the experiment) up
+        % to date
+        experiment = blockfun(@setSpecParameters, experiment, indices, names, values);
+    end
+
+    % Recompute the blocks indices (or a block pattern) after a change of
+    % their parameters (see setBlockParameters()), starting from the most
+    % recent checkpoint at or before tFrom (default: the current simulation
+    % time). Only the given blocks and the blocks depending on them, directly
+    % or indirectly via their inputs or triggers, are recomputed. All other
+    % blocks are restored from the checkpoint as well, but doStep() replays
+    % their logged records instead of processing them, until their logs end.
+    % Blocks without log cannot be replayed and are always recomputed.
+    % Note: If a recomputed block requests a replayed continuous block at a
+    % time it was not processed at in the logged run (because the timing of
+    % the recomputed block changed), it gets the most recent logged output.
+    % Returns the simulation time of the checkpoint and a logical array
+    % marking the recomputed blocks.
+    function [tNew, affected] = recomputeBlocks(indices, tFrom)
+        if nargin < 2; tFrom = t; end
+        if ischar(indices); indices = getBlocksFromPattern(blocks, '', indices); end
+        affected = affectedBlocks(indices);
+
+        iCheckpoint = find([checkpoints.t] <= tFrom, 1, 'last');
+        checkpoint = checkpoints(iCheckpoint);
+        % later checkpoints hold results of the old parameters
+        checkpoints((iCheckpoint + 1):end) = [];
+
+        fields = checkpointFields();
+        for iBlock = 1:length(blocks)
+            for iField = 1:numel(fields)
+                blocks(iBlock).(fields{iField}) = checkpoint.blocks(iBlock).(fields{iField});
+            end
+            % keep the checkpoint for later restarts
+            blocks(iBlock).state = cloneNativeObjects(blocks(iBlock).state);
+            blocks(iBlock).spec.timing = checkpoint.blocks(iBlock).timing;
+            if affected(iBlock)
+                count = min(blocks(iBlock).iteration, logs(iBlock).nUsed);
+                mex_log_store(logStoreKey, 'truncate', struct('block', iBlock, 'count', count));
+                logs(iBlock) = truncateOpaqueRecords(logs(iBlock), count);
+            end
+        end
+        replayBlocks = ~affected & ([logs.nUsed] > [blocks.iteration]);
+        pendingRestart(:) = false;
+        fprintf('Recomputing %d of %d blocks from t = %f\n', nnz(affected), length(blocks), checkpoint.t);
+
+        experimentFinished = false;
+        t = checkpoint.t;
+        [positions, logTCurrent] = mex_log_store(logStoreKey, 'seek', struct('t', t));
+        logPositions(:) = positions;
+        resetScheduler();
+        tNew = t;
+    end
+
+    % Recompute the blocks indices from the most recent checkpoint up to
+    % the current simulation time, replaying all other blocks (see
+    % recomputeBlocks())
+    function restartBlocks(indices)
+        tResume = t;
+        recomputeBlocks(indices, tResume);
+        while t < tResume && ~experimentFinished
+            doStep();
+        end
+    end
+
+    % The blocks indices and all blocks depending on them (inputs and
+    % triggers), as logical array. Blocks without log are always included,
+    % as they cannot be replayed, and so are the blocks, which cannot
+    % continue from their checkpointed state (see restorable).
+    function affected = affectedBlocks(indices)
+        affected = false(size(blocks));
+        affected(indices) = true;
+        affected(~[logs.enabled]) = true;
+        affected(~restorable) = true;
+        pending = find(affected);
+        while ~isempty(pending)
+            iBlock = pending(end);
+            pending(end) = [];
+            for iNext = normalizeEmptyArray([blocks(iBlock).dependees.block, blocks(iBlock).triggers])
+                if affected(iNext); continue; end
+                affected(iNext) = true;
+                pending(end + 1) = iNext;
+            end
+        end
+    end
+
+    % Stop replaying blocks (see recomputeBlocks()): drop their logged
+    % records after the current simulation time, so all logs end at the
+    % same time again
+    function dropReplayedRecords()
+        for iBlock = normalizeEmptyArray(find(replayBlocks))
+            mex_log_store(logStoreKey, 'truncate', struct('block', iBlock, 'count', blocks(iBlock).iteration));
+            logs(iBlock) = truncateOpaqueRecords(logs(iBlock), blocks(iBlock).iteration);
+        end
+        replayBlocks(:) = false;
+    end
+    
+    % (Re)create the scheduler from the current block timing
+    function resetScheduler()
+        opts = struct('deltaT', arrayfun(@(b)b.spec.timing.deltaT, blocks), ...
+                      'nextTime', [blocks.nextTime], 'lastTime', [blocks.lastTime], ...
+                      'depends', {{blocks.depends}}, 'triggers', {{blocks.triggers}});
+        scheduler = mex_object_handle(@mex_block_scheduler, opts);
+        schedulerKey = scheduler.key;
+    end
     
     % Prepare a block for simulation (used during initialization and from
     % recomputeFromHere() )
@@ -547,7 +753,7 @@ function engine = simulator_engine(param)
         for iIn = 1:length(inputIndices)
             inExpanded = repmat(struct('t', [], 'data', []), size(inputIndices{iIn}));
             for iInEntry = 1:length(inputIndices{iIn})
-                [logs, tempRec] = loadLogRecord(blocks, logs, blocks(iBlock).depends(iIn), inputIndices{iIn}(iInEntry));
+                [logs, tempRec] = loadLogRecord(blocks, logs, logStoreKey, blocks(iBlock).depends(iIn), inputIndices{iIn}(iInEntry));
                 inExpanded(iInEntry).t = tempRec.t;
                 inExpanded(iInEntry).data = tempRec.out;
             end
@@ -555,11 +761,174 @@ function engine = simulator_engine(param)
         end
     end
 
+    % (Re)create the log store from log data in the format of saved
+    % experiments. With a file, the log store streams all records to this
+    % log file. If indexOffset is given, savedLogs holds no records, they
+    % are read from the existing log file instead.
+    % While the engine is running, the logs array holds the data not kept
+    % by the log store (see the format description above for the remaining
+    % fields):
+    % .opaque - 1x3 logical, true for the columns (.out, .debugOut, .state)
+    %           not stored by mex_log_store, i.e. all columns of non-uniform
+    %           logs and columns of uniform logs holding structs or cells.
+    %           The records of these columns are stored in chunks of
+    %           logChunkSize() records, e.g. .out{iChunk}{iEntry}. Records
+    %           of uniform logs are stored as column vectors.
+    % .resident - false for logs, whose records have not been loaded from
+    %             the log file yet. The log store decodes full records of
+    %             these logs from the file, the opaque columns are empty.
+    %             exportLogs() loads the whole log.
+    function importLogs(savedLogs, file, indexOffset)
+        uniform = arrayfun(@(l)isequal(l.uniform, true), savedLogs);
+        opts = struct('chunkSize', logChunkSize(), 'inputCount', arrayfun(@(b)numel(b.depends), blocks), 'uniform', uniform);
+        if ~isempty(file); opts.file = file; end
+        if ~isempty(indexOffset); opts.indexOffset = indexOffset; end
+        logStore = mex_object_handle(@mex_log_store, opts);
+        logStoreKey = logStore.key;
+
+        logs = repmat(struct('enabled', false, 'uniform', false, 'nUsed', 0, 'opaque', true(1, 3), 'resident', true, ...
+                             'out', {{}}, 'debugOut', {{}}, 'state', {{}}, 'outSize', [], 'debugOutSize', [], 'stateSize', [], ...
+                             'cache', [], 'cacheOrder', [], 'load', [], 'unload', []), size(savedLogs));
+        columns = {'out', 'debugOut', 'state'};
+        for iBlock = 1:numel(savedLogs)
+            saved = savedLogs(iBlock);
+            logs(iBlock).enabled = saved.enabled;
+            logs(iBlock).uniform = uniform(iBlock);
+            logs(iBlock).opaque = repmat(~uniform(iBlock), 1, 3);
+            logs(iBlock).cache = saved.cache;
+            logs(iBlock).cacheOrder = saved.cacheOrder;
+            logs(iBlock).load = saved.load;
+            logs(iBlock).unload = saved.unload;
+            if saved.nUsed == 0; continue; end
+            if ~isempty(indexOffset)
+                logs(iBlock).resident = false;
+                logs(iBlock).outSize = saved.outSize;
+                logs(iBlock).debugOutSize = saved.debugOutSize;
+                logs(iBlock).stateSize = saved.stateSize;
+                logs(iBlock).nUsed = saved.nUsed;
+                continue;
+            end
+
+            opts = struct('block', iBlock, 'count', saved.nUsed, 'times', saved.times, 'inputs', {saved.inputs});
+            if uniform(iBlock)
+                for iCol = 1:numel(columns)
+                    sizeName = [columns{iCol} 'Size'];
+                    logs(iBlock).(sizeName) = saved.(sizeName);
+                    opts.(columns{iCol}) = saved.(columns{iCol});
+                    opts.(sizeName) = saved.(sizeName);
+                end
+            end
+            logs(iBlock).opaque = mex_log_store(logStoreKey, 'import', opts);
+            for iCol = find(logs(iBlock).opaque)
+                records = saved.(columns{iCol});
+                if uniform(iBlock); records = num2cell(records(:, 1:saved.nUsed), 1);
+                else records = records(1:saved.nUsed);
+                end
+                logs(iBlock).(columns{iCol}) = toLogChunks(records);
+            end
+            logs(iBlock).nUsed = saved.nUsed;
+        end
+    end
+
+    % Log data of the blocks indices in the format of saved experiments
+    function exported = exportLogs(indices)
+        exported = repmat(savedLogTemplate(), size(indices));
+        columns = {'out', 'debugOut', 'state'};
+        for i = 1:numel(indices)
+            data = mex_log_store(logStoreKey, 'export', struct('block', indices(i)));
+            if ~logs(indices(i)).resident
+                % the log store has just loaded the log from the log file,
+                % keep its opaque records
+                logs(indices(i)).opaque = data.opaque;
+                for iCol = find(data.opaque)
+                    records = data.(columns{iCol});
+                    if logs(indices(i)).uniform; records = cellfun(@(r)r(:), records, 'UniformOutput', false); end
+                    logs(indices(i)).(columns{iCol}) = toLogChunks(records);
+                end
+                logs(indices(i)).resident = true;
+            end
+            blockLog = logs(indices(i));
+            exported(i) = savedLogMetadata(blockLog);
+            exported(i).times = data.times;
+            exported(i).inputs = data.inputs;
+            for iCol = 1:numel(columns)
+                if blockLog.opaque(iCol)
+                    records = fromLogChunks(blockLog.(columns{iCol}), blockLog.nUsed);
+                    if blockLog.uniform; records = [records{:}]; end
+                    exported(i).(columns{iCol}) = records;
+                else exported(i).(columns{iCol}) = data.(columns{iCol});
+                end
+            end
+        end
+    end
+
+    % Timing statistics and log memory of the experiment, empty if profiling
+    % is off. Struct with fields
+    % .timing - struct array with one element per block and phase (see
+    %           'report' in mex_profiler.cpp): .block, .phase, .count,
+    %           .total, .mean, .p50, .p99, .max (durations in s)
+    % .logs - struct array with one element per block: .block, .records,
+    %         .bytes (memory held by the log) and .allocations (number of
+    %         chunks allocated while the log grew)
+    function profile = getProfile()
+        profile = [];
+        if isempty(profiler.key); return; end
+        profile.timing = mex_profiler(profiler.key, 'report');
+        stats = mex_log_store(logStoreKey, 'stats');
+        profile.logs = struct('block', {blocks.name}, 'records', num2cell(stats.records), ...
+                              'bytes', num2cell(stats.bytes), 'allocations', num2cell(stats.allocations));
+        % opaque records are kept in the chunked cell arrays of the logs
+        for iBlock = 1:numel(logs)
+            opaque = {logs(iBlock).out, logs(iBlock).debugOut, logs(iBlock).state};
+            info = whos('opaque');
+            profile.logs(iBlock).bytes = profile.logs(iBlock).bytes + info.bytes;
+            profile.logs(iBlock).allocations = profile.logs(iBlock).allocations + sum(cellfun(@numel, opaque));
+        end
+    end
+
+    % Write the recorded spans in Chrome trace event format (JSON) to file.
+    % Returns the number of spans written (0 if profiling is off).
+    function count = exportProfileTrace(file)
+        count = 0;
+        if isempty(profiler.key); return; end
+        [count, dropped] = mex_profiler(profiler.key, 'trace', struct('file', file));
+        if dropped > 0
+            warning('Sim:Profile:TraceFull', '%d spans did not fit into the trace buffer (experiment.profile.capacity)', dropped);
+        end
+    end
+
+    % Saves the experiment to the *.mat file path. With a log file, the
+    % records are already on disk: the log store adds an index to the log
+    % file (<name>.simlog next to path) and the *.mat file only holds the
+    % remaining log data (.logFile, .logIndexOffset). Otherwise, the
+    % *.mat file holds the full logs (.logFile is empty).
     function success = saveExperiment(path)
         success = true;
-        version = saveFormatVersion;
+        % the saved logs end at the simulation time
+        dropReplayedRecords();
         try
-            save(path, 'version', 'experiment', 'blocks', 'logs', 'experimentFinished', 'stopBlockIndex');
+            data = struct();
+            data.version = saveFormatVersion;
+            data.experiment = experiment;
+            data.blocks = blocks;
+            data.experimentFinished = experimentFinished;
+            data.stopBlockIndex = stopBlockIndex;
+            if ~isempty(logFile)
+                target = experimentLogFile(path);
+                data.logIndexOffset = mex_log_store(logStoreKey, 'save', struct('file', target));
+                logFile = target;
+                [~, name, ext] = fileparts(target);
+                data.logFile = [name ext];
+                data.logs = repmat(savedLogTemplate(), size(logs));
+                for iBlock = 1:numel(logs)
+                    data.logs(iBlock) = savedLogMetadata(logs(iBlock));
+                end
+            else
+                data.logFile = '';
+                data.logIndexOffset = [];
+                data.logs = exportLogs(1:length(logs));
+            end
+            save(path, '-struct', 'data');
         catch ME
             success = false;
             warning('Sim:Save:Failed', 'Could not save experiment to ''%s'': %s', path, ME.message);
@@ -567,41 +936,85 @@ function engine = simulator_engine(param)
     end
 end
 
+% log data of a single block in the format of saved experiments, see the
+% initialization of the logs array for a description of the fields
+function log = savedLogTemplate()
+    log = struct('nUsed', 0, 'times', [], 'out', [], 'debugOut', [], 'state', [], ...
+                 'inputs', {{}}, 'cache', [], 'cacheOrder', [], 'load', [], 'unload', [], ...
+                 'enabled', false, 'uniform', false, 'outSize', [], 'debugOutSize', [], 'stateSize', []);
+end
 
-% generate an allocation increment based on the expected frequency of 
-% computations for a single block. This routine merges the block's own
-% interval time (if not continuous) as well as triggers and requests
-% generated from depending blocks.
-function incr = calcAllocIncrement(blocks, iBlock)
-    deltaT = getShortestInterval(blocks, iBlock, false(size(blocks)));
-    
-    if deltaT > 0
-        incr = 1 / deltaT; % should be sufficient for one second (replace '1' with the number of seconds desired until reallocation)
-    else incr = 10; % default value
-    end
-    incr = round(incr);
-    
-    if incr < 1; incr = 1;
-    elseif incr > 100; incr = 100;
-    end    
+% log data of a single block in the format of saved experiments without the
+% records (.times, .inputs, .out, .debugOut, .state)
+function saved = savedLogMetadata(log)
+    saved = savedLogTemplate();
+    saved.nUsed = log.nUsed;
+    saved.outSize = log.outSize;
+    saved.debugOutSize = log.debugOutSize;
+    saved.stateSize = log.stateSize;
+    saved.cache = log.cache;
+    saved.cacheOrder = log.cacheOrder;
+    saved.load = log.load;
+    saved.unload = log.unload;
+    saved.enabled = log.enabled;
+    saved.uniform = log.uniform;
+end
+
+% log file of an experiment saved to path
+function file = experimentLogFile(path)
+    [folder, name] = fileparts(path);
+    file = fullfile(folder, [name '.simlog']);
+end
+
+% number of records per chunk of the log store and of opaque log records
+function n = logChunkSize()
+    n = 1024;
 end
-function [deltaT, ignore] = getShortestInterval(blocks, iBlock, ignore)
-    deltaT = blocks(iBlock).spec.timing.deltaT;
-    if deltaT <= 0; deltaT = inf; end
-    ignore(iBlock) = true;
-    if blocks(iBlock).spec.timing.deltaT > 0
-        peers = blocks(iBlock).triggeredBy;
-    else peers = unique([blocks(iBlock).dependees.block]);
+
+% split a 1xn cell array of records into chunks of logChunkSize() records
+function chunks = toLogChunks(records)
+    chunkSize = logChunkSize();
+    chunks = cell(1, ceil(numel(records) / chunkSize));
+    for iChunk = 1:numel(chunks)
+        iFirst = (iChunk - 1) * chunkSize + 1;
+        iLast = min(iChunk * chunkSize, numel(records));
+        chunks{iChunk} = cell(1, chunkSize);
+        chunks{iChunk}(1:(iLast - iFirst + 1)) = records(iFirst:iLast);
     end
-    
-    for iPeer = normalizeEmptyArray(peers)
-        if ~ignore(iPeer)
-            [deltaTPeer, ignore] = getShortestInterval(blocks, iPeer, ignore);
-            if deltaTPeer < deltaT; deltaT = deltaTPeer; end
+end
+
+% the first n records of chunks created by toLogChunks as 1xn cell array
+function records = fromLogChunks(chunks, n)
+    records = [cell(1, 0), chunks{:}];
+    records = records(1:n);
+end
+
+% drop the opaque records of a log after the first count records (the
+% records in the log store are truncated separately)
+function log = truncateOpaqueRecords(log, count)
+    chunkSize = logChunkSize();
+    nChunks = ceil(count / chunkSize);
+    columns = {'out', 'debugOut', 'state'};
+    for iCol = find(log.opaque & log.resident)
+        log.(columns{iCol})((nChunks + 1):end) = [];
+        if nChunks > 0
+            log.(columns{iCol}){nChunks}((count - (nChunks - 1) * chunkSize + 1):end) = {[]};
         end
-    end    
+    end
+    log.nUsed = count;
+    % loaded records of the dropped iterations are recomputed
+    if ~isempty(log.cache)
+        [log.cache([log.cache.iteration] > count).iteration] = deal(0);
+    end
+    % empty logs are resident, uniform logs select the column storage
+    % again on the next record
+    if count == 0
+        log.resident = true;
+        if log.uniform; log.opaque = false(1, 3); end
+    end
 end
 
+
 function [block] = determineNextBlockTimeStep(block, t)
     if block.spec.timing.deltaT > 0
         if ~isempty(block.spec.timing.getNextT)
@@ -620,36 +1033,26 @@ function [block] = determineNextBlockTimeStep(block, t)
     end
 end
 
-function [blocks, logs, changed] = processBlock(blocks, logs, iBlock, t)
-    changed = [];    
-    % prevent endless loops (should not happen, just to be sure)
-    if blocks(iBlock).locked; 
-        %fprintf('block %s is locked\n', blocks(iBlock).name);
-        return; 
-    end
-    if blocks(iBlock).lastTime >= t; 
-        %fprintf('block %s has already been computed\n', blocks(iBlock).name);
-        return; 
-    end
-
-    blocks(iBlock).locked = true;
-    %fprintf('locking %s\n', blocks(iBlock).name);
-    % prepare inputs (calculate all blocks we depend on)
-    for i = blocks(iBlock).depends        
-        if (blocks(i).spec.timing.deltaT > 0 && blocks(i).nextTime <= t) || ...
-           (blocks(i).spec.timing.deltaT == 0 && blocks(i).lastTime < t)
-            %fprintf('need to compute block %s before\n', blocks(i).name);
-            [blocks, logs, newChanged] = processBlock(blocks, logs, i, t);
-            changed = [changed, newChanged];
-        end        
-    end
+% Process a single block at time t. All blocks it depends on have already
+% been processed by then (the order is determined by mex_block_scheduler).
+% produced is true if the block generated output.
+% If replaying is true, the block's output is taken from its log instead
+% (see recomputeBlocks()). It is false on return, when the log is exhausted.
+function [blocks, logs, produced, replaying] = processBlock(blocks, logs, logStoreKey, profiler, iBlock, t, replaying)
+    produced = false;
+    profiling = ~isempty(profiler.key);
     
     % process block
-    fprintf('[%10.5f] processing ''%s''\n', t, blocks(iBlock).name);    
+    %fprintf('[%10.5f] processing ''%s''\n', t, blocks(iBlock).name);    
     iteration = blocks(iBlock).iteration + 1;
-    [newState, out, debugOut] = blocks(iBlock).spec.process(blocks(iBlock).spec, t, blocks(iBlock).state, blocks(iBlock).inputBuffers{:});
-    
-    blocks(iBlock).locked = false;
+    if profiling; mex_profiler(profiler.key, iBlock, profiler.phase.process); end
+    if replaying
+        [logs, replaying, iteration, newState, out, debugOut] = replayLogRecord(blocks, logs, logStoreKey, iBlock, t, iteration);
+    end
+    if ~replaying
+        [newState, out, debugOut] = blocks(iBlock).spec.process(blocks(iBlock).spec, t, blocks(iBlock).state, blocks(iBlock).inputBuffers{:});
+    end
+    if profiling; mex_profiler(profiler.key, iBlock, profiler.phase.inputs); end
         
     % remove processed data from our own input buffers
     lastInputs = blocks(iBlock).inputBuffers; % ...but save them for log
@@ -689,7 +1092,7 @@ function [blocks, logs, changed] = processBlock(blocks, logs, iBlock, t)
     % even with logging (partially) disabled
     blocks(iBlock).lastInputs = lastInputs; 
 
-    changed = [changed, iBlock];    
+    produced = true;
     
     % add generated output to inputBuffers of connected blocks
     for iOut = 1:length(blocks(iBlock).dependees)
@@ -719,133 +1122,128 @@ function [blocks, logs, changed] = processBlock(blocks, logs, iBlock, t)
         end
     end  
 
-    % fire triggers
+    % fire triggers (the scheduler does the same, this keeps the blocks
+    % array consistent for saving and recomputeFromHere)
     for trigger = normalizeEmptyArray(blocks(iBlock).triggers)
         if blocks(trigger).spec.timing.deltaT > 0 && blocks(trigger).lastTime < t
             blocks(trigger).nextTime = t;
         end
     end
 
-    % save out into log and inputBuffers of depending blocks    
-    if logs(iBlock).enabled
+    % save out into log and inputBuffers of depending blocks (replayed
+    % records are already logged)
+    if logs(iBlock).enabled && ~replaying
         
         % if available, use unload to reduce log data size
         if ~isempty(logs(iBlock).unload)
+            if profiling; mex_profiler(profiler.key, iBlock, profiler.phase.unload); end
             [outRecord, debugOutRecord, stateRecord] = ...
-                logs(iBlock).unload(blocks(iBlock).spec, iteration, origOut, blocks(iBlock).debugOut, blocks(iBlock).state);
+                logs(iBlock).unload(blocks(iBlock).spec, iteration, blocks(iBlock).out, blocks(iBlock).debugOut, blocks(iBlock).state);
         else [outRecord, debugOutRecord, stateRecord] = deal(blocks(iBlock).out, blocks(iBlock).debugOut, blocks(iBlock).state);            
         end
         
-        % store the current record
+        % store the current record: time, input indices and typed uniform
+        % data go to the log store (and its log file, if any), opaque
+        % records of resident logs are stored in chunks
+        if profiling; mex_profiler(profiler.key, iBlock, profiler.phase.log); end
+        try
+            opaque = mex_log_store(logStoreKey, 'append', struct('block', iBlock, 't', t, 'inputs', {lastInputIndices}, ...
+                                   'out', {outRecord}, 'debugOut', {debugOutRecord}, 'state', {stateRecord}));
+        catch ME
+            if logs(iBlock).uniform
+                warning('Sim:Core:LogConcatFailure', 'Could not append record to uniform log of block ''%s''. Either use ''normal'' logging or return consistent data', blocks(iBlock).name);
+            end
+            rethrow(ME);
+        end
         if logs(iBlock).uniform
-            % in a uniform log...
-            if logs(iBlock).nUsed > 0
-                if length(logs(iBlock).times) < iteration
-                    % resize
-                    logs(iBlock).times(end + logs(iBlock).allocIncrement) = 0;
-                    logs(iBlock).out(:, end + logs(iBlock).allocIncrement) = logs(iBlock).out(:, 1);
-                    logs(iBlock).debugOut(:, end + logs(iBlock).allocIncrement) = logs(iBlock).debugOut(:, 1);
-                    logs(iBlock).state(:, end + logs(iBlock).allocIncrement) = logs(iBlock).state(:, 1);
-                end
-                
-                try
-                    % store
-                    logs(iBlock).out(:, iteration) = outRecord(:);
-                    logs(iBlock).debugOut(:, iteration) = debugOutRecord(:);
-                    logs(iBlock).state(:, iteration) = stateRecord(:);
-                catch ME
-                    warning('Sim:Core:LogConcatFailure', 'Could not append record to uniform log of block ''%s''. Either use ''normal'' logging or return consistent data', blocks(iBlock).name);
-                    rethrow(ME);
-                end                
-            else
+            if logs(iBlock).nUsed == 0
                 % store original data size
                 % (e.g. original data might be a MxN matrix -> xxxSize = [M, N],
-                % However, it is stored as an M*N x 1 column in the uniform
-                % log array.)
+                % However, opaque records are stored as M*N x 1 columns,
+                % like in the exported log.)
                 logs(iBlock).outSize = size(outRecord);
                 logs(iBlock).debugOutSize = size(debugOutRecord);
                 logs(iBlock).stateSize = size(stateRecord);
-                logs(iBlock).out = outRecord(:);
-                logs(iBlock).debugOut = debugOutRecord(:);
-                logs(iBlock).state = stateRecord(:);
+                logs(iBlock).opaque = opaque;
             end
-        else
-            % non-uniform log
-            if length(logs(iBlock).times) < iteration
-                logs(iBlock).times(end + logs(iBlock).allocIncrement) = 0;
-                logs(iBlock).out{end + logs(iBlock).allocIncrement} = [];
-                logs(iBlock).debugOut{end + logs(iBlock).allocIncrement} = [];
-                logs(iBlock).state{end + logs(iBlock).allocIncrement} = [];
-            end
-            % no load/unload functions - store in full format
-            logs(iBlock).out{iteration} = outRecord;
-            logs(iBlock).debugOut{iteration} = debugOutRecord;
-            logs(iBlock).state{iteration} = stateRecord;
+            records = {outRecord(:), debugOutRecord(:), stateRecord(:)};
+        else records = {outRecord, debugOutRecord, stateRecord};
         end
-        
-        logs(iBlock).times(iteration) = t;
-        
-        % add input indices to log record
-        for iIn = 1:length(blocks(iBlock).depends)
-            if ~iscell(logs(iBlock).inputs{iIn})
-                % try to be memory efficient and avoid cell arrays, if
-                % possible
-                if length(lastInputIndices{iIn}) <= 1
-                    inIdx = lastInputIndices{iIn};
-                    if isempty(inIdx); inIdx = 0; end;
-                    if length(logs(iBlock).inputs{iIn}) < iteration; 
-                        logs(iBlock).inputs{iIn}(end + logs(iBlock).allocIncrement) = 0; 
-                    end
-                    logs(iBlock).inputs{iIn}(iteration) = inIdx;
-                    continue;
-                else
-                    % convert log to cell array
-                    logs(iBlock).inputs{iIn} = num2cell(logs(iBlock).inputs{iIn});
-                end
-            end
-            
-            % linear array not possible, use cell array instead
-            if length(logs(iBlock).inputs{iIn}) < iteration; 
-                logs(iBlock).inputs{iIn}{end + logs(iBlock).allocIncrement} = []; 
-            end
-            logs(iBlock).inputs{iIn}{iteration} = lastInputIndices{iIn};
+
+        chunkSize = logChunkSize();
+        iRecord = logs(iBlock).nUsed + 1; % == iteration
+        iChunk = ceil(iRecord / chunkSize);
+        iEntry = iRecord - (iChunk - 1) * chunkSize;
+        columns = {'out', 'debugOut', 'state'};
+        for iCol = find(opaque & logs(iBlock).resident)
+            if iEntry == 1; logs(iBlock).(columns{iCol}){iChunk} = cell(1, chunkSize); end
+            logs(iBlock).(columns{iCol}){iChunk}{iEntry} = records{iCol};
         end
-        
-        logs(iBlock).nUsed = logs(iBlock).nUsed + 1; % == iteration
+        logs(iBlock).nUsed = iRecord;
     end    
 end
 
+% Phases of the timing instrumentation, see getProfile() and
+% mex_profiler.cpp. The numbers must match the order of the fields.
+% - process: the block's process function
+% - inputs: bookkeeping of the engine after processing, i.e. updating the
+%           input buffers, passing the output to dependent blocks, triggers
+% - unload: the log unload function of the block
+% - log: appending the record to the log
+% - schedule: choosing the next block (block 0, the engine)
+% - draw: graphic elements and figures of the block (simulate.m)
+function phase = profilerPhases()
+    phase = struct('process', 1, 'inputs', 2, 'unload', 3, 'log', 4, 'schedule', 5, 'draw', 6);
+end
+
+% The logged record of block iBlock at time t, which is replayed instead of
+% processing the block (see recomputeBlocks()). iteration is the index of
+% the block's next record, records logged before t are skipped. out is
+% empty if the block did not produce output at t, replaying is false if the
+% log is exhausted (iteration is the index of the next record to log then).
+% Continuous blocks are processed whenever a dependent block needs their
+% output. If this happens at a time the block has not been processed at in
+% the logged run, the most recent record is repeated.
+function [logs, replaying, iteration, state, out, debugOut] = replayLogRecord(blocks, logs, logStoreKey, iBlock, t, iteration)
+    state = blocks(iBlock).state;
+    out = [];
+    debugOut = [];
+    tRecord = inf;
+    while iteration <= logs(iBlock).nUsed
+        tRecord = mex_log_store(logStoreKey, 'times', struct('block', iBlock, 'iterations', iteration));
+        if tRecord >= t; break; end
+        iteration = iteration + 1;
+    end
+    replaying = (iteration <= logs(iBlock).nUsed);
+    if ~replaying; return; end
+    if tRecord > t
+        if blocks(iBlock).spec.timing.deltaT > 0 || iteration <= 1; return; end
+        iteration = iteration - 1;
+    end
+    [logs, record] = loadLogRecord(blocks, logs, logStoreKey, iBlock, iteration);
+    [state, out, debugOut] = deal(record.state, record.out, record.debugOut);
+end
+
 % restore a single log record
 % record is a struct with fields
 % .iteration, .t, .out, .debugOut, .state - nothing special
 % .inputs - cell array with indices into the logs of input blocks
-function [logs, record] = loadLogRecord(blocks, logs, iBlock, iteration)
-    record = struct();
-    record.iteration = iteration;
+% Further arguments are passed to the load function of the block.
+function [logs, record] = loadLogRecord(blocks, logs, logStoreKey, iBlock, iteration, varargin)
     if logs(iBlock).enabled && iteration > 0 && iteration <= logs(iBlock).nUsed
-        record.t = logs(iBlock).times(iteration);
-        		
-		if logs(iBlock).uniform
-			record.out = reshape(logs(iBlock).out(:, iteration), logs(iBlock).outSize);
-			record.debugOut = reshape(logs(iBlock).debugOut(:, iteration), logs(iBlock).debugOutSize);
-			record.state = reshape(logs(iBlock).state(:, iteration), logs(iBlock).stateSize);          
-		else
-			record.out = logs(iBlock).out{iteration};
-			record.debugOut = logs(iBlock).debugOut{iteration};
-			record.state = logs(iBlock).state{iteration};
-		end
-		
-        nInputs = length(logs(iBlock).inputs);
-        record.inputs = cell(nInputs, 1);
-		for iIn = 1:nInputs
-			if ~iscell(logs(iBlock).inputs{iIn})
-                inIdx = logs(iBlock).inputs{iIn}(iteration);
-                if inIdx == 0; record.inputs{iIn} = [];
-                else record.inputs{iIn} = inIdx;
-                end                
-            else record.inputs{iIn} = logs(iBlock).inputs{iIn}{iteration};
-			end
-		end
+        record = mex_log_store(logStoreKey, 'record', struct('block', iBlock, 'iteration', iteration));
+
+        % opaque records of resident logs are not part of the log store
+        % record (records of other logs are decoded from the log file)
+        chunkSize = logChunkSize();
+        iChunk = ceil(iteration / chunkSize);
+        iEntry = iteration - (iChunk - 1) * chunkSize;
+        columns = {'out', 'debugOut', 'state'};
+        for iCol = find(logs(iBlock).opaque & logs(iBlock).resident)
+            data = logs(iBlock).(columns{iCol}){iChunk}{iEntry};
+            if logs(iBlock).uniform; data = reshape(data, logs(iBlock).([columns{iCol} 'Size'])); end
+            record.(columns{iCol}) = data;
+        end
 		
         if ~isempty(logs(iBlock).load)
             % this block uses the load/unload mechanism
@@ -859,7 +1257,7 @@ function [logs, record] = loadLogRecord(blocks, logs, iBlock, iteration)
                 
                 logs(iBlock).cache(cacheIdx).iteration = iteration;                
                 [logs(iBlock).cache(cacheIdx).out, logs(iBlock).cache(cacheIdx).debugOut, logs(iBlock).cache(cacheIdx).state] = ...
-                    logs(iBlock).load(blocks(iBlock).spec, iteration, record.out, record.debugOut, record.state);
+                    logs(iBlock).load(blocks(iBlock).spec, iteration, record.out, record.debugOut, record.state, varargin{:});
             else
                 % record is in cache, load it from there and reorder cache
                 order = logs(iBlock).cacheOrder;
@@ -876,9 +1274,8 @@ function [logs, record] = loadLogRecord(blocks, logs, iBlock, iteration)
             warning('Sim:Log:IndexOutOfRange', 'Accessing a non-existing log entry. This is an internal BUG!');
         end
         % log disabled or invalid index, create dummy record
-        record.t = 0;
-        record.out = []; record.debugOut = []; record.state = [];
-        record.inputs = cell(length(blocks(iBlock).depends), 1);
+        record = struct('iteration', iteration, 't', 0, 'out', [], 'debugOut', [], 'state', [], ...
+                        'inputs', {cell(length(blocks(iBlock).depends), 1)});
     end
 end
 
@@ -901,6 +1298,50 @@ end
 function s = substituteBlockIndex(s, substitutionTable)
     s.index = substitutionTable(s.index);
 end
+function s = setSpecParameters(s, indices, names, values)
+    if ~ismember(s.index, indices); return; end
+    for i = 1:numel(names); s.(names{i}) = values{i}; end
+end
+
+% fields of the runtime blocks kept by checkpoints (in addition to
+% spec.timing, which is changed while simulating, e.g. by getNextT)
+function fields = checkpointFields()
+    fields = {'lastTime', 'nextTime', 'iteration', 'out', 'debugOut', 'state', 'lastInputs', 'inputBuffers', 'inputIndicesBuffers'};
+end
+
+% the runtime state of all blocks for a checkpoint
+function snapshot = checkpointBlocks(blocks)
+    snapshot = rmfield(blocks, setdiff(fieldnames(blocks), checkpointFields()));
+    timing = arrayfun(@(b)b.spec.timing, blocks, 'UniformOutput', false);
+    [snapshot.timing] = timing{:};
+    for i = 1:numel(snapshot)
+        snapshot(i).state = cloneNativeObjects(snapshot(i).state);
+    end
+end
+
+% Replace the native objects (mex_object_handle) in s (possibly nested in
+% structs and cells) by independent copies. Objects, which do not support
+% copies (see clone() in object_manager.hpp), are kept: they are expected to
+% be immutable or to be recreated by their block.
+function s = cloneNativeObjects(s)
+    if isa(s, 'mex_object_handle')
+        if isscalar(s) && s.isValid()
+            copy = s.clone();
+            if ~isempty(copy); s = copy; end
+        end
+    elseif isstruct(s)
+        fields = fieldnames(s);
+        for i = 1:numel(s)
+            for j = 1:numel(fields)
+                s(i).(fields{j}) = cloneNativeObjects(s(i).(fields{j}));
+            end
+        end
+    elseif iscell(s)
+        for i = 1:numel(s)
+            s{i} = cloneNativeObjects(s{i});
+        end
+    end
+end
 
 function [blocks] = markUnused(blocks, iBlock)
     for i = normalizeEmptyArray([blocks(iBlock).depends blocks(iBlock).triggeredBy])
@@ -7,6 +7,19 @@
 % 
 % Since Matlab does not store correct Display-Aspect-Ratio information, we
 % have to override them using the -aspect command line option.
+%
+% VideoWriter encodes each frame within addFrame, i.e. it stalls the
+% simulation while recording. The 'Y4M stream' and 'PNG sequence' codecs
+% instead queue the frames for a writer thread (mex_frame_writer.cpp) and
+% leave the compression to ffmpeg afterwards, e.g.
+%
+% ffmpeg -i <inputfile>.y4m -vcodec h264 -qp 26 <outputfile>.mp4
+% ffmpeg -i <inputfile>.ffconcat -vcodec h264 -qp 26 -r <frameRate> <outputfile>.mp4
+%
+% A timestamp file <inputfile>-timestamps.txt lists the simulation time and
+% chapter of every added frame. With defaults.dropFrames set to true,
+% frames arriving while the queue is full are dropped (the previous frame
+% is shown longer), otherwise addFrame waits for the writer.
 function [v, defaults] = videoRecorder(defaults, showConfigurationDialog)
     if nargin < 1; 
         defaults = struct(); 
@@ -27,10 +40,18 @@ function [v, defaults] = videoRecorder(defaults, showConfigurationDialog)
         codecs(end + 1) = struct('name', 'MPEG4 (H.264)', 'profile', 'MPEG-4', 'extensions', {{'mp4', 'm4v'}}, 'parameters', ...
                                                             struct('name', 'Quality', 'range', [0 100], 'value', 50, 'type', 'linear'));
     end
+    % encoded in the background by mex_frame_writer, the profile is its format
+    codecs(end + 1) = struct('name', 'Y4M stream',       'profile', 'y4m',              'extensions', 'y4m', 'parameters', ...
+                                                            struct('name', 'QueueLength', 'range', [1 256], 'value', 32, 'type', 'log'));
+    codecs(end + 1) = struct('name', 'PNG sequence',     'profile', 'png',              'extensions', 'png', 'parameters', ...
+                                                            struct('name', {'QueueLength', 'Compression'}, 'range', {[1 256], [0 9]}, ...
+                                                                   'value', {32, 1}, 'type', {'log', 'linear'}));
+    nativeProfiles = {'y4m', 'png'};
     
     % prepare default settings
     settings.fileName = '';
     settings.frameRate = 10;
+    settings.dropFrames = false;
     settings.codecIdx = find(strcmp({codecs.name}, 'Motion JPEG'), 1);
     if isempty(settings.codecIdx); settings.codecIdx = 1; end
 
@@ -41,6 +62,9 @@ function [v, defaults] = videoRecorder(defaults, showConfigurationDialog)
     if isfield(defaults, 'frameRate') && isnumeric(defaults.frameRate) && ~isempty(defaults.frameRate) && defaults.frameRate(1) > 0
         settings.frameRate = defaults.frameRate(1);
     end
+    if isfield(defaults, 'dropFrames') && (islogical(defaults.dropFrames) || isnumeric(defaults.dropFrames)) && isscalar(defaults.dropFrames)
+        settings.dropFrames = logical(defaults.dropFrames);
+    end
     if isfield(defaults, 'codec') && ischar(defaults.codec)
         desiredIdx = find(strcmp({codecs.name}, defaults.codec), 1);
         if ~isempty(desiredIdx); settings.codecIdx = desiredIdx; end
@@ -77,15 +101,29 @@ function [v, defaults] = videoRecorder(defaults, showConfigurationDialog)
 
     v = struct();
     
-    writer = VideoWriter(settings.fileName, codecs(settings.codecIdx).profile);
-    writer.FrameRate = settings.frameRate;
-    for iParam = 1:length(codecs(settings.codecIdx).parameters)
-        writer.(codecs(settings.codecIdx).parameters(iParam).name) = codecs(settings.codecIdx).parameters(iParam).value;
+    codec = codecs(settings.codecIdx);
+    native = any(strcmp(codec.profile, nativeProfiles));
+    if native
+        mex_make(fullfile(fileparts(mfilename('fullpath')), 'mex_frame_writer.cpp'));
+        opts = struct('file', settings.fileName, 'format', codec.profile, 'frameRate', settings.frameRate, 'dropFrames', settings.dropFrames);
+        for iParam = 1:length(codec.parameters)
+            pName = codec.parameters(iParam).name;
+            opts.([lower(pName(1)) pName(2:end)]) = codec.parameters(iParam).value;
+        end
+        writer = mex_object_handle(@mex_frame_writer, opts);
+    else
+        writer = VideoWriter(settings.fileName, codec.profile);
+        writer.FrameRate = settings.frameRate;
+        for iParam = 1:length(codec.parameters)
+            writer.(codec.parameters(iParam).name) = codec.parameters(iParam).value;
+        end
     end
     isOpen = false;
     tStart = [];
+    chapter = 0;
     lastFrame = [];
     lastFrameIndex = [];
+    lastFrameWritten = false; % lastFrame is the last frame passed to the writer
     
     v.getFileName = @()settings.fileName;
     v.getFrameRate = @()settings.frameRate;
@@ -101,7 +139,7 @@ function [v, defaults] = videoRecorder(defaults, showConfigurationDialog)
         errMsg = [];
         try
             if ~isOpen
-                open(writer);
+                if ~native; open(writer); end
                 isOpen = true;            
             end
             if isempty(tStart) 
@@ -112,12 +150,17 @@ function [v, defaults] = videoRecorder(defaults, showConfigurationDialog)
             if frameIndex < lastFrameIndex
                 tStart = time;
                 frameIndex = 0;
-                writeVideo(writer, frame);
+                writeFrames(frame, 1, time);
+                lastFrameWritten = true;
             else
-                for i = (lastFrameIndex + 1):(frameIndex - 1)
-                    writeVideo(writer, lastFrame);
+                % fill the gap with the last frame
+                if frameIndex > lastFrameIndex + 1
+                    if lastFrameWritten; writeFrames([], frameIndex - lastFrameIndex - 1, time);
+                    else writeFrames(lastFrame, frameIndex - lastFrameIndex - 1, time);
+                    end
                 end
-                if frameIndex > lastFrameIndex; writeVideo(writer, frame); end
+                lastFrameWritten = frameIndex > lastFrameIndex;
+                if lastFrameWritten; writeFrames(frame, 1, time); end
             end
             lastFrame = frame;
             lastFrameIndex = frameIndex;
@@ -125,12 +168,32 @@ function [v, defaults] = videoRecorder(defaults, showConfigurationDialog)
             errMsg = ME.message;
         end        
     end
+    % writes frame (the previous frame if empty) count times
+    function writeFrames(frame, count, time)
+        if native
+            if isstruct(frame); frame = frame.cdata; end % getframe
+            writer.invoke('add', struct('frame', {frame}, 'repeat', count, 'time', time, 'chapter', chapter));
+        else
+            if isempty(frame); frame = lastFrame; end
+            for i = 1:count; writeVideo(writer, frame); end
+        end
+    end
     % This resets the counters for automatic frame-rate adaption
     function startChapter()
         tStart = [];
+        chapter = chapter + 1;
     end
     function deleteThis()
-        if isOpen
+        if native && ~isempty(writer)
+            % waits for the writer thread to finish the queued frames
+            try
+                writer.invoke('close');
+            catch ME
+                warning('Sim:Video:WriteFailed', 'Could not write video ''%s'': %s', settings.fileName, ME.message);
+            end
+            writer = [];
+            isOpen = false;
+        elseif isOpen
             close(writer);
             writer = [];
             isOpen = false;
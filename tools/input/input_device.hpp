@@ -0,0 +1,272 @@
+#ifndef INPUT_DEVICE_HPP
+#define INPUT_DEVICE_HPP
+
+#include "matrix.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Base for input devices (joystick, space navigator) that are read by a
+// dedicated thread. The reader thread timestamps every change of a control
+// and pushes it into a lock-free single producer/single consumer ring
+// buffer. The Matlab side drains the buffer on each call and can either
+// fetch all events since the last call or the (interpolated) device state
+// at a given time.
+namespace input {
+
+enum EventType {
+    EVENT_AXIS = 1,
+    EVENT_BUTTON = 2,
+    EVENT_HAT = 3,
+    EVENT_BALL = 4  // relative motion, index 2 * ball for x and 2 * ball + 1 for y
+};
+
+struct Event {
+    double time;    // s since the device was opened
+    uint16_t type;
+    uint16_t index; // zero-based
+    double value;
+};
+
+// lock-free ring buffer for exactly one producer and one consumer thread
+template <typename T>
+class SpscRingBuffer {
+public:
+    explicit SpscRingBuffer(size_t capacity): head_(0), tail_(0) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        items_.resize(size);
+        mask_ = size - 1;
+    }
+
+    size_t capacity() const { return items_.size(); }
+
+    // producer, false if the buffer is full
+    bool push(const T &item) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) > mask_) return false;
+        items_[head & mask_] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer, false if the buffer is empty
+    bool pop(T &item) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire)) return false;
+        item = items_[tail & mask_];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::vector<T> items_;
+    size_t mask_;
+    // separate cache lines, the indices are written by different threads
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) std::atomic<size_t> tail_;
+};
+
+struct DeviceState {
+    std::vector<double> axes;
+    std::vector<double> axisTime; // time of the last change of each axis
+    std::vector<bool> buttons;
+    std::vector<double> hats;
+    std::vector<double> balls;    // accumulated motion, [x0, y0, x1, y1, ...]
+
+    DeviceState(size_t nAxes = 0, size_t nButtons = 0, size_t nHats = 0, size_t nBalls = 0):
+        axes(nAxes, 0.0), axisTime(nAxes, 0.0), buttons(nButtons, false), hats(nHats, 0.0), balls(2 * nBalls, 0.0) { }
+
+    void apply(const Event &e) {
+        switch (e.type) {
+        case EVENT_AXIS:
+            if (e.index < axes.size()) {
+                axes[e.index] = e.value;
+                axisTime[e.index] = e.time;
+            }
+            break;
+        case EVENT_BUTTON:
+            if (e.index >= buttons.size()) buttons.resize(e.index + 1, false);
+            buttons[e.index] = e.value != 0.0;
+            break;
+        case EVENT_HAT:
+            if (e.index < hats.size()) hats[e.index] = e.value;
+            break;
+        case EVENT_BALL:
+            if (e.index < balls.size()) balls[e.index] += e.value;
+            break;
+        }
+    }
+};
+
+class InputDevice {
+public:
+    // bufferSize: capacity of the ring buffer and of the list of events not
+    //             yet fetched by events()
+    // historyLength: events are kept for this many seconds to answer
+    //                state() queries in the past
+    // samplePeriod: an axis change is interpolated over at most this period
+    //               before the event (the resolution of the reader)
+    InputDevice(size_t bufferSize, double historyLength, double samplePeriod):
+        start_(std::chrono::steady_clock::now()), ring_(bufferSize), historyLength_(historyLength),
+        samplePeriod_(samplePeriod), dropped_(0), pendingDropped_(0), stopRequested_(false), connected_(true) { }
+
+    // derived classes must call stop() in their destructor, before the
+    // device is released
+    virtual ~InputDevice() { stop(); }
+
+    double now() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    }
+
+    // struct with all events since the last call
+    mxArray *events() {
+        drain();
+        const char *fieldNames[] = { "time", "type", "index", "value", "dropped", "connected", "now" };
+        mxArray *mxEvents = mxCreateStructMatrix(1, 1, sizeof(fieldNames) / sizeof(fieldNames[0]), fieldNames);
+        size_t count = pending_.size();
+        mxArray *mxTime = mxCreateDoubleMatrix(1, count, mxREAL);
+        mxArray *mxType = mxCreateDoubleMatrix(1, count, mxREAL);
+        mxArray *mxIndex = mxCreateDoubleMatrix(1, count, mxREAL);
+        mxArray *mxValue = mxCreateDoubleMatrix(1, count, mxREAL);
+        double *pTime = mxGetPr(mxTime), *pType = mxGetPr(mxType), *pIndex = mxGetPr(mxIndex), *pValue = mxGetPr(mxValue);
+        for (size_t i = 0; i < count; i++) {
+            const Event &e = pending_[i];
+            pTime[i] = e.time;
+            pType[i] = e.type;
+            pIndex[i] = e.index + 1;
+            pValue[i] = e.value;
+        }
+        mxSetField(mxEvents, 0, "time", mxTime);
+        mxSetField(mxEvents, 0, "type", mxType);
+        mxSetField(mxEvents, 0, "index", mxIndex);
+        mxSetField(mxEvents, 0, "value", mxValue);
+        mxSetField(mxEvents, 0, "dropped", mxCreateDoubleScalar((double)pendingDropped_));
+        mxSetField(mxEvents, 0, "connected", mxCreateLogicalScalar(connected_.load()));
+        mxSetField(mxEvents, 0, "now", mxCreateDoubleScalar(now()));
+        pending_.clear();
+        pendingDropped_ = 0;
+        return mxEvents;
+    }
+
+    // struct with the device state at time t (s since the device was opened)
+    mxArray *state(double t) {
+        drain();
+        DeviceState s = stateAt(t);
+        const char *fieldNames[] = { "time", "axes", "buttons", "hats", "balls", "connected" };
+        mxArray *mxState = mxCreateStructMatrix(1, 1, sizeof(fieldNames) / sizeof(fieldNames[0]), fieldNames);
+        mxSetField(mxState, 0, "time", mxCreateDoubleScalar(t));
+        mxSetField(mxState, 0, "axes", createColumn(s.axes));
+        mxArray *mxButtons = mxCreateLogicalMatrix(s.buttons.size(), 1);
+        mxLogical *pButtons = mxGetLogicals(mxButtons);
+        for (size_t i = 0; i < s.buttons.size(); i++) pButtons[i] = s.buttons[i];
+        mxSetField(mxState, 0, "buttons", mxButtons);
+        mxSetField(mxState, 0, "hats", createColumn(s.hats));
+        mxArray *mxBalls = mxCreateDoubleMatrix(2, s.balls.size() / 2, mxREAL);
+        std::copy(s.balls.begin(), s.balls.end(), mxGetPr(mxBalls));
+        mxSetField(mxState, 0, "balls", mxBalls);
+        mxSetField(mxState, 0, "connected", mxCreateLogicalScalar(connected_.load()));
+        return mxState;
+    }
+
+protected:
+    // state before the first event, set before start()
+    void setInitialState(const DeviceState &s) { base_ = s; }
+
+    void start() {
+        stopRequested_ = false;
+        reader_ = std::thread(&InputDevice::run, this);
+    }
+
+    void stop() {
+        stopRequested_ = true;
+        if (reader_.joinable()) reader_.join();
+    }
+
+    bool stopRequested() const { return stopRequested_.load(std::memory_order_relaxed); }
+    void setDisconnected() { connected_ = false; }
+
+    // reader thread, returns when stopRequested() becomes true
+    virtual void run() = 0;
+
+    // reader thread only
+    void emit(double time, EventType type, size_t index, double value) {
+        Event e = { time, (uint16_t)type, (uint16_t)index, value };
+        if (!ring_.push(e)) dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+private:
+    void drain() {
+        Event e;
+        while (ring_.pop(e)) {
+            if (pending_.size() >= ring_.capacity()) {
+                pending_.pop_front();
+                pendingDropped_++;
+            }
+            pending_.push_back(e);
+            history_.push_back(e);
+        }
+        pendingDropped_ += dropped_.exchange(0, std::memory_order_relaxed);
+        double first = now() - historyLength_;
+        while (!history_.empty() && history_.front().time < first) {
+            base_.apply(history_.front());
+            history_.pop_front();
+        }
+    }
+
+    DeviceState stateAt(double t) const {
+        DeviceState s = base_;
+        size_t i = 0;
+        for (; i < history_.size() && history_[i].time <= t; i++) s.apply(history_[i]);
+        // an axis changed somewhere within the sample period before its
+        // next event, ramp towards that value
+        std::vector<bool> done(s.axes.size(), false);
+        for (; i < history_.size(); i++) {
+            const Event &e = history_[i];
+            if (e.type != EVENT_AXIS || e.index >= s.axes.size() || done[e.index]) continue;
+            done[e.index] = true;
+            double rampStart = std::max(s.axisTime[e.index], e.time - samplePeriod_);
+            if (t > rampStart) s.axes[e.index] += (t - rampStart) / (e.time - rampStart) * (e.value - s.axes[e.index]);
+        }
+        return s;
+    }
+
+    static mxArray *createColumn(const std::vector<double> &values) {
+        mxArray *mxColumn = mxCreateDoubleMatrix(values.size(), 1, mxREAL);
+        std::copy(values.begin(), values.end(), mxGetPr(mxColumn));
+        return mxColumn;
+    }
+
+    std::chrono::steady_clock::time_point start_;
+    SpscRingBuffer<Event> ring_;
+    double historyLength_, samplePeriod_;
+    std::atomic<uint64_t> dropped_;  // events lost because the ring buffer was full
+    uint64_t pendingDropped_;
+    std::deque<Event> pending_;      // not yet fetched by events()
+    std::deque<Event> history_;      // events within historyLength
+    DeviceState base_;               // state before the first event in history_
+    std::atomic<bool> stopRequested_, connected_;
+    std::thread reader_;
+};
+
+inline const mxArray *getOption(const mxArray *mxOpts, const char *name) {
+    return mxOpts ? mxGetField(mxOpts, 0, name) : NULL;
+}
+
+inline double getScalarOption(const mxArray *mxOpts, const char *name, double defaultValue) {
+    const mxArray *mxField = getOption(mxOpts, name);
+    if (!mxField) return defaultValue;
+    if (!(mxIsNumeric(mxField) || mxIsLogical(mxField)) || mxIsComplex(mxField) || mxGetNumberOfElements(mxField) != 1)
+        throw std::runtime_error(std::string("Parameter '") + name + "' must be a real scalar");
+    return mxGetScalar(mxField);
+}
+
+} // namespace input
+
+#endif // INPUT_DEVICE_HPP
@@ -0,0 +1,232 @@
+//$ mex mex_joystick.cpp -I../mex/include -lSDL # Maltab command for generating the MEX file
+/*******************************************************
+ * Persistent joystick/gamepad device. In contrast to joyread, the device
+ * is opened once and polled by a reader thread, which timestamps every
+ * change of an axis, button, hat or ball and keeps it in a ring buffer
+ * (see input_device.hpp), so no changes between two Matlab calls are lost.
+ *
+ * Construction: joystick = mex_object_handle(@mex_joystick[, opts])
+ * opts: struct with fields
+ *   .index - (optional) zero-based joystick index (default: 0)
+ *   .pollRate - (optional) reader thread rate in Hz (default: 500)
+ *   .bufferSize - (optional) number of buffered events (default: 4096)
+ *   .historyLength - (optional) time in s for which state queries in the
+ *                    past are answered (default: 1)
+ * The device is closed and the reader thread stopped when the handle is
+ * deleted.
+ *
+ * Methods:
+ *   events = joystick.invoke('events')
+ *       All events since the last call, struct with fields
+ *       .time - 1xN event times in s since the device was opened
+ *       .type - 1xN event types: 1 axis, 2 button, 3 hat, 4 ball
+ *       .index - 1xN one-based index of the axis/button/hat. Ball motion
+ *                is reported as x (index 2 * ball - 1) and y (2 * ball)
+ *       .value - 1xN new value (axes from -1 to 1, buttons 0 or 1, hats as
+ *                in joyread, balls the relative motion)
+ *       .dropped - number of events lost since the last call (buffer full)
+ *       .connected - always true (SDL 1.2 does not report unplugged devices)
+ *       .now - current time in s since the device was opened
+ *   state = joystick.invoke('state'[, 'time', t])
+ *       State at time t (default: now), struct with fields .time, .axes,
+ *       .buttons, .hats, .balls (2xB accumulated motion) and .connected.
+ *       Axes are interpolated linearly within one poll interval before a
+ *       change.
+ *   info = joystick.invoke('info')
+ *       Struct with the device .name and the number of .axes, .buttons,
+ *       .hats and .balls
+ */
+
+#include "mex.h"
+#include "matrix.h"
+#include <SDL/SDL.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <mex/object_manager.hpp>
+#include "input_device.hpp"
+
+// SDL is not thread safe, all calls are serialized. The joystick subsystem
+// is initialized while at least one device is open.
+static std::mutex sdlMutex;
+static int sdlUsers = 0;
+
+static double scaleAxis(int pos) {
+    return pos < 0 ? (double)pos / 32768.0 : (double)pos / 32767.0;
+}
+
+class Joystick: public input::InputDevice {
+public:
+    Joystick(int index, double pollRate, size_t bufferSize, double historyLength):
+        input::InputDevice(bufferSize, historyLength, 1.0 / pollRate), pollRate_(pollRate), joystick_(NULL) {
+        {
+            std::lock_guard<std::mutex> lock(sdlMutex);
+            if (sdlUsers == 0 && SDL_InitSubSystem(SDL_INIT_JOYSTICK | SDL_INIT_NOPARACHUTE) < 0)
+                throw std::runtime_error(std::string("Could not initialize SDL: ") + SDL_GetError());
+            sdlUsers++;
+            SDL_JoystickEventState(SDL_IGNORE); // state is polled, SDL's event queue is not used
+            if (index < 0 || index >= SDL_NumJoysticks()) {
+                releaseSdl();
+                throw std::runtime_error("Joystick not found");
+            }
+            joystick_ = SDL_JoystickOpen(index);
+            if (!joystick_) {
+                releaseSdl();
+                throw std::runtime_error("Could not open joystick");
+            }
+            name_ = SDL_JoystickName(index) ? SDL_JoystickName(index) : "";
+            counts_[0] = SDL_JoystickNumAxes(joystick_);
+            counts_[1] = SDL_JoystickNumButtons(joystick_);
+            counts_[2] = SDL_JoystickNumHats(joystick_);
+            counts_[3] = SDL_JoystickNumBalls(joystick_);
+            input::DeviceState s(counts_[0], counts_[1], counts_[2], counts_[3]);
+            SDL_JoystickUpdate();
+            read(s);
+            std::fill(s.balls.begin(), s.balls.end(), 0.0); // accumulated from here on
+            setInitialState(s);
+            last_ = s;
+        }
+        try {
+            start();
+        } catch (...) {
+            close();
+            throw;
+        }
+    }
+
+    ~Joystick() {
+        stop();
+        close();
+    }
+
+    mxArray *info() const {
+        const char *fieldNames[] = { "name", "axes", "buttons", "hats", "balls" };
+        mxArray *mxInfo = mxCreateStructMatrix(1, 1, sizeof(fieldNames) / sizeof(fieldNames[0]), fieldNames);
+        mxSetField(mxInfo, 0, "name", mxCreateString(name_.c_str()));
+        for (int i = 0; i < 4; i++) mxSetField(mxInfo, 0, fieldNames[i + 1], mxCreateDoubleScalar(counts_[i]));
+        return mxInfo;
+    }
+
+protected:
+    virtual void run() {
+        std::chrono::steady_clock::duration period =
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / pollRate_));
+        std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+        input::DeviceState s = last_;
+        while (!stopRequested()) {
+            {
+                std::lock_guard<std::mutex> lock(sdlMutex);
+                SDL_JoystickUpdate();
+                read(s);
+            }
+            double t = now();
+            for (size_t i = 0; i < s.axes.size(); i++) {
+                if (s.axes[i] != last_.axes[i]) emit(t, input::EVENT_AXIS, i, s.axes[i]);
+            }
+            for (size_t i = 0; i < s.buttons.size(); i++) {
+                if (s.buttons[i] != last_.buttons[i]) emit(t, input::EVENT_BUTTON, i, s.buttons[i] ? 1.0 : 0.0);
+            }
+            for (size_t i = 0; i < s.hats.size(); i++) {
+                if (s.hats[i] != last_.hats[i]) emit(t, input::EVENT_HAT, i, s.hats[i]);
+            }
+            for (size_t i = 0; i < s.balls.size(); i++) {
+                if (s.balls[i] != 0.0) emit(t, input::EVENT_BALL, i, s.balls[i]);
+            }
+            last_.axes = s.axes;
+            last_.buttons = s.buttons;
+            last_.hats = s.hats;
+
+            next += period;
+            std::chrono::steady_clock::time_point current = std::chrono::steady_clock::now();
+            if (next < current) next = current; // do not try to catch up after a stall
+            std::this_thread::sleep_until(next);
+        }
+    }
+
+private:
+    // current values, balls as the motion since the last read (SDL lock held)
+    void read(input::DeviceState &s) {
+        for (size_t i = 0; i < s.axes.size(); i++) s.axes[i] = scaleAxis(SDL_JoystickGetAxis(joystick_, (int)i));
+        for (size_t i = 0; i < s.buttons.size(); i++) s.buttons[i] = SDL_JoystickGetButton(joystick_, (int)i) != 0;
+        for (size_t i = 0; i < s.hats.size(); i++) s.hats[i] = SDL_JoystickGetHat(joystick_, (int)i);
+        for (size_t i = 0; i < s.balls.size() / 2; i++) {
+            int dx = 0, dy = 0;
+            if (SDL_JoystickGetBall(joystick_, (int)i, &dx, &dy) != 0) dx = dy = 0;
+            s.balls[2 * i] = dx;
+            s.balls[2 * i + 1] = dy;
+        }
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(sdlMutex);
+        if (joystick_) SDL_JoystickClose(joystick_);
+        joystick_ = NULL;
+        releaseSdl();
+    }
+
+    // SDL lock held
+    static void releaseSdl() {
+        if (--sdlUsers == 0) SDL_QuitSubSystem(SDL_INIT_JOYSTICK);
+    }
+
+    double pollRate_;
+    SDL_Joystick *joystick_;
+    std::string name_;
+    int counts_[4]; // axes, buttons, hats, balls
+    input::DeviceState last_; // values of the last poll, owned by the reader thread once started
+};
+
+enum JoystickMethod {
+    METHOD_EVENTS,
+    METHOD_STATE,
+    METHOD_INFO
+};
+
+class JoystickManager: public mex::object_manager<Joystick> {
+public:
+    JoystickManager() {
+        addMethod("events", METHOD_EVENTS);
+        addMethod("state", METHOD_STATE);
+        addMethod("info", METHOD_INFO);
+    }
+
+    virtual Joystick *create(const mxArray *mxOpts) {
+        double index = input::getScalarOption(mxOpts, "index", 0.0);
+        double pollRate = input::getScalarOption(mxOpts, "pollRate", 500.0);
+        double bufferSize = input::getScalarOption(mxOpts, "bufferSize", 4096.0);
+        double historyLength = input::getScalarOption(mxOpts, "historyLength", 1.0);
+        if (!(pollRate >= 1.0 && pollRate <= 10000.0)) throw std::runtime_error("Parameter 'pollRate' must be within [1, 10000] Hz");
+        if (!(bufferSize >= 1.0 && bufferSize <= 1e7)) throw std::runtime_error("Parameter 'bufferSize' must be within [1, 1e7]");
+        if (!(historyLength >= 0.0)) throw std::runtime_error("Parameter 'historyLength' must be non-negative");
+        return new Joystick((int)index, pollRate, (size_t)bufferSize, historyLength);
+    }
+
+    virtual void invoke(Joystick &joystick, int methodId, const mxArray *mxOpts, int nlhs, mxArray *plhs[]) {
+        if (nlhs > 1) throw std::runtime_error("Too many output arguments");
+        switch (methodId) {
+        case METHOD_EVENTS:
+            plhs[0] = joystick.events();
+            break;
+        case METHOD_STATE:
+            plhs[0] = joystick.state(input::getScalarOption(mxOpts, "time", joystick.now()));
+            break;
+        case METHOD_INFO:
+            plhs[0] = joystick.info();
+            break;
+        }
+    }
+};
+
+static JoystickManager joystickManager;
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    try {
+        joystickManager.mexFunction(nlhs, plhs, nrhs, prhs);
+    } catch (const std::exception &e) {
+        mexErrMsgIdAndTxt("mex_joystick:error", "%s", e.what());
+    }
+}
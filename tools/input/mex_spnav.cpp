@@ -0,0 +1,164 @@
+//$ mex mex_spnav.cpp -I../mex/include -lspnav # Maltab command for generating the MEX file
+/*******************************************************
+ * Persistent 3D mouse (Space Navigator) connection to spacenavd. A reader
+ * thread waits on the daemon socket, timestamps every motion and button
+ * event and keeps it in a ring buffer (see input_device.hpp), so events
+ * arriving between two Matlab calls are not lost.
+ *
+ * Compiler command line with a custom libspnav installation (adapt the
+ * include/library path according to your installation!):
+ * mex mex_spnav.cpp -I../mex/include -I../libspnav -L../libspnav -lspnav
+ *
+ * Construction: spnav = mex_object_handle(@mex_spnav[, opts])
+ * opts: struct with fields
+ *   .bufferSize - (optional) number of buffered events (default: 4096)
+ *   .historyLength - (optional) time in s for which state queries in the
+ *                    past are answered (default: 1)
+ *   .samplePeriod - (optional) interval in s of the device motion events,
+ *                   axis changes are interpolated over at most this period
+ *                   (default: 0.02)
+ * libspnav supports a single connection, so only one instance may exist.
+ * The connection is closed and the reader thread stopped when the handle
+ * is deleted.
+ *
+ * Methods:
+ *   events = spnav.invoke('events')
+ *       All events since the last call, struct with fields
+ *       .time - 1xN event times in s since the connection was opened
+ *       .type - 1xN event types: 1 axis, 2 button
+ *       .index - 1xN one-based axis (1-3 translation x/y/z, 4-6 rotation
+ *                x/y/z) or button index
+ *       .value - 1xN new value (axes scaled as by spnav, buttons 0 or 1)
+ *       .dropped - number of events lost since the last call (buffer full)
+ *       .connected - false if the connection to spacenavd was lost
+ *       .now - current time in s since the connection was opened
+ *   state = spnav.invoke('state'[, 'time', t])
+ *       State at time t (default: now), struct with fields .time, .axes
+ *       (6x1, translation and rotation), .buttons and .connected (.hats and
+ *       .balls are empty).
+ */
+
+#include "mex.h"
+#include "matrix.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdexcept>
+#include <spnav.h>
+#include <mex/object_manager.hpp>
+#include "input_device.hpp"
+
+#define AXIS_COUNT      6
+#define BUTTON_COUNT    2 // more buttons are added on their first event
+#define POLL_TIMEOUT_MS 50 // interval to check for stop requests
+
+static bool connectionOpen = false;
+
+static double scaleMotion(int value) {
+    return (double)value / 350.0;
+}
+
+class SpaceNavigator: public input::InputDevice {
+public:
+    SpaceNavigator(size_t bufferSize, double historyLength, double samplePeriod):
+        input::InputDevice(bufferSize, historyLength, samplePeriod) {
+        if (connectionOpen) throw std::runtime_error("Only one connection to spacenavd is supported");
+        if (spnav_open() == -1) throw std::runtime_error("Could not connect to spacenavd. Make sure that the device is attached and spacenavd is running!");
+        connectionOpen = true;
+        spnav_remove_events(SPNAV_EVENT_ANY);
+        setInitialState(input::DeviceState(AXIS_COUNT, BUTTON_COUNT));
+        for (int i = 0; i < AXIS_COUNT; i++) last_[i] = 0;
+        try {
+            start();
+        } catch (...) {
+            close();
+            throw;
+        }
+    }
+
+    ~SpaceNavigator() {
+        stop();
+        close();
+    }
+
+protected:
+    virtual void run() {
+        struct pollfd pfd;
+        pfd.fd = spnav_fd();
+        pfd.events = POLLIN;
+        while (!stopRequested()) {
+            pfd.revents = 0;
+            int result = poll(&pfd, 1, POLL_TIMEOUT_MS);
+            if (result < 0 && errno != EINTR) break;
+            if (result <= 0) continue;
+            if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) break;
+
+            spnav_event ev;
+            while (spnav_poll_event(&ev) != 0) {
+                double t = now();
+                if (ev.type == SPNAV_EVENT_MOTION) {
+                    int motion[AXIS_COUNT] = { ev.motion.x, ev.motion.y, ev.motion.z, ev.motion.rx, ev.motion.ry, ev.motion.rz };
+                    for (int i = 0; i < AXIS_COUNT; i++) {
+                        if (motion[i] != last_[i]) emit(t, input::EVENT_AXIS, i, scaleMotion(motion[i]));
+                        last_[i] = motion[i];
+                    }
+                } else if (ev.type == SPNAV_EVENT_BUTTON) {
+                    emit(t, input::EVENT_BUTTON, ev.button.bnum, ev.button.press ? 1.0 : 0.0);
+                }
+            }
+        }
+        if (!stopRequested()) setDisconnected();
+    }
+
+private:
+    void close() {
+        spnav_close();
+        connectionOpen = false;
+    }
+
+    int last_[AXIS_COUNT]; // raw motion of the last event, reader thread only
+};
+
+enum SpaceNavigatorMethod {
+    METHOD_EVENTS,
+    METHOD_STATE
+};
+
+class SpaceNavigatorManager: public mex::object_manager<SpaceNavigator> {
+public:
+    SpaceNavigatorManager() {
+        addMethod("events", METHOD_EVENTS);
+        addMethod("state", METHOD_STATE);
+    }
+
+    virtual SpaceNavigator *create(const mxArray *mxOpts) {
+        double bufferSize = input::getScalarOption(mxOpts, "bufferSize", 4096.0);
+        double historyLength = input::getScalarOption(mxOpts, "historyLength", 1.0);
+        double samplePeriod = input::getScalarOption(mxOpts, "samplePeriod", 0.02);
+        if (!(bufferSize >= 1.0 && bufferSize <= 1e7)) throw std::runtime_error("Parameter 'bufferSize' must be within [1, 1e7]");
+        if (!(historyLength >= 0.0)) throw std::runtime_error("Parameter 'historyLength' must be non-negative");
+        if (!(samplePeriod >= 0.0)) throw std::runtime_error("Parameter 'samplePeriod' must be non-negative");
+        return new SpaceNavigator((size_t)bufferSize, historyLength, samplePeriod);
+    }
+
+    virtual void invoke(SpaceNavigator &spnav, int methodId, const mxArray *mxOpts, int nlhs, mxArray *plhs[]) {
+        if (nlhs > 1) throw std::runtime_error("Too many output arguments");
+        switch (methodId) {
+        case METHOD_EVENTS:
+            plhs[0] = spnav.events();
+            break;
+        case METHOD_STATE:
+            plhs[0] = spnav.state(input::getScalarOption(mxOpts, "time", spnav.now()));
+            break;
+        }
+    }
+};
+
+static SpaceNavigatorManager spaceNavigatorManager;
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    try {
+        spaceNavigatorManager.mexFunction(nlhs, plhs, nrhs, prhs);
+    } catch (const std::exception &e) {
+        mexErrMsgIdAndTxt("mex_spnav:error", "%s", e.what());
+    }
+}
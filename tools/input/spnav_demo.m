@@ -1,8 +1,7 @@
 function spnav_demo()
 
-	if ~spnav('open')
-		error('Could not open Space Navigator device. Make sure that the device is attached and spacenavd is running!');
-	end
+	mex_make(struct('file', fullfile(fileparts(mfilename('fullpath')), 'mex_spnav.cpp'), 'dependencies', {{'input_device.hpp'}}));
+	device = mex_object_handle(@mex_spnav);
 	
 	f = figure('toolbar', 'figure', 'NumberTitle', 'off', 'Name', 'Space Navigator Demo', 'CloseRequestFcn', @closeHandler);
 	labelSettings = {'FontName', 'Verdana', 'FontWeight', 'bold'};
@@ -46,7 +45,13 @@ function spnav_demo()
 	run = true;
 	
 	while run		
-		res = spnav();
+		events = device.invoke('events');
+		res = device.invoke('state');
+		res.trans = res.axes(1:3);
+		res.rot = res.axes(4:6);
+		isButton = events.type == 2;
+		res.pressEvents = arrayfun(@(i) sum(isButton & events.index == i & events.value == 1), 1:numel(res.buttons));
+		res.releaseEvents = arrayfun(@(i) sum(isButton & events.index == i & events.value == 0), 1:numel(res.buttons));
 		x = res.trans(1);
 		y = res.trans(3);
 		z = res.trans(2);
@@ -147,9 +152,7 @@ function spnav_demo()
 	function closeHandler(varargin)
 		run = false;
 		delete(f);	
-		if ~spnav('close')
-			warning('Closing Space Navigator device failed');
-		end
+		delete(device);
 	end
 	
 end
\ No newline at end of file
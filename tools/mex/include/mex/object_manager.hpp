@@ -15,6 +15,11 @@
 #include <cxxabi.h>
 #endif
 // manage objects that should persist between multiple calls to a mex function 
+// Built-in commands besides the methods added by the manager:
+//   mexFunc(handle, 'delete') - destroy the instance
+//   copy = mexFunc(handle, 'clone') - handle of a copy of the instance, or
+//                                    [] if the manager does not support
+//                                    copies (see clone())
 namespace mex {
     
 template <typename Obj, typename MethodId = int, typename Key = uint64_t>
@@ -54,25 +59,14 @@ public:
 
             Obj *ptr = create(mxOpts);
             if (!ptr) throw std::runtime_error("Object construction failed.");
-            
-            Key key = (Key)ptr; // for now: use pointer as key
-            while(instances_.find(key) != instances_.end()) key++; // to be sure...
-            instances_.insert(std::make_pair(key, ptr));
-            
-            plhs[0] = mxCreateNumericMatrix(1, 1, mex::get_class<Key>::value, mxREAL);
-            *static_cast<Key *>(mxGetData(plhs[0])) = key;                    
+            plhs[0] = insert(ptr);
         } else if (nrhs <= 3) {
             // invoke function
             const mxArray *mxHandle = prhs[0];
             const mxArray *mxMethod = prhs[1];
             
             const mxArray *mxOpts = NULL;
-            if (mxGetClassID(mxHandle) != mex::get_class<Key>::value || !mex::is_scalar(mxHandle)) 
-                throw std::runtime_error("Invalid handle argument: Use return value of a constructor call!");
-            Key key = *static_cast<const Key *>(mxGetData(mxHandle));
-            
-            auto it = instances_.find(key);
-            if (it == instances_.end()) throw std::runtime_error("Invalid handle! Instance not found.");                        
+            auto it = find(mxHandle);
             Obj *ptr = it->second;
             
             if (!mxIsChar(mxMethod)) throw std::runtime_error("Command argument must be a string");
@@ -94,6 +88,11 @@ public:
                 if (mxOpts) mexWarnMsgTxt("Parameters for 'delete' command ignored.");
                 instances_.erase(it);
                 delete ptr;
+            } else if (strcmp(methodString, "clone") == 0) {
+                if (mxOpts) mexWarnMsgTxt("Parameters for 'clone' command ignored.");
+                if (nlhs > 1) throw std::runtime_error("Too many output arguments");
+                Obj *copy = clone(*ptr);
+                plhs[0] = copy ? insert(copy) : mxCreateDoubleMatrix(0, 0, mxREAL);
             } else {
                 typename method_map::const_iterator itMethod = supportedMethods_.find(methodString);
                 if (itMethod == supportedMethods_.end()) throw std::runtime_error("Unsupported method!");
@@ -102,8 +101,16 @@ public:
         } else throw std::runtime_error("Too many input arguments");
     };
     
+    // instance of a handle argument, e.g. for calls that bypass the method
+    // dispatch of mexFunction
+    Obj &instance(const mxArray *mxHandle) {
+        return *find(mxHandle)->second;
+    }
+    
     virtual Obj *create(const mxArray *mxOpts) = 0;
     virtual void invoke(Obj &obj, MethodId methodId, const mxArray *mxOpts, int nlhs, mxArray *plhs[]) = 0;        
+    // independent copy of obj for the 'clone' command, NULL if not supported
+    virtual Obj *clone(const Obj & /* obj */) { return NULL; }
 
 protected:
     void setConstructionRequiresArgument(bool b) { constructionRequiresArgument_ = b; }
@@ -114,6 +121,27 @@ private:
     typedef std::map<Key, Obj *> instance_map;
     typedef std::map<std::string, MethodId> method_map;
     
+    // take ownership of ptr, returns its handle
+    mxArray *insert(Obj *ptr) {
+        Key key = (Key)ptr; // for now: use pointer as key
+        while(instances_.find(key) != instances_.end()) key++; // to be sure...
+        instances_.insert(std::make_pair(key, ptr));
+        
+        mxArray *mxHandle = mxCreateNumericMatrix(1, 1, mex::get_class<Key>::value, mxREAL);
+        *static_cast<Key *>(mxGetData(mxHandle)) = key;
+        return mxHandle;
+    }
+    
+    typename instance_map::iterator find(const mxArray *mxHandle) {
+        if (mxGetClassID(mxHandle) != mex::get_class<Key>::value || !mex::is_scalar(mxHandle)) 
+            throw std::runtime_error("Invalid handle argument: Use return value of a constructor call!");
+        Key key = *static_cast<const Key *>(mxGetData(mxHandle));
+        
+        auto it = instances_.find(key);
+        if (it == instances_.end()) throw std::runtime_error("Invalid handle! Instance not found.");                        
+        return it;
+    }
+    
     instance_map instances_;
     bool constructionRequiresArgument_;    
     method_map supportedMethods_;
@@ -0,0 +1,219 @@
+#ifndef MEX_SERIALIZE_HPP
+#define MEX_SERIALIZE_HPP
+
+#include "mex.h"
+#include "matrix.h"
+#include <cstring>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Binary encoding of Matlab arrays, e.g. for writing them to files.
+// Numeric, logical and char arrays, cell arrays and structs are encoded
+// directly (in machine byte order), all other values (sparse matrices,
+// function handles, objects) as Matlab byte stream (getByteStreamFromArray).
+//
+// Encoding of a value:
+//   uint8 tag (value_tag)
+//   TAG_ARRAY:       uint8 class code, uint8 complex flag, dimensions,
+//                    real data, imaginary data (complex arrays only)
+//   TAG_CELL:        dimensions, encoded elements
+//   TAG_STRUCT:      dimensions, uint32 field count, field names
+//                    (uint32 length + characters), encoded fields of all
+//                    elements (element-major)
+//   TAG_BYTE_STREAM: uint64 size, Matlab byte stream
+//   TAG_NULL:        nothing (unset cell or struct field, decoded as [])
+// dimensions: uint32 number of dimensions, uint64 size of each dimension
+namespace mex {
+
+enum value_tag {
+    TAG_NULL = 0,
+    TAG_ARRAY = 1,
+    TAG_CELL = 2,
+    TAG_STRUCT = 3,
+    TAG_BYTE_STREAM = 4
+};
+
+// class codes are part of the encoding, mxClassID values are not
+static const mxClassID serialized_classes[] = {
+    mxUNKNOWN_CLASS, mxDOUBLE_CLASS, mxSINGLE_CLASS, mxINT8_CLASS, mxUINT8_CLASS, mxINT16_CLASS, mxUINT16_CLASS,
+    mxINT32_CLASS, mxUINT32_CLASS, mxINT64_CLASS, mxUINT64_CLASS, mxLOGICAL_CLASS, mxCHAR_CLASS
+};
+static const uint8_t serialized_class_count = sizeof(serialized_classes) / sizeof(serialized_classes[0]);
+
+static inline uint8_t serialized_class_code(const mxArray *arr) {
+    if (mxIsSparse(arr)) return 0;
+    mxClassID classId = mxGetClassID(arr);
+    for (uint8_t i = 1; i < serialized_class_count; i++) {
+        if (serialized_classes[i] == classId) return i;
+    }
+    return 0;
+}
+
+class value_writer {
+public:
+    explicit value_writer(std::vector<unsigned char> &buffer): buffer_(buffer) { }
+
+    template <typename T>
+    void write(const T &value) { write_bytes(&value, sizeof(T)); }
+
+    void write_bytes(const void *data, size_t size) {
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        buffer_.insert(buffer_.end(), p, p + size);
+    }
+
+    // arr may be NULL
+    void write_value(const mxArray *arr) {
+        if (!arr) {
+            write<uint8_t>(TAG_NULL);
+            return;
+        }
+        mxClassID classId = mxGetClassID(arr);
+        uint8_t classCode = serialized_class_code(arr);
+        if (classCode > 0) {
+            write<uint8_t>(TAG_ARRAY);
+            write<uint8_t>(classCode);
+            write<uint8_t>(mxIsComplex(arr) ? 1 : 0);
+            write_dimensions(arr);
+            size_t size = mxGetNumberOfElements(arr) * mxGetElementSize(arr);
+            if (size > 0) {
+                write_bytes(mxGetData(arr), size);
+                if (mxIsComplex(arr)) write_bytes(mxGetImagData(arr), size);
+            }
+        } else if (classId == mxCELL_CLASS) {
+            write<uint8_t>(TAG_CELL);
+            write_dimensions(arr);
+            for (size_t i = 0; i < mxGetNumberOfElements(arr); i++) write_value(mxGetCell(arr, i));
+        } else if (classId == mxSTRUCT_CLASS) {
+            write<uint8_t>(TAG_STRUCT);
+            write_dimensions(arr);
+            int fieldCount = mxGetNumberOfFields(arr);
+            write<uint32_t>((uint32_t)fieldCount);
+            for (int iField = 0; iField < fieldCount; iField++) {
+                const char *name = mxGetFieldNameByNumber(arr, iField);
+                write<uint32_t>((uint32_t)strlen(name));
+                write_bytes(name, strlen(name));
+            }
+            for (size_t i = 0; i < mxGetNumberOfElements(arr); i++) {
+                for (int iField = 0; iField < fieldCount; iField++) write_value(mxGetFieldByNumber(arr, i, iField));
+            }
+        } else {
+            mxArray *input = const_cast<mxArray *>(arr);
+            mxArray *stream = NULL;
+            if (mexCallMATLAB(1, &stream, 1, &input, "getByteStreamFromArray") != 0 || !stream)
+                throw std::runtime_error(std::string("Cannot serialize values of class ") + mxGetClassName(arr));
+            write<uint8_t>(TAG_BYTE_STREAM);
+            write<uint64_t>(mxGetNumberOfElements(stream));
+            write_bytes(mxGetData(stream), mxGetNumberOfElements(stream));
+            mxDestroyArray(stream);
+        }
+    }
+
+private:
+    void write_dimensions(const mxArray *arr) {
+        mwSize count = mxGetNumberOfDimensions(arr);
+        const mwSize *dims = mxGetDimensions(arr);
+        write<uint32_t>((uint32_t)count);
+        for (mwSize i = 0; i < count; i++) write<uint64_t>(dims[i]);
+    }
+
+    std::vector<unsigned char> &buffer_;
+};
+
+class value_reader {
+public:
+    value_reader(const unsigned char *data, size_t size): data_(data), size_(size), position_(0) { }
+
+    size_t position() const { return position_; }
+
+    template <typename T>
+    T read() {
+        T value;
+        memcpy(&value, read_bytes(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    const unsigned char *read_bytes(size_t size) {
+        if (size > size_ - position_) throw std::runtime_error("Unexpected end of serialized data");
+        const unsigned char *p = data_ + position_;
+        position_ += size;
+        return p;
+    }
+
+    mxArray *read_value() {
+        uint8_t tag = read<uint8_t>();
+        switch (tag) {
+        case TAG_NULL:
+            return mxCreateDoubleMatrix(0, 0, mxREAL);
+        case TAG_ARRAY: {
+            uint8_t classCode = read<uint8_t>();
+            bool complex = read<uint8_t>() != 0;
+            if (classCode == 0 || classCode >= serialized_class_count) throw std::runtime_error("Invalid class in serialized data");
+            mxClassID classId = serialized_classes[classCode];
+            std::vector<mwSize> dims = read_dimensions();
+            mxArray *arr;
+            if (classId == mxCHAR_CLASS) arr = mxCreateCharArray(dims.size(), &dims[0]);
+            else if (classId == mxLOGICAL_CLASS) arr = mxCreateLogicalArray(dims.size(), &dims[0]);
+            else arr = mxCreateNumericArray(dims.size(), &dims[0], classId, complex ? mxCOMPLEX : mxREAL);
+            size_t size = mxGetNumberOfElements(arr) * mxGetElementSize(arr);
+            if (size > 0) {
+                memcpy(mxGetData(arr), read_bytes(size), size);
+                if (complex) memcpy(mxGetImagData(arr), read_bytes(size), size);
+            }
+            return arr;
+        }
+        case TAG_CELL: {
+            std::vector<mwSize> dims = read_dimensions();
+            mxArray *arr = mxCreateCellArray(dims.size(), &dims[0]);
+            for (size_t i = 0; i < mxGetNumberOfElements(arr); i++) mxSetCell(arr, i, read_value());
+            return arr;
+        }
+        case TAG_STRUCT: {
+            std::vector<mwSize> dims = read_dimensions();
+            uint32_t fieldCount = read<uint32_t>();
+            std::vector<std::string> names(fieldCount);
+            std::vector<const char *> namePointers(fieldCount);
+            for (uint32_t iField = 0; iField < fieldCount; iField++) {
+                uint32_t length = read<uint32_t>();
+                const unsigned char *name = read_bytes(length);
+                names[iField].assign(name, name + length);
+                namePointers[iField] = names[iField].c_str();
+            }
+            mxArray *arr = mxCreateStructArray(dims.size(), &dims[0], (int)fieldCount, fieldCount > 0 ? &namePointers[0] : NULL);
+            for (size_t i = 0; i < mxGetNumberOfElements(arr); i++) {
+                for (uint32_t iField = 0; iField < fieldCount; iField++) mxSetFieldByNumber(arr, i, (int)iField, read_value());
+            }
+            return arr;
+        }
+        case TAG_BYTE_STREAM: {
+            uint64_t size = read<uint64_t>();
+            mxArray *stream = mxCreateNumericMatrix(1, (mwSize)size, mxUINT8_CLASS, mxREAL);
+            if (size > 0) memcpy(mxGetData(stream), read_bytes((size_t)size), (size_t)size);
+            mxArray *arr = NULL;
+            int result = mexCallMATLAB(1, &arr, 1, &stream, "getArrayFromByteStream");
+            mxDestroyArray(stream);
+            if (result != 0 || !arr) throw std::runtime_error("Cannot deserialize Matlab byte stream");
+            return arr;
+        }
+        default:
+            throw std::runtime_error("Invalid serialized data");
+        }
+    }
+
+private:
+    std::vector<mwSize> read_dimensions() {
+        uint32_t count = read<uint32_t>();
+        if (count < 2) throw std::runtime_error("Invalid dimensions in serialized data");
+        std::vector<mwSize> dims(count);
+        for (uint32_t i = 0; i < count; i++) dims[i] = (mwSize)read<uint64_t>();
+        return dims;
+    }
+
+    const unsigned char *data_;
+    size_t size_, position_;
+};
+
+}
+
+#endif // MEX_SERIALIZE_HPP
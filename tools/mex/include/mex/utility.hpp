@@ -14,8 +14,9 @@ template <> struct get_class<signed short>: public std::integral_constant<mxClas
 template <> struct get_class<unsigned short>: public std::integral_constant<mxClassID, mxUINT16_CLASS> { };
 template <> struct get_class<signed int>: public std::integral_constant<mxClassID, mxINT32_CLASS> { };
 template <> struct get_class<unsigned int>: public std::integral_constant<mxClassID, mxUINT32_CLASS> { };
-template <> struct get_class<signed long>: public std::integral_constant<mxClassID, mxINT32_CLASS> { };
-template <> struct get_class<unsigned long>: public std::integral_constant<mxClassID, mxUINT32_CLASS> { };
+// long is 64 bits wide on LP64 platforms (Linux, Mac OS)
+template <> struct get_class<signed long>: public std::integral_constant<mxClassID, sizeof(long) == 8 ? mxINT64_CLASS : mxINT32_CLASS> { };
+template <> struct get_class<unsigned long>: public std::integral_constant<mxClassID, sizeof(long) == 8 ? mxUINT64_CLASS : mxUINT32_CLASS> { };
 template <> struct get_class<signed long long>: public std::integral_constant<mxClassID, mxINT64_CLASS> { };
 template <> struct get_class<unsigned long long>: public std::integral_constant<mxClassID, mxUINT64_CLASS> { };
 template <> struct get_class<float>: public std::integral_constant<mxClassID, mxSINGLE_CLASS> { };
@@ -1,6 +1,11 @@
 % Wrap a mex function using the mex::object_wrapper paradigm into
 % a Matlab handle class to have destructors called automatically when
-% the object goes out of scope
+% the object goes out of scope.
+% Native objects only exist in the Matlab session that created them. Saved
+% and loaded copies (save/load, getByteStreamFromArray, ...) are inert: they
+% do not refer to any native object, invoke raises 'mex_object_handle:stale'
+% and delete does nothing, so a loaded key can never free an object
+% that happens to reuse its address.
 classdef mex_object_handle < handle
     properties
         key;
@@ -8,6 +13,9 @@ classdef mex_object_handle < handle
     end
     methods
         function obj = mex_object_handle(mexFunc, varargin)
+            if nargin == 0 % inert object, see loadobj
+                return;
+            end
             obj.mexFunctionHandle = mexFunc;
             if isempty(varargin)
                 obj.key = mexFunc();
@@ -19,6 +27,9 @@ classdef mex_object_handle < handle
             end
         end
         function varargout = invoke(obj, method, varargin)                         
+            if ~obj.isValid()
+                error('mex_object_handle:stale', 'The native object does not exist in this session (it was loaded from a file)');
+            end
             varargout = cell(1, nargout);
             if isempty(varargin)
                 [varargout{:}] = obj.mexFunctionHandle(obj.key, method);
@@ -29,8 +40,41 @@ classdef mex_object_handle < handle
             else error('Invalid arguments');
             end
         end
+        % independent copy of the native object (e.g. for the checkpoints of
+        % the simulator), [] if the mex function does not support copies
+        % (see clone() in object_manager.hpp)
+        function copy = clone(obj)
+            if ~obj.isValid()
+                error('mex_object_handle:stale', 'The native object does not exist in this session (it was loaded from a file)');
+            end
+            copy = [];
+            key = obj.mexFunctionHandle(obj.key, 'clone');
+            if ~isempty(key)
+                copy = mex_object_handle();
+                copy.mexFunctionHandle = obj.mexFunctionHandle;
+                copy.key = key;
+            end
+        end
+        function valid = isValid(obj)
+            valid = ~isempty(obj.key);
+        end
         function delete(obj)
-            obj.mexFunctionHandle(obj.key, 'delete');
+            if obj.isValid()
+                obj.mexFunctionHandle(obj.key, 'delete');
+            end
+        end
+        function s = saveobj(obj)
+            s = struct('mexFunctionHandle', obj.mexFunctionHandle);
+        end
+    end
+    methods (Static)
+        function obj = loadobj(s)
+            obj = mex_object_handle();
+            if isstruct(s)
+                obj.mexFunctionHandle = s.mexFunctionHandle;
+            elseif isa(s, 'mex_object_handle')
+                obj.mexFunctionHandle = s.mexFunctionHandle;
+            end
         end
     end
 end
@@ -0,0 +1,560 @@
+/*******************************************************
+ * Benchmark and consistency check for the raycast:: library, independent of
+ * Matlab.
+ *
+ * Usage: raycast_benchmark [options] [map.png ...]
+ * Loads indexed color PNG maps (all PNG files in maps/ by default). Like
+ * grp_obstacles_and_landmarks_from_image, the first palette entry with the
+ * color [0 0 0] marks obstacles. For each map, scans are cast from random
+ * poses in free space with every combination of map representation (dense,
+ * bitmap, distance field) and traversal (bresenham, dda). Reported are the
+ * throughput in rays/s and ns/ray (best of --repeat runs) and the average
+ * number of cells visited per ray.
+ *
+ * Options:
+ *   --poses n        number of poses per map (100)
+ *   --fov deg        field of view, centered on the pose orientation (180)
+ *   --increment deg  angle between adjacent rays (1)
+ *   --max-range m    maximum range (8)
+ *   --scale m        map scale in m/cell (0.01)
+ *   --robot-radius m if positive, the poses are a swarm of robots of this
+ *                    radius that see each other as disc obstacles (0)
+ *   --threads n      worker threads including the calling thread, 0 for
+ *                    all hardware threads (1)
+ *   --repeat n       timed runs per configuration (5)
+ *   --seed n         seed for poses and verification rays (1)
+ *   --verify         compare all configurations against straightforward
+ *                    reference implementations instead of timing them.
+ *                    The exit code is nonzero on any mismatch.
+ */
+
+#include <raycast.hpp>
+#include <png.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace raycast;
+
+struct Options {
+    Options(): poses(100), fieldOfView(180.0), increment(1.0), maxRange(8.0), scale(0.01), robotRadius(0.0),
+        threads(1), repeat(5), seed(1), verify(false) { }
+
+    size_t poses;
+    double fieldOfView, increment, maxRange, scale, robotRadius;
+    unsigned threads, repeat;
+    uint64_t seed;
+    bool verify;
+    std::vector<std::string> maps;
+};
+
+// column-major obstacle matrix as used by the Matlab blocks
+struct ObstacleMap {
+    int width, height;
+    std::vector<unsigned char> cells; // 1 for obstacles
+
+    DenseMap<unsigned char> dense() const { return DenseMap<unsigned char>(&cells[0], width, height, 1); }
+};
+
+// Map wrapper that counts calls to isFree()
+template <typename Map>
+class CountingMap {
+public:
+    explicit CountingMap(const Map &map): map_(map), count_(0) { }
+
+    int width() const { return map_.width(); }
+    int height() const { return map_.height(); }
+    bool isFree(int x, int y) const { count_++; return map_.isFree(x, y); }
+
+    const Map &map() const { return map_; }
+    size_t count() const { return count_; }
+
+private:
+    const Map &map_;
+    mutable size_t count_;
+};
+
+// keep the free space skipping of the wrapped map
+template <typename Map>
+static inline int freeSteps(const CountingMap<Map> &map, int x, int y) { return raycast::freeSteps(map.map(), x, y); }
+
+static ObstacleMap loadMap(const std::string &path) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) throw std::runtime_error("Cannot open " + path);
+
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_infop info = png ? png_create_info_struct(png) : NULL;
+    if (!info || setjmp(png_jmpbuf(png))) {
+        png_destroy_read_struct(&png, &info, NULL);
+        fclose(file);
+        throw std::runtime_error("Cannot read " + path);
+    }
+    png_init_io(png, file);
+    png_read_info(png, info);
+    if (png_get_color_type(png, info) != PNG_COLOR_TYPE_PALETTE) {
+        png_destroy_read_struct(&png, &info, NULL);
+        fclose(file);
+        throw std::runtime_error("Invalid image format. Only images with indexed colors supported: " + path);
+    }
+    png_set_packing(png);
+    png_read_update_info(png, info);
+
+    png_colorp palette;
+    int paletteSize;
+    png_get_PLTE(png, info, &palette, &paletteSize);
+    int obstacleIndex = -1;
+    for (int i = 0; i < paletteSize && obstacleIndex < 0; i++) {
+        if (palette[i].red == 0 && palette[i].green == 0 && palette[i].blue == 0) obstacleIndex = i;
+    }
+    if (obstacleIndex < 0) fprintf(stderr, "warning: obstacle color not found in %s\n", path.c_str());
+
+    ObstacleMap map;
+    map.width = png_get_image_width(png, info);
+    map.height = png_get_image_height(png, info);
+    std::vector<png_byte> image((size_t)map.width * map.height);
+    std::vector<png_bytep> rows(map.height);
+    for (int y = 0; y < map.height; y++) rows[y] = &image[(size_t)y * map.width];
+    png_read_image(png, &rows[0]);
+    png_destroy_read_struct(&png, &info, NULL);
+    fclose(file);
+
+    map.cells.resize(image.size());
+    for (int x = 0; x < map.width; x++) {
+        for (int y = 0; y < map.height; y++) map.cells[(size_t)x * map.height + y] = image[(size_t)y * map.width + x] == obstacleIndex;
+    }
+    return map;
+}
+
+static double now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// column-major Kx3 matrix of poses in free space (metric coordinates)
+static std::vector<double> randomPoses(const ObstacleMap &map, const Options &opts, std::mt19937_64 &rng) {
+    std::uniform_real_distribution<double> ux(0.0, map.width), uy(0.0, map.height), utheta(-M_PI, M_PI);
+    size_t count = opts.poses;
+    std::vector<double> poses(3 * count);
+    for (size_t k = 0; k < count; k++) {
+        double x, y;
+        do {
+            x = ux(rng);
+            y = uy(rng);
+        } while (map.cells[(size_t)x * map.height + (size_t)y]);
+        poses[k] = x * opts.scale;
+        poses[k + count] = y * opts.scale;
+        poses[k + 2 * count] = utheta(rng);
+    }
+    return poses;
+}
+
+static ScanParameters scanParameters(const Options &opts) {
+    ScanParameters scan;
+    scan.scale = opts.scale;
+    scan.offset[0] = scan.offset[1] = 0.0;
+    scan.fieldOfView[0] = -opts.fieldOfView / 2.0 * M_PI / 180.0;
+    scan.fieldOfView[1] = opts.fieldOfView / 2.0 * M_PI / 180.0;
+    scan.increment = opts.increment * M_PI / 180.0;
+    scan.maxRange = opts.maxRange;
+    scan.error = 0.0;
+    scan.seed = opts.seed;
+    return scan;
+}
+
+// column-major Kx3 matrix of robot discs [x, y, radius] at the poses
+static std::vector<double> robotDiscs(const std::vector<double> &poses, const Options &opts) {
+    std::vector<double> discs(poses.begin(), poses.begin() + 3 * opts.poses);
+    std::fill(discs.begin() + 2 * opts.poses, discs.end(), opts.robotRadius);
+    return discs;
+}
+
+static void setRobotDiscs(ScanParameters &scan, const std::vector<double> &discs, const Options &opts) {
+    if (!(opts.robotRadius > 0.0)) return;
+    scan.discs = &discs[0];
+    scan.discCount = opts.poses;
+    scan.ownDiscs = true;
+}
+
+template <typename Map>
+static void benchmark(const char *mapName, const char *traversalName, const Map &map, Traversal traversal,
+                      WorkerPool &pool, const std::vector<double> &poses, const Options &opts) {
+    ScanParameters scan = scanParameters(opts);
+    std::vector<double> discs = robotDiscs(poses, opts);
+    setRobotDiscs(scan, discs, opts);
+    size_t poseCount = opts.poses, rayCount = scan.rayCount();
+    std::vector<double> range(poseCount * rayCount), bearing(rayCount);
+
+    RayCaster caster(traversal, &pool);
+    double best = HUGE_VAL;
+    for (unsigned r = 0; r < opts.repeat; r++) {
+        double t0 = now();
+        caster.castScan(map, &poses[0], poseCount, scan, &range[0], &bearing[0]);
+        best = std::min(best, now() - t0);
+    }
+
+    CountingMap<Map> countingMap(map);
+    RayCaster(traversal).castScan(countingMap, &poses[0], poseCount, scan, &range[0], &bearing[0]);
+
+    double rays = (double)poseCount * rayCount;
+    printf("  %-15s %-10s %12.0f %10.1f %10.1f\n", mapName, traversalName, rays / best, best / rays * 1e9,
+           (double)countingMap.count() / rays);
+}
+
+// Reference Bresenham traversal, walks the cells of the ray one by one
+// without separate code paths per octant. Reproduces the conventions of
+// RayCaster: cells are truncated, the map border counts as an obstacle,
+// range is the distance from the start cell to the last free cell.
+template <typename Map>
+static bool referenceBresenham(const Map &map, double startX, double startY, double endX, double endY, double &range) {
+    int xs = (int)startX, ys = (int)startY, xe = (int)endX, ye = (int)endY;
+    if (xs < 0 || ys < 0 || xs >= map.width() || ys >= map.height() || !map.isFree(xs, ys)) {
+        range = 0.0;
+        return true;
+    }
+    int dx = std::abs(xe - xs), dy = std::abs(ye - ys);
+    bool majorX = dx >= dy;
+    int n = majorX ? dx : dy, dMinor = majorX ? dy : dx;
+    int stepX = xe >= xs ? 1 : -1, stepY = ye >= ys ? 1 : -1;
+    int x = xs, y = ys, prevX = xs, prevY = ys;
+    int error = n >> 1;
+    bool isect = false;
+    for (int i = 0; i <= n; i++) {
+        if (x < 0 || y < 0 || x >= map.width() || y >= map.height() || !map.isFree(x, y)) {
+            isect = true;
+            break;
+        }
+        prevX = x;
+        prevY = y;
+        error -= dMinor;
+        if (error < 0) {
+            // stepping off the map along the minor axis ends the ray, even after the last cell
+            if (majorX) y += stepY;
+            else x += stepX;
+            if (x < 0 || y < 0 || x >= map.width() || y >= map.height()) {
+                isect = true;
+                break;
+            }
+            error += n;
+        }
+        if (majorX) x += stepX;
+        else y += stepY;
+    }
+    range = isect ? std::sqrt((double)((prevX - xs) * (prevX - xs) + (prevY - ys) * (prevY - ys))) :
+                    std::numeric_limits<double>::quiet_NaN();
+    return isect;
+}
+
+// Reference for the DDA traversal: intersects the ray with the box of every
+// cell in the columns it crosses (slab test) and returns the earliest entry
+// into an obstacle cell or a cell outside the map.
+template <typename Map>
+static bool referenceDDA(const Map &map, double startX, double startY, double endX, double endY, double &range) {
+    int xs = (int)std::floor(startX), ys = (int)std::floor(startY);
+    if (xs < 0 || ys < 0 || xs >= map.width() || ys >= map.height() || !map.isFree(xs, ys)) {
+        range = 0.0;
+        return true;
+    }
+    double dx = endX - startX, dy = endY - startY;
+    double tHit = HUGE_VAL;
+    int x0 = (int)std::floor(std::min(startX, endX)), x1 = (int)std::floor(std::max(startX, endX));
+    for (int x = x0; x <= x1; x++) {
+        // parameter interval of the ray within column x
+        double ta = 0.0, tb = 1.0;
+        if (dx != 0.0) {
+            double t0 = (x - startX) / dx, t1 = (x + 1 - startX) / dx;
+            ta = std::max(ta, std::min(t0, t1));
+            tb = std::min(tb, std::max(t0, t1));
+        }
+        if (ta > tb) continue;
+        double ya = startY + ta * dy, yb = startY + tb * dy;
+        int y0 = (int)std::floor(std::min(ya, yb)), y1 = (int)std::floor(std::max(ya, yb));
+        for (int y = y0; y <= y1; y++) {
+            if (x >= 0 && y >= 0 && x < map.width() && y < map.height() && map.isFree(x, y)) continue;
+            double tEnter = ta, tExit = tb;
+            if (dy != 0.0) {
+                double t0 = (y - startY) / dy, t1 = (y + 1 - startY) / dy;
+                tEnter = std::max(tEnter, std::min(t0, t1));
+                tExit = std::min(tExit, std::max(t0, t1));
+            } else if (startY < y || startY >= y + 1) continue;
+            if (tEnter < tExit || (tEnter == tExit && tEnter == 1.0)) tHit = std::min(tHit, tEnter);
+        }
+    }
+    if (tHit > 1.0) {
+        range = std::numeric_limits<double>::quiet_NaN();
+        return false;
+    }
+    range = tHit * std::sqrt(dx * dx + dy * dy);
+    return true;
+}
+
+struct Rays {
+    std::vector<double> startX, startY, endX, endY;
+    size_t size() const { return startX.size(); }
+    void add(double xs, double ys, double xe, double ye) {
+        startX.push_back(xs);
+        startY.push_back(ys);
+        endX.push_back(xe);
+        endY.push_back(ye);
+    }
+};
+
+// scan rays of all poses plus random segments that may start anywhere
+// (on obstacles, outside the map)
+static Rays verificationRays(const ObstacleMap &map, const std::vector<double> &poses, const Options &opts, std::mt19937_64 &rng) {
+    ScanParameters scan = scanParameters(opts);
+    Rays rays;
+    double length = scan.maxRange / scan.scale;
+    for (size_t k = 0; k < opts.poses; k++) {
+        double xs = poses[k] / scan.scale, ys = poses[k + opts.poses] / scan.scale;
+        for (size_t i = 0; i < scan.rayCount(); i++) {
+            double arc = wrapAngle(scan.fieldOfView[0] + i * scan.increment + poses[k + 2 * opts.poses]);
+            rays.add(xs, ys, xs + length * std::cos(arc), ys + length * std::sin(arc));
+        }
+    }
+    std::uniform_real_distribution<double> ux(-10.0, map.width + 10.0), uy(-10.0, map.height + 10.0);
+    for (size_t i = 0, n = rays.size(); i < n; i++) {
+        double xs = ux(rng), ys = uy(rng);
+        rays.add(xs, ys, ux(rng), uy(rng));
+    }
+    return rays;
+}
+
+static bool sameRange(double a, double b, double tolerance) {
+    if (std::isnan(a) || std::isnan(b)) return std::isnan(a) && std::isnan(b);
+    return std::fabs(a - b) <= tolerance;
+}
+
+// compares one configuration against the reference, returns the number of mismatches
+template <typename Map>
+static size_t verify(const char *mapName, const char *traversalName, const Map &map, Traversal traversal,
+                     WorkerPool &pool, const Rays &rays, const std::vector<bool> &refISect,
+                     const std::vector<double> &refRange) {
+    // DDA ranges are computed differently by the reference, allow for rounding
+    double tolerance = traversal == TRAVERSAL_DDA ? 1e-9 : 0.0;
+    size_t count = rays.size();
+    std::unique_ptr<bool[]> isect(new bool[count]);
+    std::vector<double> range(count);
+    RayCaster(traversal, &pool).castRays(map, count, &rays.startX[0], &rays.startY[0], &rays.endX[0], &rays.endY[0],
+                                         isect.get(), &range[0]);
+    size_t mismatches = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (isect[i] == refISect[i] && sameRange(range[i], refRange[i], tolerance)) continue;
+        if (mismatches++ < 5) {
+            printf("    mismatch: ray (%.6f, %.6f) -> (%.6f, %.6f): %d %.9f, expected %d %.9f\n",
+                   rays.startX[i], rays.startY[i], rays.endX[i], rays.endY[i],
+                   (int)isect[i], range[i], (int)refISect[i], refRange[i]);
+        }
+    }
+    printf("  %-15s %-10s %zu rays, %zu mismatches\n", mapName, traversalName, count, mismatches);
+    return mismatches;
+}
+
+// scans must not depend on the number of threads or the map representation.
+// Besides the configured thread count, the scans are repeated with 2 and 3
+// threads, which restarts the workers of the pool between the scans.
+template <typename Map>
+static size_t verifyScan(const char *mapName, const char *traversalName, const Map &map, Traversal traversal, WorkerPool &pool,
+                         const std::vector<double> &poses, const Options &opts, const std::vector<double> &expected) {
+    ScanParameters scan = scanParameters(opts);
+    scan.error = 0.01;
+    std::vector<double> discs = robotDiscs(poses, opts);
+    setRobotDiscs(scan, discs, opts);
+    std::vector<double> range(expected.size()), bearing(scan.rayCount());
+    const unsigned threadCounts[] = { opts.threads, 2, 3 };
+    bool same = true;
+    for (size_t i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); i++) {
+        pool.setThreadCount(threadCounts[i]);
+        RayCaster(traversal, &pool).castScan(map, &poses[0], opts.poses, scan, &range[0], &bearing[0]);
+        same = same && memcmp(&range[0], &expected[0], range.size() * sizeof(double)) == 0;
+    }
+    pool.setThreadCount(opts.threads);
+    printf("  %-15s %-10s scan %s\n", mapName, traversalName, same ? "identical" : "DIFFERS");
+    return same ? 0 : 1;
+}
+
+// Reference for scans with robot discs: the closer of the full-length ray
+// on the map and the first of all other robots' discs (solving the
+// quadratic directly)
+static size_t verifySwarm(const char *traversalName, const DenseMap<unsigned char> &dense, Traversal traversal, WorkerPool &pool,
+                          const std::vector<double> &poses, const Options &opts) {
+    ScanParameters scan = scanParameters(opts);
+    std::vector<double> discs = robotDiscs(poses, opts);
+    setRobotDiscs(scan, discs, opts);
+    size_t poseCount = opts.poses, rayCount = scan.rayCount();
+    std::vector<double> range(poseCount * rayCount), bearing(rayCount);
+    RayCaster(traversal, &pool).castScan(dense, &poses[0], poseCount, scan, &range[0], &bearing[0]);
+
+    size_t mismatches = 0, robotHits = 0;
+    double length = scan.maxRange / scan.scale;
+    for (size_t k = 0; k < poseCount; k++) {
+        double x = poses[k], y = poses[k + poseCount];
+        for (size_t i = 0; i < rayCount; i++) {
+            double arc = wrapAngle(bearing[i] + poses[k + 2 * poseCount]);
+            double c = std::cos(arc), s = std::sin(arc);
+            double expected = HUGE_VAL, mapRange;
+            double xs = x / scan.scale, ys = y / scan.scale, xe = xs + length * c, ye = ys + length * s;
+            if (traversal == TRAVERSAL_DDA ? referenceDDA(dense, xs, ys, xe, ye, mapRange) :
+                                             referenceBresenham(dense, xs, ys, xe, ye, mapRange))
+                expected = mapRange * scan.scale;
+            bool robot = false;
+            for (size_t d = 0; d < poseCount; d++) {
+                if (d == k) continue;
+                // |p + t u - c|^2 = r^2 for the smallest t >= 0
+                double dx = x - poses[d], dy = y - poses[d + poseCount];
+                double b = dx * c + dy * s, q = dx * dx + dy * dy - opts.robotRadius * opts.robotRadius;
+                double t = q <= 0.0 ? 0.0 : (b * b - q >= 0.0 && b < 0.0 ? -b - std::sqrt(b * b - q) : HUGE_VAL);
+                if (t <= scan.maxRange && t < expected) {
+                    expected = t;
+                    robot = true;
+                }
+            }
+            robotHits += robot;
+            double actual = range[k + i * poseCount];
+            if (std::isinf(actual) && std::isinf(expected)) continue;
+            if (std::fabs(actual - expected) <= 1e-9) continue;
+            if (mismatches++ < 5) printf("    mismatch: pose %zu ray %zu: %.9f, expected %.9f\n", k, i, actual, expected);
+        }
+    }
+    printf("  %-15s %-10s swarm %zu rays (%zu on robots), %zu mismatches\n", "dense", traversalName, range.size(), robotHits, mismatches);
+    return mismatches;
+}
+
+static size_t verifyMap(const ObstacleMap &map, const DenseMap<unsigned char> &dense, const TiledBitmap &bitmap,
+                        const DistanceField &distanceField, WorkerPool &pool, const std::vector<double> &poses,
+                        const Options &opts, std::mt19937_64 &rng) {
+    Rays rays = verificationRays(map, poses, opts, rng);
+    size_t mismatches = 0;
+    for (int t = 0; t < 2; t++) {
+        Traversal traversal = t == 0 ? TRAVERSAL_BRESENHAM : TRAVERSAL_DDA;
+        const char *traversalName = t == 0 ? "bresenham" : "dda";
+
+        std::vector<bool> refISect(rays.size());
+        std::vector<double> refRange(rays.size());
+        for (size_t i = 0; i < rays.size(); i++) {
+            double range;
+            refISect[i] = t == 0 ? referenceBresenham(dense, rays.startX[i], rays.startY[i], rays.endX[i], rays.endY[i], range) :
+                                   referenceDDA(dense, rays.startX[i], rays.startY[i], rays.endX[i], rays.endY[i], range);
+            refRange[i] = range;
+        }
+        mismatches += verify("dense", traversalName, dense, traversal, pool, rays, refISect, refRange);
+        mismatches += verify("bitmap", traversalName, bitmap, traversal, pool, rays, refISect, refRange);
+        mismatches += verify("distance field", traversalName, distanceField, traversal, pool, rays, refISect, refRange);
+
+        // single-threaded scan on the dense map as the baseline
+        ScanParameters scan = scanParameters(opts);
+        scan.error = 0.01;
+        std::vector<double> discs = robotDiscs(poses, opts);
+        setRobotDiscs(scan, discs, opts);
+        std::vector<double> expected(opts.poses * scan.rayCount()), bearing(scan.rayCount());
+        RayCaster(traversal).castScan(dense, &poses[0], opts.poses, scan, &expected[0], &bearing[0]);
+        mismatches += verifyScan("bitmap", traversalName, bitmap, traversal, pool, poses, opts, expected);
+        mismatches += verifyScan("distance field", traversalName, distanceField, traversal, pool, poses, opts, expected);
+        if (opts.robotRadius > 0.0) mismatches += verifySwarm(traversalName, dense, traversal, pool, poses, opts);
+    }
+    return mismatches;
+}
+
+static void usage() {
+    printf("Usage: raycast_benchmark [--poses n] [--fov deg] [--increment deg] [--max-range m] [--scale m]\n"
+           "                         [--robot-radius m] [--threads n] [--repeat n] [--seed n] [--verify] [map.png ...]\n");
+}
+
+static Options parseOptions(int argc, char **argv) {
+    Options opts;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--verify") {
+            opts.verify = true;
+            continue;
+        }
+        if (arg == "--help" || arg == "-h") {
+            usage();
+            exit(0);
+        }
+        if (arg.compare(0, 2, "--") != 0) {
+            opts.maps.push_back(arg);
+            continue;
+        }
+        if (i + 1 >= argc) throw std::runtime_error("Missing value for option " + arg);
+        const char *value = argv[++i];
+        if (arg == "--poses") opts.poses = strtoul(value, NULL, 10);
+        else if (arg == "--fov") opts.fieldOfView = atof(value);
+        else if (arg == "--increment") opts.increment = atof(value);
+        else if (arg == "--max-range") opts.maxRange = atof(value);
+        else if (arg == "--scale") opts.scale = atof(value);
+        else if (arg == "--robot-radius") opts.robotRadius = atof(value);
+        else if (arg == "--threads") opts.threads = (unsigned)strtoul(value, NULL, 10);
+        else if (arg == "--repeat") opts.repeat = (unsigned)strtoul(value, NULL, 10);
+        else if (arg == "--seed") opts.seed = strtoull(value, NULL, 10);
+        else throw std::runtime_error("Unknown option " + arg);
+    }
+    if (opts.poses == 0 || opts.repeat == 0 || !(opts.increment > 0.0) || !(opts.fieldOfView >= 0.0) ||
+        !(opts.maxRange >= 0.0) || !(opts.scale > 0.0) || !(opts.robotRadius >= 0.0))
+        throw std::runtime_error("Invalid option value");
+
+    if (opts.maps.empty()) {
+        // semicolon separated list set up by CMake
+        std::string maps = RAYCAST_DEFAULT_MAPS;
+        for (size_t begin = 0, end; begin < maps.size(); begin = end + 1) {
+            end = maps.find(';', begin);
+            if (end == std::string::npos) end = maps.size();
+            if (end > begin) opts.maps.push_back(maps.substr(begin, end - begin));
+        }
+    }
+    return opts;
+}
+
+int main(int argc, char **argv) {
+    try {
+        Options opts = parseOptions(argc, argv);
+        WorkerPool pool;
+        pool.setThreadCount(opts.threads);
+        std::mt19937_64 rng(opts.seed);
+
+        printf("%u thread(s), %zu poses, %.1f deg field of view, %.2f deg increment, %.2f m max range, %.3f m/cell\n",
+               pool.threadCount(), opts.poses, opts.fieldOfView, opts.increment, opts.maxRange, opts.scale);
+        if (opts.robotRadius > 0.0) printf("swarm: the poses are robots of %.3f m radius\n", opts.robotRadius);
+        size_t mismatches = 0;
+        for (size_t m = 0; m < opts.maps.size(); m++) {
+            ObstacleMap map = loadMap(opts.maps[m]);
+            size_t obstacles = 0;
+            for (size_t i = 0; i < map.cells.size(); i++) obstacles += map.cells[i];
+
+            DenseMap<unsigned char> dense = map.dense();
+            double t0 = now();
+            TiledBitmap bitmap(dense);
+            double t1 = now();
+            DistanceField distanceField(bitmap);
+            double t2 = now();
+            printf("\n%s: %dx%d cells, %.1f%% obstacles, bitmap %.1f ms, distance field %.1f ms\n",
+                   opts.maps[m].c_str(), map.width, map.height, 100.0 * obstacles / map.cells.size(),
+                   (t1 - t0) * 1e3, (t2 - t1) * 1e3);
+
+            std::vector<double> poses = randomPoses(map, opts, rng);
+            if (opts.verify) {
+                mismatches += verifyMap(map, dense, bitmap, distanceField, pool, poses, opts, rng);
+                continue;
+            }
+            printf("  %-15s %-10s %12s %10s %10s\n", "map", "traversal", "rays/s", "ns/ray", "cells/ray");
+            benchmark("dense", "bresenham", dense, TRAVERSAL_BRESENHAM, pool, poses, opts);
+            benchmark("dense", "dda", dense, TRAVERSAL_DDA, pool, poses, opts);
+            benchmark("bitmap", "bresenham", bitmap, TRAVERSAL_BRESENHAM, pool, poses, opts);
+            benchmark("bitmap", "dda", bitmap, TRAVERSAL_DDA, pool, poses, opts);
+            benchmark("distance field", "bresenham", distanceField, TRAVERSAL_BRESENHAM, pool, poses, opts);
+            benchmark("distance field", "dda", distanceField, TRAVERSAL_DDA, pool, poses, opts);
+        }
+        if (opts.verify) printf("\n%s\n", mismatches == 0 ? "all results match" : "MISMATCHES FOUND");
+        return mismatches == 0 ? 0 : 1;
+    } catch (const std::exception &e) {
+        fprintf(stderr, "error: %s\n", e.what());
+        usage();
+        return 2;
+    }
+}
@@ -0,0 +1,13 @@
+#ifndef RAYCAST_HPP
+#define RAYCAST_HPP
+
+// convenience header to include all components of the raycast:: library.
+// The library does not depend on Matlab, see blocks/mex_isect_gridmap_rays.cpp
+// and blocks/mex_landmark_index.cpp for the mex interfaces.
+
+#include <raycast/grid_maps.hpp>
+#include <raycast/landmark_index.hpp>
+#include <raycast/ray_caster.hpp>
+#include <raycast/worker_pool.hpp>
+
+#endif // RAYCAST_HPP
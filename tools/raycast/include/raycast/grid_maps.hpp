@@ -0,0 +1,182 @@
+#ifndef RAYCAST_GRID_MAPS_HPP
+#define RAYCAST_GRID_MAPS_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+namespace raycast {
+
+// Obstacle maps share a minimal interface: width(), height() and
+// isFree(x, y) for zero-based cell coordinates inside the map.
+
+// Access to a column-major matrix of cells (e.g. a Matlab matrix),
+// x is the column index, y the row index
+template <typename CellType>
+class DenseMap {
+public:
+    DenseMap(const CellType *pMap, int width, int height, CellType obstacleValue):
+        pMap_(pMap), obstacleValue_(obstacleValue), width_(width), height_(height), pitch_(height) { }
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    bool isFree(int x, int y) const { return pMap_[x * pitch_ + y] != obstacleValue_; }
+
+private:
+    const CellType *pMap_;
+    CellType obstacleValue_;
+    int width_, height_;
+    unsigned pitch_;
+};
+
+// Obstacle map with one bit per cell. Cells are grouped into tiles of 8x8
+// cells, each stored in a single 64 bit word, so a ray touches at most one
+// word per 8 cells in either direction.
+class TiledBitmap {
+public:
+    template <typename Map>
+    explicit TiledBitmap(const Map &map):
+        width_(map.width()), height_(map.height()),
+        tilesX_((width_ + 7) >> 3), tiles_((size_t)tilesX_ * ((height_ + 7) >> 3), 0) {
+        for (int x = 0; x < width_; x++) {
+            for (int y = 0; y < height_; y++) {
+                if (!map.isFree(x, y)) tiles_[tileIndex(x, y)] |= (uint64_t)1 << bitIndex(x, y);
+            }
+        }
+    }
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    bool isFree(int x, int y) const { return ((tiles_[tileIndex(x, y)] >> bitIndex(x, y)) & 1) == 0; }
+
+private:
+    size_t tileIndex(int x, int y) const { return (size_t)(y >> 3) * tilesX_ + (x >> 3); }
+    static unsigned bitIndex(int x, int y) { return ((y & 7) << 3) | (x & 7); }
+
+    int width_, height_, tilesX_;
+    std::vector<uint64_t> tiles_;
+};
+
+// one-dimensional squared distance transform (Felzenszwalb & Huttenlocher).
+// v receives the locations of the parabolas of the lower envelope, z the
+// boundaries between them.
+static inline void squaredDistanceTransform1d(const int64_t *f, int n, int64_t *d, int *v, double *z) {
+    int k = 0;
+    v[0] = 0;
+    z[0] = -HUGE_VAL;
+    z[1] = HUGE_VAL;
+    for (int q = 1; q < n; q++) {
+        double s;
+        while ((s = ((f[q] + (double)q * q) - (f[v[k]] + (double)v[k] * v[k])) / (2.0 * (q - v[k]))) <= z[k]) k--;
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = HUGE_VAL;
+    }
+    k = 0;
+    for (int q = 0; q < n; q++) {
+        while (z[k + 1] < q) k++;
+        d[q] = (int64_t)(q - v[k]) * (q - v[k]) + f[v[k]];
+    }
+}
+
+// Cells without an obstacle start with this value in squaredDistanceTransform.
+// Results of at least DISTANCE_INF mean that there is no obstacle at all.
+static const int64_t DISTANCE_INF = (int64_t)1 << 40;
+
+// Exact squared Euclidean distance transform of a column-major grid in
+// linear time: on input, obstacle cells are 0 and all others DISTANCE_INF,
+// on output every cell holds the squared distance (in cells) to the
+// nearest obstacle cell.
+static inline void squaredDistanceTransform(int64_t *dist, int width, int height) {
+    std::vector<int64_t> f(std::max(width, height)), d(f.size());
+    std::vector<int> v(f.size());
+    std::vector<double> z(f.size() + 1);
+    // columns: distance to the nearest obstacle in the same column by a
+    // forward and a backward scan, then squared
+    for (int x = 0; x < width; x++) {
+        int64_t *pColumn = dist + (size_t)x * height;
+        int64_t last = DISTANCE_INF;
+        for (int y = 0; y < height; y++) pColumn[y] = last = pColumn[y] == 0 ? 0 : std::min(last + 1, DISTANCE_INF);
+        last = DISTANCE_INF;
+        for (int y = height - 1; y >= 0; y--) pColumn[y] = last = std::min(pColumn[y], last + 1);
+        for (int y = 0; y < height; y++) {
+            if (pColumn[y] < DISTANCE_INF) pColumn[y] *= pColumn[y];
+        }
+    }
+    // rows are processed in blocks, so the strided accesses read whole cache lines
+    const int BLOCK = 16;
+    std::vector<int64_t> rows((size_t)BLOCK * width);
+    for (int y0 = 0; y0 < height; y0 += BLOCK) {
+        int blockHeight = std::min(BLOCK, height - y0);
+        for (int x = 0; x < width; x++) {
+            for (int b = 0; b < blockHeight; b++) rows[(size_t)b * width + x] = dist[(size_t)x * height + y0 + b];
+        }
+        for (int b = 0; b < blockHeight; b++) {
+            squaredDistanceTransform1d(&rows[(size_t)b * width], width, &d[0], &v[0], &z[0]);
+            std::copy(d.begin(), d.begin() + width, rows.begin() + (size_t)b * width);
+        }
+        for (int x = 0; x < width; x++) {
+            for (int b = 0; b < blockHeight; b++) dist[(size_t)x * height + y0 + b] = rows[(size_t)b * width + x];
+        }
+    }
+}
+
+// Obstacle map with a precomputed Euclidean distance transform for empty
+// space skipping. For every free cell it stores the number of Bresenham
+// steps that can be taken from that cell without reaching an obstacle or
+// leaving the map: k steps move a ray by at most (k, k) cells, so all of
+// them are free if 2 * k^2 is less than the squared distance to the
+// nearest obstacle. Cells outside the map count as obstacles. The table
+// doubles as the obstacle map, so each visited cell costs a single load.
+class DistanceField {
+public:
+    template <typename Map>
+    explicit DistanceField(const Map &map): width_(map.width()), height_(map.height()),
+        freeSteps_((size_t)width_ * height_) {
+        // squared distance transform of the map padded with a border of obstacles
+        int paddedWidth = width_ + 2, paddedHeight = height_ + 2;
+        std::vector<int64_t> dist((size_t)paddedWidth * paddedHeight);
+        for (int x = 0; x < paddedWidth; x++) {
+            for (int y = 0; y < paddedHeight; y++) {
+                bool obstacle = x == 0 || y == 0 || x > width_ || y > height_ || !map.isFree(x - 1, y - 1);
+                dist[(size_t)x * paddedHeight + y] = obstacle ? 0 : DISTANCE_INF;
+            }
+        }
+        squaredDistanceTransform(&dist[0], paddedWidth, paddedHeight); // the border keeps all results finite
+
+        for (int x = 0; x < width_; x++) {
+            for (int y = 0; y < height_; y++) {
+                int64_t d2 = dist[(size_t)(x + 1) * paddedHeight + y + 1];
+                int64_t k = d2 > 0 ? (int64_t)std::sqrt((double)(d2 - 1) / 2.0) : 0;
+                while (2 * (k + 1) * (k + 1) < d2) k++;
+                while (k > 0 && 2 * k * k >= d2) k--;
+                freeSteps_[(size_t)y * width_ + x] = d2 > 0 ? (uint8_t)std::min<int64_t>(k, OBSTACLE - 1) : OBSTACLE;
+            }
+        }
+    }
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    bool isFree(int x, int y) const { return freeSteps_[(size_t)y * width_ + x] != OBSTACLE; }
+    int freeSteps(int x, int y) const { return freeSteps_[(size_t)y * width_ + x]; } // only valid for free cells
+
+private:
+    static const uint8_t OBSTACLE = 0xFF;
+
+    int width_, height_;
+    std::vector<uint8_t> freeSteps_;
+};
+
+// Number of cells a ray may skip from (x, y). Only distance fields provide
+// this information, for all other maps every cell is visited.
+template <typename Map>
+static inline int freeSteps(const Map &, int, int) { return 0; }
+
+static inline int freeSteps(const DistanceField &map, int x, int y) { return map.freeSteps(x, y); }
+
+}
+
+#endif // RAYCAST_GRID_MAPS_HPP
@@ -0,0 +1,161 @@
+#ifndef RAYCAST_LANDMARK_INDEX_HPP
+#define RAYCAST_LANDMARK_INDEX_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include <raycast/ray_caster.hpp>
+
+namespace raycast {
+
+// A landmark as seen from a sensor pose: zero-based index into the landmark
+// list, metric range and bearing relative to the pose orientation
+struct LandmarkObservation {
+    size_t id;
+    double range;
+    double bearing;
+};
+
+// Uniform grid over a static set of point landmarks. The landmarks are
+// bucketed by grid cell (one contiguous id list per cell), a query only
+// visits the cells overlapping the bounding box of the sensor sector, so its
+// cost depends on the landmarks near the sensor rather than on the total
+// number of landmarks.
+class LandmarkIndex {
+public:
+    static const size_t MAX_CELLS_PER_LANDMARK = 4; // the cell size is increased if necessary
+
+    // count landmarks with coordinates (pX[i], pY[i]). Landmarks with
+    // non-finite coordinates are never reported.
+    LandmarkIndex(const double *pX, const double *pY, size_t count, double cellSize):
+        x_(pX, pX + count), y_(pY, pY + count), cellSize_(cellSize), columns_(1), rows_(1) {
+        double minX = HUGE_VAL, minY = HUGE_VAL, maxX = -HUGE_VAL, maxY = -HUGE_VAL;
+        for (size_t i = 0; i < count; i++) {
+            if (!isFinite(i)) continue;
+            minX = std::min(minX, x_[i]);
+            maxX = std::max(maxX, x_[i]);
+            minY = std::min(minY, y_[i]);
+            maxY = std::max(maxY, y_[i]);
+        }
+        if (minX > maxX) minX = maxX = minY = maxY = 0.0; // no finite landmarks
+        originX_ = minX;
+        originY_ = minY;
+
+        // limit the number of cells for tiny cell sizes or scattered landmarks
+        double maxCells = (double)MAX_CELLS_PER_LANDMARK * std::max<size_t>(count, 1);
+        double extent = std::max(maxX - minX, maxY - minY);
+        if (!(cellSize_ > 0.0)) cellSize_ = extent > 0.0 ? extent / std::sqrt((double)std::max<size_t>(count, 1)) : 1.0;
+        while ((std::floor((maxX - minX) / cellSize_) + 1) * (std::floor((maxY - minY) / cellSize_) + 1) > maxCells) cellSize_ *= 2.0;
+        columns_ = (int)std::floor((maxX - minX) / cellSize_) + 1;
+        rows_ = (int)std::floor((maxY - minY) / cellSize_) + 1;
+
+        // counting sort of the landmark ids by cell
+        cellStart_.assign((size_t)columns_ * rows_ + 1, 0);
+        for (size_t i = 0; i < count; i++) {
+            if (isFinite(i)) cellStart_[cellIndex(i) + 1]++;
+        }
+        for (size_t c = 1; c < cellStart_.size(); c++) cellStart_[c] += cellStart_[c - 1];
+        ids_.resize(cellStart_.back());
+        std::vector<size_t> next(cellStart_.begin(), cellStart_.end() - 1);
+        for (size_t i = 0; i < count; i++) {
+            if (isFinite(i)) ids_[next[cellIndex(i)]++] = i;
+        }
+    }
+
+    size_t size() const { return x_.size(); }
+    double cellSize() const { return cellSize_; }
+    double x(size_t id) const { return x_[id]; }
+    double y(size_t id) const { return y_[id]; }
+
+    // find all landmarks with range < maxRange and a bearing within
+    // [fieldOfView[0], fieldOfView[1]] as seen from pose [x, y, theta].
+    // Bearings are wrapped to [-pi, pi) like mod(bearing + pi, 2 * pi) - pi
+    // in Matlab before the test. result receives the observations in
+    // ascending id order.
+    void query(const double pose[3], double maxRange, const double fieldOfView[2],
+               std::vector<LandmarkObservation> &result) const {
+        result.clear();
+        if (!(maxRange > 0.0) || !(fieldOfView[1] >= fieldOfView[0])) return;
+
+        double bounds[4]; // minX, maxX, minY, maxY
+        sectorBounds(pose, maxRange, fieldOfView, bounds);
+        int x0 = cellColumn(bounds[0]), x1 = cellColumn(bounds[1]);
+        int y0 = cellRow(bounds[2]), y1 = cellRow(bounds[3]);
+        for (int cy = y0; cy <= y1; cy++) {
+            for (int cx = x0; cx <= x1; cx++) {
+                // skip cells outside the range disc
+                double dx = std::max(0.0, std::max(originX_ + cx * cellSize_ - pose[0], pose[0] - originX_ - (cx + 1) * cellSize_));
+                double dy = std::max(0.0, std::max(originY_ + cy * cellSize_ - pose[1], pose[1] - originY_ - (cy + 1) * cellSize_));
+                if (dx * dx + dy * dy > maxRange * maxRange * (1.0 + 1e-9)) continue;
+
+                size_t cell = (size_t)cy * columns_ + cx;
+                for (size_t k = cellStart_[cell]; k < cellStart_[cell + 1]; k++) {
+                    size_t id = ids_[k];
+                    double lx = x_[id] - pose[0], ly = y_[id] - pose[1];
+                    double bearing = wrapAngle(std::atan2(ly, lx) - pose[2]);
+                    if (bearing < fieldOfView[0] || bearing > fieldOfView[1]) continue;
+                    double range = std::sqrt(lx * lx + ly * ly);
+                    if (!(range < maxRange)) continue;
+                    LandmarkObservation observation = { id, range, bearing };
+                    result.push_back(observation);
+                }
+            }
+        }
+        std::sort(result.begin(), result.end(),
+                  [](const LandmarkObservation &a, const LandmarkObservation &b) { return a.id < b.id; });
+    }
+
+private:
+    bool isFinite(size_t i) const { return std::isfinite(x_[i]) && std::isfinite(y_[i]); }
+    size_t cellIndex(size_t i) const { return (size_t)cellRow(y_[i]) * columns_ + cellColumn(x_[i]); }
+    int cellColumn(double x) const { return clampCell((x - originX_) / cellSize_, columns_); }
+    int cellRow(double y) const { return clampCell((y - originY_) / cellSize_, rows_); }
+    static int clampCell(double c, int count) {
+        return c <= 0.0 ? 0 : (c >= count - 1 ? count - 1 : (int)c);
+    }
+
+    // axis aligned bounding box of the sector covered by the sensor. Wrapped
+    // bearings never leave [-pi, pi], so the field of view is clipped to that
+    // interval first. The box is padded slightly, it only has to contain the
+    // sector.
+    static void sectorBounds(const double pose[3], double radius, const double fieldOfView[2], double bounds[4]) {
+        double from = std::max(fieldOfView[0], -M_PI), to = std::min(fieldOfView[1], M_PI);
+        bounds[0] = bounds[1] = pose[0];
+        bounds[2] = bounds[3] = pose[1];
+        if (to - from >= 2.0 * M_PI - 1e-9) {
+            from = 0.0;
+            to = 2.0 * M_PI;
+        } else {
+            from += pose[2];
+            to += pose[2];
+            extend(pose, radius, from, bounds);
+            extend(pose, radius, to, bounds);
+        }
+        // the arc reaches the extreme point of an axis at each multiple of pi/2
+        for (double k = std::ceil(from / (0.5 * M_PI)); k * 0.5 * M_PI <= to; k++) extend(pose, radius, k * 0.5 * M_PI, bounds);
+        double padding = 1e-9 * radius;
+        bounds[0] -= padding;
+        bounds[1] += padding;
+        bounds[2] -= padding;
+        bounds[3] += padding;
+    }
+
+    static void extend(const double pose[3], double radius, double angle, double bounds[4]) {
+        double x = pose[0] + radius * std::cos(angle), y = pose[1] + radius * std::sin(angle);
+        bounds[0] = std::min(bounds[0], x);
+        bounds[1] = std::max(bounds[1], x);
+        bounds[2] = std::min(bounds[2], y);
+        bounds[3] = std::max(bounds[3], y);
+    }
+
+    std::vector<double> x_, y_;
+    double originX_, originY_, cellSize_;
+    int columns_, rows_;
+    std::vector<size_t> cellStart_; // ids_[cellStart_[c]] to ids_[cellStart_[c + 1] - 1] are in cell c
+    std::vector<size_t> ids_;
+};
+
+} // namespace raycast
+
+#endif // RAYCAST_LANDMARK_INDEX_HPP
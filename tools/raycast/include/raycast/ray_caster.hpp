@@ -0,0 +1,542 @@
+#ifndef RAYCAST_RAY_CASTER_HPP
+#define RAYCAST_RAY_CASTER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdint.h>
+#include <vector>
+#include <raycast/grid_maps.hpp>
+#include <raycast/worker_pool.hpp>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace raycast {
+
+enum Traversal {
+    TRAVERSAL_BRESENHAM,
+    TRAVERSAL_DDA
+};
+
+struct ScanParameters {
+    double scale;
+    double offset[2];
+    double fieldOfView[2];
+    double increment;
+    double maxRange;
+    double error;
+    uint64_t seed;
+    // optional dynamic obstacles, e.g. other robots: column-major discCount
+    // x 3 matrix of [x, y, radius] discs in metric world coordinates. With
+    // ownDiscs set, disc k is the body of pose k and ignored by its rays.
+    const double *discs;
+    size_t discCount;
+    bool ownDiscs;
+
+    ScanParameters(): discs(NULL), discCount(0), ownDiscs(false) { }
+
+    // number of rays generated by the Matlab expression fieldOfView(1):increment:fieldOfView(2)
+    size_t rayCount() const {
+        return (size_t)std::floor((fieldOfView[1] - fieldOfView[0]) / increment + 1e-9) + 1;
+    }
+};
+
+// Counter based gaussian noise: the sample only depends on the seed and the
+// ray index, not on the order in which rays are processed.
+static inline uint64_t splitMix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+static inline double gaussianNoise(uint64_t seed, uint64_t index) {
+    uint64_t r1 = splitMix64(seed ^ splitMix64(index));
+    uint64_t r2 = splitMix64(r1);
+    double u1 = ((r1 >> 11) + 1) * (1.0 / 9007199254740993.0); /* (0, 1] */
+    double u2 = (r2 >> 11) * (1.0 / 9007199254740992.0);       /* [0, 1) */
+    return std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * M_PI * u2);
+}
+
+// same as mod(angle + pi, 2 * pi) - pi in Matlab
+static inline double wrapAngle(double angle) {
+    angle += M_PI;
+    return angle - std::floor(angle / (2.0 * M_PI)) * (2.0 * M_PI) - M_PI;
+}
+
+// One axis of a ray from start to end (in cells), parametrized by t in [0, 1]
+struct DDAAxis {
+    DDAAxis(double start, double end): start(start), d(end - start), invD(1.0 / d),
+        exitOffset(d > 0.0 ? 1.0 : 0.0), step(d > 0.0 ? 1 : -1) { }
+
+    // time at which the ray leaves cell c, HUGE_VAL if it never does
+    double exitTime(int c) const { return d != 0.0 ? (c + exitOffset - start) * invD : HUGE_VAL; }
+
+    // cell containing the ray at time t, consistent with exitTime()
+    int cellAt(double t, int current) const {
+        if (d == 0.0) return current;
+        int c = (int)std::floor(start + t * d);
+        while (exitTime(c) <= t) c += step;
+        while (exitTime(c - step) > t) c -= step;
+        return c;
+    }
+
+    double start, d, invD, exitOffset;
+    int step;
+};
+
+// Uniform grid over the discs of a scan (ScanParameters::discs). Each disc is
+// listed in the cells its bounding box overlaps and a ray only tests the
+// discs of the cells it passes, nearest first, so the cost of a ray does not
+// grow with the number of discs. The cell size adapts to the disc density
+// (about one disc per cell) but is at least the largest diameter.
+class DiscGrid {
+public:
+    DiscGrid(const double *discs, size_t count): discs_(discs), count_(count), columns_(0), rows_(0), cellSize_(1.0) {
+        if (count == 0) return;
+        double minX = HUGE_VAL, minY = HUGE_VAL, maxX = -HUGE_VAL, maxY = -HUGE_VAL, maxRadius = 0.0;
+        for (size_t d = 0; d < count; d++) {
+            double r = radius(d);
+            minX = std::min(minX, x(d) - r);
+            minY = std::min(minY, y(d) - r);
+            maxX = std::max(maxX, x(d) + r);
+            maxY = std::max(maxY, y(d) + r);
+            maxRadius = std::max(maxRadius, r);
+        }
+        cellSize_ = std::max(2.0 * maxRadius, std::sqrt((maxX - minX) * (maxY - minY) / (double)count));
+        if (!(cellSize_ > 0.0)) cellSize_ = 1.0;
+        originX_ = minX;
+        originY_ = minY;
+        columns_ = (int)((maxX - minX) / cellSize_) + 1;
+        rows_ = (int)((maxY - minY) / cellSize_) + 1;
+
+        // counting sort of the discs by cell
+        cellBegin_.assign((size_t)columns_ * rows_ + 1, 0);
+        for (int pass = 0; pass < 2; pass++) {
+            if (pass == 1) {
+                for (size_t i = 1; i < cellBegin_.size(); i++) cellBegin_[i] += cellBegin_[i - 1];
+                items_.resize(cellBegin_.back());
+            }
+            std::vector<size_t> fill(cellBegin_.begin(), cellBegin_.end() - 1);
+            for (size_t d = 0; d < count; d++) {
+                double r = radius(d);
+                int x0 = column(x(d) - r), x1 = column(x(d) + r), y0 = row(y(d) - r), y1 = row(y(d) + r);
+                for (int cx = x0; cx <= x1; cx++) {
+                    for (int cy = y0; cy <= y1; cy++) {
+                        size_t cell = (size_t)cy * columns_ + cx;
+                        if (pass == 0) cellBegin_[cell + 1]++;
+                        else items_[fill[cell]++] = d;
+                    }
+                }
+            }
+        }
+    }
+
+    // distance from (px, py) in direction (c, s) (unit vector) to the first
+    // disc within maxRange, except disc skip. 0 if the point is inside a disc.
+    bool intersect(double px, double py, double c, double s, double maxRange, size_t skip, double &range) const {
+        if (count_ == 0) return false;
+        // clip the ray to the grid
+        double t0 = 0.0, t1 = maxRange;
+        if (!clip(px, c, originX_, originX_ + columns_ * cellSize_, t0, t1) ||
+            !clip(py, s, originY_, originY_ + rows_ * cellSize_, t0, t1)) return false;
+
+        int cx = std::min(std::max(column(px + t0 * c), 0), columns_ - 1);
+        int cy = std::min(std::max(row(py + t0 * s), 0), rows_ - 1);
+        int stepX = c > 0.0 ? 1 : -1, stepY = s > 0.0 ? 1 : -1;
+        double tDeltaX = c != 0.0 ? cellSize_ / std::fabs(c) : HUGE_VAL;
+        double tDeltaY = s != 0.0 ? cellSize_ / std::fabs(s) : HUGE_VAL;
+        double tMaxX = c != 0.0 ? (originX_ + (cx + (c > 0.0)) * cellSize_ - px) / c : HUGE_VAL;
+        double tMaxY = s != 0.0 ? (originY_ + (cy + (s > 0.0)) * cellSize_ - py) / s : HUGE_VAL;
+        double best = HUGE_VAL;
+        while (true) {
+            size_t cell = (size_t)cy * columns_ + cx;
+            for (size_t n = cellBegin_[cell]; n < cellBegin_[cell + 1]; n++) {
+                double t;
+                if (items_[n] != skip && intersectDisc(items_[n], px, py, c, s, t) && t < best) best = t;
+            }
+            // a hit within this cell is the closest one, discs are listed
+            // in every cell they overlap
+            double tExit = std::min(tMaxX, tMaxY);
+            if (best <= tExit || tExit > t1) break;
+            if (tMaxX < tMaxY) {
+                cx += stepX;
+                tMaxX += tDeltaX;
+            } else {
+                cy += stepY;
+                tMaxY += tDeltaY;
+            }
+            if (cx < 0 || cy < 0 || cx >= columns_ || cy >= rows_) break;
+        }
+        if (!(best <= maxRange)) return false;
+        range = best;
+        return true;
+    }
+
+private:
+    double x(size_t d) const { return discs_[d]; }
+    double y(size_t d) const { return discs_[d + count_]; }
+    double radius(size_t d) const { return discs_[d + 2 * count_]; }
+    int column(double px) const { return (int)std::floor((px - originX_) / cellSize_); }
+    int row(double py) const { return (int)std::floor((py - originY_) / cellSize_); }
+
+    // limits [t0, t1] to the part of the ray p + t * d within [lower, upper]
+    static bool clip(double p, double d, double lower, double upper, double &t0, double &t1) {
+        if (d == 0.0) return p >= lower && p <= upper;
+        double ta = (lower - p) / d, tb = (upper - p) / d;
+        t0 = std::max(t0, std::min(ta, tb));
+        t1 = std::min(t1, std::max(ta, tb));
+        return t0 <= t1;
+    }
+
+    bool intersectDisc(size_t d, double px, double py, double c, double s, double &t) const {
+        double dx = x(d) - px, dy = y(d) - py, r = radius(d);
+        double b = dx * c + dy * s, q = dx * dx + dy * dy - r * r;
+        if (q <= 0.0) {
+            t = 0.0;
+            return true;
+        }
+        double discriminant = b * b - q;
+        if (b <= 0.0 || discriminant < 0.0) return false;
+        t = b - std::sqrt(discriminant);
+        return true;
+    }
+
+    const double *discs_;
+    size_t count_;
+    int columns_, rows_;
+    double cellSize_, originX_, originY_;
+    std::vector<size_t> cellBegin_, items_;
+};
+
+// Casts rays on any obstacle map of grid_maps.hpp. Coordinates are given in
+// cells, cell (i, j) covers [i, i + 1) x [j, j + 1). Batches are spread over
+// the worker pool, if one is given; results do not depend on the number of
+// threads.
+class RayCaster {
+public:
+    static const size_t PARALLEL_MIN_RAYS = 1024;  // smaller batches are not worth waking up the workers
+    static const size_t PARALLEL_CHUNK_SIZE = 128; // rays per work item
+
+    explicit RayCaster(Traversal traversal = TRAVERSAL_BRESENHAM, WorkerPool *pool = NULL):
+        traversal_(traversal), pool_(pool) { }
+
+    // test count rays from (pStartX[i], pStartY[i]) to (pEndX[i], pEndY[i]).
+    // pISect receives true for each ray that intersects an obstacle, pRange
+    // (optional) the range in cells (see castRay).
+    template <typename Map>
+    void castRays(const Map &map, size_t count, const double *pStartX, const double *pStartY,
+                  const double *pEndX, const double *pEndY, bool *pISect, double *pRange = NULL) const {
+        forEachChunk(count, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                double range;
+                pISect[i] = castRay(map, pStartX[i], pStartY[i], pEndX[i], pEndY[i], range);
+                if (pRange) pRange[i] = range;
+            }
+        });
+    }
+
+    // generate a fan of scan.rayCount() rays for each of poseCount poses.
+    // pPoses is a column-major poseCount x 3 matrix of [x, y, theta] poses in
+    // metric world coordinates, pRange receives the column-major poseCount x
+    // rayCount matrix of metric ranges (inf when no intersection was found
+    // within scan.maxRange), pBearing the bearings relative to the pose.
+    template <typename Map>
+    void castScan(const Map &map, const double *pPoses, size_t poseCount, const ScanParameters &scan,
+                  double *pRange, double *pBearing) const {
+        size_t rayCount = scan.rayCount();
+        for (size_t i = 0; i < rayCount; i++) pBearing[i] = scan.fieldOfView[0] + i * scan.increment;
+
+        DiscGrid discGrid(scan.discs, scan.discCount);
+
+        // work items are all rays of all poses, pose-major
+        forEachChunk(poseCount * rayCount, [&](size_t begin, size_t end) {
+            for (size_t j = begin; j < end; j++) {
+                size_t k = j / rayCount, i = j % rayCount;
+                double arc = wrapAngle(pBearing[i] + pPoses[k + 2 * poseCount]);
+                double c = std::cos(arc), s = std::sin(arc);
+                double discRange = scan.maxRange;
+                bool discHit = scan.discCount > 0 &&
+                    discGrid.intersect(pPoses[k], pPoses[k + poseCount], c, s, scan.maxRange, scan.ownDiscs ? k : scan.discCount, discRange);
+                double xs = (pPoses[k] - scan.offset[0]) / scan.scale;
+                double ys = (pPoses[k + poseCount] - scan.offset[1]) / scan.scale;
+                // DDA searches the map only up to the closest disc. A shorter
+                // Bresenham line has a different slope and visits different
+                // cells, so Bresenham rays always take the full length.
+                double rayLength = (traversal_ == TRAVERSAL_DDA ? discRange : scan.maxRange) / scan.scale;
+                double range;
+                bool hit = castRay(map, xs, ys, xs + rayLength * c, ys + rayLength * s, range);
+                if (hit) range *= scan.scale;
+                if (discHit && (!hit || range > discRange)) {
+                    range = discRange;
+                    hit = true;
+                }
+                if (hit) {
+                    // apply distance-dependent gaussian noise
+                    if (scan.error > 0.0) range += scan.error * range * gaussianNoise(scan.seed, j);
+                } else range = std::numeric_limits<double>::infinity();
+                pRange[k + i * poseCount] = range;
+            }
+        });
+    }
+
+    // test a single ray given in (non-integer) cell coordinates. Returns
+    // true on intersection. range receives the distance in cells (see
+    // castRayBresenham and castRayDDA) or NaN when no intersection was found
+    template <typename Map>
+    bool castRay(const Map &map, double startX, double startY, double endX, double endY, double &range) const {
+        if (traversal_ == TRAVERSAL_DDA) return castRayDDA(map, startX, startY, endX, endY, range);
+        return castRayBresenham(map, startX, startY, endX, endY, range);
+    }
+
+private:
+    template <typename Fn>
+    void forEachChunk(size_t count, Fn fn) const {
+        if (pool_ && count >= PARALLEL_MIN_RAYS) pool_->parallelFor(count, PARALLEL_CHUNK_SIZE, fn);
+        else fn((size_t)0, count);
+    }
+
+    // Bresenham mode: range is the distance from the start cell to the last
+    // free cell
+    template <typename Map>
+    bool castRayBresenham(const Map &map, double startX, double startY, double endX, double endY, double &range) const {
+        int xs = (int)startX; /* add rounding constant of 0.5 and subtract Matlab array-start-with-1-offset */
+        int ys = (int)startY;
+        if (xs >= 0 && ys >= 0 && xs < map.width() && ys < map.height()) {
+            if (map.isFree(xs, ys)) {
+                int prevX, prevY;
+                bool isect = traceRay(map, xs, ys, (int)endX, (int)endY, prevX, prevY);
+                range = isect ? std::sqrt((double)((prevX - xs) * (prevX - xs) + (prevY - ys) * (prevY - ys))) :
+                                std::numeric_limits<double>::signaling_NaN();
+                return isect;
+            }
+        }
+
+        // ray starts off the map or the start position is an obstacle
+        range = 0.0;
+        return true;
+    }
+
+    // DDA mode (Amanatides & Woo): visits every cell touched by the ray, range
+    // is the exact distance from the start point to the boundary of the first
+    // obstacle cell. Boundary crossing times are computed from the cell index
+    // instead of being accumulated, so they do not depend on how the ray got
+    // to a cell. On distance fields, free space is skipped by jumping along
+    // the ray and locating the cell at the landing point.
+    template <typename Map>
+    bool castRayDDA(const Map &map, double startX, double startY, double endX, double endY, double &range) const {
+        int x = (int)std::floor(startX), y = (int)std::floor(startY);
+        if (x < 0 || y < 0 || x >= map.width() || y >= map.height() || !map.isFree(x, y)) {
+            // ray starts off the map or the start position is an obstacle
+            range = 0.0;
+            return true;
+        }
+
+        DDAAxis ax(startX, endX), ay(startY, endY);
+        double length = std::sqrt(ax.d * ax.d + ay.d * ay.d);
+        double tMaxX = ax.exitTime(x), tMaxY = ay.exitTime(y);
+        while (true) {
+            double t;
+            if (tMaxX < tMaxY) {
+                t = tMaxX;
+                x += ax.step;
+                tMaxX = ax.exitTime(x);
+            } else {
+                t = tMaxY;
+                y += ay.step;
+                tMaxY = ay.exitTime(y);
+            }
+            if (t > 1.0) break;
+            // like the Bresenham traversal, the map border blocks the ray
+            if (x < 0 || y < 0 || x >= map.width() || y >= map.height() || !map.isFree(x, y)) {
+                range = t * length;
+                return true;
+            }
+
+            int k = freeSteps(map, x, y);
+            if (k >= 2) {
+                // the ray is inside the current cell, whose center has a clearance
+                // above k * sqrt(2). Every cell entered within (k - 1) * sqrt(2)
+                // from here is free and inside the map (see DistanceField).
+                t += 1.414 * (k - 1) / length;
+                if (t >= 1.0) break;
+                x = ax.cellAt(t, x);
+                y = ay.cellAt(t, y);
+                tMaxX = ax.exitTime(x);
+                tMaxY = ay.exitTime(y);
+            }
+        }
+        range = std::numeric_limits<double>::signaling_NaN();
+        return false;
+    }
+
+    // Bresenham traversal from a free start cell inside the map. prevX/prevY
+    // receive the last free cell on the ray. On distance fields, runs of free
+    // cells are skipped in one go; the error term is advanced by the same
+    // amount, so the visited cells are identical to the cell by cell walk.
+    template <typename Map>
+    bool traceRay(const Map &map, int xs, int ys, int xe, int ye, int &prevX, int &prevY) const {
+        int width = map.width(), height = map.height();
+        int dx = xe - xs;
+        int dy = ye - ys;
+        int x, y;
+        bool isect;
+
+#define CHECK_CELL \
+    if (map.isFree(x, y)) { \
+        prevX = x; \
+        prevY = y; \
+    } else break;
+
+// skip up to 'remaining' steps along the major axis, the minor axis follows
+// the accumulated error term
+#define SKIP_FREE_CELLS(major, majorStep, remaining, minor, minorStep, dMajor, dMinor) \
+    { \
+        int k = std::min(freeSteps(map, x, y), remaining); \
+        if (k > 0) { \
+            major += majorStep * k; \
+            error -= k * dMinor; \
+            int n = (dMajor - 1 - error) / dMajor; \
+            minor += minorStep * n; \
+            error += n * dMajor; \
+            prevX = x; \
+            prevY = y; \
+        } \
+    }
+
+        if (dx >= 0) { /* octants 1, 2, 7, 8 */
+            if (dy >= 0) { /* octants 1, 2 */
+                if (dx >= dy) { /* octant 1 */
+                    int error = dx >> 1;
+                    int xe_ = xe < width ? xe : (width - 1);
+                    for(prevX = x = xs, prevY = y = ys; x <= xe_; x++) {
+                        CHECK_CELL
+                        SKIP_FREE_CELLS(x, 1, xe_ - x, y, 1, dx, dy)
+                        error -= dy;
+                        if (error < 0) {
+                            if (++y >= height) break;
+                            error += dx;
+                        }
+                    }
+                    isect = (x <= xe);
+                } else { /* octant 2 */
+                    int error = dy >> 1;
+                    int ye_ = ye < height ? ye : (height - 1);
+                    for(prevX = x = xs, prevY = y = ys; y <= ye_; y++) {
+                        CHECK_CELL
+                        SKIP_FREE_CELLS(y, 1, ye_ - y, x, 1, dy, dx)
+                        error -= dx;
+                        if (error < 0) {
+                            if (++x >= width) break;
+                            error += dy;
+                        }
+                    }
+                    isect = (y <= ye);
+                }
+            } else { /* octants 7, 8 */
+                dy = -dy;
+                if ( dx >= dy) { /* octant 8 */
+                    int error = dx >> 1;
+                    int xe_ = xe < width ? xe : (width - 1);
+                    for(prevX = x = xs, prevY = y = ys; x <= xe_; x++) {
+                        CHECK_CELL
+                        SKIP_FREE_CELLS(x, 1, xe_ - x, y, -1, dx, dy)
+                        error -= dy;
+                        if (error < 0) {
+                            if (--y < 0) break;
+                            error += dx;
+                        }
+                    }
+                    isect = (x <= xe);
+                } else { /* octant 7 */
+                    int error = dy >> 1;
+                    int ye_ = ye < 0 ? 0 : ye;
+                    for(prevX = x = xs, prevY = y = ys; y >= ye_; y--) {
+                        CHECK_CELL
+                        SKIP_FREE_CELLS(y, -1, y - ye_, x, 1, dy, dx)
+                        error -= dx;
+                        if (error < 0) {
+                            if (++x >= width) break;
+                            error += dy;
+                        }
+                    }
+                    isect = (y >= ye);
+                }
+            }
+        } else { /* octants 3-6 */
+            dx = -dx;
+            if (dy >= 0) { /* octants 3, 4 */
+                if (dx >= dy) { /* octant 4 */
+                    int error = dx >> 1;
+                    int xe_ = xe < 0 ? 0 : xe;
+                    for(prevX = x = xs, prevY = y = ys; x >= xe_; x--) {
+                        CHECK_CELL
+                        SKIP_FREE_CELLS(x, -1, x - xe_, y, 1, dx, dy)
+                        error -= dy;
+                        if (error < 0) {
+                            if (++y >= height) break;
+                            error += dx;
+                        }
+                    }
+                    isect = (x >= xe);
+                } else { /* octant 3 */
+                    int error = dy >> 1;
+                    int ye_ = ye < height ? ye : (height - 1);
+                    for(prevX = x = xs, prevY = y = ys; y <= ye_; y++) {
+                        CHECK_CELL
+                        SKIP_FREE_CELLS(y, 1, ye_ - y, x, -1, dy, dx)
+                        error -= dx;
+                        if (error < 0) {
+                            if (--x < 0) break;
+                            error += dy;
+                        }
+                    }
+                    isect = (y <= ye);
+                }
+            } else { /* octants 5, 6 */
+                dy = -dy;
+                if (dx >= dy) { /* octant 5 */
+                    int error = dx >> 1;
+                    int xe_ = xe < 0 ? 0 : xe;
+                    for(prevX = x = xs, prevY = y = ys; x >= xe_; x--) {
+                        CHECK_CELL
+                        SKIP_FREE_CELLS(x, -1, x - xe_, y, -1, dx, dy)
+                        error -= dy;
+                        if (error < 0) {
+                            if (--y < 0) break;
+                            error += dx;
+                        }
+                    }
+                    isect = (x >= xe);
+                } else { /* octant 6 */
+                    int error = dy >> 1;
+                    int ye_ = ye < 0 ? 0 : ye;
+                    for(prevX = x = xs, prevY = y = ys; y >= ye_; y--) {
+                        CHECK_CELL
+                        SKIP_FREE_CELLS(y, -1, y - ye_, x, -1, dy, dx)
+                        error -= dx;
+                        if (error < 0) {
+                            if (--x < 0) break;
+                            error += dy;
+                        }
+                    }
+                    isect = (y >= ye);
+                }
+            }
+        }
+#undef CHECK_CELL
+#undef SKIP_FREE_CELLS
+
+        return isect;
+    }
+
+    Traversal traversal_;
+    WorkerPool *pool_;
+};
+
+}
+
+#endif // RAYCAST_RAY_CASTER_HPP
@@ -0,0 +1,119 @@
+#ifndef RAYCAST_WORKER_POOL_HPP
+#define RAYCAST_WORKER_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+namespace raycast {
+
+// Persistent pool of worker threads. The threads are created on the first
+// parallel job and survive until shutdown() or destruction, e.g. between
+// calls to a mex function. The calling thread takes part in each job.
+class WorkerPool {
+public:
+    WorkerPool(): threadCount_(0), generation_(0), activeWorkers_(0), stop_(false) { }
+    ~WorkerPool() { shutdown(); }
+
+    // 0 selects the number of hardware threads
+    void setThreadCount(unsigned count) {
+        if (count != threadCount_) shutdown();
+        threadCount_ = count;
+    }
+    unsigned threadCount() const {
+        if (threadCount_ > 0) return threadCount_;
+        unsigned hwThreads = std::thread::hardware_concurrency();
+        return hwThreads > 0 ? hwThreads : 1;
+    }
+
+    // call fn(begin, end) for consecutive chunks of [0, count). Returns
+    // after all chunks are processed. Jobs of a single chunk run on the
+    // calling thread only.
+    template <typename Fn>
+    void parallelFor(size_t count, size_t chunkSize, Fn fn) {
+        if (count <= chunkSize || threadCount() <= 1) {
+            fn((size_t)0, count);
+            return;
+        }
+        startWorkers();
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        job_ = fn;
+        jobCount_ = count;
+        chunkSize_ = chunkSize;
+        nextChunk_ = 0;
+        activeWorkers_ = workers_.size();
+        generation_++;
+        lock.unlock();
+        wake_.notify_all();
+
+        processChunks();
+
+        lock.lock();
+        while (activeWorkers_ > 0) done_.wait(lock);
+        job_ = nullptr;
+    }
+
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto it = workers_.begin(); it != workers_.end(); ++it) it->join();
+        workers_.clear();
+        stop_ = false;
+    }
+
+private:
+    void startWorkers() {
+        size_t count = threadCount() - 1;
+        // new workers must not take the generation of a finished job
+        // (generation_ is only changed by the calling thread)
+        while (workers_.size() < count) workers_.push_back(std::thread(&WorkerPool::workerLoop, this, generation_));
+    }
+
+    void processChunks() {
+        size_t chunk;
+        while ((chunk = nextChunk_++) * chunkSize_ < jobCount_) {
+            size_t begin = chunk * chunkSize_;
+            job_(begin, std::min(begin + chunkSize_, jobCount_));
+        }
+    }
+
+    void workerLoop(uint64_t lastGeneration) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            while (!stop_ && generation_ == lastGeneration) wake_.wait(lock);
+            if (stop_) return;
+            lastGeneration = generation_;
+            lock.unlock();
+
+            processChunks();
+
+            lock.lock();
+            if (--activeWorkers_ == 0) done_.notify_one();
+        }
+    }
+
+    unsigned threadCount_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_, done_;
+    std::function<void(size_t, size_t)> job_;
+    size_t jobCount_, chunkSize_;
+    std::atomic<size_t> nextChunk_;
+    uint64_t generation_;
+    size_t activeWorkers_;
+    bool stop_;
+};
+
+}
+
+#endif // RAYCAST_WORKER_POOL_HPP